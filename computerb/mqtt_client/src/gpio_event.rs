@@ -0,0 +1,234 @@
+//! Decoder for the compact binary GPIO event frames published by the ESP32
+//! on `/esp32_gpio/events` (see `main/gpio_event_codec.h` in the firmware).
+//!
+//! Frame layout, version 1 (little-endian):
+//! version (u8), count (u8), first sequence number (u32),
+//! first timestamp in microseconds (u64), then per event a pin/edge byte
+//! (pin in bits 0-5, bit 7 set for a rising edge) and a varint timestamp delta.
+
+use std::fmt;
+
+/// Frame version understood by this decoder
+pub const FRAME_VERSION: u8 = 1;
+const HEADER_LEN: usize = 14;
+
+/// Level transition seen on a pin
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Edge {
+    Falling,
+    Rising,
+}
+
+/// One decoded GPIO event
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct GpioEvent {
+    pub seq: u32,
+    pub pin: u8,
+    pub edge: Edge,
+    /// Monotonic device time, microseconds since boot
+    pub timestamp_us: u64,
+}
+
+#[derive(Debug, PartialEq, Eq)]
+pub enum DecodeError {
+    Truncated,
+    UnsupportedVersion(u8),
+    BadVarint,
+    /// Timestamp delta taking the event time past u64::MAX
+    TimestampOverflow,
+}
+
+impl fmt::Display for DecodeError {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self {
+            DecodeError::Truncated => write!(f, "frame is truncated"),
+            DecodeError::UnsupportedVersion(v) => write!(f, "unsupported frame version {}", v),
+            DecodeError::BadVarint => write!(f, "malformed timestamp delta"),
+            DecodeError::TimestampOverflow => write!(f, "timestamp delta overflows"),
+        }
+    }
+}
+
+impl std::error::Error for DecodeError {}
+
+/// Read an unsigned LEB128 varint, returns the value and the bytes consumed
+fn read_varint(buf: &[u8]) -> Result<(u64, usize), DecodeError> {
+    let mut value: u64 = 0;
+    for (i, byte) in buf.iter().enumerate().take(10) {
+        value |= ((byte & 0x7F) as u64) << (7 * i);
+        if byte & 0x80 == 0 {
+            return Ok((value, i + 1));
+        }
+    }
+    if buf.len() < 10 {
+        Err(DecodeError::Truncated)
+    } else {
+        Err(DecodeError::BadVarint)
+    }
+}
+
+/// Decode one frame into its events
+pub fn decode(frame: &[u8]) -> Result<Vec<GpioEvent>, DecodeError> {
+    if frame.is_empty() {
+        return Err(DecodeError::Truncated);
+    }
+    if frame[0] != FRAME_VERSION {
+        return Err(DecodeError::UnsupportedVersion(frame[0]));
+    }
+    if frame.len() < HEADER_LEN {
+        return Err(DecodeError::Truncated);
+    }
+
+    let count = frame[1] as usize;
+    let first_seq = u32::from_le_bytes(frame[2..6].try_into().unwrap());
+    let mut timestamp_us = u64::from_le_bytes(frame[6..14].try_into().unwrap());
+
+    let mut events = Vec::with_capacity(count);
+    let mut pos = HEADER_LEN;
+    for i in 0..count {
+        let pin_edge = *frame.get(pos).ok_or(DecodeError::Truncated)?;
+        let (delta, used) = read_varint(&frame[pos + 1..])?;
+        pos += 1 + used;
+        // Frames come from the broker: a hostile delta must not panic or wrap
+        timestamp_us = timestamp_us.checked_add(delta).ok_or(DecodeError::TimestampOverflow)?;
+
+        events.push(GpioEvent {
+            seq: first_seq.wrapping_add(i as u32),
+            pin: pin_edge & 0x3F,
+            edge: if pin_edge & 0x80 != 0 { Edge::Rising } else { Edge::Falling },
+            timestamp_us,
+        });
+    }
+    Ok(events)
+}
+
+/// Tracks sequence numbers across frames to report lost events
+#[derive(Debug, Default)]
+pub struct GapDetector {
+    next_seq: Option<u32>,
+}
+
+impl GapDetector {
+    /// Record a decoded frame, returns how many events were missed before it
+    pub fn observe(&mut self, events: &[GpioEvent]) -> u32 {
+        let (first, last) = match (events.first(), events.last()) {
+            (Some(first), Some(last)) => (first.seq, last.seq),
+            _ => return 0,
+        };
+        let missed = match self.next_seq {
+            // A sequence number lower than expected means the device restarted
+            Some(expected) if first.wrapping_sub(expected) < u32::MAX / 2 => first.wrapping_sub(expected),
+            _ => 0,
+        };
+        self.next_seq = Some(last.wrapping_add(1));
+        missed
+    }
+}
+
+/// Estimates delivery latency from device timestamps.
+///
+/// Device and host clocks are not synchronised, so the smallest observed
+/// offset (host receive time minus device event time) is taken as the
+/// baseline and the latency of an event is reported relative to it.
+#[derive(Debug, Default)]
+pub struct LatencyTracker {
+    min_offset_us: Option<i128>,
+}
+
+impl LatencyTracker {
+    /// Record an event received at `host_us`, returns its delay above the baseline
+    pub fn observe(&mut self, event: &GpioEvent, host_us: u64) -> u64 {
+        let offset = host_us as i128 - event.timestamp_us as i128;
+        let min = self.min_offset_us.map_or(offset, |min| min.min(offset));
+        self.min_offset_us = Some(min);
+        (offset - min) as u64
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // Frame produced by gpio_event_encode() for pin 4 rising at t=1000 us
+    // and pin 5 falling 300 us later, first sequence number 7
+    const TWO_EVENTS: [u8; 19] = [
+        1, 2, 7, 0, 0, 0, 0xE8, 0x03, 0, 0, 0, 0, 0, 0, // header
+        0x84, 0x00, // pin 4 rising, +0 us
+        0x05, 0xAC, 0x02, // pin 5 falling, +300 us
+    ];
+
+    #[test]
+    fn decodes_events() {
+        let events = decode(&TWO_EVENTS).unwrap();
+        assert_eq!(
+            events,
+            vec![
+                GpioEvent { seq: 7, pin: 4, edge: Edge::Rising, timestamp_us: 1000 },
+                GpioEvent { seq: 8, pin: 5, edge: Edge::Falling, timestamp_us: 1300 },
+            ]
+        );
+    }
+
+    // Frame encoded by the firmware's gpio_event_encode(), checked against it
+    // by host_test/test_gpio_event_codec.c
+    const FIRMWARE_FRAME: &[u8] = include_bytes!("../../../host_test/fixtures/gpio_events_v1.bin");
+
+    #[test]
+    fn decodes_firmware_frame() {
+        let events = decode(FIRMWARE_FRAME).unwrap();
+        assert_eq!(
+            events,
+            vec![
+                GpioEvent { seq: 41, pin: 4, edge: Edge::Rising, timestamp_us: 1000 },
+                GpioEvent { seq: 42, pin: 5, edge: Edge::Falling, timestamp_us: 1300 },
+                GpioEvent { seq: 43, pin: 63, edge: Edge::Rising, timestamp_us: 201_300 },
+                GpioEvent { seq: 44, pin: 0, edge: Edge::Falling, timestamp_us: 5_000_201_300 },
+            ]
+        );
+    }
+
+    #[test]
+    fn rejects_bad_frames() {
+        assert_eq!(decode(&TWO_EVENTS[..17]), Err(DecodeError::Truncated));
+        let mut future = TWO_EVENTS;
+        future[0] = 2;
+        assert_eq!(decode(&future), Err(DecodeError::UnsupportedVersion(2)));
+    }
+
+    #[test]
+    fn rejects_overflowing_timestamp() {
+        let mut frame = vec![1, 1, 0, 0, 0, 0];
+        frame.extend_from_slice(&(u64::MAX - 10).to_le_bytes());
+        // Pin 4 rising, +11 us in LEB128
+        frame.extend_from_slice(&[0x84, 0x0B]);
+        assert_eq!(decode(&frame), Err(DecodeError::TimestampOverflow));
+        // Largest delta a varint holds
+        frame.truncate(HEADER_LEN + 1);
+        frame.extend_from_slice(&[0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01]);
+        assert_eq!(decode(&frame), Err(DecodeError::TimestampOverflow));
+        // Up to u64::MAX is fine
+        frame.truncate(HEADER_LEN + 1);
+        frame.push(0x0A);
+        assert_eq!(decode(&frame).unwrap()[0].timestamp_us, u64::MAX);
+    }
+
+    #[test]
+    fn detects_gaps() {
+        let mut gaps = GapDetector::default();
+        let events = decode(&TWO_EVENTS).unwrap();
+        assert_eq!(gaps.observe(&events), 0);
+
+        let mut later = TWO_EVENTS;
+        later[2] = 12; // seq 9, 10 and 11 never arrived
+        assert_eq!(gaps.observe(&decode(&later).unwrap()), 3);
+    }
+
+    #[test]
+    fn latency_is_relative_to_fastest_delivery() {
+        let events = decode(&TWO_EVENTS).unwrap();
+        let mut latency = LatencyTracker::default();
+        assert_eq!(latency.observe(&events[0], 51_000), 0);
+        // Second event happened 300 us later but arrived 2300 us later
+        assert_eq!(latency.observe(&events[1], 53_300), 2_000);
+    }
+}
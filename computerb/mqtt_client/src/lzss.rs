@@ -0,0 +1,165 @@
+//! LZSS codec matching `main/lzss.h` in the firmware, used for the
+//! conversation payloads flagged as compressed in their part header.
+//!
+//! Stream format: a flag byte announces the next 8 items, bit i set when item
+//! i is a match. A literal is one byte; a match is a little-endian u16 with
+//! the length minus 3 in bits 0-4 and the distance minus 1 in bits 5-15.
+
+use std::fmt;
+
+const WINDOW: usize = 2048;
+const MIN_MATCH: usize = 3;
+const MAX_MATCH: usize = MIN_MATCH + 31;
+const HASH_BITS: u32 = 8;
+const HASH_WAYS: usize = 4;
+
+#[derive(Debug, PartialEq, Eq)]
+pub enum DecodeError {
+    Truncated,
+    BadDistance,
+    TooLong,
+}
+
+impl fmt::Display for DecodeError {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self {
+            DecodeError::Truncated => write!(f, "compressed stream is truncated"),
+            DecodeError::BadDistance => write!(f, "match refers to data before the start"),
+            DecodeError::TooLong => write!(f, "decompressed data exceeds the limit"),
+        }
+    }
+}
+
+impl std::error::Error for DecodeError {}
+
+fn hash3(p: &[u8]) -> usize {
+    let v = p[0] as u32 | (p[1] as u32) << 8 | (p[2] as u32) << 16;
+    (v.wrapping_mul(2654435761) >> (32 - HASH_BITS)) as usize
+}
+
+/// Compress a whole message, same algorithm as the firmware encoder
+pub fn encode(input: &[u8]) -> Vec<u8> {
+    // Recent positions of each 3-byte hash, most recent first
+    let mut head = vec![[None::<usize>; HASH_WAYS]; 1 << HASH_BITS];
+    let index = |head: &mut Vec<[Option<usize>; HASH_WAYS]>, pos: usize| {
+        let ways = &mut head[hash3(&input[pos..])];
+        let before = *ways;
+        ways.copy_within(0..HASH_WAYS - 1, 1);
+        ways[0] = Some(pos);
+        before
+    };
+
+    let mut out = Vec::with_capacity(input.len() + input.len() / 8 + 1);
+    let mut pos = 0;
+    while pos < input.len() {
+        let flags_at = out.len();
+        out.push(0u8);
+        for bit in 0..8 {
+            if pos == input.len() {
+                break;
+            }
+            let left = input.len() - pos;
+            let mut best = (0, 0);
+            if left >= MIN_MATCH {
+                let max = left.min(MAX_MATCH);
+                for cand in index(&mut head, pos).into_iter().flatten() {
+                    if pos - cand > WINDOW {
+                        break;
+                    }
+                    let len = (0..max).take_while(|&k| input[cand + k] == input[pos + k]).count();
+                    if len > best.0 {
+                        best = (len, pos - cand);
+                    }
+                }
+            }
+
+            let (len, dist) = best;
+            if len >= MIN_MATCH {
+                let token = ((dist - 1) << 5 | (len - MIN_MATCH)) as u16;
+                out[flags_at] |= 1 << bit;
+                out.extend_from_slice(&token.to_le_bytes());
+                for k in 1..len {
+                    if pos + k + MIN_MATCH <= input.len() {
+                        index(&mut head, pos + k);
+                    }
+                }
+                pos += len;
+            } else {
+                out.push(input[pos]);
+                pos += 1;
+            }
+        }
+    }
+    out
+}
+
+/// Decompress a whole stream, refusing to produce more than `max_len` bytes
+pub fn decode(input: &[u8], max_len: usize) -> Result<Vec<u8>, DecodeError> {
+    let mut out: Vec<u8> = Vec::new();
+    let mut i = 0;
+    while i < input.len() {
+        let flags = input[i];
+        i += 1;
+        for bit in 0..8 {
+            if i == input.len() {
+                break;
+            }
+            if flags & (1 << bit) != 0 {
+                let bytes = input.get(i..i + 2).ok_or(DecodeError::Truncated)?;
+                let token = u16::from_le_bytes([bytes[0], bytes[1]]) as usize;
+                i += 2;
+                let dist = (token >> 5) + 1;
+                let len = (token & 0x1F) + MIN_MATCH;
+                if dist > out.len() {
+                    return Err(DecodeError::BadDistance);
+                }
+                if out.len() + len > max_len {
+                    return Err(DecodeError::TooLong);
+                }
+                // Byte by byte: the source may overlap what is being written
+                for _ in 0..len {
+                    out.push(out[out.len() - dist]);
+                }
+            } else {
+                if out.len() == max_len {
+                    return Err(DecodeError::TooLong);
+                }
+                out.push(input[i]);
+                i += 1;
+            }
+        }
+    }
+    Ok(out)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const TEXT: &[u8] = b"Once upon a time, in a small village by the sea, there lived an old fisherman. \
+        Every morning the old fisherman went out to sea, and every evening the old \
+        fisherman came back to the village with his boat full of fish.";
+
+    #[test]
+    fn matches_firmware_stream() {
+        // Same bytes as test_stream_layout() in host_test/test_lzss.c
+        let packed = encode(b"abcabcabcabc");
+        assert_eq!(packed, vec![0x08, b'a', b'b', b'c', (2 << 5) | 6, 0x00]);
+        assert_eq!(decode(&packed, 100).unwrap(), b"abcabcabcabc");
+    }
+
+    #[test]
+    fn round_trips() {
+        for input in [&b""[..], b"ab", TEXT, &[b'a'; 300]] {
+            assert_eq!(decode(&encode(input), 4096).unwrap(), input);
+        }
+        assert!(encode(TEXT).len() < TEXT.len() * 85 / 100);
+    }
+
+    #[test]
+    fn rejects_bad_streams() {
+        assert_eq!(decode(&[0x01, 0x00, 0x00], 100), Err(DecodeError::BadDistance));
+        assert_eq!(decode(&[0x02, b'a', 0x00], 100), Err(DecodeError::Truncated));
+        assert_eq!(decode(&encode(TEXT), TEXT.len() - 1), Err(DecodeError::TooLong));
+    }
+}
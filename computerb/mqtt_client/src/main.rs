@@ -1,21 +1,34 @@
 use rumqttc::{AsyncClient, MqttOptions, QoS, Event, Incoming};
 use std::time::Duration;
 use std::env;
-use std::collections::VecDeque;
+use std::collections::{HashMap, VecDeque};
 use openai_api_rs::v1::api::OpenAIClient;
 use openai_api_rs::v1::chat_completion::{ChatCompletionRequest, ChatCompletionMessage, MessageRole, Content};
 
+mod gpio_event;
+mod lzss;
+mod multipart;
+mod topics;
+
 // Maximum conversation history to prevent unbounded growth
 const MAX_CONVERSATION_HISTORY: usize = 10;
-const MAX_MESSAGE_LENGTH: usize = 500;
+// Longest reply the ESP32 keeps, in bytes (CONVERSATION_MAX_TEXT_LEN in main/conversation.h): each
+// reply is stored in one fixed-size history buffer and sent back with every request, so
+// unlike answers, replies are not reassembled from parts and longer ones are cut
+const MAX_REPLY_LENGTH: usize = 500;
+// Largest decompressed ESP32 answer accepted
+const MAX_ANSWER_LENGTH: usize = 64 * 1024;
 
-/// Truncate message if too long
+/// Truncate message to at most max_len bytes, between two characters
 fn truncate_message(msg: &str, max_len: usize) -> String {
     if msg.len() <= max_len {
-        msg.to_string()
-    } else {
-        format!("{}...", &msg[..max_len - 3])
+        return msg.to_string();
     }
+    let mut end = max_len - 3;
+    while !msg.is_char_boundary(end) {
+        end -= 1;
+    }
+    format!("{}...", &msg[..end])
 }
 
 /// Call OpenAI API with conversation history
@@ -76,13 +89,27 @@ async fn main() -> Result<(), Box<dyn std::error::Error>> {
     println!("OpenAI API client initialized");
     println!("Using endpoint: {}", endpoint);
     println!("Using model: {}", model);
+
+    // Optional LZSS compression of our replies, compressed answers are always accepted
+    let compress = env::var("MQTT_COMPRESSION").map_or(false, |v| v == "lzss");
+    println!("Reply compression: {}", if compress { "lzss" } else { "off" });
+    let mut reply_id: u32 = 0;
     
     // MQTT broker configuration
     let broker = "broker.hivemq.com";
     let port = 1883;
     let client_id = "rust_chatgpt_client";
-    let subscribe_topic = "/esp_gpt_out";  // Subscribe to ESP32's ChatGPT responses
-    let publish_topic = "/client_gpt";     // Publish our ChatGPT responses to ESP32
+
+    // Devices publish under <prefix>/<device id>/: one wildcard follows the fleet.
+    // MQTT_DEVICE_ID follows a single device, MQTT_TOPIC_PREFIX="" the flat topics.
+    let prefix = env::var("MQTT_TOPIC_PREFIX").unwrap_or_else(|_| "esp32".to_string());
+    let device_id = env::var("MQTT_DEVICE_ID").ok();
+    let topics = topics::Topics::new(&prefix, device_id.as_deref());
+    let subscribe_topics = [
+        topics.filter("/esp_gpt_out"),       // ESP32's ChatGPT responses, default session
+        topics.filter("/esp_gpt_out/+"),     // and the other sessions
+    ];
+    let gpio_events_topic = topics.filter("/esp32_gpio/events");  // Binary GPIO event frames from ESP32
     
     // Create MQTT client
     let mut mqttoptions = MqttOptions::new(client_id, broker, port);
@@ -91,26 +118,107 @@ async fn main() -> Result<(), Box<dyn std::error::Error>> {
     // Create async client and event loop
     let (client, mut eventloop) = AsyncClient::new(mqttoptions, 10);
     
-    // Subscribe to /esp_gpt_out topic to receive ChatGPT responses from ESP32
-    client.subscribe(subscribe_topic, QoS::AtMostOnce).await?;
-    println!("Subscribed to topic: {} (receiving ChatGPT responses from ESP32)", subscribe_topic);
-    println!("Will publish to topic: {} (sending ChatGPT responses to ESP32)", publish_topic);
+    // Subscribe to /esp_gpt_out topics to receive ChatGPT responses from ESP32
+    for topic in &subscribe_topics {
+        client.subscribe(topic, QoS::AtMostOnce).await?;
+        println!("Subscribed to topic: {} (receiving ChatGPT responses from ESP32)", topic);
+    }
+    client.subscribe(&gpio_events_topic, QoS::AtLeastOnce).await?;
+    println!("Subscribed to topic: {} (receiving GPIO events from ESP32)", gpio_events_topic);
+    println!("Will publish to the matching {} topic (sending ChatGPT responses to ESP32)",
+             topics.filter("/client_gpt"));
     println!("Waiting for messages to start endless discussion...");
     
-    // Conversation history (maintained by Rust client)
-    let mut conversation_history: VecDeque<ChatCompletionMessage> = VecDeque::new();
+    // Conversation history (maintained by Rust client), one per device and session, keyed by answer topic
+    let mut conversations: HashMap<String, VecDeque<ChatCompletionMessage>> = HashMap::new();
+
+    // GPIO event bookkeeping per device: lost events and delivery latency
+    let mut gpio_gaps: HashMap<String, gpio_event::GapDetector> = HashMap::new();
+    let mut gpio_latency: HashMap<String, gpio_event::LatencyTracker> = HashMap::new();
+    let started = std::time::Instant::now();
+
+    // Long ESP32 answers arrive in parts, message ids are per device
+    let mut answer_parts: HashMap<String, multipart::Reassembler> = HashMap::new();
     
     // Event loop - wait for messages
     loop {
         let event = eventloop.poll().await;
         match &event {
+            Ok(Event::Incoming(Incoming::Publish(publish)))
+                if topics.parse(&publish.topic).is_some_and(|(_, topic)| topic == "/esp32_gpio/events") =>
+            {
+                // Binary frame: decode it instead of printing raw bytes
+                let device = topics.parse(&publish.topic).map_or("", |(device, _)| device);
+                match gpio_event::decode(&publish.payload) {
+                    Ok(events) => {
+                        let received_us = started.elapsed().as_micros() as u64;
+                        let missed = gpio_gaps.entry(device.to_string()).or_default().observe(&events);
+                        if missed > 0 {
+                            println!("[GPIO {}] {} event(s) lost before seq {}", device, missed, events[0].seq);
+                        }
+                        let latency = gpio_latency.entry(device.to_string()).or_default();
+                        for ev in &events {
+                            println!(
+                                "[GPIO {}] seq={} pin={} edge={:?} t={}us latency=+{}us",
+                                device, ev.seq, ev.pin, ev.edge, ev.timestamp_us,
+                                latency.observe(ev, received_us)
+                            );
+                        }
+                    }
+                    Err(e) => eprintln!("[ERROR] Invalid GPIO event frame: {}", e),
+                }
+            }
             Ok(Event::Incoming(Incoming::Publish(publish))) => {
-                let payload = String::from_utf8_lossy(&publish.payload);
+                // Answer of a device: /esp_gpt_out of its default session or /esp_gpt_out/<session>
+                let answer = topics
+                    .parse(&publish.topic)
+                    .and_then(|(device, topic)| Some((device, topic.strip_prefix("/esp_gpt_out")?)))
+                    .filter(|(_, session)| session.is_empty() || session.starts_with('/'));
+                // Answers are always framed, parts compressed or not each on its own
+                let payload = if answer.is_some() {
+                    let part = match multipart::decode(&publish.payload) {
+                        Ok(part) => part,
+                        Err(e) => {
+                            eprintln!("[ERROR] Invalid message part: {}", e);
+                            continue;
+                        }
+                    };
+                    let Some(message) = answer_parts.entry(publish.topic.clone()).or_default().push(&part) else {
+                        // Wait for the rest of the message
+                        continue;
+                    };
+                    let packed = message.parts.iter().any(|p| p.flags & multipart::FLAG_LZSS != 0);
+                    let text = message.parts.iter().try_fold(Vec::new(), |mut text, part| {
+                        if part.flags & multipart::FLAG_LZSS != 0 {
+                            text.extend(lzss::decode(&part.data, MAX_ANSWER_LENGTH)?);
+                        } else {
+                            text.extend_from_slice(&part.data);
+                        }
+                        Ok::<_, lzss::DecodeError>(text)
+                    });
+                    let text = match text {
+                        Ok(text) => text,
+                        Err(e) => {
+                            eprintln!("[ERROR] Invalid compressed answer: {}", e);
+                            continue;
+                        }
+                    };
+                    if packed {
+                        println!("[LZSS] Answer in {} parts -> {} bytes", message.parts.len(), text.len());
+                    }
+                    String::from_utf8_lossy(&text).into_owned()
+                } else {
+                    String::from_utf8_lossy(&publish.payload).into_owned()
+                };
                 println!("[RECEIVED] Topic: '{}' | Message: '{}'", publish.topic, payload);
                 
                 // Check if this is a message from /esp_gpt_out (ChatGPT response from ESP32)
-                if publish.topic == subscribe_topic {
-                    let esp32_response = truncate_message(&payload, MAX_MESSAGE_LENGTH);
+                if let Some((device, session)) = answer {
+                    // Whole answer, reassembled: no truncation on this side
+                    let esp32_response = payload;
+                    // Same device, same session
+                    let publish_topic = topics.device_topic(device, &format!("/client_gpt{}", session));
+                    let conversation_history = conversations.entry(publish.topic.clone()).or_default();
                     
                     // Add ESP32's ChatGPT response to conversation history as "assistant"
                     conversation_history.push_back(ChatCompletionMessage {
@@ -158,7 +266,7 @@ async fn main() -> Result<(), Box<dyn std::error::Error>> {
                     // Call OpenAI API with conversation history
                     match call_openai_api(messages, &mut openai_client, &model).await {
                         Ok(response) => {
-                            let truncated_response = truncate_message(&response, MAX_MESSAGE_LENGTH);
+                            let truncated_response = truncate_message(&response, MAX_REPLY_LENGTH);
                             
                             // Add our ChatGPT response to conversation history as "assistant"
                             conversation_history.push_back(ChatCompletionMessage {
@@ -176,12 +284,26 @@ async fn main() -> Result<(), Box<dyn std::error::Error>> {
                             
                             println!("[CHATGPT] Response: {}", truncated_response);
                             
-                            // Publish ChatGPT response to /client_gpt topic
+                            // Framed as a single part like the answers, compressed only when that saves bytes
+                            let mut data = truncated_response.as_bytes().to_vec();
+                            let mut flags = multipart::FLAG_LAST;
+                            if compress {
+                                let packed = lzss::encode(&data);
+                                if packed.len() < data.len() {
+                                    println!("[LZSS] Reply {} -> {} bytes", data.len(), packed.len());
+                                    data = packed;
+                                    flags |= multipart::FLAG_LZSS;
+                                }
+                            }
+                            reply_id = reply_id.wrapping_add(1);
+                            let payload = multipart::encode(reply_id, flags, 0, &data);
+
+                            // Publish ChatGPT response to the device's /client_gpt topic, at QoS 1 to match its subscription
                             match client.publish(
-                                publish_topic,
-                                QoS::AtMostOnce,
+                                &publish_topic,
+                                QoS::AtLeastOnce,
                                 false,
-                                truncated_response.as_bytes(),
+                                payload,
                             ).await {
                                 Ok(_) => {
                                     println!("[PUBLISHED] Sent ChatGPT response to ESP32 via {}", publish_topic);
@@ -209,3 +331,17 @@ async fn main() -> Result<(), Box<dyn std::error::Error>> {
         }
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn truncates_between_characters() {
+        assert_eq!(truncate_message("short", MAX_REPLY_LENGTH), "short");
+        let text = "é".repeat(300);
+        let cut = truncate_message(&text, MAX_REPLY_LENGTH);
+        assert!(cut.len() <= MAX_REPLY_LENGTH);
+        assert_eq!(cut, format!("{}...", "é".repeat(248)));
+    }
+}
@@ -0,0 +1,280 @@
+//! Reassembly of the multipart messages published by the ESP32 on
+//! `/esp_gpt_out` (see `main/multipart.h` in the firmware).
+//!
+//! Part layout, version 2 (little-endian):
+//! magic `MP`, version (u8), flags (u8), message id (u32), part number (u16),
+//! then the payload bytes of this part. The last part of a message carries
+//! `FLAG_LAST`: the device publishes an answer while it is still reading it,
+//! without knowing how many parts it will take. The other flags describe the
+//! payload of their own part, e.g. `FLAG_LZSS` for compressed.
+//!
+//! Every answer is framed, a short one as a single part flagged last, so a
+//! payload that is not a valid part is an error, never plain text.
+
+use std::collections::{BTreeMap, VecDeque};
+use std::fmt;
+
+/// Part version understood by this decoder
+pub const PART_VERSION: u8 = 2;
+const HEADER_LEN: usize = 10;
+/// Payload of this part compressed with LZSS on its own, see `lzss.rs`
+pub const FLAG_LZSS: u8 = 0x01;
+/// Last part of the message
+pub const FLAG_LAST: u8 = 0x80;
+const FLAGS_KNOWN: u8 = FLAG_LZSS | FLAG_LAST;
+/// Incomplete messages kept at once; the oldest is given up past this
+const MAX_PENDING: usize = 4;
+
+/// One decoded part
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Part<'a> {
+    pub msg_id: u32,
+    pub flags: u8,
+    pub index: u16,
+    pub data: &'a [u8],
+}
+
+impl Part<'_> {
+    pub fn is_last(&self) -> bool {
+        self.flags & FLAG_LAST != 0
+    }
+}
+
+#[derive(Debug, PartialEq, Eq)]
+pub enum DecodeError {
+    NotAPart,
+    Truncated,
+    UnsupportedVersion(u8),
+    UnknownFlags(u8),
+}
+
+impl fmt::Display for DecodeError {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self {
+            DecodeError::NotAPart => write!(f, "not a message part"),
+            DecodeError::Truncated => write!(f, "part is truncated"),
+            DecodeError::UnsupportedVersion(v) => write!(f, "unsupported part version {}", v),
+            DecodeError::UnknownFlags(flags) => write!(f, "unknown part flags {:#04x}", flags),
+        }
+    }
+}
+
+impl std::error::Error for DecodeError {}
+
+/// Decode the header of one part, the payload is borrowed
+pub fn decode(payload: &[u8]) -> Result<Part<'_>, DecodeError> {
+    if !payload.starts_with(b"MP") {
+        return Err(DecodeError::NotAPart);
+    }
+    if payload.len() < HEADER_LEN {
+        return Err(DecodeError::Truncated);
+    }
+    if payload[2] != PART_VERSION {
+        return Err(DecodeError::UnsupportedVersion(payload[2]));
+    }
+    if payload[3] & !FLAGS_KNOWN != 0 {
+        return Err(DecodeError::UnknownFlags(payload[3]));
+    }
+    Ok(Part {
+        msg_id: u32::from_le_bytes(payload[4..8].try_into().unwrap()),
+        flags: payload[3],
+        index: u16::from_le_bytes([payload[8], payload[9]]),
+        data: &payload[HEADER_LEN..],
+    })
+}
+
+/// Encode one part; a message fitting one publish is sent as part 0 flagged `FLAG_LAST`
+pub fn encode(msg_id: u32, flags: u8, index: u16, data: &[u8]) -> Vec<u8> {
+    let mut part = Vec::with_capacity(HEADER_LEN + data.len());
+    part.extend_from_slice(&[b'M', b'P', PART_VERSION, flags]);
+    part.extend_from_slice(&msg_id.to_le_bytes());
+    part.extend_from_slice(&index.to_le_bytes());
+    part.extend_from_slice(data);
+    part
+}
+
+/// Payload of one part of a reassembled message, encoded as its flags say
+#[derive(Debug, PartialEq, Eq)]
+pub struct Payload {
+    pub flags: u8,
+    pub data: Vec<u8>,
+}
+
+/// A reassembled message: its parts in order, each to be decoded on its own and joined
+#[derive(Debug, PartialEq, Eq)]
+pub struct Message {
+    pub parts: Vec<Payload>,
+}
+
+#[derive(Debug)]
+struct Pending {
+    msg_id: u32,
+    parts: BTreeMap<u16, Payload>,
+    last: Option<u16>,
+}
+
+impl Pending {
+    /// The part cannot belong to this message: the device restarted and reused its id
+    fn conflicts(&self, part: &Part) -> bool {
+        match self.last {
+            Some(last) => part.index > last || (part.is_last() && part.index != last),
+            None => part.is_last() && self.parts.keys().next_back().is_some_and(|&i| i > part.index),
+        }
+    }
+}
+
+/// Puts messages back together from their parts, in any order.
+///
+/// A message is complete once its last part and every part before it
+/// arrived. A message whose parts were lost never completes; it is dropped
+/// once `MAX_PENDING` newer messages are in progress.
+#[derive(Debug, Default)]
+pub struct Reassembler {
+    pending: VecDeque<Pending>,
+    dropped: u64,
+}
+
+impl Reassembler {
+    /// Add a part, returns the whole message once it is complete
+    pub fn push(&mut self, part: &Part) -> Option<Message> {
+        let pos = match self.pending.iter().position(|p| p.msg_id == part.msg_id) {
+            // Same id but a part that does not fit: the device restarted, start over
+            Some(pos) if self.pending[pos].conflicts(part) => {
+                self.pending.remove(pos);
+                None
+            }
+            found => found,
+        };
+        let pos = pos.unwrap_or_else(|| {
+            if self.pending.len() >= MAX_PENDING {
+                self.pending.pop_front();
+                self.dropped += 1;
+            }
+            self.pending.push_back(Pending { msg_id: part.msg_id, parts: BTreeMap::new(), last: None });
+            self.pending.len() - 1
+        });
+
+        let pending = &mut self.pending[pos];
+        pending
+            .parts
+            .entry(part.index)
+            .or_insert_with(|| Payload { flags: part.flags, data: part.data.to_vec() });
+        if part.is_last() {
+            pending.last = Some(part.index);
+        }
+        match pending.last {
+            Some(last) if pending.parts.len() == last as usize + 1 => {}
+            _ => return None,
+        }
+
+        let done = self.pending.remove(pos).unwrap();
+        Some(Message { parts: done.parts.into_values().collect() })
+    }
+
+    /// Incomplete messages given up so far
+    pub fn dropped(&self) -> u64 {
+        self.dropped
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // Parts produced by multipart_writer_next() for "hello world" in chunks of 8, message id 5
+    const PART0: [u8; 18] = [b'M', b'P', 2, 0, 5, 0, 0, 0, 0, 0, b'h', b'e', b'l', b'l', b'o', b' ', b'w', b'o'];
+    const PART1: [u8; 13] = [b'M', b'P', 2, 0x80, 5, 0, 0, 0, 1, 0, b'r', b'l', b'd'];
+
+    fn joined(message: Message) -> Vec<u8> {
+        message.parts.into_iter().flat_map(|p| p.data).collect()
+    }
+
+    #[test]
+    fn decodes_parts() {
+        let part = decode(&PART1).unwrap();
+        assert_eq!(part, Part { msg_id: 5, flags: FLAG_LAST, index: 1, data: b"rld" });
+        assert!(part.is_last());
+        assert!(!decode(&PART0).unwrap().is_last());
+    }
+
+    #[test]
+    fn encodes_parts() {
+        assert_eq!(encode(5, FLAG_LAST, 1, b"rld"), PART1);
+        let single = encode(9, FLAG_LZSS | FLAG_LAST, 0, b"xyz");
+        let part = decode(&single).unwrap();
+        assert_eq!(part, Part { msg_id: 9, flags: FLAG_LZSS | FLAG_LAST, index: 0, data: b"xyz" });
+    }
+
+    #[test]
+    fn rejects_bad_parts() {
+        assert_eq!(decode(&PART0[..9]), Err(DecodeError::Truncated));
+        let mut old = PART0;
+        old[2] = 1;
+        assert_eq!(decode(&old), Err(DecodeError::UnsupportedVersion(1)));
+        let mut unknown = PART0;
+        unknown[3] = 0x40;
+        assert_eq!(decode(&unknown), Err(DecodeError::UnknownFlags(0x40)));
+    }
+
+    #[test]
+    fn plain_text_is_not_a_part() {
+        assert_eq!(decode(b"plain text"), Err(DecodeError::NotAPart));
+        // Text that starts like a header is still not taken for a part
+        assert_eq!(decode(b"MPEG-4 part 14 container"), Err(DecodeError::UnsupportedVersion(b'E')));
+        assert_eq!(decode(b"MP"), Err(DecodeError::Truncated));
+        assert!(decode(b"MPs voted on the bill").is_err());
+    }
+
+    #[test]
+    fn reassembles_in_any_order() {
+        let mut r = Reassembler::default();
+        assert_eq!(r.push(&decode(&PART1).unwrap()), None);
+        // A duplicate does not complete the message
+        assert_eq!(r.push(&decode(&PART1).unwrap()), None);
+        let message = r.push(&decode(&PART0).unwrap()).unwrap();
+        assert_eq!(joined(message), b"hello world");
+        assert!(r.pending.is_empty());
+
+        // Single part
+        let single = encode(6, FLAG_LAST, 0, b"hi");
+        let message = r.push(&decode(&single).unwrap()).unwrap();
+        assert_eq!(message.parts, vec![Payload { flags: FLAG_LAST, data: b"hi".to_vec() }]);
+    }
+
+    #[test]
+    fn keeps_the_flags_of_each_part() {
+        let mut r = Reassembler::default();
+        assert_eq!(r.push(&decode(&encode(3, FLAG_LZSS, 0, b"packed")).unwrap()), None);
+        let message = r.push(&decode(&encode(3, FLAG_LAST, 1, b"plain")).unwrap()).unwrap();
+        assert_eq!(message.parts[0], Payload { flags: FLAG_LZSS, data: b"packed".to_vec() });
+        assert_eq!(message.parts[1], Payload { flags: FLAG_LAST, data: b"plain".to_vec() });
+    }
+
+    #[test]
+    fn starts_over_when_the_id_is_reused() {
+        let mut r = Reassembler::default();
+        assert_eq!(r.push(&decode(&PART0).unwrap()), None);
+        assert_eq!(r.push(&decode(&encode(5, 0, 2, b"x")).unwrap()), None);
+        // Message 5 again after a restart, a single part: parts 0 and 2 belonged to the old one
+        let message = r.push(&decode(&encode(5, FLAG_LAST, 0, b"new")).unwrap()).unwrap();
+        assert_eq!(joined(message), b"new");
+        assert!(r.pending.is_empty());
+    }
+
+    #[test]
+    fn gives_up_on_incomplete_messages() {
+        let mut r = Reassembler::default();
+        for id in 0..=MAX_PENDING as u8 {
+            let mut part = PART0;
+            part[4] = id;
+            assert_eq!(r.push(&decode(&part).unwrap()), None);
+        }
+        assert_eq!(r.dropped(), 1);
+        assert_eq!(r.pending.len(), MAX_PENDING);
+
+        // Message 0 was given up, its last part starts it over
+        let mut last = PART1;
+        last[4] = 0;
+        assert_eq!(r.push(&decode(&last).unwrap()), None);
+    }
+}
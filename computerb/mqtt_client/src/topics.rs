@@ -0,0 +1,99 @@
+//! Topic layout of the ESP32 fleet (see `main/topic_ns.h` in the firmware).
+//!
+//! Each device publishes under `<prefix>/<device id>/...`, e.g.
+//! `esp32/a1b2c3d4e5f6/esp_gpt_out`, so one wildcard filter,
+//! `esp32/+/esp_gpt_out`, follows the whole fleet while every device only
+//! receives its own traffic. An empty prefix selects the flat topics
+//! (`/esp_gpt_out`, ...) of firmware built without a prefix.
+
+/// Devices followed: all of them, or one device id
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Topics {
+    prefix: String,
+    device: Option<String>,
+}
+
+impl Topics {
+    pub fn new(prefix: &str, device: Option<&str>) -> Self {
+        Topics {
+            prefix: prefix.trim_end_matches('/').to_string(),
+            device: device.filter(|d| !d.is_empty()).map(str::to_string),
+        }
+    }
+
+    fn flat(&self) -> bool {
+        self.prefix.is_empty()
+    }
+
+    /// Subscription filter of a device topic such as `/esp_gpt_out`, for the devices followed
+    pub fn filter(&self, topic: &str) -> String {
+        if self.flat() {
+            topic.to_string()
+        } else {
+            format!("{}/{}{}", self.prefix, self.device.as_deref().unwrap_or("+"), topic)
+        }
+    }
+
+    /// Full topic of a device topic for one device, e.g. where to reply
+    pub fn device_topic(&self, device: &str, topic: &str) -> String {
+        if self.flat() {
+            topic.to_string()
+        } else {
+            format!("{}/{}{}", self.prefix, device, topic)
+        }
+    }
+
+    /// Device id and device topic of a received topic; the id is "" with flat topics
+    pub fn parse<'a>(&self, topic: &'a str) -> Option<(&'a str, &'a str)> {
+        if self.flat() {
+            return topic.starts_with('/').then_some(("", topic));
+        }
+        let rest = topic.strip_prefix(self.prefix.as_str())?.strip_prefix('/')?;
+        let split = rest.find('/')?;
+        let (device, device_topic) = rest.split_at(split);
+        if device.is_empty() || self.device.as_deref().is_some_and(|d| d != device) {
+            return None;
+        }
+        Some((device, device_topic))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn fleet_filters() {
+        let t = Topics::new("esp32", None);
+        assert_eq!(t.filter("/esp_gpt_out"), "esp32/+/esp_gpt_out");
+        assert_eq!(t.filter("/esp_gpt_out/+"), "esp32/+/esp_gpt_out/+");
+        assert_eq!(t.device_topic("a1b2c3d4e5f6", "/client_gpt"), "esp32/a1b2c3d4e5f6/client_gpt");
+
+        let one = Topics::new("plant1/line2/", Some("kitchen"));
+        assert_eq!(one.filter("/esp32_gpio/events"), "plant1/line2/kitchen/esp32_gpio/events");
+    }
+
+    #[test]
+    fn parses_received_topics() {
+        let t = Topics::new("esp32", None);
+        assert_eq!(t.parse("esp32/a1b2/esp_gpt_out"), Some(("a1b2", "/esp_gpt_out")));
+        assert_eq!(t.parse("esp32/a1b2/esp_gpt_out/s1"), Some(("a1b2", "/esp_gpt_out/s1")));
+        assert_eq!(t.parse("esp32/a1b2"), None);
+        assert_eq!(t.parse("esp32//esp_gpt_out"), None);
+        assert_eq!(t.parse("esp320/a1b2/esp_gpt_out"), None);
+        assert_eq!(t.parse("/esp_gpt_out"), None);
+
+        let one = Topics::new("esp32", Some("a1b2"));
+        assert_eq!(one.parse("esp32/c3d4/esp_gpt_out"), None);
+        assert_eq!(one.parse("esp32/a1b2/esp_gpt_out"), Some(("a1b2", "/esp_gpt_out")));
+    }
+
+    #[test]
+    fn flat_topics() {
+        let t = Topics::new("", Some("ignored"));
+        assert_eq!(t.filter("/esp_gpt_out"), "/esp_gpt_out");
+        assert_eq!(t.device_topic("", "/client_gpt/s1"), "/client_gpt/s1");
+        assert_eq!(t.parse("/esp_gpt_out/s1"), Some(("", "/esp_gpt_out/s1")));
+        assert_eq!(t.parse("esp32/a1b2/esp_gpt_out"), None);
+    }
+}
@@ -0,0 +1,225 @@
+/*
+ * Round-trip time to a local broker against a public one
+ *
+ * A stand-in broker runs in a thread on this machine, in place of the
+ * mosquitto instance on the devices' network: it answers CONNECT with
+ * CONNACK and PINGREQ with PINGRESP, which is all the benchmark sends.
+ * The same exchanges are then timed against the brokers given on the
+ * command line (default broker.hivemq.com:1883):
+ *   - TCP connection set-up, what broker_failover.c probes
+ *   - CONNECT to CONNACK
+ *   - PINGREQ to PINGRESP, the round trip of every QoS 0 message
+ *
+ * Not part of ctest, run build_host/bench_broker_rtt [host[:port]...] by hand.
+ */
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOCAL_PINGS 200
+// Fewer on a public broker, shared with everybody
+#define REMOTE_PINGS 20
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int read_full(int fd, uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = recv(fd, buf, len, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+ * @brief Read one MQTT packet, small ones only
+ *
+ * @return Packet type (high nibble of the first byte), -1 on error
+ */
+static int read_packet(int fd)
+{
+    uint8_t header[2];
+    uint8_t body[256];
+
+    if (read_full(fd, header, 2) != 0 || header[1] & 0x80) {
+        return -1;
+    }
+    if (header[1] > 0 && read_full(fd, body, header[1]) != 0) {
+        return -1;
+    }
+    return header[0] >> 4;
+}
+
+/* ---- Stand-in broker ---- */
+
+static void *stand_in_client(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    static const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+    static const uint8_t pingresp[] = {0xD0, 0x00};
+    int type;
+
+    while ((type = read_packet(fd)) > 0) {
+        if (type == 1) {
+            send(fd, connack, sizeof(connack), 0);
+        } else if (type == 12) {
+            send(fd, pingresp, sizeof(pingresp), 0);
+        } else if (type == 14) {
+            break;
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static void *stand_in_broker(void *arg)
+{
+    int listen_fd = (int)(intptr_t)arg;
+
+    while (1) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            return NULL;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        pthread_t thread;
+        pthread_create(&thread, NULL, stand_in_client, (void *)(intptr_t)fd);
+        pthread_detach(thread);
+    }
+}
+
+static int start_stand_in(uint16_t *port)
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0 ||
+            getsockname(fd, (struct sockaddr *)&addr, &len) != 0) {
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    pthread_t thread;
+    pthread_create(&thread, NULL, stand_in_broker, (void *)(intptr_t)fd);
+    pthread_detach(thread);
+    return 0;
+}
+
+/* ---- Client side ---- */
+
+static void bench(const char *label, const char *host, const char *port, int pings)
+{
+    // MQTT 3.1.1 CONNECT, clean session, keep-alive 60 s, client id "bench"
+    static const uint8_t connect_pkt[] = {0x10, 0x11, 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x02, 0x00, 0x3C,
+                                          0x00, 0x05, 'b', 'e', 'n', 'c', 'h'};
+    static const uint8_t pingreq[] = {0xC0, 0x00};
+    static const uint8_t disconnect[] = {0xE0, 0x00};
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *res = NULL;
+    double rtt[LOCAL_PINGS];
+
+    // Resolution is left out, as in the firmware's probes
+    if (getaddrinfo(host, port, &hints, &res) != 0) {
+        printf("%-28s unresolved\n", label);
+        return;
+    }
+    int fd = socket(res->ai_family, SOCK_STREAM, 0);
+    struct timeval tv = {.tv_sec = 5};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    double t0 = now_ms();
+    int err = connect(fd, res->ai_addr, res->ai_addrlen);
+    double tcp_ms = now_ms() - t0;
+    freeaddrinfo(res);
+    if (err != 0) {
+        printf("%-28s unreachable\n", label);
+        close(fd);
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    t0 = now_ms();
+    send(fd, connect_pkt, sizeof(connect_pkt), 0);
+    if (read_packet(fd) != 2) {
+        printf("%-28s no CONNACK\n", label);
+        close(fd);
+        return;
+    }
+    double connack_ms = now_ms() - t0;
+
+    for (int i = 0; i < pings; i++) {
+        t0 = now_ms();
+        send(fd, pingreq, sizeof(pingreq), 0);
+        if (read_packet(fd) != 13) {
+            printf("%-28s no PINGRESP\n", label);
+            close(fd);
+            return;
+        }
+        rtt[i] = now_ms() - t0;
+    }
+    send(fd, disconnect, sizeof(disconnect), 0);
+    close(fd);
+
+    qsort(rtt, pings, sizeof(rtt[0]), cmp_double);
+    printf("%-28s %8.3f %8.3f %8.3f %8.3f\n", label, tcp_ms, connack_ms, rtt[pings / 2], rtt[pings * 9 / 10]);
+}
+
+int main(int argc, char **argv)
+{
+    static const char *default_brokers[] = {"broker.hivemq.com:1883"};
+    const char **brokers = default_brokers;
+    int count = 1;
+    uint16_t port;
+    char port_str[6];
+
+    if (argc > 1) {
+        brokers = (const char **)argv + 1;
+        count = argc - 1;
+    }
+    if (start_stand_in(&port) != 0) {
+        perror("stand-in broker");
+        return 1;
+    }
+    snprintf(port_str, sizeof(port_str), "%u", port);
+
+    printf("%-28s %8s %8s %8s %8s   (ms)\n", "broker", "tcp", "connack", "ping p50", "ping p90");
+    bench("stand-in (loopback)", "127.0.0.1", port_str, LOCAL_PINGS);
+    for (int i = 0; i < count; i++) {
+        char host[128];
+        snprintf(host, sizeof(host), "%s", brokers[i]);
+        char *colon = strrchr(host, ':');
+        const char *broker_port = "1883";
+        if (colon != NULL) {
+            *colon = '\0';
+            broker_port = colon + 1;
+        }
+        bench(brokers[i], host, broker_port, REMOTE_PINGS);
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * LZSS on conversation text: compression ratio, CPU time per KB, airtime saved
+ *
+ * Messages are cut from an English corpus at the sizes the conversation
+ * uses: 500-byte /client_gpt replies and whole OpenAI answers of a few KB.
+ * Airtime is the payload time alone at two Wi-Fi PHY rates, MQTT, TCP and
+ * 802.11 headers excluded since compression does not change them. The
+ * firmware logs its own compression time per KB at debug level.
+ *
+ * Not part of ctest, run build_host/bench_lzss by hand.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "lzss.h"
+
+#define ROUNDS 2000
+
+static const char CORPUS[] =
+    "The lighthouse keeper had not spoken to another person in three weeks when the storm arrived. "
+    "It came from the west, as the old storms always did, and by nightfall the waves were climbing the "
+    "rocks below the tower. He lit the lamp, wound the clockwork that turned the lens, and sat down by the "
+    "window with a cup of tea that went cold before he remembered to drink it. Somewhere out in the dark a "
+    "ship was trying to find the harbour, and the only thing between that ship and the rocks was the light "
+    "turning above his head. He thought about the keepers before him, about the logbooks on the shelf with "
+    "their careful entries, wind from the west, sea rough, lamp lit at dusk. He thought about how little the "
+    "entries said and how much they must have meant. Near midnight he saw it: a single green light, then a "
+    "red one, rising and falling with the swell. The ship was closer than it should have been. He went up "
+    "the stairs two at a time, checked the lamp, checked the lens, and then, because there was nothing else "
+    "to do, he stood at the gallery rail in the rain and watched. The green light turned. Slowly, far too "
+    "slowly, the ship came about and found the channel, and the lights slid past the rocks and into the "
+    "calm water of the harbour. He went back down, wrote wind from the west, sea rough, lamp lit at dusk, "
+    "one ship safely in, and for the first time in three weeks he laughed out loud. In the morning the "
+    "harbour master rowed out with bread, a newspaper and a letter from the captain of the ship. The letter "
+    "was short. It said that the captain had seen the light, that the light had been enough, and that he "
+    "would be sailing past again in the spring. The keeper read the letter twice, folded it, and put it "
+    "in the logbook, between the entry for the storm and the blank page for the day that had just begun. "
+    "Then he climbed the stairs, cleaned the lens, and wound the clockwork, as the keepers before him had "
+    "done, because there would be another night, and another storm, and somewhere another ship.";
+
+static uint8_t s_packed[8192];
+static uint8_t s_unpacked[8192];
+static lzss_encoder_t s_enc;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(const char *name, size_t msg_len)
+{
+    size_t corpus_len = sizeof(CORPUS) - 1;
+    size_t messages = corpus_len / msg_len;
+    size_t raw = 0;
+    size_t packed = 0;
+    double encode_s = 0;
+    double decode_s = 0;
+
+    for (size_t m = 0; m < messages; m++) {
+        const char *msg = CORPUS + m * msg_len;
+        size_t packed_len = 0;
+
+        double t0 = now_s();
+        for (int r = 0; r < ROUNDS; r++) {
+            lzss_encoder_init(&s_enc, msg, msg_len);
+            packed_len = lzss_encode(&s_enc, s_packed, sizeof(s_packed));
+        }
+        double t1 = now_s();
+        for (int r = 0; r < ROUNDS; r++) {
+            lzss_decode(s_packed, packed_len, s_unpacked, sizeof(s_unpacked));
+        }
+        double t2 = now_s();
+
+        if (memcmp(s_unpacked, msg, msg_len) != 0) {
+            printf("%s: round trip failed\n", name);
+            return;
+        }
+        raw += msg_len;
+        packed += packed_len;
+        encode_s += t1 - t0;
+        decode_s += t2 - t1;
+    }
+
+    double kb = raw * (double)ROUNDS / 1024;
+    double saved_bits = (raw - packed) * 8.0 / messages;
+    printf("%-22s %3zu msgs  ratio %.2f  encode %6.1f us/KB  decode %5.1f us/KB"
+           "  airtime saved/msg %6.0f us @6 Mbps %5.1f us @54 Mbps\n",
+           name, messages, (double)packed / raw, encode_s * 1e6 / kb, decode_s * 1e6 / kb,
+           saved_bits / 6.0, saved_bits / 54.0);
+}
+
+int main(void)
+{
+    printf("LZSS, window %d, host CPU\n", LZSS_WINDOW);
+    bench("reply (500 B)", 500);
+    bench("answer (1 KB)", 1024);
+    bench("answer (whole corpus)", sizeof(CORPUS) - 1);
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Bytes on the wire per PUBLISH, MQTT 3.1.1 against MQTT 5
+ *
+ * Packet sizes follow the encoding rules of both specifications for the
+ * topics the firmware publishes, at their typical payload sizes: QoS 0,
+ * fixed header, topic, MQTT 5 properties, payload. With MQTT 5 the first
+ * message of a hot topic carries topic and alias, the following ones the
+ * alias alone; answers also carry correlation data, response topic and
+ * message expiry. TCP/IP and TLS overhead is the same for both.
+ *
+ * Not part of ctest, run build_host/bench_mqtt5_overhead by hand.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// Bytes of a variable byte integer
+static size_t varint_len(size_t v)
+{
+    return v < 128 ? 1 : v < 16384 ? 2 : v < 2097152 ? 3 : 4;
+}
+
+static size_t packet_len(size_t remaining)
+{
+    return 1 + varint_len(remaining) + remaining;
+}
+
+static size_t publish_v311(const char *topic, size_t payload)
+{
+    return packet_len(2 + strlen(topic) + payload);
+}
+
+typedef struct {
+    bool alias;                 // Topic alias property
+    bool alias_only;            // Empty topic, alias already known by the broker
+    size_t correlation;         // Correlation data length, 0 for none
+    const char *response_topic;
+    bool expiry;
+} props_t;
+
+static size_t publish_v5(const char *topic, size_t payload, const props_t *p)
+{
+    size_t props = 0;
+    if (p->alias) {
+        props += 1 + 2;
+    }
+    if (p->correlation > 0) {
+        props += 1 + 2 + p->correlation;
+    }
+    if (p->response_topic != NULL) {
+        props += 1 + 2 + strlen(p->response_topic);
+    }
+    if (p->expiry) {
+        props += 1 + 4;
+    }
+    size_t topic_len = p->alias_only ? 0 : strlen(topic);
+    return packet_len(2 + topic_len + varint_len(props) + props + payload);
+}
+
+static void compare(const char *topic, size_t payload, bool hot, bool answer)
+{
+    props_t first = {
+        .alias = hot,
+        .correlation = answer ? 4 : 0,
+        .response_topic = answer ? "/client_gpt" : NULL,
+        .expiry = answer,
+    };
+    props_t next = first;
+    next.alias_only = hot;
+
+    size_t v311 = publish_v311(topic, payload);
+    size_t v5_first = publish_v5(topic, payload, &first);
+    size_t v5_next = publish_v5(topic, payload, &next);
+    printf("%-38s %5zu B payload  3.1.1 %5zu B  5 first %5zu B  5 next %5zu B  (%+zd B, %+.1f%%)\n",
+           topic, payload, v311, v5_first, v5_next,
+           (ssize_t)v5_next - (ssize_t)v311, 100.0 * ((double)v5_next - v311) / v311);
+}
+
+// Default namespace of the device topics, see main/topic_ns.h
+#define NS "esp32/a1b2c3d4e5f6"
+
+int main(void)
+{
+    printf("Bytes per QoS 0 PUBLISH packet\n");
+    compare(NS "/esp32_gpio/events", 16, true, false);  // One binary event
+    compare(NS "/esp32_gpio/events", 80, true, false);  // Coalesced batch
+    compare(NS "/esp32_gpio/inputs", 60, true, false);
+    compare(NS "/esp32_pcnt", 90, true, false);
+    compare(NS "/esp32_metrics", 700, true, false);
+    compare(NS "/esp32_gpio", 7, false, false);         // "pressed", not aliased
+    compare(NS "/esp_gpt_out", 512, true, true);        // Answer part with correlation and expiry
+    compare(NS "/esp_gpt_out", 112, true, true);        // Last part of an answer
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Throughput of the SPSC ring against a copying queue
+ *
+ * The queue baseline behaves like a FreeRTOS queue: fixed-size items sized
+ * for the largest message, copied in by the sender and out by the receiver,
+ * with a lock and a wake-up per operation. The ring is written in place by
+ * the producer and read in place by the consumer.
+ *
+ * Not part of ctest, run build_host/bench_spsc_ring by hand.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "spsc_ring.h"
+
+#define MESSAGES 1000000
+#define MAX_MESSAGE 512
+#define RING_SIZE 8192
+// Same memory as the ring
+#define QUEUE_LEN (RING_SIZE / (MAX_MESSAGE + 4))
+
+static uint8_t s_payload[MAX_MESSAGE];
+
+// Message lengths like MQTT payloads, from 16 to MAX_MESSAGE bytes
+static size_t message_len(uint32_t i)
+{
+    return 16 + (i * 2654435761u) % (MAX_MESSAGE - 16 + 1);
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* ---- Copying queue: one lock, fixed-size items ---- */
+
+typedef struct {
+    uint32_t len;
+    uint8_t data[MAX_MESSAGE];
+} queue_item_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    queue_item_t items[QUEUE_LEN];
+    size_t head;
+    size_t count;
+} s_queue = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .not_empty = PTHREAD_COND_INITIALIZER,
+    .not_full = PTHREAD_COND_INITIALIZER,
+};
+
+static void queue_send(const queue_item_t *item)
+{
+    pthread_mutex_lock(&s_queue.lock);
+    while (s_queue.count == QUEUE_LEN) {
+        pthread_cond_wait(&s_queue.not_full, &s_queue.lock);
+    }
+    s_queue.items[(s_queue.head + s_queue.count) % QUEUE_LEN] = *item;
+    s_queue.count++;
+    pthread_cond_signal(&s_queue.not_empty);
+    pthread_mutex_unlock(&s_queue.lock);
+}
+
+static void queue_receive(queue_item_t *item)
+{
+    pthread_mutex_lock(&s_queue.lock);
+    while (s_queue.count == 0) {
+        pthread_cond_wait(&s_queue.not_empty, &s_queue.lock);
+    }
+    *item = s_queue.items[s_queue.head];
+    s_queue.head = (s_queue.head + 1) % QUEUE_LEN;
+    s_queue.count--;
+    pthread_cond_signal(&s_queue.not_full);
+    pthread_mutex_unlock(&s_queue.lock);
+}
+
+static void *queue_producer(void *arg)
+{
+    (void)arg;
+    // The message is built in a local item, then copied into the queue
+    static queue_item_t item;
+    for (uint32_t i = 0; i < MESSAGES; i++) {
+        item.len = message_len(i);
+        memcpy(item.data, s_payload, item.len);
+        queue_send(&item);
+    }
+    return NULL;
+}
+
+static uint64_t queue_consume(void)
+{
+    static queue_item_t item;
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < MESSAGES; i++) {
+        queue_receive(&item);
+        bytes += item.len + item.data[item.len - 1];
+    }
+    return bytes;
+}
+
+/* ---- SPSC ring: written and read in place ---- */
+
+static spsc_ring_t s_ring;
+static uint32_t s_ring_buf[RING_SIZE / 4];
+
+static void *ring_producer(void *arg)
+{
+    (void)arg;
+    for (uint32_t i = 0; i < MESSAGES; i++) {
+        size_t len = message_len(i);
+        uint8_t *w;
+        while ((w = spsc_ring_reserve(&s_ring, len)) == NULL) {
+            sched_yield();
+        }
+        memcpy(w, s_payload, len);
+        spsc_ring_commit(&s_ring, len);
+    }
+    return NULL;
+}
+
+static uint64_t ring_consume(void)
+{
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < MESSAGES; i++) {
+        size_t len;
+        const uint8_t *rd;
+        while ((rd = spsc_ring_peek(&s_ring, &len)) == NULL) {
+            sched_yield();
+        }
+        bytes += len + rd[len - 1];
+        spsc_ring_release(&s_ring);
+    }
+    return bytes;
+}
+
+static void run(const char *name, void *(*producer)(void *), uint64_t (*consume)(void))
+{
+    pthread_t thread;
+    double start = now_s();
+    pthread_create(&thread, NULL, producer, NULL);
+    uint64_t bytes = consume();
+    pthread_join(thread, NULL);
+    double elapsed = now_s() - start;
+
+    printf("%-12s %8.0f kmsg/s %8.1f MB/s (%.3f s, checksum %llu)\n", name,
+           MESSAGES / elapsed / 1e3, bytes / elapsed / 1e6, elapsed, (unsigned long long)bytes);
+}
+
+int main(void)
+{
+    memset(s_payload, 0x5a, sizeof(s_payload));
+    spsc_ring_init(&s_ring, s_ring_buf, sizeof(s_ring_buf));
+
+    printf("%d messages of 16-%d bytes, %d bytes of buffering\n", MESSAGES, MAX_MESSAGE, RING_SIZE);
+    run("copy queue", queue_producer, queue_consume);
+    run("spsc ring", ring_producer, ring_consume);
+    return 0;
+}
@@ -0,0 +1,24 @@
+/*
+ * Minimal assertion helpers for the host tests
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define CHECK_STR_EQ(actual, expected) do { \
+        if (strcmp((actual), (expected)) != 0) { \
+            fprintf(stderr, "%s:%d: expected \"%s\"\n  got \"%s\"\n", __FILE__, __LINE__, (expected), (actual)); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define RUN_TEST(fn) do { fn(); printf("%s passed\n", #fn); } while (0)
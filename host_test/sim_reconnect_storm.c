@@ -0,0 +1,172 @@
+/*
+ * Reconnect load on a broker restarting under a fleet of devices
+ *
+ * CLIENTS devices are connected when the broker restarts at t = 0 and
+ * comes back after DOWN_MS. Attempts while it is down fail (connection
+ * refused); once up it accepts CAPACITY_PER_S connections per second,
+ * bursts of up to one second's worth included, and refuses the others as
+ * busy (CONNACK server unavailable). Every device
+ * waits according to its strategy before each attempt:
+ *   - fixed: the client's default, a constant 10 s
+ *   - backoff: exponential backoff without jitter, same windows as the policy
+ *   - policy: reconnect_policy.c, full jitter and fast first retry
+ *
+ * Reported: attempts in the busiest 100 ms, total and refused attempts,
+ * and when half, 99 % and all of the fleet are connected again.
+ *
+ * Not part of ctest, run build_host/sim_reconnect_storm by hand.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "reconnect_policy.h"
+
+#define CLIENTS 1000
+#define DOWN_MS 5000
+#define CAPACITY_PER_S 200
+#define TICK_MS 10
+#define DURATION_MS (600 * 1000)
+#define HISTOGRAM_S 30
+
+// Firmware defaults (Kconfig)
+#define FIRST_MS 1000
+#define BASE_MS 1000
+#define CAP_MS 60000
+// esp-mqtt's reconnect_timeout_ms default
+#define FIXED_MS 10000
+
+typedef enum {
+    STRATEGY_FIXED,
+    STRATEGY_BACKOFF,
+    STRATEGY_POLICY,
+} strategy_t;
+
+static const char *const s_names[] = {"fixed 10 s", "backoff, no jitter", "policy"};
+
+typedef struct {
+    int64_t next_ms;            // Next attempt, -1 once connected
+    uint32_t attempt;
+    reconnect_policy_t policy;
+} client_t;
+
+static client_t s_clients[CLIENTS];
+
+static uint32_t delay_ms(strategy_t strategy, client_t *c, reconnect_cause_t cause, int64_t now_ms)
+{
+    uint32_t d;
+
+    switch (strategy) {
+    case STRATEGY_FIXED:
+        return FIXED_MS;
+    case STRATEGY_BACKOFF:
+        d = c->attempt == 0 ? FIRST_MS : (BASE_MS << (c->attempt < 6 ? c->attempt - 1 : 6));
+        c->attempt++;
+        return d < CAP_MS ? d : CAP_MS;
+    case STRATEGY_POLICY:
+    default:
+        return reconnect_policy_delay_ms(&c->policy, cause, now_ms * 1000);
+    }
+}
+
+// "-" when never reached within DURATION_MS
+static const char *seconds(int64_t ms)
+{
+    static char buf[4][16];
+    static int next;
+    char *out = buf[next++ % 4];
+
+    if (ms < 0) {
+        return "-";
+    }
+    snprintf(out, sizeof(buf[0]), "%.1f", ms / 1000.0);
+    return out;
+}
+
+static void simulate(strategy_t strategy)
+{
+    static uint32_t per_second[HISTOGRAM_S];
+    // Attempts of the last 100 ms, per tick
+    uint32_t window[100 / TICK_MS] = {0};
+    uint32_t total = 0, refused = 0, peak = 0, connected = 0;
+    int64_t t50 = -1, t99 = -1, t100 = -1;
+    double tokens = 0;
+
+    memset(per_second, 0, sizeof(per_second));
+    for (int i = 0; i < CLIENTS; i++) {
+        client_t *c = &s_clients[i];
+        c->attempt = 0;
+        reconnect_policy_init(&c->policy, FIRST_MS, BASE_MS, CAP_MS, i + 1);
+        // Connected long before the restart, which every device sees at once
+        reconnect_policy_connected(&c->policy, -3600 * 1000000LL);
+        c->next_ms = delay_ms(strategy, c, RECONNECT_CAUSE_LOST, 0);
+    }
+
+    for (int64_t now = 0; now < DURATION_MS && connected < CLIENTS; now += TICK_MS) {
+        bool up = now >= DOWN_MS;
+        uint32_t tick_attempts = 0;
+        if (up) {
+            // Bursts up to one second of connections are absorbed (listen backlog, handshakes in flight)
+            tokens += CAPACITY_PER_S * TICK_MS / 1000.0;
+            if (tokens > CAPACITY_PER_S) {
+                tokens = CAPACITY_PER_S;
+            }
+        }
+        for (int i = 0; i < CLIENTS; i++) {
+            client_t *c = &s_clients[i];
+            if (c->next_ms < 0 || c->next_ms > now) {
+                continue;
+            }
+            tick_attempts++;
+            if (up && tokens >= 1) {
+                tokens -= 1;
+                c->next_ms = -1;
+                connected++;
+                continue;
+            }
+            refused += up;
+            c->next_ms = now + delay_ms(strategy, c, up ? RECONNECT_CAUSE_BUSY : RECONNECT_CAUSE_UNREACHABLE, now);
+        }
+        total += tick_attempts;
+        if (now / 1000 < HISTOGRAM_S) {
+            per_second[now / 1000] += tick_attempts;
+        }
+        // Busiest 100 ms, from the 10 ms ticks
+        window[(now / TICK_MS) % (100 / TICK_MS)] = tick_attempts;
+        uint32_t sum = 0;
+        for (size_t k = 0; k < sizeof(window) / sizeof(window[0]); k++) {
+            sum += window[k];
+        }
+        peak = sum > peak ? sum : peak;
+
+        if (t50 < 0 && connected >= CLIENTS / 2) {
+            t50 = now;
+        }
+        if (t99 < 0 && connected >= CLIENTS * 99 / 100) {
+            t99 = now;
+        }
+        if (t100 < 0 && connected == CLIENTS) {
+            t100 = now;
+        }
+    }
+
+    printf("%-20s %8u %8u %8u %8s %8s %8s\n", s_names[strategy], peak, total, refused,
+           seconds(t50), seconds(t99), seconds(t100));
+    printf("%-20s attempts/s:", "");
+    for (int s = 0; s < HISTOGRAM_S; s++) {
+        printf(" %u", per_second[s]);
+    }
+    printf("\n");
+}
+
+int main(void)
+{
+    printf("%d clients, broker down %d ms then accepting %d connections/s\n\n", CLIENTS, DOWN_MS, CAPACITY_PER_S);
+    printf("%-20s %8s %8s %8s %8s %8s %8s\n", "strategy", "peak", "attempts", "refused", "50% (s)", "99% (s)",
+           "all (s)");
+    simulate(STRATEGY_FIXED);
+    simulate(STRATEGY_BACKOFF);
+    simulate(STRATEGY_POLICY);
+    return 0;
+}
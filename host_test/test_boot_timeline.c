@@ -0,0 +1,78 @@
+/*
+ * Boot timeline: parallel steps, totals and the text chart
+ */
+#include "host_test.h"
+#include "boot_timeline.h"
+
+static void test_parallel_steps(void)
+{
+    boot_timeline_t t;
+
+    boot_timeline_init(&t);
+    int nvs = boot_timeline_begin(&t, "nvs", 300000);
+    boot_timeline_end(&t, nvs, 320000);
+    // Network association overlaps the GPIO and conversation setup
+    int net = boot_timeline_begin(&t, "network", 320000);
+    int gpio = boot_timeline_begin(&t, "gpio", 321000);
+    boot_timeline_end(&t, gpio, 322000);
+    int conv = boot_timeline_begin(&t, "conversation", 322000);
+    boot_timeline_end(&t, conv, 330000);
+    boot_timeline_end(&t, net, 2320000);
+    int mqtt = boot_timeline_begin(&t, "mqtt", 2320000);
+
+    CHECK(t.count == 5);
+    CHECK(boot_timeline_span_us(&t) == 2320000);
+    // The running step is not counted
+    CHECK(boot_timeline_busy_us(&t) == 20000 + 2000000 + 1000 + 8000);
+
+    boot_timeline_end(&t, mqtt, 2720000);
+    CHECK(boot_timeline_span_us(&t) == 2720000);
+    CHECK(boot_timeline_busy_us(&t) == 2429000);
+
+    // Ending an unknown step is harmless
+    boot_timeline_end(&t, -1, 1);
+    boot_timeline_end(&t, 12, 1);
+    CHECK(boot_timeline_span_us(&t) == 2720000);
+}
+
+static void test_full(void)
+{
+    boot_timeline_t t;
+
+    boot_timeline_init(&t);
+    for (int i = 0; i < BOOT_TIMELINE_MAX_STEPS; i++) {
+        CHECK(boot_timeline_begin(&t, "step", i) == i);
+    }
+    CHECK(boot_timeline_begin(&t, "extra", 99) == -1);
+}
+
+static void test_format(void)
+{
+    boot_timeline_t t;
+    char line[128];
+
+    boot_timeline_init(&t);
+    int a = boot_timeline_begin(&t, "network", 0);
+    int b = boot_timeline_begin(&t, "gpio", 0);
+    boot_timeline_end(&t, b, 100);
+    boot_timeline_end(&t, a, 3200000);
+    boot_timeline_begin(&t, "mqtt", 1600000);
+
+    CHECK(boot_timeline_format_step(&t, 0, line, sizeof(line)) > 0);
+    CHECK_STR_EQ(line, "network           0.0 ms   +3200.0 ms |################################|");
+    // A 100 us step still gets one cell
+    CHECK(boot_timeline_format_step(&t, 1, line, sizeof(line)) > 0);
+    CHECK_STR_EQ(line, "gpio              0.0 ms      +0.1 ms |#                               |");
+    CHECK(boot_timeline_format_step(&t, 2, line, sizeof(line)) > 0);
+    CHECK_STR_EQ(line, "mqtt           1600.0 ms      running |                ................|");
+
+    CHECK(boot_timeline_format_step(&t, 0, line, 20) == -1);
+}
+
+int main(void)
+{
+    RUN_TEST(test_parallel_steps);
+    RUN_TEST(test_full);
+    RUN_TEST(test_format);
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Broker provisioning: URI validation and the "broker" command
+ */
+#include "host_test.h"
+#include "broker_config.h"
+
+static bool uri_ok(const char *uri)
+{
+    return broker_uri_valid(uri, strlen(uri));
+}
+
+static broker_command_t parse(const char *cmd, broker_config_t *cfg)
+{
+    return broker_config_parse_command(cmd, strlen(cmd), cfg);
+}
+
+static void test_uri_valid(void)
+{
+    CHECK(uri_ok("mqtt://mqtt.eclipseprojects.io"));
+    CHECK(uri_ok("mqtts://10.0.0.2:8883"));
+    CHECK(uri_ok("ws://broker.local:8080/mqtt"));
+    CHECK(uri_ok("wss://broker.local/mqtt"));
+
+    CHECK(!uri_ok(""));
+    CHECK(!uri_ok("mqtt://"));
+    CHECK(!uri_ok("mqtt:///path"));
+    CHECK(!uri_ok("http://broker.local"));
+    CHECK(!uri_ok("mqtt://broker local"));
+    CHECK(!uri_ok("FROM_STDIN"));
+
+    char long_uri[BROKER_URI_MAX + 1];
+    memset(long_uri, 'a', sizeof(long_uri) - 1);
+    long_uri[BROKER_URI_MAX] = '\0';
+    memcpy(long_uri, "mqtt://", 7);
+    CHECK(!uri_ok(long_uri));
+    long_uri[BROKER_URI_MAX - 1] = '\0';
+    CHECK(uri_ok(long_uri));
+}
+
+static void test_parse_set(void)
+{
+    broker_config_t cfg;
+
+    CHECK(parse("broker mqtt://10.0.0.2:1883", &cfg) == BROKER_COMMAND_SET);
+    CHECK_STR_EQ(cfg.uri, "mqtt://10.0.0.2:1883");
+    CHECK_STR_EQ(cfg.username, "");
+    CHECK_STR_EQ(cfg.password, "");
+
+    CHECK(parse("broker  mqtts://b.local:8883 dev1 s3cret\n", &cfg) == BROKER_COMMAND_SET);
+    CHECK_STR_EQ(cfg.uri, "mqtts://b.local:8883");
+    CHECK_STR_EQ(cfg.username, "dev1");
+    CHECK_STR_EQ(cfg.password, "s3cret");
+
+    // Not NUL-terminated, as received from the MQTT client
+    const char payload[] = "broker mqtt://a.local xx";
+    CHECK(broker_config_parse_command(payload, 21, &cfg) == BROKER_COMMAND_SET);
+    CHECK_STR_EQ(cfg.uri, "mqtt://a.local");
+}
+
+static void test_parse_others(void)
+{
+    broker_config_t cfg;
+
+    CHECK(parse("broker reset", &cfg) == BROKER_COMMAND_RESET);
+    CHECK(parse("start", &cfg) == BROKER_COMMAND_NONE);
+    CHECK(parse("brokers mqtt://a", &cfg) == BROKER_COMMAND_NONE);
+    CHECK(parse("broker", &cfg) == BROKER_COMMAND_INVALID);
+    CHECK(parse("broker reset now", &cfg) == BROKER_COMMAND_INVALID);
+    CHECK(parse("broker http://a.local", &cfg) == BROKER_COMMAND_INVALID);
+    CHECK(parse("broker mqtt://a.local u p extra", &cfg) == BROKER_COMMAND_INVALID);
+}
+
+static void test_host_port(void)
+{
+    char host[64];
+    uint16_t port;
+
+    CHECK(broker_uri_host_port("mqtt://broker.hivemq.com", host, sizeof(host), &port));
+    CHECK_STR_EQ(host, "broker.hivemq.com");
+    CHECK(port == 1883);
+    CHECK(broker_uri_host_port("mqtts://10.0.0.2", host, sizeof(host), &port) && port == 8883);
+    CHECK(broker_uri_host_port("wss://b.local/mqtt", host, sizeof(host), &port) && port == 443);
+    CHECK_STR_EQ(host, "b.local");
+    CHECK(broker_uri_host_port("https://openrouter.ai/api/v1/chat/completions", host, sizeof(host), &port));
+    CHECK_STR_EQ(host, "openrouter.ai");
+    CHECK(port == 443);
+    CHECK(broker_uri_host_port("http://localhost:1234/v1", host, sizeof(host), &port) && port == 1234);
+
+    CHECK(broker_uri_host_port("ws://user:p@ss@b.local:8080/mqtt?x=1", host, sizeof(host), &port));
+    CHECK_STR_EQ(host, "b.local");
+    CHECK(port == 8080);
+    CHECK(broker_uri_host_port("mqtt://[fd00::1]:1884", host, sizeof(host), &port));
+    CHECK_STR_EQ(host, "fd00::1");
+    CHECK(port == 1884);
+    CHECK(broker_uri_host_port("mqtt://[fd00::1]", host, sizeof(host), &port) && port == 1883);
+
+    CHECK(!broker_uri_host_port("mqtt://b.local:", host, sizeof(host), &port));
+    CHECK(!broker_uri_host_port("mqtt://b.local:65536", host, sizeof(host), &port));
+    CHECK(!broker_uri_host_port("mqtt://b.local:12a", host, sizeof(host), &port));
+    CHECK(!broker_uri_host_port("mqtt://[fd00::1", host, sizeof(host), &port));
+    CHECK(!broker_uri_host_port("mqtt://user@:1883", host, sizeof(host), &port));
+    CHECK(!broker_uri_host_port("mqtt://broker.hivemq.com", host, 8, &port));
+}
+
+static void test_uri_build(void)
+{
+    char uri[BROKER_URI_MAX];
+    char host[64];
+    uint16_t port;
+
+    CHECK(broker_uri_build(uri, sizeof(uri), "192.168.1.10", 1883));
+    CHECK_STR_EQ(uri, "mqtt://192.168.1.10:1883");
+    CHECK(broker_uri_build(uri, sizeof(uri), "fd00::1", 1884));
+    CHECK_STR_EQ(uri, "mqtt://[fd00::1]:1884");
+    CHECK(broker_uri_host_port(uri, host, sizeof(host), &port));
+    CHECK_STR_EQ(host, "fd00::1");
+    CHECK(port == 1884);
+    CHECK(broker_uri_build(uri, sizeof(uri), "mosquitto.local", 1883));
+    CHECK_STR_EQ(uri, "mqtt://mosquitto.local:1883");
+
+    CHECK(!broker_uri_build(uri, sizeof(uri), "", 1883));
+    CHECK(!broker_uri_build(uri, 16, "mosquitto.local", 1883));
+}
+
+int main(void)
+{
+    RUN_TEST(test_uri_valid);
+    RUN_TEST(test_parse_set);
+    RUN_TEST(test_parse_others);
+    RUN_TEST(test_host_port);
+    RUN_TEST(test_uri_build);
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * Broker selection: candidate list, smoothed round-trip times, health and hysteresis
+ */
+#include "host_test.h"
+#include "broker_select.h"
+
+static void test_list(void)
+{
+    broker_select_t s;
+
+    broker_select_init(&s, 20000);
+    broker_select_set_primary(&s, "mqtt://primary.local");
+    CHECK(broker_select_add_list(&s, "mqtt://b.local, mqtts://c.local:8883,,http://bad mqtt://b.local") == 2);
+    CHECK(s.count == 3);
+    CHECK_STR_EQ(s.candidates[1].uri, "mqtt://b.local");
+    CHECK_STR_EQ(s.candidates[2].uri, "mqtts://c.local:8883");
+    CHECK(broker_select_add_list(&s, "ws://d.local ws://e.local") == 1);
+    CHECK(s.count == BROKER_SELECT_MAX);
+
+    // The primary changes in place, fallbacks stay
+    broker_select_use(&s, 2);
+    broker_select_set_primary(&s, "mqtt://new.local");
+    CHECK_STR_EQ(s.candidates[0].uri, "mqtt://new.local");
+    CHECK(s.current == 0 && s.count == BROKER_SELECT_MAX);
+}
+
+static void test_fastest_with_margin(void)
+{
+    broker_select_t s;
+
+    broker_select_init(&s, 20000);
+    broker_select_set_primary(&s, "mqtt://a.local");
+    broker_select_add_list(&s, "mqtt://b.local,mqtt://c.local");
+
+    // Nothing probed yet: round robin from the current one
+    CHECK(broker_select_best(&s) == 1);
+
+    broker_select_probe_result(&s, 0, 80000);
+    broker_select_probe_result(&s, 1, 30000);
+    broker_select_probe_result(&s, 2, -1);
+    CHECK(broker_select_best(&s) == 1);
+    broker_select_use(&s, 1);
+
+    // c answers now, a little faster than b: not worth a reconnection
+    broker_select_probe_result(&s, 2, 20000);
+    CHECK(broker_select_best(&s) == 1);
+
+    // b slows down for good: the average follows within a few probes
+    int32_t rtt = s.candidates[1].rtt_us;
+    broker_select_probe_result(&s, 1, 200000);
+    CHECK(s.candidates[1].rtt_us == rtt + (200000 - rtt) / 4);
+    CHECK(broker_select_best(&s) == 2);
+}
+
+static void test_failures(void)
+{
+    broker_select_t s;
+
+    broker_select_init(&s, 20000);
+    broker_select_set_primary(&s, "mqtt://a.local");
+    broker_select_add_list(&s, "mqtt://b.local");
+    broker_select_probe_result(&s, 0, 10000);
+    broker_select_probe_result(&s, 1, 50000);
+    CHECK(broker_select_best(&s) == 0);
+
+    // One failed probe is tolerated, two are not
+    broker_select_probe_result(&s, 0, -1);
+    CHECK(broker_select_healthy(&s.candidates[0]));
+    CHECK(s.candidates[0].last_rtt_us == -1);
+    CHECK(broker_select_best(&s) == 0);
+    broker_select_probe_result(&s, 0, -1);
+    CHECK(broker_select_best(&s) == 1);
+
+    // A success makes it healthy again, and faster by more than the margin it wins back
+    broker_select_use(&s, 1);
+    broker_select_probe_result(&s, 0, 10000);
+    CHECK(broker_select_best(&s) == 0);
+    broker_select_use(&s, 0);
+
+    // A dropped MQTT connection counts at once, even though TCP probes succeed
+    broker_select_connection_failed(&s);
+    CHECK(broker_select_best(&s) == 1);
+    // Successful TCP probes do not clear it before a few rounds
+    for (int i = 0; i < BROKER_SELECT_REFUSED_PROBES - 1; i++) {
+        broker_select_probe_result(&s, 0, 10000);
+        CHECK(!broker_select_healthy(&s.candidates[0]));
+    }
+    broker_select_probe_result(&s, 0, 10000);
+    CHECK(broker_select_healthy(&s.candidates[0]));
+
+    broker_select_connection_failed(&s);
+    broker_select_use(&s, 1);
+    broker_select_connection_failed(&s);
+    // Nobody healthy: try the next one in turn, until one connects
+    CHECK(broker_select_best(&s) == 0);
+    broker_select_use(&s, 0);
+    broker_select_connected(&s);
+    CHECK(broker_select_best(&s) == 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_list);
+    RUN_TEST(test_fastest_with_margin);
+    RUN_TEST(test_failures);
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Gesture classification from timestamped button edges
+ */
+#include "host_test.h"
+#include "button_gesture.h"
+
+#define MS 1000LL
+#define LONG_PRESS (800 * MS)
+#define DOUBLE_PRESS (300 * MS)
+
+static void test_short_press_after_double_window(void)
+{
+    button_gesture_t g;
+    button_gesture_init(&g, LONG_PRESS, DOUBLE_PRESS);
+
+    CHECK(button_gesture_deadline(&g) == INT64_MAX);
+    CHECK(button_gesture_edge(&g, true, 1000 * MS) == BUTTON_GESTURE_NONE);
+    CHECK(button_gesture_edge(&g, false, 1100 * MS) == BUTTON_GESTURE_RELEASE);
+
+    // Nothing before the double press window closes, then a single short press
+    CHECK(button_gesture_deadline(&g) == 1400 * MS);
+    CHECK(button_gesture_poll(&g, 1399 * MS) == BUTTON_GESTURE_NONE);
+    CHECK(button_gesture_poll(&g, 1400 * MS) == BUTTON_GESTURE_SHORT_PRESS);
+    CHECK(button_gesture_deadline(&g) == INT64_MAX);
+}
+
+static void test_short_press_without_double_press(void)
+{
+    button_gesture_t g;
+    button_gesture_init(&g, LONG_PRESS, 0);
+
+    button_gesture_edge(&g, true, 0);
+    CHECK(button_gesture_edge(&g, false, 100 * MS) == (BUTTON_GESTURE_RELEASE | BUTTON_GESTURE_SHORT_PRESS));
+    CHECK(button_gesture_deadline(&g) == INT64_MAX);
+}
+
+static void test_long_press(void)
+{
+    button_gesture_t g;
+    button_gesture_init(&g, LONG_PRESS, DOUBLE_PRESS);
+
+    button_gesture_edge(&g, true, 0);
+    CHECK(button_gesture_deadline(&g) == LONG_PRESS);
+    // Reported while the button is still held
+    CHECK(button_gesture_poll(&g, LONG_PRESS) == BUTTON_GESTURE_LONG_PRESS);
+    CHECK(button_gesture_deadline(&g) == INT64_MAX);
+    CHECK(button_gesture_edge(&g, false, 2000 * MS) == BUTTON_GESTURE_RELEASE);
+    CHECK(g.state == BUTTON_STATE_IDLE);
+}
+
+static void test_long_press_seen_late_on_release(void)
+{
+    button_gesture_t g;
+    button_gesture_init(&g, LONG_PRESS, DOUBLE_PRESS);
+
+    // The task missed the deadline: the release edge still reports both
+    button_gesture_edge(&g, true, 0);
+    CHECK(button_gesture_edge(&g, false, 900 * MS) == (BUTTON_GESTURE_LONG_PRESS | BUTTON_GESTURE_RELEASE));
+    CHECK(g.state == BUTTON_STATE_IDLE);
+}
+
+static void test_double_press(void)
+{
+    button_gesture_t g;
+    button_gesture_init(&g, LONG_PRESS, DOUBLE_PRESS);
+
+    button_gesture_edge(&g, true, 0);
+    button_gesture_edge(&g, false, 100 * MS);
+    CHECK(button_gesture_edge(&g, true, 350 * MS) == BUTTON_GESTURE_DOUBLE_PRESS);
+    // Holding the second press does not turn it into a long press
+    CHECK(button_gesture_poll(&g, 2000 * MS) == BUTTON_GESTURE_NONE);
+    CHECK(button_gesture_edge(&g, false, 2100 * MS) == BUTTON_GESTURE_RELEASE);
+    CHECK(g.state == BUTTON_STATE_IDLE);
+}
+
+static void test_second_press_too_late(void)
+{
+    button_gesture_t g;
+    button_gesture_init(&g, LONG_PRESS, DOUBLE_PRESS);
+
+    button_gesture_edge(&g, true, 0);
+    button_gesture_edge(&g, false, 100 * MS);
+    // Window closed at 400 ms: first press is short, second one starts anew
+    CHECK(button_gesture_edge(&g, true, 500 * MS) == BUTTON_GESTURE_SHORT_PRESS);
+    CHECK(g.state == BUTTON_STATE_PRESSED);
+    CHECK(button_gesture_deadline(&g) == 500 * MS + LONG_PRESS);
+}
+
+int main(void)
+{
+    RUN_TEST(test_short_press_after_double_window);
+    RUN_TEST(test_short_press_without_double_press);
+    RUN_TEST(test_long_press);
+    RUN_TEST(test_long_press_seen_late_on_release);
+    RUN_TEST(test_double_press);
+    RUN_TEST(test_second_press_too_late);
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * DNS cache: TTL, negative entries, replacement, background refresh
+ */
+#include "host_test.h"
+#include "dns_cache.h"
+
+#define S(s) ((s) * 1000000LL)
+
+static void test_ttl(void)
+{
+    dns_cache_t c;
+    uint32_t addr = 0;
+
+    dns_cache_init(&c, 3600);
+    CHECK(dns_cache_lookup(&c, "broker.example.com", 0, &addr) == DNS_CACHE_MISS);
+    dns_cache_store(&c, "broker.example.com", 0x0a000001, 300, 0);
+    CHECK(dns_cache_lookup(&c, "Broker.Example.com", S(299), &addr) == DNS_CACHE_HIT);
+    CHECK(addr == 0x0a000001);
+    CHECK(dns_cache_lookup(&c, "broker.example.com", S(300), &addr) == DNS_CACHE_MISS);
+
+    // Longer TTLs are cut, a TTL of 0 is not cached and drops the old address
+    dns_cache_store(&c, "broker.example.com", 0x0a000002, 86400, S(300));
+    CHECK(dns_cache_lookup(&c, "broker.example.com", S(300 + 3599), &addr) == DNS_CACHE_HIT);
+    CHECK(dns_cache_lookup(&c, "broker.example.com", S(300 + 3600), &addr) == DNS_CACHE_MISS);
+    dns_cache_store(&c, "broker.example.com", 0x0a000003, 0, S(4000));
+    CHECK(dns_cache_lookup(&c, "broker.example.com", S(4000), &addr) == DNS_CACHE_MISS);
+    CHECK(c.hits == 2 && c.misses == 4);
+}
+
+static void test_negative(void)
+{
+    dns_cache_t c;
+    uint32_t addr = 0;
+
+    dns_cache_init(&c, 3600);
+    dns_cache_store_negative(&c, "typo.example.com", 30, 0);
+    CHECK(dns_cache_lookup(&c, "typo.example.com", S(29), &addr) == DNS_CACHE_NEGATIVE);
+    CHECK(dns_cache_lookup(&c, "typo.example.com", S(30), &addr) == DNS_CACHE_MISS);
+    // The name appeared
+    dns_cache_store(&c, "typo.example.com", 0x0a000001, 60, S(30));
+    CHECK(dns_cache_lookup(&c, "typo.example.com", S(31), &addr) == DNS_CACHE_HIT);
+    CHECK(c.negative_hits == 1 && c.hits == 1);
+}
+
+static void test_replacement(void)
+{
+    dns_cache_t c;
+    uint32_t addr = 0;
+    char name[DNS_CACHE_NAME_MAX];
+
+    dns_cache_init(&c, 3600);
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        snprintf(name, sizeof(name), "host%d.example.com", i);
+        dns_cache_store(&c, name, i, 600, S(i));
+    }
+    // host0 was looked up last, host1 least recently
+    CHECK(dns_cache_lookup(&c, "host0.example.com", S(100), &addr) == DNS_CACHE_HIT);
+    dns_cache_store(&c, "new.example.com", 99, 600, S(101));
+    CHECK(dns_cache_lookup(&c, "host1.example.com", S(102), &addr) == DNS_CACHE_MISS);
+    CHECK(dns_cache_lookup(&c, "host0.example.com", S(102), &addr) == DNS_CACHE_HIT);
+    CHECK(dns_cache_lookup(&c, "new.example.com", S(102), &addr) == DNS_CACHE_HIT && addr == 99);
+
+    // Too long to be cached
+    char longname[DNS_CACHE_NAME_MAX + 8];
+    memset(longname, 'a', sizeof(longname) - 1);
+    longname[sizeof(longname) - 1] = '\0';
+    dns_cache_store(&c, longname, 1, 600, S(103));
+    CHECK(dns_cache_lookup(&c, longname, S(103), &addr) == DNS_CACHE_MISS);
+}
+
+static void test_refresh(void)
+{
+    dns_cache_t c;
+    uint32_t addr = 0;
+    char name[DNS_CACHE_NAME_MAX] = "";
+
+    dns_cache_init(&c, 3600);
+    CHECK(dns_cache_next_refresh(&c, 0, name, sizeof(name)) == INT64_MAX);
+    dns_cache_store(&c, "api.example.com", 1, 800, 0);
+    dns_cache_store(&c, "broker.example.com", 2, 80, 0);
+    // Too short to refresh, and negative entries are never refreshed
+    dns_cache_store(&c, "short.example.com", 3, 5, 0);
+    dns_cache_store_negative(&c, "typo.example.com", 30, 0);
+
+    // Refreshed with 1/8 of the TTL left
+    CHECK(dns_cache_next_refresh(&c, S(1), name, sizeof(name)) == S(70));
+    CHECK_STR_EQ(name, "broker.example.com");
+    dns_cache_store(&c, "broker.example.com", 2, 80, S(70));
+    CHECK(dns_cache_next_refresh(&c, S(70), name, sizeof(name)) == S(140));
+
+    // Failed: retried while it has not expired
+    dns_cache_refresh_failed(&c, "broker.example.com", S(145));
+    CHECK(dns_cache_next_refresh(&c, S(140), name, sizeof(name)) == S(145));
+    dns_cache_refresh_failed(&c, "broker.example.com", S(150));
+    CHECK(dns_cache_next_refresh(&c, S(145), name, sizeof(name)) == S(700));
+    CHECK_STR_EQ(name, "api.example.com");
+
+    // A name nobody looked up for an hour is left to expire, a lookup brings it back
+    dns_cache_init(&c, 86400);
+    dns_cache_store(&c, "api.example.com", 1, 8000, 0);
+    CHECK(dns_cache_next_refresh(&c, S(7000), name, sizeof(name)) == INT64_MAX);
+    CHECK(dns_cache_lookup(&c, "api.example.com", S(7000), &addr) == DNS_CACHE_HIT);
+    CHECK(dns_cache_next_refresh(&c, S(7000), name, sizeof(name)) == S(7000));
+}
+
+int main(void)
+{
+    RUN_TEST(test_ttl);
+    RUN_TEST(test_negative);
+    RUN_TEST(test_replacement);
+    RUN_TEST(test_refresh);
+    return 0;
+}
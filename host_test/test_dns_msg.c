@@ -0,0 +1,188 @@
+/*
+ * DNS messages: query layout, answers, CNAME chains, negative answers, forged or broken answers
+ */
+#include "host_test.h"
+#include "dns_msg.h"
+
+#define NAME "api.Example.com"
+
+typedef struct {
+    uint8_t buf[DNS_MSG_MAX];
+    size_t len;
+} msg_t;
+
+static void put(msg_t *m, const void *data, size_t len)
+{
+    memcpy(m->buf + m->len, data, len);
+    m->len += len;
+}
+
+static void put16(msg_t *m, uint16_t v)
+{
+    uint8_t b[2] = {v >> 8, v & 0xff};
+    put(m, b, 2);
+}
+
+static void put32(msg_t *m, uint32_t v)
+{
+    put16(m, v >> 16);
+    put16(m, v & 0xffff);
+}
+
+/*
+ * @brief Answer to the query of NAME with id 0x1234: the question is copied, records follow
+ */
+static void answer_start(msg_t *m, uint16_t flags, uint16_t answers, uint16_t authority)
+{
+    int len = dns_msg_query(m->buf, sizeof(m->buf), 0x1234, NAME);
+    CHECK(len > 0);
+    m->len = len;
+    // Response, recursion desired and available
+    flags |= 0x8000 | 0x0100 | 0x0080;
+    m->buf[2] = flags >> 8;
+    m->buf[3] = flags & 0xff;
+    m->buf[6] = answers >> 8;
+    m->buf[7] = answers & 0xff;
+    m->buf[8] = authority >> 8;
+    m->buf[9] = authority & 0xff;
+}
+
+// Record header, owner given as a compression pointer
+static void record(msg_t *m, uint16_t owner, uint16_t type, uint32_t ttl, uint16_t rdlen)
+{
+    put16(m, 0xc000 | owner);
+    put16(m, type);
+    put16(m, 1);
+    put32(m, ttl);
+    put16(m, rdlen);
+}
+
+static void test_query(void)
+{
+    uint8_t buf[DNS_MSG_MAX];
+    const uint8_t expected[] = {
+        0xbe, 0xef, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0,
+        3, 'a', 'p', 'i', 7, 'E', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0,
+        0, 1, 0, 1,
+    };
+
+    CHECK(dns_msg_query(buf, sizeof(buf), 0xbeef, NAME) == sizeof(expected));
+    CHECK(memcmp(buf, expected, sizeof(expected)) == 0);
+    // A trailing dot is the same name
+    CHECK(dns_msg_query(buf, sizeof(buf), 0xbeef, NAME ".") == sizeof(expected));
+    CHECK(memcmp(buf, expected, sizeof(expected)) == 0);
+
+    CHECK(dns_msg_query(buf, sizeof(buf), 1, "") < 0);
+    CHECK(dns_msg_query(buf, sizeof(buf), 1, "a..b") < 0);
+    CHECK(dns_msg_query(buf, sizeof(expected) - 1, 1, NAME) < 0);
+    char label[70];
+    memset(label, 'x', 64);
+    label[64] = '\0';
+    CHECK(dns_msg_query(buf, sizeof(buf), 1, label) < 0);
+}
+
+static void test_address(void)
+{
+    msg_t m;
+    dns_msg_answer_t answer;
+    const uint8_t addr[] = {93, 184, 216, 34};
+
+    answer_start(&m, 0, 1, 0);
+    record(&m, 12, 1, 300, 4);
+    put(&m, addr, 4);
+    // The case of the question is the server's choice
+    CHECK(dns_msg_parse(m.buf, m.len, 0x1234, "API.example.COM", &answer) == DNS_MSG_ADDR);
+    CHECK(memcmp(&answer.addr, addr, 4) == 0);
+    CHECK(answer.ttl_s == 300);
+}
+
+static void test_cname_chain(void)
+{
+    msg_t m;
+    dns_msg_answer_t answer;
+    const uint8_t addr[] = {10, 1, 2, 3};
+
+    answer_start(&m, 0, 3, 0);
+    // api.example.com CNAME lb.example.net (TTL 3600), lb CNAME edge (TTL 60), edge A (TTL 600)
+    size_t lb = m.len + 12;
+    record(&m, 12, 5, 3600, 16);
+    put(&m, "\x02lb\x07" "example\x03net\x00", 16);
+    size_t edge = m.len + 12;
+    record(&m, lb, 5, 60, 7);
+    put(&m, "\x04" "edge\xc0", 6);
+    put(&m, (uint8_t[]){(uint8_t)lb}, 1);
+    record(&m, edge, 1, 600, 4);
+    put(&m, addr, 4);
+    CHECK(dns_msg_parse(m.buf, m.len, 0x1234, NAME, &answer) == DNS_MSG_ADDR);
+    CHECK(memcmp(&answer.addr, addr, 4) == 0);
+    CHECK(answer.ttl_s == 60);
+}
+
+static void test_negative(void)
+{
+    msg_t m;
+    dns_msg_answer_t answer;
+
+    // NXDOMAIN with the SOA of the zone: the smaller of its TTL and MINIMUM
+    answer_start(&m, 3, 0, 1);
+    record(&m, 16, 6, 900, 32);
+    put(&m, "\x02ns\xc0\x10\x04host\xc0\x10", 12);
+    put32(&m, 2026101601);
+    put32(&m, 7200);
+    put32(&m, 3600);
+    put32(&m, 1209600);
+    put32(&m, 300);
+    CHECK(dns_msg_parse(m.buf, m.len, 0x1234, NAME, &answer) == DNS_MSG_NXDOMAIN);
+    CHECK(answer.ttl_s == 300);
+
+    // Name without IPv4 address, no SOA
+    answer_start(&m, 0, 1, 0);
+    record(&m, 12, 28, 300, 16);
+    put(&m, "0123456789abcdef", 16);
+    CHECK(dns_msg_parse(m.buf, m.len, 0x1234, NAME, &answer) == DNS_MSG_NODATA);
+    CHECK(answer.ttl_s == 0);
+}
+
+static void test_rejected(void)
+{
+    msg_t m;
+    dns_msg_answer_t answer;
+
+    answer_start(&m, 0, 1, 0);
+    record(&m, 12, 1, 300, 4);
+    put(&m, "\x01\x02\x03\x04", 4);
+    // Another query's answer, or another name
+    CHECK(dns_msg_parse(m.buf, m.len, 0x1235, NAME, &answer) == DNS_MSG_INVALID);
+    CHECK(dns_msg_parse(m.buf, m.len, 0x1234, "api.example.co", &answer) == DNS_MSG_INVALID);
+    CHECK(dns_msg_parse(m.buf, m.len, 0x1234, "api.example.com.au", &answer) == DNS_MSG_INVALID);
+    // Cut short
+    CHECK(dns_msg_parse(m.buf, m.len - 1, 0x1234, NAME, &answer) == DNS_MSG_INVALID);
+    CHECK(dns_msg_parse(m.buf, 11, 0x1234, NAME, &answer) == DNS_MSG_INVALID);
+    // Our own query looped back
+    uint8_t query[DNS_MSG_MAX];
+    int len = dns_msg_query(query, sizeof(query), 0x1234, NAME);
+    CHECK(dns_msg_parse(query, len, 0x1234, NAME, &answer) == DNS_MSG_INVALID);
+
+    // Truncated, server failure
+    answer_start(&m, 0x0200, 0, 0);
+    CHECK(dns_msg_parse(m.buf, m.len, 0x1234, NAME, &answer) == DNS_MSG_FAILED);
+    answer_start(&m, 2, 0, 0);
+    CHECK(dns_msg_parse(m.buf, m.len, 0x1234, NAME, &answer) == DNS_MSG_FAILED);
+
+    // A TTL with the top bit set counts as 0
+    answer_start(&m, 0, 1, 0);
+    record(&m, 12, 1, 0x80000000u, 4);
+    put(&m, "\x01\x02\x03\x04", 4);
+    CHECK(dns_msg_parse(m.buf, m.len, 0x1234, NAME, &answer) == DNS_MSG_ADDR);
+    CHECK(answer.ttl_s == 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_query);
+    RUN_TEST(test_address);
+    RUN_TEST(test_cname_chain);
+    RUN_TEST(test_negative);
+    RUN_TEST(test_rejected);
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Inbound duplicate filter: redeliveries, repeated commands, reused ids, window
+ */
+#include "host_test.h"
+#include "dup_filter.h"
+
+static uint32_t hash_of(const char *topic, const char *data)
+{
+    return dup_filter_hash(topic, strlen(topic), data, strlen(data), strlen(data));
+}
+
+static void test_redelivery(void)
+{
+    dup_filter_t f;
+    uint32_t reply = hash_of("esp32/dev1/client_gpt", "Tell me more about it");
+
+    dup_filter_init(&f);
+    CHECK(!dup_filter_check(&f, 7, reply, false));
+    CHECK(!dup_filter_check(&f, 8, hash_of("esp32/dev1/esp32_commands", "start"), false));
+    // Redelivered after a lost PUBACK: DUP flag, same packet id, same content
+    CHECK(dup_filter_check(&f, 7, reply, true));
+    CHECK(dup_filter_check(&f, 7, reply, true));
+    CHECK(f.suppressed == 2);
+    // Redelivered without the first delivery having arrived
+    CHECK(!dup_filter_check(&f, 9, hash_of("esp32/dev1/client_gpt", "And then?"), true));
+    CHECK(f.suppressed == 2);
+}
+
+static void test_repeats_are_not_duplicates(void)
+{
+    dup_filter_t f;
+    uint32_t start = hash_of("esp32/dev1/esp32_commands", "start");
+
+    dup_filter_init(&f);
+    // The same command twice, with new packet ids
+    CHECK(!dup_filter_check(&f, 1, start, false));
+    CHECK(!dup_filter_check(&f, 2, start, false));
+    // A reused packet id with other content
+    CHECK(!dup_filter_check(&f, 1, hash_of("esp32/dev1/esp32_commands", "reset"), false));
+    // Same payload on another topic, or with another total length (long message, same first fragment)
+    CHECK(hash_of("esp32/dev1/client_gpt", "start") != start);
+    CHECK(dup_filter_hash("t", 1, "abc", 3, 3) != dup_filter_hash("t", 1, "abc", 3, 4000));
+    CHECK(f.suppressed == 0);
+}
+
+static void test_reused_id_without_dup(void)
+{
+    dup_filter_t f;
+    uint32_t start = hash_of("esp32/dev1/esp32_commands", "start");
+
+    dup_filter_init(&f);
+    // The broker reuses the packet id for the same command sent again: a first delivery, kept
+    CHECK(!dup_filter_check(&f, 1, start, false));
+    CHECK(!dup_filter_check(&f, 1, start, false));
+    CHECK(f.suppressed == 0);
+    // Its redelivery is still recognized
+    CHECK(dup_filter_check(&f, 1, start, true));
+    CHECK(f.suppressed == 1);
+}
+
+static void test_window(void)
+{
+    dup_filter_t f;
+
+    dup_filter_init(&f);
+    for (uint16_t id = 1; id <= DUP_FILTER_SIZE + 1; id++) {
+        CHECK(!dup_filter_check(&f, id, id * 100, false));
+    }
+    // The oldest one left the window, the others are still there
+    CHECK(!dup_filter_check(&f, 1, 100, true));
+    CHECK(dup_filter_check(&f, DUP_FILTER_SIZE + 1, (DUP_FILTER_SIZE + 1) * 100, true));
+    CHECK(dup_filter_check(&f, 3, 300, true));
+}
+
+int main(void)
+{
+    RUN_TEST(test_redelivery);
+    RUN_TEST(test_repeats_are_not_duplicates);
+    RUN_TEST(test_reused_id_without_dup);
+    RUN_TEST(test_window);
+    return 0;
+}
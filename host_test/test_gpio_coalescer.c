@@ -0,0 +1,113 @@
+/*
+ * Coalescing of GPIO events: quiet window, latency cap and batch size
+ */
+#include <stdint.h>
+
+#include "host_test.h"
+#include "gpio_coalescer.h"
+
+#define MS 1000LL
+#define OVERHEAD 30
+
+static gpio_event_t event_at(uint8_t pin, int64_t t_us)
+{
+    return (gpio_event_t) {.pin = pin, .edge = GPIO_EVENT_EDGE_RISING, .timestamp_us = t_us};
+}
+
+static void setup(gpio_coalescer_t *c, gpio_event_t *storage, size_t max_events)
+{
+    gpio_coalescer_config_t cfg = {
+        .window_us = 20 * MS,
+        .max_latency_us = 100 * MS,
+        .max_events = max_events,
+        .packet_overhead = OVERHEAD,
+    };
+    gpio_coalescer_init(c, &cfg, storage);
+}
+
+static void test_window_and_latency_cap(void)
+{
+    gpio_coalescer_t c;
+    gpio_event_t storage[16];
+    setup(&c, storage, 16);
+
+    CHECK(gpio_coalescer_deadline(&c) == INT64_MAX);
+    gpio_event_t ev = event_at(4, 1000 * MS);
+    gpio_coalescer_add(&c, &ev);
+    CHECK(gpio_coalescer_deadline(&c) == 1020 * MS);
+
+    // Each new event pushes the quiet window, up to the cap of the oldest
+    for (int64_t t = 1015; t <= 1105; t += 15) {
+        ev = event_at(4, t * MS);
+        gpio_coalescer_add(&c, &ev);
+    }
+    CHECK(gpio_coalescer_deadline(&c) == 1100 * MS);
+}
+
+static void test_batch_size_and_sequence(void)
+{
+    gpio_coalescer_t c;
+    gpio_event_t storage[3];
+    uint8_t frame[GPIO_EVENT_FRAME_LEN(3)];
+    setup(&c, storage, 3);
+
+    for (int i = 0; i < 3; i++) {
+        gpio_event_t ev = event_at(i, i * MS);
+        CHECK(gpio_coalescer_add(&c, &ev));
+    }
+    CHECK(gpio_coalescer_is_full(&c));
+    gpio_event_t extra = event_at(9, 3 * MS);
+    CHECK(!gpio_coalescer_add(&c, &extra));
+
+    int len = gpio_coalescer_flush(&c, frame, sizeof(frame));
+    CHECK(len > GPIO_EVENT_HEADER_LEN);
+    CHECK(frame[1] == 3 && frame[2] == 0);
+    CHECK(gpio_coalescer_flush(&c, frame, sizeof(frame)) == 0);
+
+    // The next frame continues the sequence numbers
+    CHECK(gpio_coalescer_add(&c, &extra));
+    CHECK(gpio_coalescer_flush(&c, frame, sizeof(frame)) > 0);
+    CHECK(frame[2] == 3);
+}
+
+static void test_stats_count_savings(void)
+{
+    gpio_coalescer_t c;
+    gpio_event_t storage[8];
+    uint8_t frame[GPIO_EVENT_FRAME_LEN(8)];
+    setup(&c, storage, 8);
+
+    for (int i = 0; i < 8; i++) {
+        gpio_event_t ev = event_at(4, 1000 + i * 100);
+        gpio_coalescer_add(&c, &ev);
+    }
+    int len = gpio_coalescer_flush(&c, frame, sizeof(frame));
+    CHECK(c.stats.events == 8 && c.stats.publishes == 1);
+    CHECK(c.stats.bytes == (uint32_t)(len + OVERHEAD));
+    // One publish per event: a 16-byte frame and the overhead each time
+    CHECK(c.stats.bytes_unbatched == 8 * (GPIO_EVENT_HEADER_LEN + 2 + OVERHEAD));
+    printf("  8 events: %u bytes coalesced, %u unbatched\n", c.stats.bytes, c.stats.bytes_unbatched);
+}
+
+static void test_flush_buffer_too_small(void)
+{
+    gpio_coalescer_t c;
+    gpio_event_t storage[2];
+    uint8_t frame[GPIO_EVENT_HEADER_LEN];
+    setup(&c, storage, 2);
+
+    gpio_event_t ev = event_at(4, 0);
+    gpio_coalescer_add(&c, &ev);
+    CHECK(gpio_coalescer_flush(&c, frame, sizeof(frame)) == -1);
+    // Kept for a flush into a large enough buffer
+    CHECK(c.count == 1 && c.stats.publishes == 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_window_and_latency_cap);
+    RUN_TEST(test_batch_size_and_sequence);
+    RUN_TEST(test_stats_count_savings);
+    RUN_TEST(test_flush_buffer_too_small);
+    return 0;
+}
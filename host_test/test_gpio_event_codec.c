@@ -0,0 +1,84 @@
+/*
+ * Binary GPIO event frames
+ *
+ * fixtures/gpio_events_v1.bin is the frame of FIXTURE_EVENTS below. The
+ * computer's decoder (computerb/mqtt_client/src/gpio_event.rs) decodes the
+ * same file in its tests, so the encoder and the decoder are checked
+ * against each other.
+ */
+#include <stdint.h>
+
+#include "host_test.h"
+#include "gpio_event_codec.h"
+
+#define FIXTURE_SEQ 41
+
+static const gpio_event_t FIXTURE_EVENTS[] = {
+    {.pin = 4, .edge = GPIO_EVENT_EDGE_RISING, .timestamp_us = 1000},
+    {.pin = 5, .edge = GPIO_EVENT_EDGE_FALLING, .timestamp_us = 1300},
+    // Multi-byte deltas: 200 ms, then more than an hour
+    {.pin = 63, .edge = GPIO_EVENT_EDGE_RISING, .timestamp_us = 201300},
+    {.pin = 0, .edge = GPIO_EVENT_EDGE_FALLING, .timestamp_us = 5000201300LL},
+};
+#define FIXTURE_COUNT (sizeof(FIXTURE_EVENTS) / sizeof(FIXTURE_EVENTS[0]))
+
+static size_t read_fixture(const char *name, uint8_t *buf, size_t len)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", FIXTURE_DIR, name);
+    FILE *f = fopen(path, "rb");
+    CHECK(f != NULL);
+    size_t n = fread(buf, 1, len, f);
+    fclose(f);
+    return n;
+}
+
+static void test_matches_shared_fixture(void)
+{
+    uint8_t expected[GPIO_EVENT_FRAME_LEN(FIXTURE_COUNT)];
+    uint8_t frame[GPIO_EVENT_FRAME_LEN(FIXTURE_COUNT)];
+
+    size_t expected_len = read_fixture("gpio_events_v1.bin", expected, sizeof(expected));
+    int len = gpio_event_encode(FIXTURE_EVENTS, FIXTURE_COUNT, FIXTURE_SEQ, frame, sizeof(frame));
+    CHECK(len == (int)expected_len);
+    CHECK(memcmp(frame, expected, expected_len) == 0);
+}
+
+static void test_header_and_deltas(void)
+{
+    uint8_t frame[GPIO_EVENT_FRAME_LEN(2)];
+    int len = gpio_event_encode(FIXTURE_EVENTS, 2, 7, frame, sizeof(frame));
+
+    // Same frame as the hand-written one of the decoder's unit tests
+    static const uint8_t two_events[] = {
+        1, 2, 7, 0, 0, 0, 0xE8, 0x03, 0, 0, 0, 0, 0, 0,
+        0x84, 0x00,
+        0x05, 0xAC, 0x02,
+    };
+    CHECK(len == (int)sizeof(two_events));
+    CHECK(memcmp(frame, two_events, sizeof(two_events)) == 0);
+}
+
+static void test_rejects_invalid(void)
+{
+    uint8_t frame[GPIO_EVENT_FRAME_LEN(2)];
+    gpio_event_t events[2] = {FIXTURE_EVENTS[1], FIXTURE_EVENTS[0]};
+
+    CHECK(gpio_event_encode(FIXTURE_EVENTS, 0, 0, frame, sizeof(frame)) == -1);
+    // Out of order timestamps
+    CHECK(gpio_event_encode(events, 2, 0, frame, sizeof(frame)) == -1);
+    events[0] = FIXTURE_EVENTS[0];
+    events[0].pin = 64;
+    CHECK(gpio_event_encode(events, 1, 0, frame, sizeof(frame)) == -1);
+    // No room for the longest encoding of the second event
+    CHECK(gpio_event_encode(FIXTURE_EVENTS, 2, 0, frame, GPIO_EVENT_FRAME_LEN(1)) == -1);
+    CHECK(gpio_event_encode(FIXTURE_EVENTS, 1, 0, frame, GPIO_EVENT_HEADER_LEN - 1) == -1);
+}
+
+int main(void)
+{
+    RUN_TEST(test_matches_shared_fixture);
+    RUN_TEST(test_header_and_deltas);
+    RUN_TEST(test_rejects_invalid);
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Pin lists from menuconfig and the JSON message of one scan
+ */
+#include "host_test.h"
+#include "gpio_pins.h"
+
+static void test_parse_lists_and_ranges(void)
+{
+    uint64_t mask = 0;
+
+    CHECK(gpio_pins_parse("4,5,12-15", &mask));
+    CHECK(mask == ((1ULL << 4) | (1ULL << 5) | (0xFULL << 12)));
+    CHECK(gpio_pins_parse(" 0 , 63 ", &mask));
+    CHECK(mask == ((1ULL << 0) | (1ULL << 63)));
+    CHECK(gpio_pins_parse("7-7,7", &mask));
+    CHECK(mask == 1ULL << 7);
+    // An empty list is valid and selects nothing
+    CHECK(gpio_pins_parse("", &mask));
+    CHECK(mask == 0);
+}
+
+static void test_parse_rejects_malformed(void)
+{
+    uint64_t mask = 0xAA;
+
+    CHECK(!gpio_pins_parse("64", &mask));
+    CHECK(!gpio_pins_parse("-1", &mask));
+    CHECK(!gpio_pins_parse("15-12", &mask));
+    CHECK(!gpio_pins_parse("4,x", &mask));
+    CHECK(!gpio_pins_parse("4-", &mask));
+    // Left alone on error
+    CHECK(mask == 0xAA);
+}
+
+static void test_format_changes(void)
+{
+    char buf[128];
+    uint64_t changed = (1ULL << 4) | (1ULL << 33);
+    uint64_t levels = 1ULL << 33;
+
+    int len = gpio_pins_format_changes(changed, levels, 123456, buf, sizeof(buf));
+    CHECK_STR_EQ(buf, "{\"ts\":123456,\"changes\":[{\"pin\":4,\"level\":0},{\"pin\":33,\"level\":1}]}");
+    CHECK(len == (int)strlen(buf));
+
+    CHECK(gpio_pins_format_changes(0, 0, 5, buf, sizeof(buf)) > 0);
+    CHECK_STR_EQ(buf, "{\"ts\":5,\"changes\":[]}");
+}
+
+static void test_format_too_small(void)
+{
+    char buf[64];
+    int len = gpio_pins_format_changes(1ULL << 4, 0, 1, buf, sizeof(buf));
+
+    // No room for the closing "]}" of a message that would otherwise fit exactly
+    CHECK(gpio_pins_format_changes(1ULL << 4, 0, 1, buf, (size_t)len) == -1);
+    CHECK(gpio_pins_format_changes(1ULL << 4, 0, 1, buf, (size_t)len + 1) == len);
+    CHECK(gpio_pins_format_changes(~0ULL, 0, 1, buf, sizeof(buf)) == -1);
+}
+
+int main(void)
+{
+    RUN_TEST(test_parse_lists_and_ranges);
+    RUN_TEST(test_parse_rejects_malformed);
+    RUN_TEST(test_format_changes);
+    RUN_TEST(test_format_too_small);
+    return 0;
+}
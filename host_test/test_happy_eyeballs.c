@@ -0,0 +1,183 @@
+/*
+ * Happy eyeballs: IPv6 and IPv4 loopback listeners, one family blackholed or refusing
+ *
+ * A listener with a backlog of 0 whose queue already holds a connection
+ * drops further SYNs, exactly like a blackholed path: the connection
+ * attempt hangs until its timeout.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host_test.h"
+#include "happy_eyeballs.h"
+
+#define STAGGER_MS 100
+#define TIMEOUT_MS 2000
+// Scheduling slack allowed on top of the expected times
+#define SLACK_MS 50
+
+typedef struct {
+    int listener;
+    int filler;             // Connection filling the queue of a blackholed listener
+    struct sockaddr_storage addr;
+} endpoint_t;
+
+static long elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/*
+ * @brief Listener on the loopback address of a family
+ *
+ * @param blackhole Drop the connection attempts
+ * @param closed Nothing listens: attempts are refused
+ */
+static void endpoint_open(endpoint_t *e, int family, bool blackhole, bool closed)
+{
+    socklen_t len = family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+
+    memset(e, 0, sizeof(*e));
+    e->filler = -1;
+    e->addr.ss_family = family;
+    if (family == AF_INET6) {
+        ((struct sockaddr_in6 *)&e->addr)->sin6_addr = in6addr_loopback;
+    } else {
+        ((struct sockaddr_in *)&e->addr)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+    e->listener = socket(family, SOCK_STREAM, 0);
+    CHECK(e->listener >= 0);
+    CHECK(bind(e->listener, (struct sockaddr *)&e->addr, len) == 0);
+    CHECK(getsockname(e->listener, (struct sockaddr *)&e->addr, &len) == 0);
+    if (closed) {
+        // Bound, so the port stays ours, but not listening
+        return;
+    }
+    CHECK(listen(e->listener, blackhole ? 0 : 8) == 0);
+    if (blackhole) {
+        e->filler = socket(family, SOCK_STREAM, 0);
+        CHECK(connect(e->filler, (struct sockaddr *)&e->addr, len) == 0);
+    }
+}
+
+static void endpoint_close(endpoint_t *e)
+{
+    close(e->listener);
+    if (e->filler >= 0) {
+        close(e->filler);
+    }
+}
+
+/*
+ * @brief Race IPv6 then IPv4
+ *
+ * @return Connection time in ms
+ */
+static long race(const endpoint_t *v6, const endpoint_t *v4, int stagger_ms, int *winner)
+{
+    struct sockaddr_storage addrs[2] = {v6->addr, v4->addr};
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int fd = happy_eyeballs_connect(addrs, 2, stagger_ms, TIMEOUT_MS, winner);
+    long ms = elapsed_ms(&start);
+    CHECK((fd >= 0) == (*winner >= 0));
+    if (fd >= 0) {
+        close(fd);
+    }
+    return ms;
+}
+
+static void test_both_working(void)
+{
+    endpoint_t v6, v4;
+    int winner;
+
+    endpoint_open(&v6, AF_INET6, false, false);
+    endpoint_open(&v4, AF_INET, false, false);
+    long ms = race(&v6, &v4, STAGGER_MS, &winner);
+    printf("  both working: %s in %ld ms\n", winner == 0 ? "IPv6" : "IPv4", ms);
+    // IPv6 first, IPv4 never needed
+    CHECK(winner == 0 && ms < STAGGER_MS);
+    endpoint_close(&v6);
+    endpoint_close(&v4);
+}
+
+static void test_ipv6_blackholed(void)
+{
+    endpoint_t v6, v4;
+    int winner;
+
+    endpoint_open(&v6, AF_INET6, true, false);
+    endpoint_open(&v4, AF_INET, false, false);
+    long ms = race(&v6, &v4, STAGGER_MS, &winner);
+    printf("  IPv6 blackholed: %s in %ld ms (stagger %d ms)\n", winner == 0 ? "IPv6" : "IPv4", ms, STAGGER_MS);
+    CHECK(winner == 1 && ms >= STAGGER_MS && ms < STAGGER_MS + SLACK_MS);
+
+    // Tried one after the other, as without racing: the whole timeout
+    ms = race(&v6, &v4, TIMEOUT_MS, &winner);
+    printf("  IPv6 blackholed, sequential: %s after %ld ms\n", winner < 0 ? "nothing" : "connected", ms);
+    CHECK(winner == -1 && ms >= TIMEOUT_MS);
+    endpoint_close(&v6);
+    endpoint_close(&v4);
+}
+
+static void test_ipv4_blackholed(void)
+{
+    endpoint_t v6, v4;
+    int winner;
+
+    endpoint_open(&v6, AF_INET6, false, false);
+    endpoint_open(&v4, AF_INET, true, false);
+    long ms = race(&v6, &v4, STAGGER_MS, &winner);
+    printf("  IPv4 blackholed: %s in %ld ms\n", winner == 0 ? "IPv6" : "IPv4", ms);
+    CHECK(winner == 0 && ms < STAGGER_MS);
+    endpoint_close(&v6);
+    endpoint_close(&v4);
+}
+
+static void test_ipv6_refused(void)
+{
+    endpoint_t v6, v4;
+    int winner;
+
+    // A refusal starts IPv4 at once, without waiting for the stagger
+    endpoint_open(&v6, AF_INET6, false, true);
+    endpoint_open(&v4, AF_INET, false, false);
+    long ms = race(&v6, &v4, STAGGER_MS, &winner);
+    printf("  IPv6 refused: %s in %ld ms\n", winner == 0 ? "IPv6" : "IPv4", ms);
+    CHECK(winner == 1 && ms < STAGGER_MS);
+    endpoint_close(&v6);
+    endpoint_close(&v4);
+}
+
+static void test_both_blackholed(void)
+{
+    endpoint_t v6, v4;
+    int winner;
+
+    endpoint_open(&v6, AF_INET6, true, false);
+    endpoint_open(&v4, AF_INET, true, false);
+    long ms = race(&v6, &v4, STAGGER_MS, &winner);
+    printf("  both blackholed: given up after %ld ms\n", ms);
+    CHECK(winner == -1 && ms >= TIMEOUT_MS && ms < TIMEOUT_MS + SLACK_MS);
+    endpoint_close(&v6);
+    endpoint_close(&v4);
+}
+
+int main(void)
+{
+    RUN_TEST(test_both_working);
+    RUN_TEST(test_ipv6_blackholed);
+    RUN_TEST(test_ipv4_blackholed);
+    RUN_TEST(test_ipv6_refused);
+    RUN_TEST(test_both_blackholed);
+    return 0;
+}
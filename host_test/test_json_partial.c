@@ -0,0 +1,131 @@
+/*
+ * String value of a JSON document fed piece by piece, as the LLM response
+ * arrives from the HTTP client
+ */
+#include <stdbool.h>
+
+#include "host_test.h"
+#include "json_partial.h"
+
+#define RESPONSE "{\"id\":\"x\",\"choices\":[{\"index\":0,\"message\":{\"role\":\"assistant\"," \
+                 "\"content\" : \"Line 1\\nsaid \\\"hi\\\" \\u00e9t\\u00e9 \\ud83d\\ude00 caf\xc3\xa9\"}}]," \
+                 "\"usage\":{\"content\":\"not this one\"}}"
+#define VALUE "Line 1\nsaid \"hi\" \xc3\xa9t\xc3\xa9 \xf0\x9f\x98\x80 caf\xc3\xa9"
+
+typedef struct {
+    char buf[256];
+    size_t len;
+    int runs;
+} sink_t;
+
+static void collect(const char *data, size_t len, void *ctx)
+{
+    sink_t *s = ctx;
+
+    CHECK(len > 0 && s->len + len < sizeof(s->buf));
+    memcpy(s->buf + s->len, data, len);
+    s->len += len;
+    s->buf[s->len] = '\0';
+    s->runs++;
+}
+
+/*
+ * @brief Feed doc in blocks of block bytes, returns the last status
+ */
+static json_partial_status_t feed(const char *doc, size_t len, size_t block, const char *key, sink_t *s)
+{
+    json_partial_t j;
+    json_partial_status_t st = JSON_PARTIAL_SEARCHING;
+
+    memset(s, 0, sizeof(*s));
+    json_partial_init(&j, key);
+    for (size_t off = 0; off < len; off += block) {
+        st = json_partial_feed(&j, doc + off, len - off < block ? len - off : block, collect, s);
+    }
+    return st;
+}
+
+static void test_whole_document(void)
+{
+    sink_t s;
+
+    CHECK(feed(RESPONSE, strlen(RESPONSE), strlen(RESPONSE), "content", &s) == JSON_PARTIAL_COMPLETE);
+    CHECK_STR_EQ(s.buf, VALUE);
+    // Plain text between escapes goes out as it is, not byte by byte
+    CHECK(s.runs < 20);
+
+    CHECK(feed(RESPONSE, strlen(RESPONSE), 64, "missing", &s) == JSON_PARTIAL_SEARCHING);
+    CHECK(s.len == 0);
+    // "index" is a number, not a string
+    CHECK(feed(RESPONSE, strlen(RESPONSE), 64, "index", &s) == JSON_PARTIAL_INVALID);
+    // "assistant" is a value, not a key: the search goes on past it
+    static const char doc[] = "{\"role\":\"assistant\",\"x\":1,\"assistant\":\"yes\"}";
+    CHECK(feed(doc, strlen(doc), 5, "assistant", &s) == JSON_PARTIAL_COMPLETE);
+    CHECK_STR_EQ(s.buf, "yes");
+}
+
+static void test_any_block_size(void)
+{
+    sink_t s;
+
+    // Key, escapes and the surrogate pair split at every possible place
+    for (size_t block = 1; block <= strlen(RESPONSE); block++) {
+        CHECK(feed(RESPONSE, strlen(RESPONSE), block, "content", &s) == JSON_PARTIAL_COMPLETE);
+        CHECK_STR_EQ(s.buf, VALUE);
+    }
+}
+
+static void test_cut_document(void)
+{
+    const char *value_end = strstr(RESPONSE, "\"}}]");
+    sink_t s;
+
+    // Wherever the document ends, what came out is a prefix of the value
+    for (size_t len = 0; len < (size_t)(value_end - RESPONSE); len++) {
+        json_partial_status_t st = feed(RESPONSE, len, 7, "content", &s);
+        CHECK(st == JSON_PARTIAL_SEARCHING || st == JSON_PARTIAL_VALUE);
+        CHECK(strncmp(s.buf, VALUE, s.len) == 0);
+    }
+    // Cut inside 😀: nothing of it came out yet
+    const char *emoji = strstr(RESPONSE, "\\ud83d");
+    CHECK(feed(RESPONSE, emoji - RESPONSE + 8, 3, "content", &s) == JSON_PARTIAL_VALUE);
+    CHECK(strstr(s.buf, "\xf0") == NULL);
+}
+
+static void test_malformed_escapes(void)
+{
+    sink_t s;
+    static const char bad_hex[] = "{\"content\":\"ab\\u00zz\"}";
+    static const char lone_high[] = "{\"content\":\"ab\\ud83dxy\"}";
+    static const char bad_low[] = "{\"content\":\"ab\\ud83d\\u0041\"}";
+
+    CHECK(feed(bad_hex, strlen(bad_hex), 4, "content", &s) == JSON_PARTIAL_INVALID);
+    CHECK_STR_EQ(s.buf, "ab");
+    CHECK(feed(lone_high, strlen(lone_high), 4, "content", &s) == JSON_PARTIAL_INVALID);
+    CHECK(feed(bad_low, strlen(bad_low), 4, "content", &s) == JSON_PARTIAL_INVALID);
+}
+
+static void test_utf8_complete(void)
+{
+    static const char text[] = "caf\xc3\xa9 \xf0\x9f\x98\x80";
+
+    CHECK(json_partial_utf8_complete(text, strlen(text)) == strlen(text));
+    CHECK(json_partial_utf8_complete("", 0) == 0);
+    // Cut inside the emoji: back to the space before it
+    for (size_t cut = 1; cut < 4; cut++) {
+        CHECK(json_partial_utf8_complete(text, strlen(text) - cut) == 6);
+    }
+    // Cut inside é
+    CHECK(json_partial_utf8_complete(text, 4) == 3);
+    CHECK(json_partial_utf8_complete(text, 5) == 5);
+}
+
+int main(void)
+{
+    RUN_TEST(test_whole_document);
+    RUN_TEST(test_any_block_size);
+    RUN_TEST(test_cut_document);
+    RUN_TEST(test_malformed_escapes);
+    RUN_TEST(test_utf8_complete);
+    return 0;
+}
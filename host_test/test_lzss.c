@@ -0,0 +1,118 @@
+/*
+ * LZSS codec: round trips, resumable encoding, worst-case expansion and corrupt streams
+ */
+#include <stdint.h>
+
+#include "host_test.h"
+#include "lzss.h"
+
+static lzss_encoder_t enc;
+static uint8_t packed[8192];
+static uint8_t unpacked[8192];
+
+static const char *TEXT =
+    "Once upon a time, in a small village by the sea, there lived an old fisherman. "
+    "Every morning the old fisherman went out to sea, and every evening the old "
+    "fisherman came back to the village with his boat full of fish.";
+
+static size_t encode_all(const void *in, size_t len)
+{
+    CHECK(lzss_encoder_init(&enc, in, len));
+    return lzss_encode(&enc, packed, sizeof(packed));
+}
+
+static void round_trip(const void *in, size_t len)
+{
+    size_t packed_len = encode_all(in, len);
+    CHECK(packed_len < sizeof(packed));
+    CHECK(lzss_decode(packed, packed_len, unpacked, sizeof(unpacked)) == len);
+    CHECK(memcmp(unpacked, in, len) == 0);
+}
+
+static void test_round_trip(void)
+{
+    round_trip(TEXT, strlen(TEXT));
+    round_trip("", 0);
+    round_trip("ab", 2);
+
+    // Overlapping match: the distance is shorter than the length
+    char run[300];
+    memset(run, 'a', sizeof(run));
+    round_trip(run, sizeof(run));
+    CHECK(encode_all(run, sizeof(run)) < 30);
+
+    // Repeated text compresses
+    size_t text_len = strlen(TEXT);
+    CHECK(encode_all(TEXT, text_len) < text_len * 85 / 100);
+}
+
+static void test_incompressible(void)
+{
+    uint8_t noise[4096];
+    uint32_t x = 12345;
+    for (size_t i = 0; i < sizeof(noise); i++) {
+        x = x * 1103515245 + 12345;
+        noise[i] = x >> 16;
+    }
+    round_trip(noise, sizeof(noise));
+    // At worst one flag byte per 8 literals
+    CHECK(encode_all(noise, sizeof(noise)) <= sizeof(noise) + (sizeof(noise) + 7) / 8);
+}
+
+static void test_resumable(void)
+{
+    size_t len = strlen(TEXT);
+    size_t whole = encode_all(TEXT, len);
+    uint8_t copy[512];
+    memcpy(copy, packed, whole);
+
+    // Counting only
+    CHECK(lzss_encoder_init(&enc, TEXT, len));
+    CHECK(lzss_encode(&enc, NULL, SIZE_MAX) == whole);
+
+    // Taken 5 bytes at a time: same stream
+    CHECK(lzss_encoder_init(&enc, TEXT, len));
+    size_t got = 0;
+    size_t n;
+    while ((n = lzss_encode(&enc, packed + got, 5)) > 0) {
+        got += n;
+        CHECK(n == 5 || got == whole);
+    }
+    CHECK(got == whole);
+    CHECK(memcmp(packed, copy, whole) == 0);
+}
+
+static void test_corrupt_streams(void)
+{
+    // Match before any output
+    static const uint8_t early_match[] = {0x01, 0x00, 0x00};
+    CHECK(lzss_decode(early_match, sizeof(early_match), unpacked, sizeof(unpacked)) == LZSS_ERROR);
+    // Match token cut short
+    static const uint8_t cut[] = {0x02, 'a', 0x00};
+    CHECK(lzss_decode(cut, sizeof(cut), unpacked, sizeof(unpacked)) == LZSS_ERROR);
+    // Output too small
+    size_t len = strlen(TEXT);
+    size_t packed_len = encode_all(TEXT, len);
+    CHECK(lzss_decode(packed, packed_len, unpacked, len - 1) == LZSS_ERROR);
+    CHECK(lzss_decode(packed, packed_len, unpacked, len) == len);
+
+    CHECK(!lzss_encoder_init(&enc, TEXT, LZSS_MAX_INPUT + 1));
+}
+
+static void test_stream_layout(void)
+{
+    // Same bytes as in the Rust client tests: 3 literals, then 9 bytes from 3 back
+    static const uint8_t expected[] = {0x08, 'a', 'b', 'c', (3 - 1) << 5 | (9 - LZSS_MIN_MATCH), 0x00};
+    CHECK(encode_all("abcabcabcabc", 12) == sizeof(expected));
+    CHECK(memcmp(packed, expected, sizeof(expected)) == 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_incompressible);
+    RUN_TEST(test_resumable);
+    RUN_TEST(test_corrupt_streams);
+    RUN_TEST(test_stream_layout);
+    return 0;
+}
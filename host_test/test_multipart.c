@@ -0,0 +1,136 @@
+/*
+ * Multipart framing: header layout, last part flag and reassembly of the payloads
+ */
+#include <stdint.h>
+
+#include "host_test.h"
+#include "multipart.h"
+
+#define CHUNK 8
+
+/*
+ * @brief Write every part of a message the way the firmware does, returns the total length
+ *
+ * The length is not known upfront: a full chunk goes out once more text follows it.
+ */
+static size_t write_parts(multipart_writer_t *w, const char *msg, uint8_t *out, size_t *part_lens, int *count)
+{
+    size_t len = strlen(msg);
+    size_t offset = 0;
+    uint8_t *p = out;
+
+    *count = 0;
+    do {
+        size_t n = len - offset < CHUNK ? len - offset : CHUNK;
+        bool last = offset + n == len;
+        CHECK(multipart_writer_next(w, p, last ? MULTIPART_FLAG_LAST : 0));
+        memcpy(p + MULTIPART_HEADER_LEN, msg + offset, n);
+        offset += n;
+        part_lens[(*count)++] = MULTIPART_HEADER_LEN + n;
+        p += MULTIPART_HEADER_LEN + n;
+    } while (offset < len);
+    return p - out;
+}
+
+static void test_header_layout(void)
+{
+    multipart_writer_t w;
+    uint8_t parts[64];
+    size_t lens[4];
+    int count;
+
+    multipart_writer_init(&w, 0x04030201);
+    CHECK(multipart_writer_next(&w, parts, MULTIPART_FLAG_LZSS | MULTIPART_FLAG_LAST));
+    memcpy(parts + MULTIPART_HEADER_LEN, "abc", 3);
+    static const uint8_t expected[] = {
+        'M', 'P', 2, MULTIPART_FLAG_LZSS | MULTIPART_FLAG_LAST, 0x01, 0x02, 0x03, 0x04, 0, 0, 'a', 'b', 'c',
+    };
+    CHECK(memcmp(parts, expected, sizeof(expected)) == 0);
+    // Nothing after the last part
+    CHECK(!multipart_writer_next(&w, parts + 32, 0));
+
+    multipart_header_t hdr;
+    CHECK(multipart_read_header(parts, sizeof(expected), &hdr));
+    CHECK(hdr.msg_id == 0x04030201 && hdr.part == 0 && hdr.flags == (MULTIPART_FLAG_LZSS | MULTIPART_FLAG_LAST));
+    CHECK(!multipart_read_header(parts, MULTIPART_HEADER_LEN - 1, &hdr));
+
+    // An empty message is still announced by one empty part
+    multipart_writer_init(&w, 7);
+    CHECK(write_parts(&w, "", parts, lens, &count) == MULTIPART_HEADER_LEN);
+    CHECK(count == 1 && parts[3] == MULTIPART_FLAG_LAST);
+}
+
+static void test_plain_text_is_not_a_part(void)
+{
+    multipart_header_t hdr;
+    uint8_t part[MULTIPART_HEADER_LEN] = {'M', 'P', MULTIPART_VERSION, 0, 1, 0, 0, 0, 0, 0};
+
+    CHECK(!multipart_read_header((const uint8_t *)"plain text message", 18, &hdr));
+    // Text starting like a header
+    CHECK(!multipart_read_header((const uint8_t *)"MPEG-4 part 14 container", 24, &hdr));
+    CHECK(!multipart_read_header((const uint8_t *)"MPs voted on the bill", 21, &hdr));
+    // Older version, unknown flag
+    CHECK(multipart_read_header(part, sizeof(part), &hdr));
+    part[2] = 1;
+    CHECK(!multipart_read_header(part, sizeof(part), &hdr));
+    part[2] = MULTIPART_VERSION;
+    part[3] = 0x40;
+    CHECK(!multipart_read_header(part, sizeof(part), &hdr));
+}
+
+static void test_split_and_join(void)
+{
+    const char *msg = "The quick brown fox jumps over the lazy dog";
+    size_t len = strlen(msg);
+    multipart_writer_t w;
+    uint8_t parts[128];
+    size_t lens[8];
+    char joined[64] = {0};
+    size_t joined_len = 0;
+    int count;
+
+    multipart_writer_init(&w, 42);
+    write_parts(&w, msg, parts, lens, &count);
+    CHECK(count == (int)((len + CHUNK - 1) / CHUNK));
+
+    const uint8_t *p = parts;
+    for (int i = 0; i < count; i++) {
+        multipart_header_t hdr;
+        // Every part fits the buffer of one chunk and carries its number, the last one its flag
+        CHECK(lens[i] <= MULTIPART_HEADER_LEN + CHUNK);
+        CHECK(multipart_read_header(p, lens[i], &hdr));
+        CHECK(hdr.msg_id == 42 && hdr.part == i);
+        CHECK(hdr.flags == (i == count - 1 ? MULTIPART_FLAG_LAST : 0));
+        memcpy(joined + joined_len, p + MULTIPART_HEADER_LEN, lens[i] - MULTIPART_HEADER_LEN);
+        joined_len += lens[i] - MULTIPART_HEADER_LEN;
+        p += lens[i];
+    }
+    CHECK(joined_len == len);
+    CHECK_STR_EQ(joined, msg);
+}
+
+static void test_part_numbers_run_out(void)
+{
+    multipart_writer_t w;
+    uint8_t hdr[MULTIPART_HEADER_LEN];
+
+    multipart_writer_init(&w, 1);
+    w.part = UINT16_MAX;
+    // Part 65535 can close the message, never continue it
+    CHECK(!multipart_writer_next(&w, hdr, 0));
+    CHECK(!multipart_writer_next(&w, hdr, MULTIPART_FLAG_LAST));
+
+    multipart_writer_init(&w, 1);
+    w.part = UINT16_MAX;
+    CHECK(multipart_writer_next(&w, hdr, MULTIPART_FLAG_LAST));
+    CHECK(hdr[8] == 0xFF && hdr[9] == 0xFF);
+}
+
+int main(void)
+{
+    RUN_TEST(test_header_layout);
+    RUN_TEST(test_plain_text_is_not_a_part);
+    RUN_TEST(test_split_and_join);
+    RUN_TEST(test_part_numbers_run_out);
+    return 0;
+}
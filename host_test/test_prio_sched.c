@@ -0,0 +1,184 @@
+/*
+ * Priority classes of the conversation scheduler, and a simulation of the
+ * conversation worker showing a bounded press latency while /client_gpt is
+ * saturated. The worker is modelled taking requests straight from the
+ * scheduler; the session queue in between is simulated under the same load
+ * in test_session_table.c.
+ */
+#include "host_test.h"
+#include "prio_sched.h"
+
+typedef struct {
+    int type;
+    int64_t posted_ms;
+} item_t;
+
+static void test_highest_class_first(void)
+{
+    prio_sched_t s;
+    item_t user[2], command[2], continuation[4];
+    item_t item;
+    prio_class_t cls;
+
+    prio_sched_init(&s, sizeof(item_t));
+    prio_sched_set_class(&s, PRIO_CLASS_USER_INPUT, user, 2);
+    prio_sched_set_class(&s, PRIO_CLASS_COMMAND, command, 2);
+    prio_sched_set_class(&s, PRIO_CLASS_CONTINUATION, continuation, 4);
+
+    CHECK(!prio_sched_pop(&s, &item, &cls));
+    prio_sched_push(&s, PRIO_CLASS_CONTINUATION, &(item_t){1, 0});
+    prio_sched_push(&s, PRIO_CLASS_CONTINUATION, &(item_t){2, 0});
+    prio_sched_push(&s, PRIO_CLASS_COMMAND, &(item_t){3, 0});
+    prio_sched_push(&s, PRIO_CLASS_USER_INPUT, &(item_t){4, 0});
+
+    CHECK(prio_sched_pop(&s, &item, &cls) && item.type == 4 && cls == PRIO_CLASS_USER_INPUT);
+    CHECK(prio_sched_pop(&s, &item, &cls) && item.type == 3 && cls == PRIO_CLASS_COMMAND);
+    // FIFO within a class
+    CHECK(prio_sched_pop(&s, &item, &cls) && item.type == 1 && cls == PRIO_CLASS_CONTINUATION);
+    CHECK(prio_sched_pop(&s, &item, NULL) && item.type == 2);
+    CHECK(!prio_sched_pop(&s, &item, NULL));
+}
+
+static void test_full_class_drops_oldest(void)
+{
+    prio_sched_t s;
+    item_t continuation[3];
+    item_t item;
+
+    prio_sched_init(&s, sizeof(item_t));
+    prio_sched_set_class(&s, PRIO_CLASS_CONTINUATION, continuation, 3);
+
+    for (int i = 1; i <= 3; i++) {
+        CHECK(prio_sched_push(&s, PRIO_CLASS_CONTINUATION, &(item_t){i, 0}));
+    }
+    CHECK(!prio_sched_push(&s, PRIO_CLASS_CONTINUATION, &(item_t){4, 0}));
+    CHECK(!prio_sched_push(&s, PRIO_CLASS_CONTINUATION, &(item_t){5, 0}));
+    CHECK(s.classes[PRIO_CLASS_CONTINUATION].dropped == 2);
+    CHECK(prio_sched_pending(&s, PRIO_CLASS_CONTINUATION) == 3);
+
+    for (int i = 3; i <= 5; i++) {
+        CHECK(prio_sched_pop(&s, &item, NULL) && item.type == i);
+    }
+
+    prio_sched_push(&s, PRIO_CLASS_CONTINUATION, &(item_t){6, 0});
+    prio_sched_clear(&s, PRIO_CLASS_CONTINUATION);
+    CHECK(prio_sched_pending(&s, PRIO_CLASS_CONTINUATION) == 0);
+}
+
+/*
+ * Conversation worker model, one step per millisecond:
+ *  - a /client_gpt reply arrives every 20 ms, each one costs an LLM call
+ *  - a "reset" command arrives every 7 s
+ *  - a button press arrives every 4.3 s; it cancels the call in flight
+ *    (closed after at most one poll interval) and the pending requests
+ * With prioritized == false every request shares one FIFO, as a plain queue would.
+ */
+#define SIM_DURATION_MS 120000
+#define SIM_LLM_CALL_MS 1500
+#define SIM_CANCEL_POLL_MS 100
+#define SIM_REPLY_PERIOD_MS 20
+
+enum { SIM_START, SIM_RESET, SIM_CONTINUE };
+
+typedef struct {
+    int64_t press_max_ms;
+    int64_t command_max_ms;
+    int presses_while_busy;
+    int commands_posted;
+    int commands_served;
+    int continuations_served;
+} sim_result_t;
+
+static void simulate(bool prioritized, sim_result_t *r)
+{
+    prio_sched_t s;
+    item_t user[2], command[2], continuation[8];
+    int64_t busy_until = 0;
+    item_t item;
+
+    prio_sched_init(&s, sizeof(item_t));
+    prio_sched_set_class(&s, PRIO_CLASS_USER_INPUT, user, 2);
+    prio_sched_set_class(&s, PRIO_CLASS_COMMAND, command, 2);
+    prio_sched_set_class(&s, PRIO_CLASS_CONTINUATION, continuation, 8);
+    memset(r, 0, sizeof(*r));
+
+    for (int64_t t = 0; t < SIM_DURATION_MS; t++) {
+        prio_class_t user_cls = prioritized ? PRIO_CLASS_USER_INPUT : PRIO_CLASS_CONTINUATION;
+        prio_class_t command_cls = prioritized ? PRIO_CLASS_COMMAND : PRIO_CLASS_CONTINUATION;
+
+        if (t % SIM_REPLY_PERIOD_MS == 0) {
+            prio_sched_push(&s, PRIO_CLASS_CONTINUATION, &(item_t){SIM_CONTINUE, t});
+        }
+        if (t % 7000 == 3500) {
+            prio_sched_push(&s, command_cls, &(item_t){SIM_RESET, t});
+            r->commands_posted++;
+        }
+        if (t % 4300 == 1000) {
+            // conversation_post(START): cancel, drop everything pending, then queue the press
+            if (t < busy_until) {
+                r->presses_while_busy++;
+                if (busy_until > t + SIM_CANCEL_POLL_MS) {
+                    busy_until = t + SIM_CANCEL_POLL_MS;
+                }
+            }
+            for (int cls = 0; cls < PRIO_CLASS_COUNT; cls++) {
+                prio_sched_clear(&s, cls);
+            }
+            prio_sched_push(&s, user_cls, &(item_t){SIM_START, t});
+        }
+
+        if (t < busy_until || !prio_sched_pop(&s, &item, NULL)) {
+            continue;
+        }
+        int64_t wait = t - item.posted_ms;
+        switch (item.type) {
+        case SIM_START:
+            if (wait > r->press_max_ms) {
+                r->press_max_ms = wait;
+            }
+            busy_until = t + SIM_LLM_CALL_MS;
+            break;
+        case SIM_RESET:
+            r->commands_served++;
+            if (wait > r->command_max_ms) {
+                r->command_max_ms = wait;
+            }
+            busy_until = t + 1;
+            break;
+        case SIM_CONTINUE:
+            r->continuations_served++;
+            busy_until = t + SIM_LLM_CALL_MS;
+            break;
+        }
+    }
+}
+
+static void test_press_latency_bounded_under_saturation(void)
+{
+    sim_result_t prio, fifo;
+    simulate(true, &prio);
+    simulate(false, &fifo);
+
+    printf("  press max wait %lld ms, command max wait %lld ms, commands served %d/%d (single FIFO: %d/%d)\n",
+           (long long)prio.press_max_ms, (long long)prio.command_max_ms,
+           prio.commands_served, prio.commands_posted, fifo.commands_served, fifo.commands_posted);
+
+    // The worker was busy with a reply for most presses, replies kept flowing
+    CHECK(prio.presses_while_busy > 10);
+    CHECK(prio.continuations_served > 30);
+
+    // A press waits for the cancelled call to close, never for queued replies
+    CHECK(prio.press_max_ms <= SIM_CANCEL_POLL_MS);
+    // A command waits at most for the call in flight
+    CHECK(prio.command_max_ms <= SIM_LLM_CALL_MS);
+    // Sharing a queue with the replies, commands are pushed out by the flood
+    CHECK(prio.commands_served > fifo.commands_served);
+}
+
+int main(void)
+{
+    RUN_TEST(test_highest_class_first);
+    RUN_TEST(test_full_class_drops_oldest);
+    RUN_TEST(test_press_latency_bounded_under_saturation);
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * Host simulation of the pulse counter publishing logic: raw counter
+ * readings as the PCNT driver would return them, report every second.
+ */
+#include "host_test.h"
+#include "pulse_report.h"
+
+#define SECOND_US 1000000LL
+
+static void test_counts_and_rates(void)
+{
+    pulse_report_t r;
+    char buf[256];
+    pulse_report_init(&r, 0);
+    CHECK(pulse_report_add_channel(&r, 18) == 0);
+    CHECK(pulse_report_add_channel(&r, 19) == 1);
+
+    // 1 kHz flow meter on GPIO 18, 2.5 Hz encoder on GPIO 19 over two seconds
+    pulse_report_update(&r, 0, 1000);
+    pulse_report_update(&r, 1, 2);
+    pulse_report_format(&r, SECOND_US, buf, sizeof(buf));
+    pulse_report_update(&r, 0, 2000);
+    pulse_report_update(&r, 1, 5);
+    CHECK(pulse_report_format(&r, 2 * SECOND_US, buf, sizeof(buf)) > 0);
+    CHECK_STR_EQ(buf, "{\"interval_ms\":1000,\"counters\":["
+                 "{\"pin\":18,\"count\":1000,\"total\":2000,\"rate_hz\":1000.0},"
+                 "{\"pin\":19,\"count\":3,\"total\":5,\"rate_hz\":3.0}]}");
+}
+
+static void test_counter_wrap_around(void)
+{
+    pulse_report_t r;
+    char buf[256];
+    pulse_report_init(&r, 0);
+    pulse_report_add_channel(&r, 4);
+
+    // Raw count close to the top of the 32-bit range, then wrapping
+    pulse_report_update(&r, 0, INT32_MAX - 9);
+    pulse_report_format(&r, SECOND_US, buf, sizeof(buf));
+    pulse_report_update(&r, 0, INT32_MIN + 40);
+    CHECK(pulse_report_format(&r, 2 * SECOND_US, buf, sizeof(buf)) > 0);
+    CHECK(r.channels[0].total == (uint64_t)INT32_MAX + 41);
+    CHECK(strstr(buf, "\"count\":50,") != NULL);
+}
+
+static void test_rate_uses_real_interval(void)
+{
+    pulse_report_t r;
+    char buf[256];
+    pulse_report_init(&r, 0);
+    pulse_report_add_channel(&r, 4);
+
+    // Report task delayed: 300 pulses over 1.5 s is 200 Hz, not 300 Hz
+    pulse_report_update(&r, 0, 300);
+    CHECK(pulse_report_format(&r, 3 * SECOND_US / 2, buf, sizeof(buf)) > 0);
+    CHECK(strstr(buf, "\"interval_ms\":1500,") != NULL);
+    CHECK(strstr(buf, "\"rate_hz\":200.0}") != NULL);
+}
+
+static void test_small_buffer_keeps_interval_open(void)
+{
+    pulse_report_t r;
+    char small[16];
+    char buf[256];
+    pulse_report_init(&r, 0);
+    pulse_report_add_channel(&r, 4);
+
+    // A report that does not fit must not lose the counts of the interval
+    pulse_report_update(&r, 0, 70);
+    CHECK(pulse_report_format(&r, SECOND_US, small, sizeof(small)) == -1);
+    pulse_report_update(&r, 0, 100);
+    CHECK(pulse_report_format(&r, 2 * SECOND_US, buf, sizeof(buf)) > 0);
+    CHECK(strstr(buf, "\"interval_ms\":2000,") != NULL);
+    CHECK(strstr(buf, "\"count\":100,") != NULL);
+}
+
+static void test_channel_limit(void)
+{
+    pulse_report_t r;
+    pulse_report_init(&r, 0);
+    for (int i = 0; i < PULSE_REPORT_MAX_CHANNELS; i++) {
+        CHECK(pulse_report_add_channel(&r, i) == i);
+    }
+    CHECK(pulse_report_add_channel(&r, 30) == -1);
+}
+
+int main(void)
+{
+    RUN_TEST(test_counts_and_rates);
+    RUN_TEST(test_counter_wrap_around);
+    RUN_TEST(test_rate_uses_real_interval);
+    RUN_TEST(test_small_buffer_keeps_interval_open);
+    RUN_TEST(test_channel_limit);
+    return 0;
+}
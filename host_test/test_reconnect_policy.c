@@ -0,0 +1,123 @@
+/*
+ * Reconnect policy: backoff windows, jitter, fast first retry and causes
+ */
+#include "host_test.h"
+#include "reconnect_policy.h"
+
+#define S 1000000LL
+
+// Largest of many delays drawn for the same state, to check the window
+static uint32_t max_delay(uint32_t attempt, reconnect_cause_t cause, uint32_t *min)
+{
+    reconnect_policy_t p;
+    uint32_t max = 0;
+
+    *min = UINT32_MAX;
+    for (uint32_t seed = 1; seed <= 2000; seed++) {
+        reconnect_policy_init(&p, 500, 1000, 60000, seed);
+        p.attempt = attempt;
+        uint32_t d = reconnect_policy_delay_ms(&p, cause, 0);
+        max = d > max ? d : max;
+        *min = d < *min ? d : *min;
+    }
+    return max;
+}
+
+static void test_backoff_windows(void)
+{
+    uint32_t min;
+
+    // Full jitter: the delays cover [0, window]
+    uint32_t max = max_delay(0, RECONNECT_CAUSE_UNREACHABLE, &min);
+    CHECK(max <= 1000 && max > 950 && min < 50);
+    max = max_delay(3, RECONNECT_CAUSE_UNREACHABLE, &min);
+    CHECK(max <= 8000 && max > 7600 && min < 400);
+    // Capped, even after many attempts
+    max = max_delay(20, RECONNECT_CAUSE_UNREACHABLE, &min);
+    CHECK(max <= 60000 && max > 57000);
+
+    // A busy broker gets a wider window
+    max = max_delay(0, RECONNECT_CAUSE_BUSY, &min);
+    CHECK(max <= 4000 && max > 3800);
+    // A refused client waits in the upper half of the cap
+    max = max_delay(0, RECONNECT_CAUSE_REJECTED, &min);
+    CHECK(max <= 60000 && min >= 30000);
+}
+
+static void test_fast_first_retry(void)
+{
+    reconnect_policy_t p;
+
+    reconnect_policy_init(&p, 500, 1000, 60000, 42);
+    reconnect_policy_connected(&p, 0);
+    CHECK(reconnect_policy_delay_ms(&p, RECONNECT_CAUSE_LOST, 120 * S) <= 500);
+    // Then backoff while the broker does not answer
+    CHECK(p.attempt == 1);
+    reconnect_policy_delay_ms(&p, RECONNECT_CAUSE_UNREACHABLE, 121 * S);
+    CHECK(p.attempt == 2);
+
+    // Connected again for long enough: the next drop is retried fast
+    reconnect_policy_connected(&p, 125 * S);
+    CHECK(reconnect_policy_delay_ms(&p, RECONNECT_CAUSE_LOST, 200 * S) <= 500);
+    CHECK(p.attempt == 1);
+}
+
+static void test_flapping_keeps_backing_off(void)
+{
+    reconnect_policy_t p;
+    uint32_t max = 0;
+
+    reconnect_policy_init(&p, 500, 1000, 60000, 7);
+    reconnect_policy_connected(&p, 0);
+    reconnect_policy_delay_ms(&p, RECONNECT_CAUSE_LOST, 100 * S);
+    // The broker accepts, then drops the connection at once, over and over
+    for (int i = 0; i < 10; i++) {
+        reconnect_policy_connected(&p, (101 + i) * S);
+        uint32_t d = reconnect_policy_delay_ms(&p, RECONNECT_CAUSE_LOST, (101 + i) * S + 100000);
+        max = d > max ? d : max;
+    }
+    CHECK(p.attempt == 11);
+    CHECK(max > 500);
+}
+
+static void test_deterministic_per_seed(void)
+{
+    reconnect_policy_t a, b, c;
+
+    reconnect_policy_init(&a, 500, 1000, 60000, 1234);
+    reconnect_policy_init(&b, 500, 1000, 60000, 1234);
+    reconnect_policy_init(&c, 500, 1000, 60000, 4321);
+    int same = 0;
+    for (int i = 0; i < 8; i++) {
+        uint32_t da = reconnect_policy_delay_ms(&a, RECONNECT_CAUSE_UNREACHABLE, 0);
+        CHECK(da == reconnect_policy_delay_ms(&b, RECONNECT_CAUSE_UNREACHABLE, 0));
+        same += da == reconnect_policy_delay_ms(&c, RECONNECT_CAUSE_UNREACHABLE, 0);
+    }
+    CHECK(same < 8);
+
+    // Seed 0 would never change
+    reconnect_policy_init(&a, 500, 1000, 60000, 0);
+    CHECK(reconnect_policy_delay_ms(&a, RECONNECT_CAUSE_UNREACHABLE, 0) !=
+          reconnect_policy_delay_ms(&a, RECONNECT_CAUSE_UNREACHABLE, 0));
+}
+
+static void test_connack_causes(void)
+{
+    CHECK(reconnect_cause_from_connack(3) == RECONNECT_CAUSE_BUSY);
+    CHECK(reconnect_cause_from_connack(0x89) == RECONNECT_CAUSE_BUSY);
+    CHECK(reconnect_cause_from_connack(0x9F) == RECONNECT_CAUSE_BUSY);
+    CHECK(reconnect_cause_from_connack(4) == RECONNECT_CAUSE_REJECTED);
+    CHECK(reconnect_cause_from_connack(5) == RECONNECT_CAUSE_REJECTED);
+    CHECK(reconnect_cause_from_connack(0x86) == RECONNECT_CAUSE_REJECTED);
+    CHECK_STR_EQ(reconnect_cause_name(RECONNECT_CAUSE_BUSY), "busy");
+}
+
+int main(void)
+{
+    RUN_TEST(test_backoff_windows);
+    RUN_TEST(test_fast_first_retry);
+    RUN_TEST(test_flapping_keeps_backing_off);
+    RUN_TEST(test_deterministic_per_seed);
+    RUN_TEST(test_connack_causes);
+    return 0;
+}
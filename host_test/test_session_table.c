@@ -0,0 +1,445 @@
+/*
+ * Conversation sessions: naming, eviction, per-session ordering, purge of
+ * cancelled work in every session or in one, and simulations of the worker pool serving independent
+ * sessions in parallel and of button presses while /client_gpt saturates
+ * the default session
+ */
+#include "host_test.h"
+#include "session_table.h"
+
+#define DEPTH 3
+
+typedef struct {
+    int turn;
+} item_t;
+
+static item_t s_storage[SESSION_TABLE_MAX * DEPTH];
+
+static int open_name(session_table_t *t, const char *name, bool *created)
+{
+    return session_table_open(t, name, strlen(name), created);
+}
+
+static void test_names(void)
+{
+    CHECK(session_name_valid("", 0));
+    CHECK(session_name_valid("kitchen-2_b", 11));
+    CHECK(session_name_valid("abcdefghijklmnopqrstuvwx", SESSION_NAME_MAX));
+    CHECK(!session_name_valid("abcdefghijklmnopqrstuvwxy", SESSION_NAME_MAX + 1));
+    CHECK(!session_name_valid("a/b", 3));
+    CHECK(!session_name_valid("a\"b", 3));
+    CHECK(!session_name_valid("+", 1));
+}
+
+static void test_open_finds_or_creates(void)
+{
+    session_table_t t;
+    bool created;
+
+    session_table_init(&t, 3, s_storage, DEPTH, sizeof(item_t));
+    int def = open_name(&t, "", &created);
+    CHECK(def >= 0 && created);
+    int a = session_table_open(&t, "kitchen/x", 7, &created);
+    CHECK(a >= 0 && a != def && created);
+    CHECK_STR_EQ(session_table_name(&t, a), "kitchen");
+    CHECK(open_name(&t, "kitchen", &created) == a && !created);
+    CHECK(open_name(&t, "", NULL) == def);
+    // Prefix of an existing name is another session
+    int b = open_name(&t, "kitch", &created);
+    CHECK(b >= 0 && b != a && created);
+}
+
+static void test_eviction_spares_active_sessions(void)
+{
+    session_table_t t;
+    item_t item = {0};
+    int session;
+    bool created;
+
+    session_table_init(&t, 3, s_storage, DEPTH, sizeof(item_t));
+    int a = open_name(&t, "a", NULL);
+    int b = open_name(&t, "b", NULL);
+    int c = open_name(&t, "c", NULL);
+    CHECK(session_table_post(&t, b, &item));
+    CHECK(session_table_post(&t, a, &item));
+    CHECK(session_table_post(&t, c, &item));
+
+    // Every session has work pending
+    CHECK(open_name(&t, "d", NULL) == -1);
+
+    // b is taken by a worker, a and c are idle once served; a was used before c
+    CHECK(session_table_take(&t, &session, &item) && session == b);
+    CHECK(session_table_take(&t, &session, &item) && session == a);
+    session_table_done(&t, a);
+    CHECK(session_table_take(&t, &session, &item) && session == c);
+    session_table_done(&t, c);
+    int d = open_name(&t, "d", &created);
+    CHECK(d == a && created);
+    CHECK_STR_EQ(session_table_name(&t, d), "d");
+    CHECK(t.slots[d].pending == 0);
+
+    // c is older than d, b is still busy whatever its age
+    CHECK(open_name(&t, "e", NULL) == c);
+    CHECK(open_name(&t, "f", NULL) == d);
+    CHECK_STR_EQ(session_table_name(&t, b), "b");
+    session_table_done(&t, b);
+    CHECK(open_name(&t, "g", NULL) == b);
+
+    // The default session keeps its slot, idle and least recently used as it is
+    session_table_init(&t, 2, s_storage, DEPTH, sizeof(item_t));
+    int def = open_name(&t, "", NULL);
+    open_name(&t, "a", NULL);
+    CHECK(open_name(&t, "b", NULL) != def);
+    CHECK(open_name(&t, "c", NULL) != def);
+    CHECK(open_name(&t, "", &created) == def && !created);
+}
+
+static void test_one_worker_per_session(void)
+{
+    session_table_t t;
+    item_t item;
+    int session;
+
+    session_table_init(&t, 2, s_storage, DEPTH, sizeof(item_t));
+    int a = open_name(&t, "a", NULL);
+    int b = open_name(&t, "b", NULL);
+    for (int i = 1; i <= 3; i++) {
+        CHECK(session_table_post(&t, a, &(item_t){i}));
+    }
+    CHECK(!session_table_post(&t, a, &(item_t){4}));
+    CHECK(t.slots[a].rejected == 1);
+    CHECK(session_table_post(&t, b, &(item_t){10}));
+
+    // First worker takes a, the second one gets b rather than a's next turn
+    CHECK(session_table_take(&t, &session, &item) && session == a && item.turn == 1);
+    CHECK(session_table_take(&t, &session, &item) && session == b && item.turn == 10);
+    CHECK(!session_table_take(&t, &session, &item));
+
+    // a comes back with its remaining turns, in order
+    session_table_done(&t, a);
+    CHECK(session_table_take(&t, &session, &item) && session == a && item.turn == 2);
+    // Posting to a busy session does not make it ready twice
+    CHECK(session_table_post(&t, a, &(item_t){4}));
+    CHECK(!session_table_take(&t, &session, &item));
+    session_table_done(&t, a);
+    CHECK(session_table_take(&t, &session, &item) && session == a && item.turn == 3);
+    session_table_done(&t, a);
+    CHECK(session_table_take(&t, &session, &item) && session == a && item.turn == 4);
+    session_table_done(&t, a);
+    session_table_done(&t, b);
+    CHECK(!session_table_take(&t, &session, &item));
+}
+
+static void test_sessions_take_turns(void)
+{
+    session_table_t t;
+    item_t item;
+    int session;
+    int order[6];
+
+    session_table_init(&t, 2, s_storage, DEPTH, sizeof(item_t));
+    int a = open_name(&t, "a", NULL);
+    int b = open_name(&t, "b", NULL);
+    for (int i = 0; i < 3; i++) {
+        session_table_post(&t, a, &(item_t){i});
+    }
+    for (int i = 0; i < 3; i++) {
+        session_table_post(&t, b, &(item_t){i});
+    }
+    // A single worker alternates instead of draining a first
+    for (int i = 0; i < 6; i++) {
+        CHECK(session_table_take(&t, &session, &item));
+        order[i] = session;
+        session_table_done(&t, session);
+    }
+    CHECK(order[0] == a && order[1] == b && order[2] == a && order[3] == b && order[4] == a && order[5] == b);
+}
+
+static bool drop_odd(void *item, void *ctx)
+{
+    (*(int *)ctx)++;
+    return ((item_t *)item)->turn % 2 != 0;
+}
+
+static void test_purge(void)
+{
+    session_table_t t;
+    item_t item;
+    int session;
+    int calls = 0;
+
+    session_table_init(&t, 3, s_storage, DEPTH, sizeof(item_t));
+    int a = open_name(&t, "a", NULL);
+    int b = open_name(&t, "b", NULL);
+    int c = open_name(&t, "c", NULL);
+    // a wraps around its FIFO: turns 2, 3, 4 with the head in the middle
+    for (int i = 0; i < 3; i++) {
+        session_table_post(&t, a, &(item_t){i});
+    }
+    CHECK(session_table_take(&t, &session, &item) && session == a);
+    session_table_done(&t, a);
+    CHECK(session_table_take(&t, &session, &item) && session == a);
+    session_table_done(&t, a);
+    session_table_post(&t, a, &(item_t){3});
+    session_table_post(&t, a, &(item_t){4});
+    session_table_post(&t, b, &(item_t){1});
+    session_table_post(&t, c, &(item_t){6});
+    session_table_post(&t, c, &(item_t){7});
+
+    CHECK(session_table_purge(&t, drop_odd, &calls) == 3);
+    CHECK(calls == 6);
+    CHECK(t.slots[a].pending == 2 && t.slots[b].pending == 0 && t.slots[c].pending == 1);
+
+    // b left the ready list, the others kept their order and items
+    CHECK(session_table_take(&t, &session, &item) && session == a && item.turn == 2);
+    session_table_done(&t, a);
+    CHECK(session_table_take(&t, &session, &item) && session == c && item.turn == 6);
+    session_table_done(&t, c);
+    CHECK(session_table_take(&t, &session, &item) && session == a && item.turn == 4);
+    session_table_done(&t, a);
+    CHECK(!session_table_take(&t, &session, &item));
+    // Room again for posts
+    CHECK(session_table_post(&t, b, &(item_t){8}));
+}
+
+/*
+ * Cancelling a session, as conversation_cancel() does for the default one:
+ * its token moves to a new generation and its queued jobs of the old one
+ * go. Each session has its own generations, so another session's job is
+ * kept whatever its generation number.
+ */
+typedef struct {
+    uint32_t generation;
+} gen_job_t;
+
+static bool gen_stale(void *item, void *ctx)
+{
+    return ((gen_job_t *)item)->generation != *(uint32_t *)ctx;
+}
+
+static void test_purge_one_session(void)
+{
+    static gen_job_t storage[2 * DEPTH];
+    session_table_t t;
+    gen_job_t job;
+    int session;
+    uint32_t generation[2] = {0, 0};
+
+    session_table_init(&t, 2, storage, DEPTH, sizeof(gen_job_t));
+    int a = open_name(&t, "", NULL);
+    int b = open_name(&t, "b", NULL);
+    session_table_post(&t, a, &(gen_job_t){generation[a]});
+    session_table_post(&t, b, &(gen_job_t){generation[b]});
+    session_table_post(&t, a, &(gen_job_t){generation[a]});
+
+    // Cancel a: both its jobs go, b's job of the same generation number stays queued
+    generation[a]++;
+    CHECK(session_table_purge_session(&t, a, gen_stale, &generation[a]) == 2);
+    CHECK(t.slots[a].pending == 0 && t.slots[b].pending == 1);
+    CHECK(session_table_take(&t, &session, &job) && session == b && job.generation == generation[b]);
+    session_table_done(&t, b);
+    CHECK(!session_table_take(&t, &session, &job));
+
+    // A job of a's new generation is kept by the next cancel of b
+    session_table_post(&t, a, &(gen_job_t){generation[a]});
+    session_table_post(&t, b, &(gen_job_t){generation[b]});
+    generation[b]++;
+    CHECK(session_table_purge_session(&t, b, gen_stale, &generation[b]) == 1);
+    CHECK(session_table_take(&t, &session, &job) && session == a && job.generation == generation[a]);
+    session_table_done(&t, a);
+    CHECK(!session_table_take(&t, &session, &job));
+}
+
+/*
+ * The saturation scenario of the priority test (test_prio_sched.c), through
+ * the session queue of the default session as the firmware runs it, one
+ * step per millisecond:
+ *  - a /client_gpt reply arrives every 20 ms and is dispatched to the default
+ *    session, whose queue holds 2 jobs; each one costs an LLM call
+ *  - a button press every 4.3 s cancels: the call in flight ends within one
+ *    poll interval, then the press is dispatched to the same session
+ * Without the purge the queue is full of cancelled replies at every press
+ * and the press is refused.
+ */
+#define SAT_DEPTH 2
+#define SAT_DURATION_MS 120000
+#define SAT_LLM_CALL_MS 1500
+#define SAT_CANCEL_POLL_MS 100
+#define SAT_REPLY_PERIOD_MS 20
+
+enum { SAT_START = -1 };
+
+typedef struct {
+    int presses;
+    int presses_refused;
+    int presses_while_busy;
+    int64_t press_max_ms;
+    int replies_served;
+} sat_result_t;
+
+typedef struct {
+    int turn;                   // SAT_START or reply number
+    uint32_t generation;
+    int64_t posted_ms;
+} sat_job_t;
+
+static bool sat_stale(void *item, void *ctx)
+{
+    return ((sat_job_t *)item)->generation != *(uint32_t *)ctx;
+}
+
+static void simulate_saturation(bool purge, sat_result_t *r)
+{
+    static sat_job_t storage[SAT_DEPTH];
+    session_table_t t;
+    sat_job_t job;
+    uint32_t generation = 0;
+    int64_t busy_until = 0;
+    int worker_session = -1;
+
+    session_table_init(&t, 1, storage, SAT_DEPTH, sizeof(sat_job_t));
+    int def = open_name(&t, "", NULL);
+    memset(r, 0, sizeof(*r));
+
+    for (int64_t now = 0; now < SAT_DURATION_MS; now++) {
+        if (now % SAT_REPLY_PERIOD_MS == 0) {
+            session_table_post(&t, def, &(sat_job_t){(int)now, generation, now});
+        }
+        if (now % 4300 == 1000) {
+            // conversation_post(START): cancel, then dispatch the press
+            generation++;
+            if (purge) {
+                session_table_purge(&t, sat_stale, &generation);
+            }
+            if (worker_session >= 0 && now < busy_until) {
+                r->presses_while_busy++;
+                if (busy_until > now + SAT_CANCEL_POLL_MS) {
+                    busy_until = now + SAT_CANCEL_POLL_MS;
+                }
+            }
+            r->presses++;
+            if (!session_table_post(&t, def, &(sat_job_t){SAT_START, generation, now})) {
+                r->presses_refused++;
+            }
+        }
+
+        if (worker_session >= 0) {
+            if (now < busy_until) {
+                continue;
+            }
+            session_table_done(&t, worker_session);
+            worker_session = -1;
+        }
+        // Jobs of a cancelled generation are thrown away by the worker when taken
+        while (session_table_take(&t, &worker_session, &job)) {
+            if (job.generation == generation) {
+                break;
+            }
+            session_table_done(&t, worker_session);
+            worker_session = -1;
+        }
+        if (worker_session < 0) {
+            continue;
+        }
+        if (job.turn == SAT_START) {
+            if (now - job.posted_ms > r->press_max_ms) {
+                r->press_max_ms = now - job.posted_ms;
+            }
+        } else {
+            r->replies_served++;
+        }
+        busy_until = now + SAT_LLM_CALL_MS;
+    }
+}
+
+static void test_press_not_refused_under_saturation(void)
+{
+    sat_result_t with, without;
+    simulate_saturation(true, &with);
+    simulate_saturation(false, &without);
+
+    printf("  presses refused %d/%d, max wait %lld ms (without purge: %d/%d refused)\n",
+           with.presses_refused, with.presses, (long long)with.press_max_ms,
+           without.presses_refused, without.presses);
+
+    // The worker was answering a reply at most presses, and replies kept flowing
+    CHECK(with.presses_while_busy > 10);
+    CHECK(with.replies_served > 30);
+    // Every press got in and waited for the cancelled call only
+    CHECK(with.presses_refused == 0);
+    CHECK(with.press_max_ms <= SAT_CANCEL_POLL_MS);
+    CHECK(without.presses_refused > with.presses / 2);
+}
+
+/*
+ * Four sessions with three turns each, every turn taking 1 s of OpenAI time.
+ * With one worker the last answer comes after 12 s; with four workers the
+ * sessions run side by side and finish after 3 s, each still in order.
+ */
+static int simulate(int workers)
+{
+    session_table_t t;
+    int busy_until[4] = {0};
+    int worker_session[4];
+    int last_turn[4];
+    int now = 0;
+    int done = 0;
+
+    session_table_init(&t, 4, s_storage, DEPTH, sizeof(item_t));
+    for (int s = 0; s < 4; s++) {
+        char name[2] = {(char)('a' + s), '\0'};
+        int i = open_name(&t, name, NULL);
+        last_turn[i] = -1;
+        for (int turn = 0; turn < 3; turn++) {
+            CHECK(session_table_post(&t, i, &(item_t){turn}));
+        }
+    }
+    for (int w = 0; w < workers; w++) {
+        worker_session[w] = -1;
+    }
+
+    while (done < 12) {
+        for (int w = 0; w < workers; w++) {
+            if (worker_session[w] >= 0 && busy_until[w] <= now) {
+                session_table_done(&t, worker_session[w]);
+                worker_session[w] = -1;
+                done++;
+            }
+        }
+        for (int w = 0; w < workers; w++) {
+            item_t item;
+            if (worker_session[w] < 0 && session_table_take(&t, &worker_session[w], &item)) {
+                CHECK(item.turn == last_turn[worker_session[w]] + 1);
+                last_turn[worker_session[w]] = item.turn;
+                busy_until[w] = now + 1000;
+            }
+        }
+        now += 100;
+    }
+    return now - 100;
+}
+
+static void test_worker_pool_latency(void)
+{
+    int one = simulate(1);
+    int two = simulate(2);
+    int four = simulate(4);
+    printf("  last answer after %d ms with 1 worker, %d ms with 2, %d ms with 4\n", one, two, four);
+    CHECK(one == 12000);
+    CHECK(two == 6000);
+    CHECK(four == 3000);
+}
+
+int main(void)
+{
+    RUN_TEST(test_names);
+    RUN_TEST(test_open_finds_or_creates);
+    RUN_TEST(test_eviction_spares_active_sessions);
+    RUN_TEST(test_one_worker_per_session);
+    RUN_TEST(test_sessions_take_turns);
+    RUN_TEST(test_purge);
+    RUN_TEST(test_purge_one_session);
+    RUN_TEST(test_press_not_refused_under_saturation);
+    RUN_TEST(test_worker_pool_latency);
+    return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * Fixed-size buffer pool: alignment, exhaustion, reuse and statistics
+ */
+#include <stdint.h>
+
+#include "host_test.h"
+#include "slab_pool.h"
+
+#define BUF_SIZE 13
+#define COUNT 4
+
+static void *storage[SLAB_POOL_STORAGE_SIZE(COUNT, BUF_SIZE) / sizeof(void *)];
+
+static void test_alloc_until_exhausted(void)
+{
+    slab_pool_t p;
+    void *bufs[COUNT];
+
+    slab_pool_init(&p, storage, BUF_SIZE, COUNT);
+    CHECK(slab_pool_available(&p) == COUNT);
+
+    for (int i = 0; i < COUNT; i++) {
+        bufs[i] = slab_pool_alloc(&p);
+        CHECK(bufs[i] != NULL);
+        CHECK((uintptr_t)bufs[i] % sizeof(void *) == 0);
+        // Buffers stay inside the storage and never overlap
+        CHECK((uint8_t *)bufs[i] >= (uint8_t *)storage);
+        CHECK((uint8_t *)bufs[i] + BUF_SIZE <= (uint8_t *)storage + sizeof(storage));
+        for (int j = 0; j < i; j++) {
+            intptr_t d = (uint8_t *)bufs[i] - (uint8_t *)bufs[j];
+            CHECK(d >= BUF_SIZE || d <= -BUF_SIZE);
+        }
+        memset(bufs[i], 'a' + i, BUF_SIZE);
+    }
+    CHECK(slab_pool_available(&p) == 0);
+    CHECK(slab_pool_alloc(&p) == NULL);
+    CHECK(slab_pool_alloc(&p) == NULL);
+    CHECK(p.stats.exhausted == 2);
+    CHECK(p.stats.in_use == COUNT && p.stats.high_water == COUNT);
+
+    // Writing a whole buffer did not touch its neighbours
+    for (int i = 0; i < COUNT; i++) {
+        for (int k = 0; k < BUF_SIZE; k++) {
+            CHECK(((char *)bufs[i])[k] == 'a' + i);
+        }
+    }
+}
+
+static void test_free_and_reuse(void)
+{
+    slab_pool_t p;
+
+    slab_pool_init(&p, storage, BUF_SIZE, COUNT);
+    void *a = slab_pool_alloc(&p);
+    void *b = slab_pool_alloc(&p);
+    void *c = slab_pool_alloc(&p);
+
+    // Last freed, first reused
+    slab_pool_free(&p, b);
+    CHECK(p.stats.in_use == 2);
+    CHECK(slab_pool_alloc(&p) == b);
+
+    slab_pool_free(&p, a);
+    slab_pool_free(&p, c);
+    slab_pool_free(&p, NULL);
+    CHECK(p.stats.in_use == 1);
+    CHECK(p.stats.high_water == 3);
+    CHECK(slab_pool_available(&p) == COUNT - 1);
+
+    // Every buffer can be taken again, none twice
+    void *bufs[COUNT - 1];
+    for (int i = 0; i < COUNT - 1; i++) {
+        bufs[i] = slab_pool_alloc(&p);
+        CHECK(bufs[i] != NULL && bufs[i] != b);
+        for (int j = 0; j < i; j++) {
+            CHECK(bufs[i] != bufs[j]);
+        }
+    }
+    CHECK(slab_pool_alloc(&p) == NULL);
+    CHECK(p.stats.exhausted == 1);
+}
+
+int main(void)
+{
+    RUN_TEST(test_alloc_until_exhausted);
+    RUN_TEST(test_free_and_reuse);
+    return 0;
+}
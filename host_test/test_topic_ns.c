@@ -0,0 +1,80 @@
+/*
+ * Per-device topic namespace: identifiers, full topics and received topics
+ */
+#include "host_test.h"
+#include "topic_ns.h"
+
+static void test_mac_id(void)
+{
+    char id[TOPIC_NS_MAC_ID_LEN + 1];
+    const uint8_t mac[6] = {0xA1, 0xB2, 0xC3, 0x04, 0x0E, 0xF0};
+
+    topic_ns_mac_id(id, mac);
+    CHECK_STR_EQ(id, "a1b2c3040ef0");
+}
+
+static void test_build(void)
+{
+    topic_ns_t ns;
+    char topic[64];
+
+    CHECK(topic_ns_init(&ns, "esp32", "a1b2c3040ef0"));
+    CHECK(topic_ns_build(&ns, "/esp_gpt_out", topic, sizeof(topic)));
+    CHECK_STR_EQ(topic, "esp32/a1b2c3040ef0/esp_gpt_out");
+
+    // Multi-level prefix
+    CHECK(topic_ns_init(&ns, "plant1/line2", "kitchen"));
+    CHECK(topic_ns_build(&ns, "/client_gpt/s1", topic, sizeof(topic)));
+    CHECK_STR_EQ(topic, "plant1/line2/kitchen/client_gpt/s1");
+    CHECK(!topic_ns_build(&ns, "/client_gpt/s1", topic, 20));
+
+    // Empty prefix: flat topics, whatever the identifier
+    CHECK(topic_ns_init(&ns, "", "a1b2c3040ef0"));
+    CHECK(topic_ns_build(&ns, "/esp32_gpio", topic, sizeof(topic)));
+    CHECK_STR_EQ(topic, "/esp32_gpio");
+}
+
+static void test_rejects_bad_names(void)
+{
+    topic_ns_t ns;
+
+    CHECK(!topic_ns_init(&ns, "esp32/+", "a1"));
+    CHECK(!topic_ns_init(&ns, "esp32", "#"));
+    CHECK(!topic_ns_init(&ns, "esp32", "a/b"));
+    CHECK(!topic_ns_init(&ns, "esp32", ""));
+    CHECK(!topic_ns_init(&ns, "a-prefix-long-enough-to-overflow", "a1b2c3040ef0"));
+    CHECK(ns.base_len == 0);
+}
+
+static void test_strip(void)
+{
+    topic_ns_t ns;
+    size_t rest_len;
+    const char *rest;
+
+    CHECK(topic_ns_init(&ns, "esp32", "dev1"));
+    const char *t = "esp32/dev1/client_gpt/s1";
+    rest = topic_ns_strip(&ns, t, strlen(t), &rest_len);
+    CHECK(rest != NULL && rest_len == 14 && strncmp(rest, "/client_gpt/s1", rest_len) == 0);
+
+    // Another device, a longer identifier, nothing after the namespace
+    t = "esp32/dev2/client_gpt";
+    CHECK(topic_ns_strip(&ns, t, strlen(t), &rest_len) == NULL);
+    t = "esp32/dev10/client_gpt";
+    CHECK(topic_ns_strip(&ns, t, strlen(t), &rest_len) == NULL);
+    CHECK(topic_ns_strip(&ns, "esp32/dev1", 10, &rest_len) == NULL);
+
+    // Flat topics pass through
+    CHECK(topic_ns_init(&ns, "", ""));
+    rest = topic_ns_strip(&ns, "/esp32_commands", 15, &rest_len);
+    CHECK(rest != NULL && rest_len == 15);
+}
+
+int main(void)
+{
+    RUN_TEST(test_mac_id);
+    RUN_TEST(test_build);
+    RUN_TEST(test_rejects_bad_names);
+    RUN_TEST(test_strip);
+    return 0;
+}
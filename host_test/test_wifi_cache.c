@@ -0,0 +1,97 @@
+/*
+ * Cached Wi-Fi connection: record and lease checks
+ */
+#include "host_test.h"
+#include "wifi_cache.h"
+
+static wifi_cache_t cached(void)
+{
+    wifi_cache_t c = {
+        .version = WIFI_CACHE_VERSION,
+        .channel = 6,
+        .bssid = {0x24, 0x0a, 0xc4, 0x11, 0x22, 0x33},
+        .ssid = "home",
+        .password = "secret123",
+        .ip = {192, 168, 1, 42},
+        .netmask = {255, 255, 255, 0},
+        .gateway = {192, 168, 1, 1},
+        .dns = {192, 168, 1, 1},
+    };
+    return c;
+}
+
+static void test_valid(void)
+{
+    wifi_cache_t c = cached();
+
+    CHECK(wifi_cache_valid(&c, sizeof(c)));
+    // Record of an older layout
+    CHECK(!wifi_cache_valid(&c, sizeof(c) - 4));
+    c.version = WIFI_CACHE_VERSION + 1;
+    CHECK(!wifi_cache_valid(&c, sizeof(c)));
+
+    c = cached();
+    c.channel = 0;
+    CHECK(!wifi_cache_valid(&c, sizeof(c)));
+    c.channel = 149;
+    CHECK(wifi_cache_valid(&c, sizeof(c)));
+
+    c = cached();
+    memset(c.bssid, 0, sizeof(c.bssid));
+    CHECK(!wifi_cache_valid(&c, sizeof(c)));
+    c.bssid[0] = 0x01;
+    CHECK(!wifi_cache_valid(&c, sizeof(c)));
+
+    c = cached();
+    c.ssid[0] = '\0';
+    CHECK(!wifi_cache_valid(&c, sizeof(c)));
+    // Not terminated: corrupt record
+    c = cached();
+    memset(c.ssid, 'a', sizeof(c.ssid));
+    CHECK(!wifi_cache_valid(&c, sizeof(c)));
+
+    // Open networks have no password
+    c = cached();
+    c.password[0] = '\0';
+    CHECK(wifi_cache_valid(&c, sizeof(c)));
+}
+
+static void test_lease(void)
+{
+    wifi_cache_t c = cached();
+
+    CHECK(wifi_cache_lease_valid(&c));
+    // Cached before any lease
+    memset(c.ip, 0, sizeof(c.ip));
+    CHECK(!wifi_cache_lease_valid(&c));
+
+    c = cached();
+    memcpy(c.netmask, (uint8_t[]){255, 0, 255, 0}, 4);
+    CHECK(!wifi_cache_lease_valid(&c));
+
+    c = cached();
+    memcpy(c.gateway, (uint8_t[]){10, 0, 0, 1}, 4);
+    CHECK(!wifi_cache_lease_valid(&c));
+
+    c = cached();
+    memcpy(c.ip, (uint8_t[]){192, 168, 1, 255}, 4);
+    CHECK(!wifi_cache_lease_valid(&c));
+    memcpy(c.ip, (uint8_t[]){192, 168, 1, 0}, 4);
+    CHECK(!wifi_cache_lease_valid(&c));
+    memcpy(c.ip, (uint8_t[]){192, 168, 1, 1}, 4);
+    CHECK(!wifi_cache_lease_valid(&c));
+
+    // Wider subnet
+    c = cached();
+    memcpy(c.netmask, (uint8_t[]){255, 255, 252, 0}, 4);
+    memcpy(c.ip, (uint8_t[]){192, 168, 2, 255}, 4);
+    memcpy(c.gateway, (uint8_t[]){192, 168, 0, 1}, 4);
+    CHECK(wifi_cache_lease_valid(&c));
+}
+
+int main(void)
+{
+    RUN_TEST(test_valid);
+    RUN_TEST(test_lease);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+
+#include "app_boot.h"
+#include "boot_timeline.h"
+
+static const char *TAG = "app_boot";
+
+static EventGroupHandle_t s_events = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+static boot_timeline_t s_timeline;
+
+esp_err_t app_boot_init(void)
+{
+    boot_timeline_init(&s_timeline);
+    s_events = xEventGroupCreate();
+    s_lock = xSemaphoreCreateMutex();
+    return (s_events != NULL && s_lock != NULL) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+int app_boot_step_begin(const char *name)
+{
+    // Steps begin and end in several tasks
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int step = boot_timeline_begin(&s_timeline, name, esp_timer_get_time());
+    xSemaphoreGive(s_lock);
+    return step;
+}
+
+void app_boot_step_end(int step)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    boot_timeline_end(&s_timeline, step, esp_timer_get_time());
+    xSemaphoreGive(s_lock);
+}
+
+void app_boot_signal(app_boot_event_t event)
+{
+    xEventGroupSetBits(s_events, event);
+}
+
+void app_boot_wait(app_boot_event_t event)
+{
+    xEventGroupWaitBits(s_events, event, pdFALSE, pdTRUE, portMAX_DELAY);
+}
+
+void app_boot_log_timeline(void)
+{
+    char line[96];
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t span = boot_timeline_span_us(&s_timeline);
+    int64_t busy = boot_timeline_busy_us(&s_timeline);
+    ESP_LOGI(TAG, "Boot timeline, times since reset:");
+    for (size_t i = 0; i < s_timeline.count; i++) {
+        if (boot_timeline_format_step(&s_timeline, i, line, sizeof(line)) > 0) {
+            ESP_LOGI(TAG, "  %s", line);
+        }
+    }
+    // Step durations add up to more than the elapsed time when steps overlapped
+    ESP_LOGI(TAG, "Ready %.1f ms after reset, %.1f ms of steps", span / 1000.0, busy / 1000.0);
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,60 @@
+/*
+ * Startup orchestration
+ *
+ * Startup steps run in parallel where they do not depend on each other:
+ * the network connects in its own task while GPIO, the publish queue and
+ * the conversation tasks are set up, and the MQTT client starts as soon as
+ * an IP address is assigned. Modules wait for what they need with
+ * app_boot_wait(). Every step is recorded in a timeline (boot_timeline.h)
+ * logged once the device is connected to the broker.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    APP_BOOT_NETWORK_UP = 1 << 0,   // IP address assigned
+    APP_BOOT_MQTT_CONNECTED = 1 << 1,
+} app_boot_event_t;
+
+/*
+ * @brief Create the startup state, first thing in app_main()
+ */
+esp_err_t app_boot_init(void);
+
+/*
+ * @brief Record the start of a step
+ *
+ * @param name Step name, must stay valid forever
+ * @return Step handle for app_boot_step_end()
+ */
+int app_boot_step_begin(const char *name);
+
+/*
+ * @brief Record the end of a step
+ */
+void app_boot_step_end(int step);
+
+/*
+ * @brief Signal a startup event, waking the tasks waiting for it
+ */
+void app_boot_signal(app_boot_event_t event);
+
+/*
+ * @brief Block until a startup event happened, returns at once afterwards
+ */
+void app_boot_wait(app_boot_event_t event);
+
+/*
+ * @brief Log the timeline of the steps so far with their durations
+ */
+void app_boot_log_timeline(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -14,27 +14,210 @@
 
 // GPIO includes for button reading
 #include "driver/gpio.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-
-// OpenAI includes
-#include "OpenAI.h"
+#include "freertos/timers.h"
+#include "gpio_scanner.h"
+#include "gpio_pins.h"
+#include "gpio_event_codec.h"
+#include "gpio_coalescer.h"
+#include "app_metrics.h"
+#include "button_gesture.h"
+#include "conversation.h"
+#include "mqtt_publisher.h"
+#include "app_topics.h"
+#include "broker_store.h"
+#include "broker_failover.h"
+#include "mqtt_reconnect.h"
+#include "mqtt_session.h"
+#if CONFIG_BROKER_MDNS_DISCOVERY
+#include "broker_mdns.h"
+#endif
+#if CONFIG_DNS_CACHE
+#include "dns_resolver.h"
+#endif
+#include "app_boot.h"
+#include "wifi_fast.h"
+#if CONFIG_SOC_PCNT_SUPPORTED
+#include "pulse_counter.h"
+#endif
 
 static const char *TAG = "mqtt_example";
 
 // GPIO pin number from menuconfig
 #define GPIO_BUTTON_PIN CONFIG_GPIO_BUTTON_PIN
 
-// Global MQTT client handle - needed so GPIO task can publish messages
-static esp_mqtt_client_handle_t mqtt_client_handle = NULL;
+#if CONFIG_GPIO_EVENT_FORMAT_BINARY
+#define GPIO_CHANGES_TOPIC app_topic(APP_TOPIC_GPIO_EVENTS)
+#define GPIO_CHANGES_QOS app_topic_qos(APP_TOPIC_GPIO_EVENTS)
+#else
+#define GPIO_CHANGES_TOPIC app_topic(APP_TOPIC_GPIO_INPUTS)
+#define GPIO_CHANGES_QOS app_topic_qos(APP_TOPIC_GPIO_INPUTS)
+// Worst case for one scan: every scanned pin changed at once
+#define GPIO_CHANGES_PAYLOAD_LEN 1024
+#endif
+
+// "broker" on /esp32_commands, off unless enabled in menuconfig
+#if CONFIG_BROKER_REMOTE_COMMAND
+#define BROKER_REMOTE_COMMAND 1
+#else
+#define BROKER_REMOTE_COMMAND 0
+#endif
+
+// Configured broker and where its settings came from at boot
+static broker_config_t s_primary;
+static broker_source_t s_broker_source;
+// Broker the client connects to: the configured one or a fallback (broker_failover.h)
+static broker_config_t s_broker;
+static bool s_mqtt_started = false;
+// Time from boot to the first connection, -1 until connected
+static int64_t s_boot_connected_us = -1;
+static uint32_t s_broker_changes;
+static esp_mqtt_client_handle_t s_client;
+// Boot step from client start to the first connection
+static int s_mqtt_step = -1;
+
+
+/*
+ * @brief Client configuration connecting to the given broker
+ */
+static void broker_client_config(esp_mqtt_client_config_t *mqtt_cfg, const broker_config_t *broker)
+{
+    *mqtt_cfg = (esp_mqtt_client_config_t) {
+        .broker.address.uri = broker->uri,
+        // The client keeps the previous credentials when these are NULL
+        .credentials.username = broker->username[0] != '\0' ? broker->username : NULL,
+        .credentials.authentication.password = broker->password[0] != '\0' ? broker->password : NULL,
+        // Reconnections are timed by mqtt_reconnect.c, this only applies if its timer failed
+        .network.reconnect_timeout_ms = mqtt_reconnect_backstop_ms(),
+#if CONFIG_MQTT_PROTOCOL_5
+        .session.protocol_ver = MQTT_PROTOCOL_V_5,
+#endif
+    };
+    mqtt_session_client_config(mqtt_cfg);
+#if CONFIG_HAPPY_EYEBALLS
+    // The transport's lookup of this host then returns the address family that connects first
+    dns_resolver_race(broker->uri);
+#endif
+}
+
+/*
+ * @brief Switch the client to new broker settings, in the timer service task
+ *
+ * Closing the connection from the MQTT event handler would pull the
+ * transport from under the MQTT task, hence the deferred call.
+ *
+ * @param arg broker_config_t allocated by request_broker_switch(), freed here
+ */
+static void apply_broker_config(void *arg, uint32_t client_arg)
+{
+    broker_config_t *broker = arg;
+    esp_mqtt_client_handle_t client = (esp_mqtt_client_handle_t)(uintptr_t)client_arg;
+    esp_mqtt_client_config_t mqtt_cfg;
+
+    s_broker = *broker;
+    free(broker);
+    mqtt_session_forget();
+    broker_client_config(&mqtt_cfg, &s_broker);
+    if (esp_mqtt_set_config(client, &mqtt_cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "Broker settings rejected by the client");
+        return;
+    }
+    ESP_LOGI(TAG, "Reconnecting to %s", s_broker.uri);
+    esp_mqtt_client_disconnect(client);
+    esp_mqtt_client_reconnect(client);
+    s_broker_changes++;
+}
+
+/*
+ * @brief Connect to another broker
+ *
+ * Applied at once before the client starts, else by apply_broker_config().
+ */
+static void request_broker_switch(const broker_config_t *next)
+{
+    if (!s_mqtt_started) {
+        esp_mqtt_client_config_t mqtt_cfg;
+        s_broker = *next;
+        broker_client_config(&mqtt_cfg, &s_broker);
+        esp_mqtt_set_config(s_client, &mqtt_cfg);
+        return;
+    }
+
+    broker_config_t *broker = malloc(sizeof(*broker));
+    if (broker == NULL) {
+        ESP_LOGE(TAG, "No memory for the broker settings");
+        return;
+    }
+    *broker = *next;
+    // Pointers fit in the 32-bit argument on the ESP32 targets
+    if (xTimerPendFunctionCall(apply_broker_config, broker, (uint32_t)(uintptr_t)s_client, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Cannot switch broker now");
+        free(broker);
+    }
+}
+
+/*
+ * @brief Run a "broker" command received on /esp32_commands
+ *
+ * The new settings are stored first, so they survive a reboot even when
+ * the broker cannot be reached right away.
+ */
+static void handle_broker_command(broker_command_t command, const broker_config_t *next)
+{
+    broker_config_t primary;
+    esp_err_t err;
+
+    if (command == BROKER_COMMAND_SET) {
+        primary = *next;
+        err = broker_store_save(&primary);
+    } else {
+        err = broker_store_erase(&primary);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Broker settings not stored: %s", esp_err_to_name(err));
+    }
 
-// Global OpenAI handle
-static OpenAI_t *openai_handle = NULL;
+    // Without stored settings a FROM_STDIN build only asks for a URL at the next boot
+    if (!broker_uri_valid(primary.uri, strlen(primary.uri))) {
+        ESP_LOGI(TAG, "Broker settings used from the next boot");
+        return;
+    }
+    s_primary = primary;
+    broker_failover_set_primary(s_primary.uri);
+    if (strcmp(s_primary.uri, s_broker.uri) == 0) {
+        ESP_LOGI(TAG, "Broker settings used from the next connection");
+        return;
+    }
+    request_broker_switch(&s_primary);
+}
 
-// Buffer for storing ChatGPT responses (limited to prevent RAM overflow)
-#define MAX_RESPONSE_LEN 500
-static char chatgpt_response_buffer[MAX_RESPONSE_LEN + 1];
+/*
+ * @brief Failover decision: connect to candidate index, 0 being the configured broker
+ */
+static void failover_switch(int index, const char *uri)
+{
+    broker_config_t broker = {0};
 
+    if (index == 0) {
+        broker = s_primary;
+    } else {
+        // Fallback brokers carry their credentials in the URI, if any
+        snprintf(broker.uri, sizeof(broker.uri), "%s", uri);
+    }
+    request_broker_switch(&broker);
+}
+
+/*
+ * @brief Report where the broker settings came from and how long the first connection took
+ */
+static int broker_metrics_writer(char *buf, size_t len, int64_t interval_us)
+{
+    return snprintf(buf, len, "{\"source\":\"%s\",\"boot_connected_ms\":%lld,\"changes\":%" PRIu32 "}",
+                    broker_source_name(s_broker_source),
+                    s_boot_connected_us < 0 ? -1LL : (long long)(s_boot_connected_us / 1000), s_broker_changes);
+}
 
 static void log_error_if_nonzero(const char *message, int error_code)
 {
@@ -63,16 +246,33 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     switch ((esp_mqtt_event_id_t)event_id) {
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
-        ESP_LOGI(TAG, "Ready to publish button presses to /esp32_gpio");
-        // Subscribe to command topic for bidirectional communication
-        int msg_id_sub = esp_mqtt_client_subscribe(event->client, "/esp32_commands", 0);
-        ESP_LOGI(TAG, "Subscribed to /esp32_commands topic, msg_id=%d", msg_id_sub);
-        // Subscribe to /client_gpt topic to receive ChatGPT responses from Rust client
-        int msg_id_gpt = esp_mqtt_client_subscribe(event->client, "/client_gpt", 0);
-        ESP_LOGI(TAG, "Subscribed to /client_gpt topic, msg_id=%d", msg_id_gpt);
+        mqtt_reconnect_connected();
+        broker_failover_connected();
+        if (s_boot_connected_us < 0) {
+            s_boot_connected_us = esp_timer_get_time();
+            ESP_LOGI(TAG, "Connected %lld ms after boot, broker settings from %s",
+                     (long long)(s_boot_connected_us / 1000), broker_source_name(s_broker_source));
+            app_boot_step_end(s_mqtt_step);
+            app_boot_signal(APP_BOOT_MQTT_CONNECTED);
+            app_boot_log_timeline();
+        }
+        mqtt_publisher_reset_aliases();
+        ESP_LOGI(TAG, "Ready to publish button presses to %s", app_topic(APP_TOPIC_GPIO));
+        // Commands and ChatGPT responses from the Rust client, unless the broker kept the subscriptions
+        mqtt_session_connected(event->client, event->session_present);
+        break;
+    case MQTT_EVENT_BEFORE_CONNECT:
+        mqtt_session_before_connect();
+        break;
+    case MQTT_EVENT_SUBSCRIBED:
+        ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
+        mqtt_session_subscribed(event->msg_id);
         break;
     case MQTT_EVENT_DISCONNECTED:
         ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+        mqtt_reconnect_disconnected();
+        broker_failover_connection_lost();
+        mqtt_publisher_reset_aliases();
         break;
     case MQTT_EVENT_PUBLISHED:
         ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
@@ -80,75 +280,60 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     case MQTT_EVENT_DATA:
         ESP_LOGI(TAG, "MQTT_EVENT_DATA");
         ESP_LOGI(TAG, "Topic: %.*s", event->topic_len, event->topic);
-        ESP_LOGI(TAG, "Data: %.*s", event->data_len, event->data);
-        
-        // Check if this is a message from /client_gpt topic (ChatGPT response from Rust client)
-        if (event->topic_len == 11 && strncmp(event->topic, "/client_gpt", 11) == 0) {
-            // Extract the message (truncate if too long to prevent RAM overflow)
-            int data_len = event->data_len;
-            if (data_len > MAX_RESPONSE_LEN) {
-                data_len = MAX_RESPONSE_LEN;
-                ESP_LOGW(TAG, "Message truncated from %d to %d bytes", event->data_len, MAX_RESPONSE_LEN);
+
+        // Topic within this device's namespace, e.g. "/client_gpt"
+        size_t topic_len = 0;
+        const char *topic = event->topic_len > 0 ? app_topic_strip(event->topic, event->topic_len, &topic_len) : NULL;
+        bool command = topic_len == 15 && strncmp(topic, "/esp32_commands", 15) == 0;
+        // A broker command carries credentials: only the length of a command is logged
+        if (command) {
+            ESP_LOGI(TAG, "Data: %d bytes", event->data_len);
+        } else {
+            ESP_LOGI(TAG, "Data: %.*s", event->data_len, event->data);
+        }
+        // A redelivered reply must not start a second OpenAI request
+        if (mqtt_session_duplicate(event)) {
+            break;
+        }
+
+        // Check if this is a message from /client_gpt[/<session>] (ChatGPT response from Rust client).
+        // Long messages arrive in several events, only the first one carries the topic.
+        if ((topic_len >= 11 && strncmp(topic, "/client_gpt", 11) == 0 &&
+             (topic_len == 11 || topic[11] == '/')) ||
+            (event->topic_len == 0 && event->current_data_offset > 0)) {
+            const char *session = topic_len > 12 ? topic + 12 : "";
+            int session_len = topic_len > 12 ? topic_len - 12 : 0;
+            // MQTT 5: the reply names the answer it responds to
+            uint32_t correlation = 0;
+#if CONFIG_MQTT_PROTOCOL_5
+            if (event->property != NULL && event->property->correlation_data_len == 4) {
+                const uint8_t *c = (const uint8_t *)event->property->correlation_data;
+                correlation = c[0] | c[1] << 8 | c[2] << 16 | (uint32_t)c[3] << 24;
             }
-            
-            // Copy message to buffer (null-terminated)
-            memcpy(chatgpt_response_buffer, event->data, data_len);
-            chatgpt_response_buffer[data_len] = '\0';
-            
-            ESP_LOGI(TAG, "Received ChatGPT response from Rust client: %.*s", data_len, chatgpt_response_buffer);
-            
-            // Call OpenAI API with the received message to continue the conversation
-            if (openai_handle != NULL) {
-                // Create a chat completion object
-                OpenAI_ChatCompletion_t *chat = openai_handle->chatCreate(openai_handle);
-                if (chat != NULL) {
-                    // Use model from menuconfig (defaults to free OpenRouter model)
-                    chat->setModel(chat, CONFIG_OPENAI_MODEL);
-                    chat->setTemperature(chat, 0.7);
-                    
-                    // Send the received message to OpenAI API (save=true to maintain conversation)
-                    OpenAI_StringResponse_t *response = chat->message(chat, chatgpt_response_buffer, true);
-                    if (response != NULL && response->getError(response) == NULL) {
-                        // Get the response text
-                        uint32_t len = response->getLen(response);
-                        if (len > 0) {
-                            char *response_text = response->getData(response, 0);
-                            if (response_text != NULL) {
-                                // Truncate if too long
-                                int pub_len = strlen(response_text);
-                                if (pub_len > MAX_RESPONSE_LEN) {
-                                    pub_len = MAX_RESPONSE_LEN;
-                                    ESP_LOGW(TAG, "Response truncated before publishing");
-                                }
-                                
-                                // Publish ChatGPT response to /esp_gpt_out topic
-                                int msg_id = esp_mqtt_client_publish(
-                                    mqtt_client_handle,
-                                    "/esp_gpt_out",
-                                    response_text,
-                                    pub_len,
-                                    0,  // QoS 0
-                                    0   // Don't retain
-                                );
-                                ESP_LOGI(TAG, "Published ChatGPT response to /esp_gpt_out, msg_id=%d", msg_id);
-                                ESP_LOGI(TAG, "Response: %.*s", pub_len, response_text);
-                            }
-                        }
-                        response->deleteResponse(response);
-                    } else {
-                        const char *error = response ? response->getError(response) : "Unknown error";
-                        ESP_LOGE(TAG, "OpenAI API error: %s", error ? error : "Failed to get response");
-                        if (response) {
-                            response->deleteResponse(response);
-                        }
-                    }
-                    // Clean up chat completion object
-                    openai_handle->chatDelete(chat);
-                } else {
-                    ESP_LOGE(TAG, "Failed to create ChatCompletion object");
-                }
-            } else {
-                ESP_LOGE(TAG, "OpenAI handle not initialized");
+#endif
+            // Written straight into the conversation worker's ring to continue the discussion;
+            // the OpenAI call must not block the MQTT task
+            conversation_reply_fragment(session, session_len, event->data, event->data_len,
+                                        event->current_data_offset, event->total_data_len, correlation);
+        } else if (command) {
+            broker_config_t next;
+            broker_command_t broker_command = broker_config_parse_command(event->data, event->data_len, &next);
+            if (broker_command != BROKER_COMMAND_NONE && !BROKER_REMOTE_COMMAND) {
+                // Anyone able to publish here could move the device to their own broker
+                ESP_LOGW(TAG, "broker command ignored, CONFIG_BROKER_REMOTE_COMMAND is off");
+            } else if (broker_command == BROKER_COMMAND_INVALID) {
+                ESP_LOGW(TAG, "Usage: broker <uri> [<username> [<password>]] | broker reset");
+            } else if (broker_command != BROKER_COMMAND_NONE) {
+                handle_broker_command(broker_command, &next);
+            } else if (mqtt_session_command(event->client, event->data, event->data_len)) {
+                // "reconnect" or "seq <n>", see mqtt_session.h
+            } else if (event->data_len == 6 && strncmp(event->data, "cancel", 6) == 0) {
+                // Conversation commands, handled after button input but before /client_gpt replies
+                conversation_cancel();
+            } else if (event->data_len == 5 && strncmp(event->data, "start", 5) == 0) {
+                conversation_post(PRIO_CLASS_COMMAND, CONVERSATION_START);
+            } else if (event->data_len == 5 && strncmp(event->data, "reset", 5) == 0) {
+                conversation_post(PRIO_CLASS_COMMAND, CONVERSATION_RESET);
             }
         }
         break;
@@ -159,7 +344,11 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             log_error_if_nonzero("reported from tls stack", event->error_handle->esp_tls_stack_err);
             log_error_if_nonzero("captured as transport's socket errno",  event->error_handle->esp_transport_sock_errno);
             ESP_LOGI(TAG, "Last errno string (%s)", strerror(event->error_handle->esp_transport_sock_errno));
+        } else if (event->error_handle->error_type == MQTT_ERROR_TYPE_CONNECTION_REFUSED) {
+            ESP_LOGI(TAG, "Connection refused, return code 0x%x", event->error_handle->connect_return_code);
         }
+        // Picks the delay before the next attempt
+        mqtt_reconnect_error(event->error_handle);
         break;
     default:
         break;
@@ -167,173 +356,366 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 
 }
 
+/*
+ * @brief Run the action mapped to each recognized button gesture
+ *
+ * - short press: start a new discussion with the initial prompt, cancelling the current one
+ * - long press: cancel the conversation request in flight and the pending ones
+ * - double press: reset the conversation history
+ */
+static void handle_button_gestures(uint32_t gestures)
+{
+    if (gestures & BUTTON_GESTURE_SHORT_PRESS) {
+        ESP_LOGI(TAG, "Button pressed! Calling OpenAI API with initial prompt...");
+        // Also publish to /esp32_gpio for backward compatibility/logging
+        mqtt_publisher_publish(app_topic(APP_TOPIC_GPIO), "pressed", 0, app_topic_qos(APP_TOPIC_GPIO), 0);
+        // Aborts the request in flight, if any, then starts over
+        if (!conversation_post(PRIO_CLASS_USER_INPUT, CONVERSATION_START)) {
+            ESP_LOGW(TAG, "Conversation not available, button press ignored");
+        }
+    }
+    if (gestures & BUTTON_GESTURE_LONG_PRESS) {
+        ESP_LOGI(TAG, "Long press: cancelling conversation request");
+        conversation_cancel();
+    }
+    if (gestures & BUTTON_GESTURE_DOUBLE_PRESS) {
+        ESP_LOGI(TAG, "Double press: resetting conversation history");
+        conversation_post(PRIO_CLASS_USER_INPUT, CONVERSATION_RESET);
+    }
+    if (gestures & BUTTON_GESTURE_RELEASE) {
+        ESP_LOGD(TAG, "Button released");
+    }
+}
+
+#if CONFIG_GPIO_EVENT_FORMAT_BINARY
+// Events waiting for the coalescing window to close
+static gpio_event_t gpio_batch_events[CONFIG_GPIO_COALESCE_MAX_EVENTS];
+static gpio_coalescer_t gpio_batch;
+
+/*
+ * @brief Publish all pending GPIO events as one frame on /esp32_gpio/events
+ */
+static void flush_gpio_events(void)
+{
+    // Frame buffer (static to keep the task stack small)
+    static uint8_t frame[GPIO_EVENT_FRAME_LEN(CONFIG_GPIO_COALESCE_MAX_EVENTS)];
+
+    int len = gpio_coalescer_flush(&gpio_batch, frame, sizeof(frame));
+    if (len > 0) {
+        mqtt_publisher_publish(GPIO_CHANGES_TOPIC, (const char *)frame, len, GPIO_CHANGES_QOS, 0);
+    }
+}
+
+/*
+ * @brief Report GPIO publish rates and what coalescing saved since the last report
+ */
+static int gpio_metrics_writer(char *buf, size_t len, int64_t interval_us)
+{
+    static gpio_coalescer_stats_t last;
+    gpio_coalescer_stats_t now = gpio_batch.stats;
+    float secs = interval_us / 1000000.0f;
+
+    uint32_t events = now.events - last.events;
+    uint32_t publishes = now.publishes - last.publishes;
+    int64_t bytes = (int64_t)(now.bytes - last.bytes);
+    int64_t bytes_saved = (int64_t)(now.bytes_unbatched - last.bytes_unbatched) - bytes;
+    last = now;
+
+    return snprintf(buf, len,
+                    "{\"events_per_s\":%.2f,\"publishes_per_s\":%.2f,\"bytes_per_s\":%.1f,"
+                    "\"packets_saved_per_s\":%.2f,\"bytes_saved_per_s\":%.1f}",
+                    events / secs, publishes / secs, bytes / secs,
+                    (events - publishes) / secs, bytes_saved / secs);
+}
+#endif /* CONFIG_GPIO_EVENT_FORMAT_BINARY */
+
+/*
+ * @brief Report the pins changed during one scan
+ *
+ * Binary format: each changed pin becomes an event of the coalescing batch,
+ * published later as one gpio_event_codec frame on /esp32_gpio/events.
+ * JSON format: {"ts":...,"changes":[...]} published now on /esp32_gpio/inputs.
+ */
+static void report_pin_changes(uint64_t changed, uint64_t levels, int64_t timestamp_us)
+{
+#if CONFIG_GPIO_EVENT_FORMAT_BINARY
+    while (changed != 0) {
+        int pin = __builtin_ctzll(changed);
+        changed &= changed - 1;
+
+        gpio_event_t event = {
+            .pin = pin,
+            .edge = ((levels >> pin) & 1) ? GPIO_EVENT_EDGE_RISING : GPIO_EVENT_EDGE_FALLING,
+            .timestamp_us = timestamp_us,
+        };
+        // Batch size reached: the current batch goes out before this event is added
+        if (gpio_coalescer_is_full(&gpio_batch)) {
+            flush_gpio_events();
+        }
+        gpio_coalescer_add(&gpio_batch, &event);
+    }
+#else
+    // Buffer for one batch of pin changes (static to keep the task stack small)
+    static char changes_payload[GPIO_CHANGES_PAYLOAD_LEN];
+
+    int len = gpio_pins_format_changes(changed, levels, timestamp_us,
+                                       changes_payload, sizeof(changes_payload));
+    if (len > 0) {
+        // All changes of this scan go out in a single publish
+        mqtt_publisher_publish(GPIO_CHANGES_TOPIC, changes_payload, len, GPIO_CHANGES_QOS, 0);
+    } else {
+        ESP_LOGW(TAG, "Pin changes do not fit in %d bytes, dropped", GPIO_CHANGES_PAYLOAD_LEN);
+    }
+#endif
+}
+
+/*
+ * @brief Ticks to wait until a deadline in microseconds, portMAX_DELAY if there is none
+ */
+static TickType_t ticks_until(int64_t deadline_us)
+{
+    if (deadline_us == INT64_MAX) {
+        return portMAX_DELAY;
+    }
+    int64_t remaining_us = deadline_us - esp_timer_get_time();
+    if (remaining_us <= 0) {
+        return 0;
+    }
+    // Round up so the task never wakes before the deadline
+    return (TickType_t)((remaining_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000));
+}
+
 /*
 * @brief GPIO monitoring task
 * 
-* This task runs in the background and continuously checks the GPIO pin.
-* When the button is pressed (pin goes HIGH), it calls OpenAI API with initial prompt
-* and publishes the response to /esp_gpt_out topic to start the endless discussion.
+* This task runs in the background and sleeps until an edge interrupt fires
+* on one of the scanned pins, or until a pending deadline (coalescing window,
+* gesture timeout) expires. After an edge it waits for the contacts to settle
+* and reads the whole GPIO input register at once; changed pins are reported
+* as events and button edges feed the gesture state machine.
 */
 static void gpio_task(void* arg)
 {
-    bool last_state = false;  // Track previous button state to detect edges
-    
-    ESP_LOGI(TAG, "GPIO monitoring task started on pin %d", GPIO_BUTTON_PIN);
-    
+    button_gesture_t gesture;
+    uint64_t last_levels = gpio_scanner_read();  // Baseline, only changes are published
+
+    button_gesture_init(&gesture, CONFIG_BUTTON_LONG_PRESS_MS * 1000LL, CONFIG_BUTTON_DOUBLE_PRESS_MS * 1000LL);
+    ESP_LOGI(TAG, "GPIO monitoring task started, button on pin %d", GPIO_BUTTON_PIN);
+
     while (1) {
-        // Read the current GPIO pin level
-        int level = gpio_get_level(GPIO_BUTTON_PIN);
-        
-        // Detect rising edge: button was just pressed (went from LOW to HIGH)
-        if (level == 1 && !last_state) {
-            // Button is pressed! Call OpenAI API with initial prompt
-            ESP_LOGI(TAG, "Button pressed! Calling OpenAI API with initial prompt...");
-            
-            if (openai_handle != NULL && mqtt_client_handle != NULL) {
-                // Create a chat completion object
-                OpenAI_ChatCompletion_t *chat = openai_handle->chatCreate(openai_handle);
-                if (chat != NULL) {
-                    // Configure chat completion - use model from menuconfig
-                    chat->setModel(chat, CONFIG_OPENAI_MODEL);
-                    chat->setTemperature(chat, 0.7);
-                    
-                    // Get initial prompt from menuconfig
-                    const char *initial_prompt = CONFIG_INITIAL_PROMPT;
-                    ESP_LOGI(TAG, "Sending prompt to OpenAI: %s", initial_prompt);
-                    
-                    // Send to OpenAI API (save=true to maintain conversation for future calls)
-                    OpenAI_StringResponse_t *response = chat->message(chat, initial_prompt, true);
-                    if (response != NULL && response->getError(response) == NULL) {
-                        // Get the response text
-                        uint32_t len = response->getLen(response);
-                        if (len > 0) {
-                            char *response_text = response->getData(response, 0);
-                            if (response_text != NULL) {
-                                // Truncate if too long to prevent RAM overflow
-                                int pub_len = strlen(response_text);
-                                if (pub_len > MAX_RESPONSE_LEN) {
-                                    pub_len = MAX_RESPONSE_LEN;
-                                    ESP_LOGW(TAG, "Response truncated before publishing");
-                                }
-                                
-                                // Publish ChatGPT response to /esp_gpt_out topic
-                                int msg_id = esp_mqtt_client_publish(
-                                    mqtt_client_handle,
-                                    "/esp_gpt_out",
-                                    response_text,
-                                    pub_len,
-                                    0,  // QoS 0
-                                    0   // Don't retain
-                                );
-                                ESP_LOGI(TAG, "Published ChatGPT response to /esp_gpt_out, msg_id=%d", msg_id);
-                                ESP_LOGI(TAG, "Response: %.*s", pub_len, response_text);
-                                
-                                // Also publish to /esp32_gpio for backward compatibility/logging
-                                esp_mqtt_client_publish(
-                                    mqtt_client_handle,
-                                    "/esp32_gpio",
-                                    "pressed",
-                                    0,
-                                    0,
-                                    0
-                                );
-                            }
-                        }
-                        response->deleteResponse(response);
-                    } else {
-                        const char *error = response ? response->getError(response) : "Unknown error";
-                        ESP_LOGE(TAG, "OpenAI API error: %s", error ? error : "Failed to get response");
-                        if (response) {
-                            response->deleteResponse(response);
-                        }
-                    }
-                    // Clean up chat completion object
-                    openai_handle->chatDelete(chat);
-                } else {
-                    ESP_LOGE(TAG, "Failed to create ChatCompletion object");
-                }
-            } else {
-                if (openai_handle == NULL) {
-                    ESP_LOGW(TAG, "OpenAI handle not initialized, button press ignored");
-                }
-                if (mqtt_client_handle == NULL) {
-                    ESP_LOGW(TAG, "MQTT client not ready yet, button press ignored");
+        // Sleep until an edge or the nearest deadline, forever when everything is idle
+        int64_t deadline = button_gesture_deadline(&gesture);
+#if CONFIG_GPIO_EVENT_FORMAT_BINARY
+        int64_t batch_deadline = gpio_coalescer_deadline(&gpio_batch);
+        if (batch_deadline < deadline) {
+            deadline = batch_deadline;
+        }
+#endif
+        int64_t edge_us = gpio_scanner_wait_edge(ticks_until(deadline));
+
+        if (edge_us >= 0) {
+            // Debounce: let the contacts settle, then read all scanned pins in one access
+            vTaskDelay(pdMS_TO_TICKS(CONFIG_GPIO_SCAN_PERIOD_MS));
+            uint64_t levels = gpio_scanner_read();
+            uint64_t changed = levels ^ last_levels;
+
+            if (changed != 0) {
+                report_pin_changes(changed, levels, edge_us);
+
+                // Button edges are classified into gestures by their timestamps
+                if (changed & (1ULL << GPIO_BUTTON_PIN)) {
+                    bool pressed = (levels >> GPIO_BUTTON_PIN) & 1;
+                    handle_button_gestures(button_gesture_edge(&gesture, pressed, edge_us));
                 }
             }
+
+            // Update last levels for next iteration
+            last_levels = levels;
         }
-        
-        // Update last state for next iteration
-        last_state = (level == 1);
-        
-        // Wait 50ms before checking again (debouncing + reduces CPU usage)
-        vTaskDelay(pdMS_TO_TICKS(50));
+
+        // Gestures completed by a timeout (long press, end of double press window)
+        handle_button_gestures(button_gesture_poll(&gesture, esp_timer_get_time()));
+
+#if CONFIG_GPIO_EVENT_FORMAT_BINARY
+        // Publish the batch once its coalescing window or latency cap has elapsed
+        if (esp_timer_get_time() >= gpio_coalescer_deadline(&gpio_batch)) {
+            flush_gpio_events();
+        }
+#endif
     }
 }
 
 /*
- * @brief Initialize GPIO pin as input
+ * @brief Initialize GPIO input pins
  * 
- * Configures the specified GPIO pin as an input with pull-down resistor.
+ * Configures the button pin and every pin of CONFIG_GPIO_INPUT_PINS as inputs
+ * with pull-down resistor. Pins of CONFIG_GPIO_PCNT_PINS go to the hardware
+ * pulse counter instead.
  * When button is not pressed, pin will be LOW (0).
  * When button is pressed (connected to 3.3V), pin will be HIGH (1).
  */
- static void gpio_init(void)
- {
-     // Configure GPIO pin structure
-     gpio_config_t io_conf = {
-         .intr_type = GPIO_INTR_DISABLE,      // No interrupt, we'll poll manually
-         .mode = GPIO_MODE_INPUT,             // Set as input pin
-         .pin_bit_mask = (1ULL << GPIO_BUTTON_PIN),  // Which pin to configure
-         .pull_down_en = GPIO_PULLDOWN_ENABLE, // Enable pull-down resistor
-         .pull_up_en = GPIO_PULLUP_DISABLE,    // Disable pull-up resistor
-     };
-     
-     // Apply the configuration
-     gpio_config(&io_conf);
-     ESP_LOGI(TAG, "GPIO %d configured as input with pull-down", GPIO_BUTTON_PIN);
- }
- 
+static void gpio_init(void)
+{
+    uint64_t pin_mask = 0;
 
+    // Parse the pin list from menuconfig, the button pin is always scanned
+    if (!gpio_pins_parse(CONFIG_GPIO_INPUT_PINS, &pin_mask)) {
+        ESP_LOGE(TAG, "Invalid GPIO input pin list \"%s\", scanning button only", CONFIG_GPIO_INPUT_PINS);
+        pin_mask = 0;
+    }
+    pin_mask |= 1ULL << GPIO_BUTTON_PIN;
 
-static void mqtt_app_start(void)
-{
-    esp_mqtt_client_config_t mqtt_cfg = {
-        .broker.address.uri = CONFIG_BROKER_URL,
+#if CONFIG_SOC_PCNT_SUPPORTED
+    // Pins in pulse counter mode are counted by hardware instead of being scanned
+    uint64_t pcnt_mask = 0;
+    if (!gpio_pins_parse(CONFIG_GPIO_PCNT_PINS, &pcnt_mask)) {
+        ESP_LOGE(TAG, "Invalid pulse counter pin list \"%s\", ignored", CONFIG_GPIO_PCNT_PINS);
+        pcnt_mask = 0;
+    }
+    if (pcnt_mask & (1ULL << GPIO_BUTTON_PIN)) {
+        ESP_LOGW(TAG, "Button GPIO %d cannot be a pulse counter, kept as scanned input", GPIO_BUTTON_PIN);
+        pcnt_mask &= ~(1ULL << GPIO_BUTTON_PIN);
+    }
+    if (pcnt_mask != 0) {
+        pin_mask &= ~pcnt_mask;
+        ESP_ERROR_CHECK(pulse_counter_init(pcnt_mask));
+    }
+#endif
+
+    // Apply the configuration
+    ESP_ERROR_CHECK(gpio_scanner_init(pin_mask));
+    ESP_LOGI(TAG, "GPIO %d configured as button input with pull-down", GPIO_BUTTON_PIN);
+
+#if CONFIG_GPIO_EVENT_FORMAT_BINARY
+    // Coalescing limits from menuconfig, overhead is MQTT fixed header + topic of one publish
+    gpio_coalescer_config_t batch_cfg = {
+        .window_us = CONFIG_GPIO_COALESCE_WINDOW_MS * 1000LL,
+        .max_latency_us = CONFIG_GPIO_COALESCE_MAX_LATENCY_MS * 1000LL,
+        .max_events = CONFIG_GPIO_COALESCE_MAX_EVENTS,
+        .packet_overhead = 4 + strlen(GPIO_CHANGES_TOPIC),
     };
-#if CONFIG_BROKER_URL_FROM_STDIN
-    char line[128];
-
-    if (strcmp(mqtt_cfg.broker.address.uri, "FROM_STDIN") == 0) {
-        int count = 0;
-        printf("Please enter url of mqtt broker\n");
-        while (count < 128) {
-            int c = fgetc(stdin);
-            if (c == '\n') {
-                line[count] = '\0';
-                break;
-            } else if (c > 0 && c < 127) {
-                line[count] = c;
-                ++count;
-            }
-            vTaskDelay(10 / portTICK_PERIOD_MS);
+    gpio_coalescer_init(&gpio_batch, &batch_cfg, gpio_batch_events);
+    app_metrics_register("gpio", gpio_metrics_writer);
+#endif
+}
+
+
+
+#if CONFIG_BROKER_URL_FROM_STDIN && CONFIG_BROKER_STDIN_WINDOW_S > 0
+/*
+ * @brief Pending function call: connect to the broker typed on the console
+ */
+static void apply_console_broker(void *arg, uint32_t unused)
+{
+    broker_config_t *next = arg;
+
+    // Stored and applied like the broker command
+    s_broker_source = BROKER_SOURCE_STDIN;
+    handle_broker_command(BROKER_COMMAND_SET, next);
+    free(next);
+}
+
+/*
+ * @brief Give the console a while to replace the stored broker URL, without holding up the boot
+ */
+static void broker_console_task(void *arg)
+{
+    broker_config_t *next = malloc(sizeof(*next));
+
+    if (next != NULL) {
+        *next = s_primary;
+        // Applied by the timer task, like the other broker changes
+        if (!broker_store_read_console(next, CONFIG_BROKER_STDIN_WINDOW_S * 1000) ||
+            xTimerPendFunctionCall(apply_console_broker, next, 0, portMAX_DELAY) != pdPASS) {
+            free(next);
         }
-        mqtt_cfg.broker.address.uri = line;
-        printf("Broker url: %s\n", line);
-    } else {
-        ESP_LOGE(TAG, "Configuration mismatch: wrong broker url");
-        abort();
     }
-#endif /* CONFIG_BROKER_URL_FROM_STDIN */
+    vTaskDelete(NULL);
+}
+#endif
+
+/*
+ * @brief Load the broker settings and create the client, no network needed
+ */
+static void mqtt_app_init(void)
+{
+    esp_mqtt_client_config_t mqtt_cfg;
+
+    // Stored settings are used at once, the console only blocks before the first provisioning
+    s_broker_source = broker_store_load(&s_primary);
+    ESP_LOGI(TAG, "Broker %s (from %s)", s_primary.uri, broker_source_name(s_broker_source));
+    s_broker = s_primary;
+    ESP_ERROR_CHECK(mqtt_session_init());
+    broker_client_config(&mqtt_cfg, &s_broker);
+    ESP_ERROR_CHECK(broker_failover_init(s_primary.uri, failover_switch));
 
-    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
-    mqtt_client_handle = client;  // Store globally so GPIO task can use it
+    s_client = esp_mqtt_client_init(&mqtt_cfg);
+    ESP_ERROR_CHECK(mqtt_reconnect_init(s_client));
+    ESP_ERROR_CHECK(mqtt_session_start(s_client));
     /* The last argument may be used to pass data to the event handler, in this example mqtt_event_handler */
-    esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
-    esp_mqtt_client_start(client);
+    esp_mqtt_client_register_event(s_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    app_metrics_register("broker", broker_metrics_writer);
+#if CONFIG_BROKER_URL_FROM_STDIN && CONFIG_BROKER_STDIN_WINDOW_S > 0
+    // The boot goes on with the stored URL meanwhile
+    if (s_broker_source == BROKER_SOURCE_NVS) {
+        xTaskCreate(broker_console_task, "broker_console", 3072, NULL, 3, NULL);
+    }
+#endif
+}
+
+/*
+ * @brief Connect to the broker, once an IP address is assigned
+ */
+static void mqtt_app_start(void)
+{
+#if CONFIG_BROKER_MDNS_DISCOVERY
+    // A broker on the local network comes first, the configured one becomes its fallback
+    char local_uri[BROKER_URI_MAX];
+    int mdns_step = app_boot_step_begin("broker_mdns");
+    if (broker_mdns_discover(local_uri, sizeof(local_uri)) == ESP_OK) {
+        broker_failover_prefer(local_uri);
+    }
+    app_boot_step_end(mdns_step);
+#endif
+
+    // The fastest broker from the start rather than a switch right after connecting
+    if (broker_failover_active()) {
+        int step = app_boot_step_begin("broker_probe");
+        broker_failover_pick();
+        app_boot_step_end(step);
+    }
+
+    // Started before the network is up, the client would wait a whole reconnect timeout after the first failure
+    s_mqtt_step = app_boot_step_begin("mqtt");
+    esp_mqtt_client_start(s_client);
+    s_mqtt_started = true;
+
+    // Every task publishes through the single publisher task, none uses the client directly
+    ESP_ERROR_CHECK(mqtt_publisher_start(s_client));
+    ESP_ERROR_CHECK(broker_failover_start());
+}
+
+/*
+ * @brief Connect Wi-Fi or Ethernet while app_main() sets up the rest
+ */
+static void network_task(void *arg)
+{
+    int step = app_boot_step_begin("network");
+    /* example_connect() configures Wi-Fi or Ethernet, as selected in menuconfig.
+     * Read "Establishing Wi-Fi or Ethernet Connection" section in
+     * examples/protocols/README.md for more information about this function.
+     * With Wi-Fi, the access point of the previous boot is tried first.
+     */
+    ESP_ERROR_CHECK(wifi_fast_connect());
+    app_boot_step_end(step);
+    app_boot_signal(APP_BOOT_NETWORK_UP);
+    vTaskDelete(NULL);
 }
 
 void app_main(void)
 {
+    // Before anything else: every startup step is recorded in the boot timeline
+    ESP_ERROR_CHECK(app_boot_init());
     ESP_LOGI(TAG, "[APP] Startup..");
     ESP_LOGI(TAG, "[APP] Free memory: %" PRIu32 " bytes", esp_get_free_heap_size());
     ESP_LOGI(TAG, "[APP] IDF version: %s", esp_get_idf_version());
@@ -345,60 +727,64 @@ void app_main(void)
     esp_log_level_set("esp-tls", ESP_LOG_VERBOSE);
     esp_log_level_set("transport", ESP_LOG_VERBOSE);
     esp_log_level_set("outbox", ESP_LOG_VERBOSE);
+    // The OpenAI client polls its connection to stay cancellable, keep the read timeouts quiet
+    esp_log_level_set("HTTP_CLIENT", ESP_LOG_ERROR);
 
+    int step = app_boot_step_begin("nvs");
     ESP_ERROR_CHECK(nvs_flash_init());
+    app_boot_step_end(step);
+
+    step = app_boot_step_begin("netif");
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
+#if CONFIG_DNS_CACHE
+    // Before the first connection: every name lookup goes through the cache from here on
+    ESP_ERROR_CHECK(dns_resolver_start());
+#if CONFIG_HAPPY_EYEBALLS
+    dns_resolver_race(CONFIG_OPENAI_API_URL);
+#endif
+#endif
+    // Topic names are needed by every module that publishes
+    ESP_ERROR_CHECK(app_topics_init());
+    app_boot_step_end(step);
 
-    /* This helper function configures Wi-Fi or Ethernet, as selected in menuconfig.
-     * Read "Establishing Wi-Fi or Ethernet Connection" section in
-     * examples/protocols/README.md for more information about this function.
-     */
-    ESP_ERROR_CHECK(example_connect());
+    // Association and DHCP take seconds: everything up to the MQTT start runs meanwhile
+    xTaskCreate(network_task, "boot_network", 4096, NULL, 5, NULL);
 
-    // Initialize GPIO pin before starting MQTT
+    // Queue first: what is published before the broker is reached waits there
+    step = app_boot_step_begin("publisher");
+    ESP_ERROR_CHECK(mqtt_publisher_init());
+    app_boot_step_end(step);
+
+    // Conversation worker: runs the OpenAI calls outside the GPIO and MQTT tasks
+    step = app_boot_step_begin("conversation");
+    ESP_ERROR_CHECK(conversation_start());
+    app_boot_step_end(step);
+
+    // Button presses are captured from here on, long before the broker is connected
+    step = app_boot_step_begin("gpio");
     gpio_init();
+    // Create background task to monitor GPIO button
+    // Parameters: function, task name, stack size, parameter, priority, task handle
+    xTaskCreate(gpio_task, "gpio_task", 3072, NULL, 10, NULL);
+    app_boot_step_end(step);
 
-    // Initialize OpenAI API client
-    const char *api_key = CONFIG_OPENAI_API_KEY;
-    if (strlen(api_key) > 0) {
-        openai_handle = OpenAICreate(api_key);
-        if (openai_handle != NULL) {
-            // Set custom API URL if configured (for OpenRouter, LM Studio, etc.)
-            const char *api_url = CONFIG_OPENAI_API_URL;
-            // Check if URL is different from default OpenAI URL
-            if (strlen(api_url) > 0 && strcmp(api_url, "https://api.openai.com/v1/chat/completions") != 0) {
-                // Extract base URL (remove /v1/chat/completions if present)
-                char base_url[256];
-                strncpy(base_url, api_url, sizeof(base_url) - 1);
-                base_url[sizeof(base_url) - 1] = '\0';
-                
-                // Remove /v1/chat/completions suffix if present
-                char *suffix = strstr(base_url, "/v1/chat/completions");
-                if (suffix != NULL) {
-                    *suffix = '\0';
-                }
-                
-                OpenAIChangeBaseURL(openai_handle, base_url);
-                ESP_LOGI(TAG, "OpenAI base URL set to: %s", base_url);
-            }
-            ESP_LOGI(TAG, "OpenAI API initialized successfully");
-            ESP_LOGI(TAG, "Using model: %s", CONFIG_OPENAI_MODEL);
-        } else {
-            ESP_LOGE(TAG, "Failed to initialize OpenAI API");
-        }
-    } else {
-        ESP_LOGW(TAG, "OpenAI API key not configured. ChatGPT features will be disabled.");
-    }
+    step = app_boot_step_begin("mqtt_init");
+    mqtt_app_init();
+    app_boot_step_end(step);
 
+    app_boot_wait(APP_BOOT_NETWORK_UP);
     mqtt_app_start();
 
-    // Create background task to monitor GPIO button
-    // Parameters: function, task name, stack size, parameter, priority, task handle
-    xTaskCreate(gpio_task, "gpio_task", 2048, NULL, 10, NULL);
-    
+    // Periodic report on /esp32_metrics, once every module registered its writer
+    app_metrics_start();
+#if CONFIG_SOC_PCNT_SUPPORTED
+    // Periodic counts and rates of the pulse counter pins on /esp32_pcnt
+    pulse_counter_start();
+#endif
+
     ESP_LOGI(TAG, "Application initialized. Monitoring GPIO %d for button presses...", GPIO_BUTTON_PIN);
-    if (openai_handle != NULL) {
+    if (strlen(CONFIG_OPENAI_API_KEY) > 0) {
         ESP_LOGI(TAG, "ChatGPT integration ready. Press button to start endless discussion!");
     }
 }
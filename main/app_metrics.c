@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "app_metrics.h"
+#include "mqtt_publisher.h"
+#include "app_topics.h"
+
+static const char *TAG = "app_metrics";
+
+#define METRICS_MAX_WRITERS 12
+#define METRICS_PAYLOAD_LEN 2048
+
+typedef struct {
+    const char *name;
+    app_metrics_writer_t writer;
+} metrics_entry_t;
+
+static metrics_entry_t s_writers[METRICS_MAX_WRITERS];
+static int s_writer_count = 0;
+// Writers register from app_main and from network_task (wifi) while the report may be running
+static portMUX_TYPE s_writers_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t app_metrics_register(const char *name, app_metrics_writer_t writer)
+{
+    bool registered = false;
+
+    portENTER_CRITICAL(&s_writers_lock);
+    if (s_writer_count < METRICS_MAX_WRITERS) {
+        s_writers[s_writer_count].name = name;
+        s_writers[s_writer_count].writer = writer;
+        s_writer_count++;
+        registered = true;
+    }
+    portEXIT_CRITICAL(&s_writers_lock);
+    if (!registered) {
+        ESP_LOGE(TAG, "No slot left for metrics writer %s", name);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/*
+ * @brief Build the full report: uptime followed by every registered writer
+ */
+static int metrics_format(char *buf, size_t buf_len, int64_t interval_us)
+{
+    int len = snprintf(buf, buf_len, "{\"uptime_ms\":%" PRId64, esp_timer_get_time() / 1000);
+    if (len < 0 || (size_t)len >= buf_len) {
+        return -1;
+    }
+
+    // Slots are never released: the ones below the count are complete
+    portENTER_CRITICAL(&s_writers_lock);
+    int count = s_writer_count;
+    portEXIT_CRITICAL(&s_writers_lock);
+
+    for (int i = 0; i < count; i++) {
+        int n = snprintf(buf + len, buf_len - len, ",\"%s\":", s_writers[i].name);
+        if (n < 0 || (size_t)n >= buf_len - len) {
+            return -1;
+        }
+        len += n;
+
+        n = s_writers[i].writer(buf + len, buf_len - len, interval_us);
+        if (n < 0 || (size_t)n >= buf_len - len) {
+            ESP_LOGW(TAG, "Metrics of %s do not fit, report dropped", s_writers[i].name);
+            return -1;
+        }
+        len += n;
+    }
+
+    if ((size_t)len + 2 > buf_len) {
+        return -1;
+    }
+    buf[len++] = '}';
+    buf[len] = '\0';
+    return len;
+}
+
+static void metrics_task(void *arg)
+{
+    // Report buffer (static to keep the task stack small)
+    static char payload[METRICS_PAYLOAD_LEN];
+    int64_t last_report = esp_timer_get_time();
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_METRICS_INTERVAL_MS));
+
+        int64_t now = esp_timer_get_time();
+        int len = metrics_format(payload, sizeof(payload), now - last_report);
+        last_report = now;
+        if (len > 0) {
+            mqtt_publisher_publish(app_topic(APP_TOPIC_METRICS), payload, len, app_topic_qos(APP_TOPIC_METRICS), 0);
+            ESP_LOGD(TAG, "%s", payload);
+        }
+    }
+}
+
+void app_metrics_start(void)
+{
+    // Low priority: reporting must never delay button handling
+    xTaskCreate(metrics_task, "metrics_task", 3072, NULL, 2, NULL);
+    ESP_LOGI(TAG, "Publishing metrics to %s every %d ms", app_topic(APP_TOPIC_METRICS), CONFIG_METRICS_INTERVAL_MS);
+}
@@ -0,0 +1,49 @@
+/*
+ * Periodic metrics report
+ *
+ * Modules register a writer that formats their own counters; every
+ * CONFIG_METRICS_INTERVAL_MS the writers are called in turn and the result
+ * is published as one JSON object on /esp32_metrics, for example
+ * {"uptime_ms":12000,"gpio":{...},...}.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * @brief Metrics writer callback
+ *
+ * Writes the JSON value of the module (usually an object) into buf.
+ *
+ * @param buf Output buffer
+ * @param len Size of the output buffer
+ * @param interval_us Time since the previous report, for rate computations
+ * @return Number of characters written, or -1 if buf is too small
+ */
+typedef int (*app_metrics_writer_t)(char *buf, size_t len, int64_t interval_us);
+
+/*
+ * @brief Register a metrics writer under a JSON key
+ *
+ * Writers may register from any task, before or after app_metrics_start().
+ *
+ * @param name JSON key of the module, must stay valid forever
+ * @param writer Callback formatting the module's metrics
+ * @return ESP_OK, or ESP_ERR_NO_MEM when all slots are used
+ */
+esp_err_t app_metrics_register(const char *name, app_metrics_writer_t writer);
+
+/*
+ * @brief Start the task publishing the metrics report through mqtt_publisher
+ */
+void app_metrics_start(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_mac.h"
+
+#include "app_topics.h"
+
+static const char *TAG = "app_topics";
+
+static const char *const s_device_topics[APP_TOPIC_COUNT] = {
+    [APP_TOPIC_GPIO] = "/esp32_gpio",
+    [APP_TOPIC_GPIO_EVENTS] = "/esp32_gpio/events",
+    [APP_TOPIC_GPIO_INPUTS] = "/esp32_gpio/inputs",
+    [APP_TOPIC_PCNT] = "/esp32_pcnt",
+    [APP_TOPIC_METRICS] = "/esp32_metrics",
+    [APP_TOPIC_COMMANDS] = "/esp32_commands",
+    [APP_TOPIC_GPT_OUT] = "/esp_gpt_out",
+    [APP_TOPIC_CLIENT_GPT] = "/client_gpt",
+};
+
+// Published topics: QoS of their messages; subscribed topics: QoS of the subscription
+static const uint8_t s_topic_qos[APP_TOPIC_COUNT] = {
+    [APP_TOPIC_GPIO] = CONFIG_MQTT_QOS_EVENTS,
+    // High rate: QoS 0 by default, the only QoS using topic aliases
+    [APP_TOPIC_GPIO_EVENTS] = CONFIG_MQTT_QOS_GPIO_EVENTS,
+    [APP_TOPIC_GPIO_INPUTS] = CONFIG_MQTT_QOS_GPIO_EVENTS,
+    // Periodic reports, each one superseded by the next
+    [APP_TOPIC_PCNT] = 0,
+    [APP_TOPIC_METRICS] = 0,
+    [APP_TOPIC_COMMANDS] = CONFIG_MQTT_QOS_INBOUND,
+    [APP_TOPIC_GPT_OUT] = CONFIG_MQTT_QOS_ANSWERS,
+    [APP_TOPIC_CLIENT_GPT] = CONFIG_MQTT_QOS_INBOUND,
+};
+
+static topic_ns_t s_ns;
+static char s_device_id[TOPIC_NS_BASE_MAX + 1];
+static char s_topics[APP_TOPIC_COUNT][APP_TOPIC_MAX];
+
+esp_err_t app_topics_init(void)
+{
+    if (CONFIG_TOPIC_PREFIX[0] != '\0') {
+        if (CONFIG_DEVICE_ID[0] != '\0') {
+            snprintf(s_device_id, sizeof(s_device_id), "%s", CONFIG_DEVICE_ID);
+        } else {
+            uint8_t mac[6];
+            ESP_ERROR_CHECK(esp_read_mac(mac, ESP_MAC_WIFI_STA));
+            topic_ns_mac_id(s_device_id, mac);
+        }
+    }
+    if (!topic_ns_init(&s_ns, CONFIG_TOPIC_PREFIX, s_device_id)) {
+        ESP_LOGE(TAG, "Invalid topic prefix \"%s\" or device ID \"%s\"", CONFIG_TOPIC_PREFIX, s_device_id);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 0; i < APP_TOPIC_COUNT; i++) {
+        // Cannot fail: the namespace is at most TOPIC_NS_BASE_MAX long
+        topic_ns_build(&s_ns, s_device_topics[i], s_topics[i], sizeof(s_topics[i]));
+    }
+    if (s_ns.base_len > 0) {
+        ESP_LOGI(TAG, "Device ID %s, topics under %s/", s_device_id, s_ns.base);
+    } else {
+        ESP_LOGI(TAG, "Flat topics, shared with every device on the broker");
+    }
+    return ESP_OK;
+}
+
+const char *app_topic(app_topic_t topic)
+{
+    return s_topics[topic];
+}
+
+int app_topic_qos(app_topic_t topic)
+{
+    return s_topic_qos[topic];
+}
+
+const char *app_topic_strip(const char *topic, size_t len, size_t *rest_len)
+{
+    return topic_ns_strip(&s_ns, topic, len, rest_len);
+}
+
+const char *app_topics_device_id(void)
+{
+    return s_device_id;
+}
@@ -0,0 +1,70 @@
+/*
+ * MQTT topics of this device
+ *
+ * Every topic lives under CONFIG_TOPIC_PREFIX/<device id> (see topic_ns.h),
+ * the device identifier being CONFIG_DEVICE_ID or, by default, the Wi-Fi
+ * station MAC address. With an empty prefix the flat topics are used.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "topic_ns.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longest device topic, namespace included
+#define APP_TOPIC_MAX (TOPIC_NS_BASE_MAX + 24)
+
+typedef enum {
+    APP_TOPIC_GPIO,             // /esp32_gpio
+    APP_TOPIC_GPIO_EVENTS,      // /esp32_gpio/events
+    APP_TOPIC_GPIO_INPUTS,      // /esp32_gpio/inputs
+    APP_TOPIC_PCNT,             // /esp32_pcnt
+    APP_TOPIC_METRICS,          // /esp32_metrics
+    APP_TOPIC_COMMANDS,         // /esp32_commands
+    APP_TOPIC_GPT_OUT,          // /esp_gpt_out
+    APP_TOPIC_CLIENT_GPT,       // /client_gpt
+    APP_TOPIC_COUNT,
+} app_topic_t;
+
+/*
+ * @brief Build the topics from the configuration and the MAC address
+ *
+ * Before anything publishes or subscribes.
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if the prefix or the identifier is unusable
+ */
+esp_err_t app_topics_init(void);
+
+/*
+ * @brief Full topic, valid once app_topics_init() returned
+ */
+const char *app_topic(app_topic_t topic);
+
+/*
+ * @brief QoS of a topic: of the messages published on it, or of its subscription
+ *
+ * Button presses and GPIO events are worth a retransmission, periodic
+ * reports are not; see the "MQTT QoS" options in menuconfig.
+ */
+int app_topic_qos(app_topic_t topic);
+
+/*
+ * @brief Device topic of a topic received from the broker, see topic_ns_strip()
+ *
+ * @return Device topic, e.g. "/client_gpt/s1", or NULL if the topic belongs to another device
+ */
+const char *app_topic_strip(const char *topic, size_t len, size_t *rest_len);
+
+/*
+ * @brief Device identifier, "" with flat topics
+ */
+const char *app_topics_device_id(void);
+
+#ifdef __cplusplus
+}
+#endif
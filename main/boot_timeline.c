@@ -0,0 +1,82 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "boot_timeline.h"
+
+void boot_timeline_init(boot_timeline_t *t)
+{
+    memset(t, 0, sizeof(*t));
+}
+
+int boot_timeline_begin(boot_timeline_t *t, const char *name, int64_t now_us)
+{
+    if (t->count >= BOOT_TIMELINE_MAX_STEPS) {
+        return -1;
+    }
+    boot_step_t *s = &t->steps[t->count];
+    s->name = name;
+    s->start_us = now_us;
+    s->end_us = -1;
+    return t->count++;
+}
+
+void boot_timeline_end(boot_timeline_t *t, int step, int64_t now_us)
+{
+    if (step >= 0 && (size_t)step < t->count) {
+        t->steps[step].end_us = now_us;
+    }
+}
+
+int64_t boot_timeline_span_us(const boot_timeline_t *t)
+{
+    int64_t span = 0;
+
+    for (size_t i = 0; i < t->count; i++) {
+        if (t->steps[i].end_us > span) {
+            span = t->steps[i].end_us;
+        }
+    }
+    return span;
+}
+
+int64_t boot_timeline_busy_us(const boot_timeline_t *t)
+{
+    int64_t busy = 0;
+
+    for (size_t i = 0; i < t->count; i++) {
+        if (t->steps[i].end_us >= 0) {
+            busy += t->steps[i].end_us - t->steps[i].start_us;
+        }
+    }
+    return busy;
+}
+
+int boot_timeline_format_step(const boot_timeline_t *t, size_t step, char *buf, size_t len)
+{
+    const boot_step_t *s = &t->steps[step];
+    int64_t span = boot_timeline_span_us(t);
+    char bar[BOOT_TIMELINE_BAR_WIDTH + 1];
+
+    // '#' while the step ran, '.' up to the end of the chart for a step still running
+    int64_t end = s->end_us >= 0 ? s->end_us : span;
+    char mark = s->end_us >= 0 ? '#' : '.';
+    for (int i = 0; i < BOOT_TIMELINE_BAR_WIDTH; i++) {
+        int64_t cell_start = span * i / BOOT_TIMELINE_BAR_WIDTH;
+        int64_t cell_end = i == BOOT_TIMELINE_BAR_WIDTH - 1 ? span + 1 : span * (i + 1) / BOOT_TIMELINE_BAR_WIDTH;
+        // The cell holding the start is always drawn, so short steps stay visible
+        bool ran = s->start_us < cell_end && end > cell_start;
+        bool starts = s->start_us >= cell_start && s->start_us < cell_end;
+        bar[i] = span > 0 && (ran || starts) ? mark : ' ';
+    }
+    bar[BOOT_TIMELINE_BAR_WIDTH] = '\0';
+
+    int n;
+    if (s->end_us >= 0) {
+        n = snprintf(buf, len, "%-12s %8.1f ms %+9.1f ms |%s|", s->name, s->start_us / 1000.0,
+                     (s->end_us - s->start_us) / 1000.0, bar);
+    } else {
+        n = snprintf(buf, len, "%-12s %8.1f ms %12s |%s|", s->name, s->start_us / 1000.0, "running", bar);
+    }
+    return (n < 0 || (size_t)n >= len) ? -1 : n;
+}
@@ -0,0 +1,70 @@
+/*
+ * Boot timeline
+ *
+ * Start and end time of each startup step, steps running in parallel
+ * included, and their rendering as a text Gantt chart for the log:
+ *   network         310.2 ms   +2104.5 ms |   ##########################   |
+ *   gpio            311.0 ms      +1.2 ms |   #                            |
+ * Times are since reset, so the first step also shows the bootloader time.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOOT_TIMELINE_MAX_STEPS 16
+// Characters of the bar drawn by boot_timeline_format_step()
+#define BOOT_TIMELINE_BAR_WIDTH 32
+
+typedef struct {
+    const char *name;
+    int64_t start_us;
+    int64_t end_us;             // -1 while the step runs
+} boot_step_t;
+
+typedef struct {
+    boot_step_t steps[BOOT_TIMELINE_MAX_STEPS];
+    size_t count;
+} boot_timeline_t;
+
+void boot_timeline_init(boot_timeline_t *t);
+
+/*
+ * @brief Record the start of a step
+ *
+ * @param name Step name, must stay valid forever
+ * @return Step index for boot_timeline_end(), -1 if the timeline is full
+ */
+int boot_timeline_begin(boot_timeline_t *t, const char *name, int64_t now_us);
+
+/*
+ * @brief Record the end of a step, ignored for -1
+ */
+void boot_timeline_end(boot_timeline_t *t, int step, int64_t now_us);
+
+/*
+ * @brief End of the last step to finish, i.e. the wall-clock time of the boot
+ */
+int64_t boot_timeline_span_us(const boot_timeline_t *t);
+
+/*
+ * @brief Sum of the durations of the finished steps
+ *
+ * Above the wall-clock time spent in steps when some of them overlapped.
+ */
+int64_t boot_timeline_busy_us(const boot_timeline_t *t);
+
+/*
+ * @brief Format one line of the chart, bar scaled to boot_timeline_span_us()
+ *
+ * @return Number of characters written, or -1 if buf is too small
+ */
+int boot_timeline_format_step(const boot_timeline_t *t, size_t step, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
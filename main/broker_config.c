@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "broker_config.h"
+
+bool broker_uri_valid(const char *uri, size_t len)
+{
+    static const char *const schemes[] = {"mqtt://", "mqtts://", "ws://", "wss://"};
+
+    if (len >= BROKER_URI_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (uri[i] <= ' ' || uri[i] > '~') {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < sizeof(schemes) / sizeof(schemes[0]); i++) {
+        size_t n = strlen(schemes[i]);
+        // Something must follow the scheme, and it cannot start with the path
+        if (len > n && strncmp(uri, schemes[i], n) == 0 && uri[n] != '/' && uri[n] != ':') {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool broker_uri_host_port(const char *uri, char *host, size_t host_len, uint16_t *port)
+{
+    static const struct {
+        const char *scheme;
+        uint16_t port;
+    } defaults[] = {{"mqtt://", 1883}, {"mqtts://", 8883}, {"ws://", 80}, {"wss://", 443},
+                    {"http://", 80}, {"https://", 443}};
+
+    const char *p = NULL;
+    for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++) {
+        size_t n = strlen(defaults[i].scheme);
+        if (strncmp(uri, defaults[i].scheme, n) == 0) {
+            p = uri + n;
+            *port = defaults[i].port;
+            break;
+        }
+    }
+    if (p == NULL) {
+        return false;
+    }
+
+    // Authority ends at the path; user information ends at its last '@'
+    const char *end = p + strcspn(p, "/?#");
+    for (const char *q = p; q < end; q++) {
+        if (*q == '@') {
+            p = q + 1;
+        }
+    }
+
+    const char *host_end;
+    const char *port_start = NULL;
+    if (*p == '[') {
+        p++;
+        host_end = memchr(p, ']', end - p);
+        if (host_end == NULL) {
+            return false;
+        }
+        if (host_end + 1 < end) {
+            if (host_end[1] != ':') {
+                return false;
+            }
+            port_start = host_end + 2;
+        }
+    } else {
+        host_end = memchr(p, ':', end - p);
+        if (host_end != NULL) {
+            port_start = host_end + 1;
+        } else {
+            host_end = end;
+        }
+    }
+
+    size_t n = host_end - p;
+    if (n == 0 || n >= host_len) {
+        return false;
+    }
+    memcpy(host, p, n);
+    host[n] = '\0';
+
+    if (port_start != NULL) {
+        uint32_t value = 0;
+        if (port_start == end) {
+            return false;
+        }
+        for (const char *q = port_start; q < end; q++) {
+            if (*q < '0' || *q > '9' || (value = value * 10 + (*q - '0')) > 65535) {
+                return false;
+            }
+        }
+        if (value == 0) {
+            return false;
+        }
+        *port = value;
+    }
+    return true;
+}
+
+/*
+ * @brief Next space-separated word of [*pos, end)
+ *
+ * @return Length of the word, 0 at the end of the payload
+ */
+static size_t next_word(const char **pos, const char *end, const char **word)
+{
+    const char *p = *pos;
+
+    while (p < end && *p == ' ') {
+        p++;
+    }
+    *word = p;
+    while (p < end && *p != ' ') {
+        p++;
+    }
+    *pos = p;
+    return p - *word;
+}
+
+bool broker_uri_build(char *uri, size_t len, const char *host, uint16_t port)
+{
+    bool ipv6 = strchr(host, ':') != NULL;
+    int n = snprintf(uri, len, "mqtt://%s%s%s:%u", ipv6 ? "[" : "", host, ipv6 ? "]" : "", (unsigned)port);
+    return n > 0 && (size_t)n < len && host[0] != '\0' && broker_uri_valid(uri, n);
+}
+
+broker_command_t broker_config_parse_command(const char *data, size_t len, broker_config_t *cfg)
+{
+    const char *pos = data;
+    const char *end = data + len;
+    const char *word;
+    size_t n;
+
+    // Trailing newline of commands typed in mosquitto_pub -l and the like
+    while (end > data && (end[-1] == '\n' || end[-1] == '\r')) {
+        end--;
+    }
+    n = next_word(&pos, end, &word);
+    if (n != 6 || strncmp(word, "broker", 6) != 0) {
+        return BROKER_COMMAND_NONE;
+    }
+
+    const char *uri;
+    size_t uri_len = next_word(&pos, end, &uri);
+    if (uri_len == 5 && strncmp(uri, "reset", 5) == 0) {
+        return next_word(&pos, end, &word) == 0 ? BROKER_COMMAND_RESET : BROKER_COMMAND_INVALID;
+    }
+    if (!broker_uri_valid(uri, uri_len)) {
+        return BROKER_COMMAND_INVALID;
+    }
+
+    const char *user;
+    const char *pass;
+    size_t user_len = next_word(&pos, end, &user);
+    size_t pass_len = next_word(&pos, end, &pass);
+    if (user_len >= BROKER_USERNAME_MAX || pass_len >= BROKER_PASSWORD_MAX ||
+        next_word(&pos, end, &word) != 0) {
+        return BROKER_COMMAND_INVALID;
+    }
+
+    memcpy(cfg->uri, uri, uri_len);
+    cfg->uri[uri_len] = '\0';
+    memcpy(cfg->username, user, user_len);
+    cfg->username[user_len] = '\0';
+    memcpy(cfg->password, pass, pass_len);
+    cfg->password[pass_len] = '\0';
+    return BROKER_COMMAND_SET;
+}
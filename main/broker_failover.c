@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+
+#include "broker_failover.h"
+#include "broker_select.h"
+#include "app_metrics.h"
+
+static const char *TAG = "broker_failover";
+
+#define FAILOVER_TASK_STACK 4096
+// Host names longer than this cannot be probed
+#define PROBE_HOST_MAX 64
+// Failed connections in a row before the current broker is given up; one is often a network glitch
+#define LOSSES_BEFORE_REFUSED 2
+
+static broker_select_t s_select;
+static SemaphoreHandle_t s_lock = NULL;
+static broker_failover_switch_t s_on_switch;
+static TaskHandle_t s_task = NULL;
+static bool s_connected = false;
+static int s_losses = 0;                // Since the last connection, -1 while our own disconnection is pending
+static uint32_t s_switches = 0;
+
+esp_err_t broker_failover_init(const char *primary_uri, broker_failover_switch_t on_switch)
+{
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_on_switch = on_switch;
+    broker_select_init(&s_select, CONFIG_BROKER_SWITCH_MARGIN_MS * 1000);
+    broker_select_set_primary(&s_select, primary_uri);
+    size_t added = broker_select_add_list(&s_select, CONFIG_BROKER_FALLBACK_URLS);
+    if (added > 0) {
+        ESP_LOGI(TAG, "%u fallback broker(s)", (unsigned)added);
+    } else if (CONFIG_BROKER_FALLBACK_URLS[0] != '\0') {
+        ESP_LOGW(TAG, "No usable fallback broker in \"%s\"", CONFIG_BROKER_FALLBACK_URLS);
+    }
+    return ESP_OK;
+}
+
+bool broker_failover_active(void)
+{
+    return s_select.count > 1;
+}
+
+void broker_failover_prefer(const char *uri)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int index = broker_select_add(&s_select, uri, strlen(uri));
+    if (index >= 0) {
+        broker_select_use(&s_select, index);
+    }
+    xSemaphoreGive(s_lock);
+
+    if (index < 0) {
+        ESP_LOGW(TAG, "Broker %s already listed or no room left", uri);
+        return;
+    }
+    ESP_LOGI(TAG, "Preferring broker %d", index);
+    s_on_switch(index, uri);
+}
+
+/*
+ * @brief Start a non-blocking TCP connection to a candidate
+ *
+ * @return Socket, or -1 if the host could not be resolved or connected to
+ */
+static int probe_open(const char *uri, int64_t *start_us, int32_t *rtt_us)
+{
+    char host[PROBE_HOST_MAX];
+    char port[6];
+    uint16_t port_num;
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *res = NULL;
+
+    *rtt_us = -1;
+    if (!broker_uri_host_port(uri, host, sizeof(host), &port_num)) {
+        return -1;
+    }
+    snprintf(port, sizeof(port), "%u", port_num);
+    // Resolution is not part of the round-trip time
+    if (getaddrinfo(host, port, &hints, &res) != 0 || res == NULL) {
+        return -1;
+    }
+    int fd = socket(res->ai_family, SOCK_STREAM, 0);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        *start_us = esp_timer_get_time();
+        if (connect(fd, res->ai_addr, res->ai_addrlen) == 0) {
+            *rtt_us = esp_timer_get_time() - *start_us;
+            close(fd);
+            fd = -1;
+        } else if (errno != EINPROGRESS) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+/*
+ * @brief Time a TCP connection to every candidate, all at once
+ *
+ * @return Number of brokers that answered
+ */
+static int probe_round(void)
+{
+    char uris[BROKER_SELECT_MAX][BROKER_URI_MAX];
+    int fds[BROKER_SELECT_MAX];
+    int64_t start_us[BROKER_SELECT_MAX];
+    int32_t rtt_us[BROKER_SELECT_MAX];
+    int pending = 0;
+    int answered = 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t count = s_select.count;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(uris[i], s_select.candidates[i].uri, BROKER_URI_MAX);
+    }
+    xSemaphoreGive(s_lock);
+
+    for (size_t i = 0; i < count; i++) {
+        fds[i] = probe_open(uris[i], &start_us[i], &rtt_us[i]);
+        pending += fds[i] >= 0;
+    }
+
+    // Handshakes complete in any order, each is timed when its socket becomes writable
+    int64_t deadline_us = esp_timer_get_time() + CONFIG_BROKER_PROBE_TIMEOUT_MS * 1000LL;
+    while (pending > 0) {
+        int64_t remaining_us = deadline_us - esp_timer_get_time();
+        if (remaining_us <= 0) {
+            break;
+        }
+        fd_set wfds;
+        int max_fd = -1;
+        FD_ZERO(&wfds);
+        for (size_t i = 0; i < count; i++) {
+            if (fds[i] >= 0) {
+                FD_SET(fds[i], &wfds);
+                max_fd = fds[i] > max_fd ? fds[i] : max_fd;
+            }
+        }
+        struct timeval tv = {.tv_sec = remaining_us / 1000000, .tv_usec = remaining_us % 1000000};
+        if (select(max_fd + 1, NULL, &wfds, NULL, &tv) <= 0) {
+            break;
+        }
+        int64_t now_us = esp_timer_get_time();
+        for (size_t i = 0; i < count; i++) {
+            if (fds[i] >= 0 && FD_ISSET(fds[i], &wfds)) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(fds[i], SOL_SOCKET, SO_ERROR, &err, &len);
+                rtt_us[i] = err == 0 ? now_us - start_us[i] : -1;
+                close(fds[i]);
+                fds[i] = -1;
+                pending--;
+            }
+        }
+    }
+    // Still connecting at the deadline: too slow to count as reachable
+    for (size_t i = 0; i < count; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (size_t i = 0; i < count && i < s_select.count; i++) {
+        // The primary may have been replaced while probing
+        if (strcmp(uris[i], s_select.candidates[i].uri) == 0) {
+            broker_select_probe_result(&s_select, i, rtt_us[i]);
+        }
+        answered += rtt_us[i] >= 0;
+    }
+    xSemaphoreGive(s_lock);
+    return answered;
+}
+
+/*
+ * @brief Select the best broker after a probe round, switching if it changed
+ */
+static void select_broker(int answered)
+{
+    char uri[BROKER_URI_MAX];
+
+    // Nobody answered: the network is down, not the brokers
+    if (answered == 0) {
+        ESP_LOGW(TAG, "No broker reachable");
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int best = broker_select_best(&s_select);
+    bool changed = best != s_select.current;
+    if (changed) {
+        broker_select_use(&s_select, best);
+        memcpy(uri, s_select.candidates[best].uri, sizeof(uri));
+        // Closing the current connection reports a loss that is not the new broker's
+        s_losses = s_connected ? -1 : 0;
+        s_switches++;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (changed) {
+        ESP_LOGI(TAG, "Switching to broker %d", best);
+        s_on_switch(best, uri);
+    }
+}
+
+void broker_failover_pick(void)
+{
+    select_broker(probe_round());
+}
+
+static void failover_task(void *arg)
+{
+    TickType_t period = CONFIG_BROKER_PROBE_INTERVAL_S > 0 ? pdMS_TO_TICKS(CONFIG_BROKER_PROBE_INTERVAL_S * 1000)
+                                                           : portMAX_DELAY;
+
+    while (1) {
+        // Periodic round, or at once after a lost connection
+        ulTaskNotifyTake(pdTRUE, period);
+        select_broker(probe_round());
+    }
+}
+
+/*
+ * @brief Metrics writer: current broker and the probe results, host and port only (no credentials)
+ */
+static int failover_metrics_writer(char *buf, size_t len, int64_t interval_us)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int n = snprintf(buf, len, "{\"current\":%d,\"switches\":%" PRIu32 ",\"brokers\":[",
+                     s_select.current, s_switches);
+    for (size_t i = 0; i < s_select.count && n >= 0 && (size_t)n < len; i++) {
+        const broker_candidate_t *c = &s_select.candidates[i];
+        char host[PROBE_HOST_MAX];
+        uint16_t port = 0;
+        if (!broker_uri_host_port(c->uri, host, sizeof(host), &port)) {
+            snprintf(host, sizeof(host), "?");
+        }
+        n += snprintf(buf + n, len - n,
+                      "%s{\"host\":\"%s:%u\",\"rtt_ms\":%.1f,\"last_rtt_ms\":%.1f,\"healthy\":%s}",
+                      i > 0 ? "," : "", host, port, c->rtt_us / 1000.0f, c->last_rtt_us / 1000.0f,
+                      broker_select_healthy(c) ? "true" : "false");
+    }
+    xSemaphoreGive(s_lock);
+    if (n >= 0 && (size_t)n < len) {
+        n += snprintf(buf + n, len - n, "]}");
+    }
+    return n;
+}
+
+esp_err_t broker_failover_start(void)
+{
+    if (!broker_failover_active()) {
+        return ESP_OK;
+    }
+    // Low priority: probes only add a little latency to decisions that are not urgent
+    if (xTaskCreate(failover_task, "broker_failover", FAILOVER_TASK_STACK, NULL, 3, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    app_metrics_register("failover", failover_metrics_writer);
+    return ESP_OK;
+}
+
+void broker_failover_set_primary(const char *uri)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    broker_select_set_primary(&s_select, uri);
+    s_losses = s_connected ? -1 : 0;
+    xSemaphoreGive(s_lock);
+}
+
+void broker_failover_connected(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_connected = true;
+    s_losses = 0;
+    broker_select_connected(&s_select);
+    xSemaphoreGive(s_lock);
+}
+
+void broker_failover_connection_lost(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_connected = false;
+    if (++s_losses >= LOSSES_BEFORE_REFUSED) {
+        broker_select_connection_failed(&s_select);
+    }
+    xSemaphoreGive(s_lock);
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * Broker failover
+ *
+ * The configured broker (broker_store.h) comes first in a list completed by
+ * CONFIG_BROKER_FALLBACK_URLS and by a broker found on the local network
+ * (broker_mdns.h), which is preferred. Every candidate is probed at startup and
+ * every CONFIG_BROKER_PROBE_INTERVAL_S by timing a TCP connection to it,
+ * all candidates at once, and the client is switched to the fastest healthy
+ * broker (broker_select.h). A lost connection triggers a probe round at
+ * once. Subscriptions are made again on every connection, so a switch
+ * needs nothing else.
+ *
+ * The current broker and the round-trip times are reported under
+ * "failover" on /esp32_metrics. With a single broker nothing runs.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * @brief Called to connect to another broker, from the probe task or broker_failover_pick()
+ *
+ * @param index Candidate index, 0 for the configured broker
+ * @param uri URI of the candidate; fallback brokers carry their credentials in it, if any
+ */
+typedef void (*broker_failover_switch_t)(int index, const char *uri);
+
+/*
+ * @brief Build the candidate list
+ *
+ * @param primary_uri URI of the configured broker
+ * @param on_switch Called whenever another broker is selected
+ */
+esp_err_t broker_failover_init(const char *primary_uri, broker_failover_switch_t on_switch);
+
+/*
+ * @brief true when there are several brokers to choose from
+ */
+bool broker_failover_active(void);
+
+/*
+ * @brief Add a candidate and make it current, e.g. a broker found on the local network
+ *
+ * Before broker_failover_pick(), which keeps it while it is healthy and no
+ * broker is faster by CONFIG_BROKER_SWITCH_MARGIN_MS.
+ */
+void broker_failover_prefer(const char *uri);
+
+/*
+ * @brief Probe every candidate now and select the fastest one, before the client starts
+ *
+ * Takes the longest round-trip time of the reachable brokers, at most
+ * CONFIG_BROKER_PROBE_TIMEOUT_MS.
+ */
+void broker_failover_pick(void);
+
+/*
+ * @brief Start the periodic probes, once the client is started
+ */
+esp_err_t broker_failover_start(void);
+
+/*
+ * @brief The configured broker changed, it becomes the current one
+ */
+void broker_failover_set_primary(const char *uri);
+
+/*
+ * @brief Report MQTT connections and disconnections of the client
+ */
+void broker_failover_connected(void);
+void broker_failover_connection_lost(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,67 @@
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "mdns.h"
+
+#include "broker_mdns.h"
+#include "broker_config.h"
+
+static const char *TAG = "broker_mdns";
+
+// Longest host name looked up, ".local" included
+#define MDNS_HOST_MAX 72
+
+/*
+ * @brief Address to connect to an mDNS answer: its IPv4 address, else its host name
+ *
+ * The host name resolves through lwIP's mDNS support, slower than an
+ * address announced along with the service.
+ */
+static bool result_host(const mdns_result_t *r, char *host, size_t len)
+{
+    for (const mdns_ip_addr_t *a = r->addr; a != NULL; a = a->next) {
+        if (a->addr.type == ESP_IPADDR_TYPE_V4) {
+            snprintf(host, len, IPSTR, IP2STR(&a->addr.u_addr.ip4));
+            return true;
+        }
+    }
+    if (r->hostname == NULL) {
+        return false;
+    }
+    int n = snprintf(host, len, "%s.local", r->hostname);
+    return n > 0 && (size_t)n < len;
+}
+
+esp_err_t broker_mdns_discover(char *uri, size_t len)
+{
+    mdns_result_t *results = NULL;
+    char host[MDNS_HOST_MAX];
+
+    esp_err_t err = mdns_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "mDNS not started: %s", esp_err_to_name(err));
+        return err;
+    }
+    // One answer is enough, the query returns as soon as it arrives
+    err = mdns_query_ptr("_mqtt", "_tcp", CONFIG_BROKER_MDNS_TIMEOUT_MS, 1, &results);
+    if (err == ESP_OK) {
+        err = ESP_ERR_NOT_FOUND;
+        for (const mdns_result_t *r = results; r != NULL; r = r->next) {
+            if (result_host(r, host, sizeof(host)) && broker_uri_build(uri, len, host, r->port)) {
+                ESP_LOGI(TAG, "Local broker \"%s\" at %s", r->instance_name ? r->instance_name : "", uri);
+                err = ESP_OK;
+                break;
+            }
+        }
+    }
+    if (err == ESP_ERR_NOT_FOUND) {
+        ESP_LOGI(TAG, "No local broker announced");
+    } else if (err != ESP_OK) {
+        ESP_LOGE(TAG, "mDNS query failed: %s", esp_err_to_name(err));
+    }
+    mdns_query_results_free(results);
+    // Nothing to answer for: no responder left running
+    mdns_free();
+    return err;
+}
@@ -0,0 +1,32 @@
+/*
+ * Discovery of a broker on the local network
+ *
+ * A broker announcing the _mqtt._tcp service with mDNS (e.g. mosquitto
+ * with an avahi service file) saves every message the trip to a public
+ * broker. It is looked up once the network is up, then handed to the
+ * failover (broker_failover.h) as the preferred broker, the configured one
+ * remaining as fallback.
+ */
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * @brief Look up a broker, waiting at most CONFIG_BROKER_MDNS_TIMEOUT_MS
+ *
+ * The first answer wins. The mDNS service only runs during the query.
+ *
+ * @param uri Filled with the broker URI, "mqtt://<address>:<port>"
+ * @param len Size of uri
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if no broker answered, or an mDNS error
+ */
+esp_err_t broker_mdns_discover(char *uri, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,121 @@
+#include <string.h>
+
+#include "broker_select.h"
+
+void broker_select_init(broker_select_t *s, int32_t margin_us)
+{
+    memset(s, 0, sizeof(*s));
+    s->margin_us = margin_us;
+}
+
+static void reset_candidate(broker_candidate_t *c, const char *uri, size_t len)
+{
+    memcpy(c->uri, uri, len);
+    c->uri[len] = '\0';
+    c->rtt_us = -1;
+    c->last_rtt_us = -1;
+    c->failures = 0;
+    c->refused = 0;
+}
+
+int broker_select_add(broker_select_t *s, const char *uri, size_t len)
+{
+    if (s->count >= BROKER_SELECT_MAX || !broker_uri_valid(uri, len)) {
+        return -1;
+    }
+    for (size_t i = 0; i < s->count; i++) {
+        if (strlen(s->candidates[i].uri) == len && strncmp(s->candidates[i].uri, uri, len) == 0) {
+            return -1;
+        }
+    }
+    reset_candidate(&s->candidates[s->count], uri, len);
+    return s->count++;
+}
+
+size_t broker_select_add_list(broker_select_t *s, const char *list)
+{
+    size_t added = 0;
+
+    while (*list != '\0') {
+        list += strspn(list, ", ");
+        size_t len = strcspn(list, ", ");
+        if (len > 0 && broker_select_add(s, list, len) >= 0) {
+            added++;
+        }
+        list += len;
+    }
+    return added;
+}
+
+void broker_select_set_primary(broker_select_t *s, const char *uri)
+{
+    size_t len = strnlen(uri, BROKER_URI_MAX - 1);
+
+    if (s->count == 0) {
+        s->count = 1;
+    }
+    reset_candidate(&s->candidates[0], uri, len);
+    s->current = 0;
+}
+
+void broker_select_probe_result(broker_select_t *s, int index, int32_t rtt_us)
+{
+    broker_candidate_t *c = &s->candidates[index];
+
+    c->last_rtt_us = rtt_us < 0 ? -1 : rtt_us;
+    if (rtt_us < 0) {
+        if (c->failures < 255) {
+            c->failures++;
+        }
+        return;
+    }
+    c->failures = 0;
+    if (c->refused > 0) {
+        c->refused--;
+    }
+    // Exponential average over about 4 probes, a single slow handshake does not cause a switch
+    c->rtt_us = c->rtt_us < 0 ? rtt_us : c->rtt_us + (rtt_us - c->rtt_us) / 4;
+}
+
+void broker_select_connection_failed(broker_select_t *s)
+{
+    s->candidates[s->current].refused = BROKER_SELECT_REFUSED_PROBES;
+}
+
+void broker_select_connected(broker_select_t *s)
+{
+    s->candidates[s->current].refused = 0;
+}
+
+bool broker_select_healthy(const broker_candidate_t *c)
+{
+    return c->failures < BROKER_SELECT_MAX_FAILURES && c->refused == 0 && c->rtt_us >= 0;
+}
+
+int broker_select_best(const broker_select_t *s)
+{
+    int best = -1;
+
+    for (size_t i = 0; i < s->count; i++) {
+        const broker_candidate_t *c = &s->candidates[i];
+        if (broker_select_healthy(c) && (best < 0 || c->rtt_us < s->candidates[best].rtt_us)) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return s->count > 0 ? (s->current + 1) % s->count : 0;
+    }
+
+    const broker_candidate_t *cur = &s->candidates[s->current];
+    if (broker_select_healthy(cur) && cur->rtt_us <= s->candidates[best].rtt_us + s->margin_us) {
+        return s->current;
+    }
+    return best;
+}
+
+void broker_select_use(broker_select_t *s, int index)
+{
+    if (index >= 0 && (size_t)index < s->count) {
+        s->current = index;
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ * Broker selection
+ *
+ * Hardware-independent part of the broker failover: the candidate brokers,
+ * their smoothed round-trip times from the probes (TCP connection set-up
+ * time) and their health, and the choice of the broker to connect to: the
+ * fastest healthy one, but the current broker is kept until another one is
+ * faster by a margin, so that close round-trip times do not make the
+ * client hop between brokers.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "broker_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BROKER_SELECT_MAX 4
+// Consecutive failed probes after which a broker is unhealthy
+#define BROKER_SELECT_MAX_FAILURES 2
+// Successful probes before a broker that dropped the MQTT connection is tried again
+#define BROKER_SELECT_REFUSED_PROBES 4
+
+typedef struct {
+    char uri[BROKER_URI_MAX];
+    int32_t rtt_us;             // Smoothed round-trip time, -1 before the first successful probe
+    int32_t last_rtt_us;        // Latest probe, -1 if it failed
+    uint8_t failures;           // Consecutive failed probes
+    uint8_t refused;            // Successful probes to wait after a failed MQTT connection
+} broker_candidate_t;
+
+typedef struct {
+    broker_candidate_t candidates[BROKER_SELECT_MAX];
+    size_t count;
+    int current;                // Candidate in use
+    int32_t margin_us;          // Advantage needed to leave a healthy current broker
+} broker_select_t;
+
+/*
+ * @brief Initialize an empty list, candidate 0 will be the current one
+ */
+void broker_select_init(broker_select_t *s, int32_t margin_us);
+
+/*
+ * @brief Add a candidate
+ *
+ * @return Its index, or -1 if the list is full, the URI invalid or already listed
+ */
+int broker_select_add(broker_select_t *s, const char *uri, size_t len);
+
+/*
+ * @brief Add the candidates of a comma- or space-separated list
+ *
+ * @return Number of candidates added, invalid entries are skipped
+ */
+size_t broker_select_add_list(broker_select_t *s, const char *list);
+
+/*
+ * @brief Replace candidate 0 (the configured broker) and make it current
+ */
+void broker_select_set_primary(broker_select_t *s, const char *uri);
+
+/*
+ * @brief Record a probe result
+ *
+ * @param rtt_us Connection set-up time, negative if the probe failed
+ */
+void broker_select_probe_result(broker_select_t *s, int index, int32_t rtt_us);
+
+/*
+ * @brief Record a lost or refused connection to the current broker
+ *
+ * A broker accepting TCP connections but not MQTT ones would pass the
+ * probes: it stays unhealthy for BROKER_SELECT_REFUSED_PROBES probes.
+ */
+void broker_select_connection_failed(broker_select_t *s);
+
+/*
+ * @brief Record a successful MQTT connection to the current broker
+ */
+void broker_select_connected(broker_select_t *s);
+
+bool broker_select_healthy(const broker_candidate_t *c);
+
+/*
+ * @brief Broker to connect to after the latest results
+ *
+ * The current broker while it is healthy and no healthy broker is faster by
+ * the margin; else the fastest healthy one. When none is healthy, the next
+ * candidate after the current one, so that every broker is retried in turn.
+ *
+ * @return Candidate index, to be made current with broker_select_use()
+ */
+int broker_select_best(const broker_select_t *s);
+
+void broker_select_use(broker_select_t *s, int index);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "broker_store.h"
+
+static const char *TAG = "broker_store";
+
+#define NVS_NAMESPACE "broker"
+
+/*
+ * @brief Read one string key, "" when it is missing
+ */
+static esp_err_t get_str(nvs_handle_t nvs, const char *key, char *out, size_t len)
+{
+    esp_err_t err = nvs_get_str(nvs, key, out, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        out[0] = '\0';
+        return ESP_OK;
+    }
+    return err;
+}
+
+static bool load_nvs(broker_config_t *cfg)
+{
+    nvs_handle_t nvs;
+
+    // A missing namespace means nothing was ever stored
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    esp_err_t err = get_str(nvs, "uri", cfg->uri, sizeof(cfg->uri));
+    if (err == ESP_OK) {
+        err = get_str(nvs, "user", cfg->username, sizeof(cfg->username));
+    }
+    if (err == ESP_OK) {
+        err = get_str(nvs, "pass", cfg->password, sizeof(cfg->password));
+    }
+    nvs_close(nvs);
+
+    if (err != ESP_OK || !broker_uri_valid(cfg->uri, strlen(cfg->uri))) {
+        if (err != ESP_OK || cfg->uri[0] != '\0') {
+            ESP_LOGW(TAG, "Ignoring stored broker settings: %s", esp_err_to_name(err));
+        }
+        return false;
+    }
+    return true;
+}
+
+static void load_kconfig(broker_config_t *cfg)
+{
+    snprintf(cfg->uri, sizeof(cfg->uri), "%s", CONFIG_BROKER_URL);
+    cfg->username[0] = '\0';
+    cfg->password[0] = '\0';
+}
+
+#if CONFIG_BROKER_URL_FROM_STDIN
+/*
+ * @brief Read the broker URL from the console until a valid one is entered or the time is up
+ *
+ * stdin does not block: characters are consumed as fast as they arrive and
+ * the task only sleeps while the input is empty.
+ *
+ * @param timeout Ticks to wait for, portMAX_DELAY for ever
+ * @return false if no valid URL was entered in time
+ */
+static bool read_stdin(broker_config_t *cfg, TickType_t timeout)
+{
+    TickType_t start = xTaskGetTickCount();
+    size_t count = 0;
+
+    for (;;) {
+        int c = fgetc(stdin);
+        if (c == EOF) {
+            if (timeout != portMAX_DELAY && xTaskGetTickCount() - start >= timeout) {
+                return false;
+            }
+            clearerr(stdin);
+            vTaskDelay(pdMS_TO_TICKS(10));
+        } else if (c == '\n' || c == '\r') {
+            cfg->uri[count] = '\0';
+            if (broker_uri_valid(cfg->uri, count)) {
+                break;
+            }
+            if (count > 0) {
+                printf("Invalid url \"%s\", expected mqtt://, mqtts://, ws:// or wss://\n", cfg->uri);
+            }
+            count = 0;
+        } else if (c > 0 && c < 127 && count < sizeof(cfg->uri) - 1) {
+            cfg->uri[count++] = c;
+        }
+    }
+    cfg->username[0] = '\0';
+    cfg->password[0] = '\0';
+    printf("Broker url: %s\n", cfg->uri);
+    return true;
+}
+
+static void load_stdin(broker_config_t *cfg)
+{
+    printf("Please enter url of mqtt broker\n");
+    read_stdin(cfg, portMAX_DELAY);
+}
+
+bool broker_store_read_console(broker_config_t *cfg, uint32_t timeout_ms)
+{
+    broker_config_t entered;
+
+    printf("Please enter url of mqtt broker within %" PRIu32 " s to replace %s\n", timeout_ms / 1000, cfg->uri);
+    if (!read_stdin(&entered, pdMS_TO_TICKS(timeout_ms))) {
+        return false;
+    }
+    *cfg = entered;
+    return true;
+}
+#endif /* CONFIG_BROKER_URL_FROM_STDIN */
+
+broker_source_t broker_store_load(broker_config_t *cfg)
+{
+    if (load_nvs(cfg)) {
+        return BROKER_SOURCE_NVS;
+    }
+#if CONFIG_BROKER_URL_FROM_STDIN
+    load_stdin(cfg);
+    // Failing to store only costs the console prompt at the next boot
+    esp_err_t err = broker_store_save(cfg);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Broker settings not stored: %s", esp_err_to_name(err));
+    }
+    return BROKER_SOURCE_STDIN;
+#else
+    load_kconfig(cfg);
+    return BROKER_SOURCE_KCONFIG;
+#endif
+}
+
+esp_err_t broker_store_save(const broker_config_t *cfg)
+{
+    nvs_handle_t nvs;
+
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_str(nvs, "uri", cfg->uri);
+    if (err == ESP_OK) {
+        err = nvs_set_str(nvs, "user", cfg->username);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_str(nvs, "pass", cfg->password);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+esp_err_t broker_store_erase(broker_config_t *cfg)
+{
+    nvs_handle_t nvs;
+
+    load_kconfig(cfg);
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_erase_all(nvs);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+const char *broker_source_name(broker_source_t source)
+{
+    switch (source) {
+    case BROKER_SOURCE_NVS:
+        return "nvs";
+    case BROKER_SOURCE_STDIN:
+        return "stdin";
+    default:
+        return "kconfig";
+    }
+}
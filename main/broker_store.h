@@ -0,0 +1,71 @@
+/*
+ * Broker settings persisted in NVS
+ *
+ * Provisioning happens once: the settings entered on the console
+ * (CONFIG_BROKER_URL = "FROM_STDIN") or received with the "broker" command
+ * are saved in NVS and used at every following boot without waiting for
+ * the console. Without stored settings the menuconfig ones apply.
+ *
+ * A FROM_STDIN build keeps reading the console for a while after booting
+ * with stored settings (CONFIG_BROKER_STDIN_WINDOW_S): a URL typed then
+ * replaces them, so the device can be provisioned again without erasing
+ * the flash.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include "broker_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    BROKER_SOURCE_NVS,
+    BROKER_SOURCE_KCONFIG,
+    BROKER_SOURCE_STDIN,
+} broker_source_t;
+
+/*
+ * @brief Settings to connect with at boot
+ *
+ * The stored settings, else the menuconfig URL, else a URL read from the
+ * console, saved for the next boots. Needs nvs_flash_init().
+ *
+ * @param cfg Filled with the settings
+ * @return Where the settings come from
+ */
+broker_source_t broker_store_load(broker_config_t *cfg);
+
+/*
+ * @brief Read a broker URL typed on the console, giving up after a while
+ *
+ * Blocks the calling task until a valid URL is entered or the time is up.
+ * Nothing is stored, see broker_store_save(). Only in FROM_STDIN builds.
+ *
+ * @param cfg Settings in use, replaced by the URL entered, credentials cleared
+ * @param timeout_ms How long to wait for a URL
+ * @return true if a URL was entered, cfg then holds it
+ */
+bool broker_store_read_console(broker_config_t *cfg, uint32_t timeout_ms);
+
+/*
+ * @brief Persist settings for the next boots
+ */
+esp_err_t broker_store_save(const broker_config_t *cfg);
+
+/*
+ * @brief Forget the stored settings, the menuconfig ones apply at the next connection
+ *
+ * @param cfg Filled with the menuconfig settings
+ */
+esp_err_t broker_store_erase(broker_config_t *cfg);
+
+/*
+ * @brief Name of a settings source for logs and metrics, e.g. "nvs"
+ */
+const char *broker_source_name(broker_source_t source);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,81 @@
+#include "button_gesture.h"
+
+void button_gesture_init(button_gesture_t *g, int64_t long_press_us, int64_t double_press_us)
+{
+    g->long_press_us = long_press_us;
+    g->double_press_us = double_press_us;
+    g->state = BUTTON_STATE_IDLE;
+    g->deadline_us = INT64_MAX;
+}
+
+static void enter(button_gesture_t *g, button_state_t state, int64_t deadline_us)
+{
+    g->state = state;
+    g->deadline_us = deadline_us;
+}
+
+uint32_t button_gesture_edge(button_gesture_t *g, bool pressed, int64_t t_us)
+{
+    // A deadline that expired before this edge is handled first
+    uint32_t gestures = button_gesture_poll(g, t_us);
+
+    switch (g->state) {
+    case BUTTON_STATE_IDLE:
+        if (pressed) {
+            enter(g, BUTTON_STATE_PRESSED, t_us + g->long_press_us);
+        }
+        break;
+    case BUTTON_STATE_PRESSED:
+        if (!pressed) {
+            gestures |= BUTTON_GESTURE_RELEASE;
+            if (g->double_press_us > 0) {
+                enter(g, BUTTON_STATE_WAIT_SECOND, t_us + g->double_press_us);
+            } else {
+                gestures |= BUTTON_GESTURE_SHORT_PRESS;
+                enter(g, BUTTON_STATE_IDLE, INT64_MAX);
+            }
+        }
+        break;
+    case BUTTON_STATE_WAIT_SECOND:
+        if (pressed) {
+            // Reported on the second press itself, no need to wait for its release
+            gestures |= BUTTON_GESTURE_DOUBLE_PRESS;
+            enter(g, BUTTON_STATE_SECOND_PRESSED, INT64_MAX);
+        }
+        break;
+    case BUTTON_STATE_LONG_HELD:
+    case BUTTON_STATE_SECOND_PRESSED:
+        if (!pressed) {
+            gestures |= BUTTON_GESTURE_RELEASE;
+            enter(g, BUTTON_STATE_IDLE, INT64_MAX);
+        }
+        break;
+    }
+    return gestures;
+}
+
+uint32_t button_gesture_poll(button_gesture_t *g, int64_t now_us)
+{
+    if (now_us < g->deadline_us) {
+        return BUTTON_GESTURE_NONE;
+    }
+
+    switch (g->state) {
+    case BUTTON_STATE_PRESSED:
+        // Still held when the long press threshold expired
+        enter(g, BUTTON_STATE_LONG_HELD, INT64_MAX);
+        return BUTTON_GESTURE_LONG_PRESS;
+    case BUTTON_STATE_WAIT_SECOND:
+        // No second press in the window: it was a single short press
+        enter(g, BUTTON_STATE_IDLE, INT64_MAX);
+        return BUTTON_GESTURE_SHORT_PRESS;
+    default:
+        g->deadline_us = INT64_MAX;
+        return BUTTON_GESTURE_NONE;
+    }
+}
+
+int64_t button_gesture_deadline(const button_gesture_t *g)
+{
+    return g->deadline_us;
+}
@@ -0,0 +1,85 @@
+/*
+ * Button gesture recognition
+ *
+ * Timestamp-driven state machine classifying the debounced edges of the
+ * button into short press, long press, double press and release. It is
+ * only fed on edges and on its own deadline, so it costs nothing while the
+ * button is idle.
+ *
+ *  - long press: held for at least long_press_us, reported while still held
+ *  - double press: second press starting within double_press_us of the first release
+ *  - short press: released before long_press_us and no second press followed
+ *    (reported once the double press window closed, or on release when it is 0)
+ *  - release: every release of the button
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Gestures are returned as a bit mask, one step can complete several of them
+#define BUTTON_GESTURE_NONE         0
+#define BUTTON_GESTURE_SHORT_PRESS  (1 << 0)
+#define BUTTON_GESTURE_LONG_PRESS   (1 << 1)
+#define BUTTON_GESTURE_DOUBLE_PRESS (1 << 2)
+#define BUTTON_GESTURE_RELEASE      (1 << 3)
+
+typedef enum {
+    BUTTON_STATE_IDLE,
+    BUTTON_STATE_PRESSED,           // First press down, long press not reached yet
+    BUTTON_STATE_LONG_HELD,         // Long press reported, waiting for release
+    BUTTON_STATE_WAIT_SECOND,       // Released after a short press, double press window open
+    BUTTON_STATE_SECOND_PRESSED,    // Double press reported, waiting for release
+} button_state_t;
+
+typedef struct {
+    int64_t long_press_us;
+    int64_t double_press_us;
+    button_state_t state;
+    int64_t deadline_us;            // INT64_MAX when no timeout is pending
+} button_gesture_t;
+
+/*
+ * @brief Initialize the state machine
+ *
+ * @param g State machine
+ * @param long_press_us Hold time of a long press
+ * @param double_press_us Maximum gap between release and second press, 0 disables double press
+ */
+void button_gesture_init(button_gesture_t *g, int64_t long_press_us, int64_t double_press_us);
+
+/*
+ * @brief Feed a debounced button edge
+ *
+ * @param g State machine
+ * @param pressed New button state
+ * @param t_us Time of the edge in microseconds
+ * @return Mask of BUTTON_GESTURE_* completed by this edge
+ */
+uint32_t button_gesture_edge(button_gesture_t *g, bool pressed, int64_t t_us);
+
+/*
+ * @brief Process an expired deadline
+ *
+ * Safe to call at any time, does nothing before the deadline.
+ *
+ * @param g State machine
+ * @param now_us Current time in microseconds
+ * @return Mask of BUTTON_GESTURE_* completed by the timeout
+ */
+uint32_t button_gesture_poll(button_gesture_t *g, int64_t now_us);
+
+/*
+ * @brief Time at which button_gesture_poll() must be called next
+ *
+ * @return Deadline in microseconds, INT64_MAX when idle
+ */
+int64_t button_gesture_deadline(const button_gesture_t *g);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,863 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include "conversation.h"
+#include "llm_client.h"
+#include "app_metrics.h"
+#include "prio_sched.h"
+#include "spsc_ring.h"
+#include "mqtt_publisher.h"
+#include "slab_pool.h"
+#include "multipart.h"
+#include "lzss.h"
+#include "session_table.h"
+#include "app_topics.h"
+#include "app_boot.h"
+
+static const char *TAG = "conversation";
+
+// Pending requests per priority class, see prio_sched.h
+#define USER_INPUT_SLOTS 2
+#define COMMAND_SLOTS 2
+// /client_gpt replies, power of two; each one takes its length plus a few bytes
+#define REPLY_RING_SIZE 2048
+// Turns waiting for a worker in each session
+#define SESSION_QUEUE_DEPTH 2
+#define DISPATCHER_TASK_STACK 4096
+#define WORKER_TASK_STACK 8192
+// Longest wait for room in the publish queue between two parts of an answer
+#define ANSWER_PART_TIMEOUT_MS 1000
+
+_Static_assert(MULTIPART_HEADER_LEN + CONFIG_MULTIPART_CHUNK_SIZE <= CONFIG_PUBLISH_QUEUE_SLOT_SIZE,
+               "CONFIG_MULTIPART_CHUNK_SIZE must leave room for the part header in a publish queue slot");
+_Static_assert(CONFIG_CONVERSATION_SESSIONS <= SESSION_TABLE_MAX, "Too many conversation sessions");
+_Static_assert(TOPIC_NS_BASE_MAX + sizeof("/esp_gpt_out/") + SESSION_NAME_MAX <= MQTT_PUBLISHER_TOPIC_MAX,
+               "Session topics must fit the publish queue");
+
+typedef struct {
+    conversation_request_t type;
+    uint32_t generation;            // Cancel generation of the default session when the request was posted
+    int64_t posted_us;
+} conversation_msg_t;
+
+// Requests are taken by priority: a button press never waits behind /client_gpt replies
+static prio_sched_t s_sched;
+static conversation_msg_t s_user_input_slots[USER_INPUT_SLOTS];
+static conversation_msg_t s_command_slots[COMMAND_SLOTS];
+static SemaphoreHandle_t s_sched_lock = NULL;
+static TaskHandle_t s_task = NULL;          // Dispatcher
+// Longest time a request waited before a worker took it, per class, since the last metrics report
+static int64_t s_wait_max_us[PRIO_CLASS_COUNT];
+
+/*
+ * Replies are the lowest priority class. They are written by the MQTT task
+ * straight into this ring, fragment by fragment, and moved by the
+ * dispatcher into a message buffer of their session.
+ */
+typedef struct {
+    uint32_t generation;            // Cancel generation of the default session when the reply arrived, for its replies
+    uint32_t correlation;           // Answer the reply responds to, 0 if unknown
+    int64_t posted_us;
+    char session[SESSION_NAME_MAX + 1];
+    int len;
+    char text[];                    // NUL-terminated
+} reply_hdr_t;
+
+static spsc_ring_t s_replies;
+static uint32_t s_reply_buf[REPLY_RING_SIZE / 4];
+static reply_hdr_t *s_reply_open = NULL;    // Reply being received, MQTT task only
+static int s_reply_cap = 0;
+static uint32_t s_replies_dropped = 0;
+static uint32_t s_replies_stale = 0;
+// Id of the last answer published by any session, also its multipart message id
+static uint32_t s_answer_seq = 0;
+
+// Answers published since the last metrics report: bytes before and after compression
+static struct {
+    uint32_t raw;
+    uint32_t sent;
+    int64_t compress_us;
+} s_tx;
+
+/*
+ * Work of one session, handed to the workers by the session table: a
+ * button request, a command or a reply to answer.
+ */
+typedef enum {
+    JOB_START,
+    JOB_RESET,
+    JOB_REPLY,
+} job_type_t;
+
+typedef struct {
+    job_type_t type;
+    prio_class_t cls;
+    uint32_t generation;            // Cancel generation of its session
+    uint32_t correlation;
+    int64_t posted_us;
+    char *text;                     // Reply in a message buffer, owned by the job; NULL otherwise
+} job_t;
+
+// Conversation history sent with every request, bounded by CONFIG_CONVERSATION_MAX_TURNS
+#define HISTORY_MAX_MESSAGES (2 * CONFIG_CONVERSATION_MAX_TURNS + 1)
+
+/*
+ * State of one session, indexed like the session table. Only touched by the
+ * worker that took the session, or by the dispatcher while it is idle.
+ */
+typedef struct {
+    llm_message_t history[HISTORY_MAX_MESSAGES];
+    size_t history_len;
+    uint32_t answer_id;             // Id of the last answer published
+    // Token of this session only: cancelling the default session leaves the others' requests running
+    llm_cancel_t cancel;
+    char answer_topic[MQTT_PUBLISHER_TOPIC_MAX];
+    char reply_topic[MQTT_PUBLISHER_TOPIC_MAX];
+    // Since the last metrics report, approximate by design
+    uint32_t turns;
+    int64_t latency_last_us;        // Reply received to answer published
+    int64_t latency_max_us;
+} session_t;
+
+static session_table_t s_table;
+static job_t s_jobs[CONFIG_CONVERSATION_SESSIONS * SESSION_QUEUE_DEPTH];
+static SemaphoreHandle_t s_table_lock = NULL;
+static SemaphoreHandle_t s_work = NULL;     // Given for every job posted, workers wait on it
+static session_t s_sessions[CONFIG_CONVERSATION_SESSIONS];
+// Slot of the default session, driven by the button and /esp32_commands; opened at start and never evicted
+static int s_default = -1;
+
+/*
+ * Each worker publishes its answers part by part with its own buffers, as
+ * the answer is decoded: one chunk of it is in RAM, never the whole answer.
+ */
+typedef struct {
+    int session;                    // Session being served
+    char chunk[CONFIG_MULTIPART_CHUNK_SIZE];    // Answer text not published yet
+    size_t chunk_len;
+    uint8_t part[MULTIPART_HEADER_LEN + CONFIG_MULTIPART_CHUNK_SIZE];
+    multipart_writer_t mw;
+    bool answer_open;               // First part of the answer published, or about to be
+    bool answer_failed;             // A part could not be published, the rest is dropped
+    size_t answer_len;
+    size_t answer_sent;
+#if CONFIG_PAYLOAD_COMPRESSION
+    lzss_encoder_t lzss;
+#endif
+} worker_t;
+
+static worker_t s_workers[CONFIG_CONVERSATION_WORKERS];
+
+// HTTPS connections to OpenAI open at once: each one holds a TLS session in RAM
+static SemaphoreHandle_t s_conn_slots = NULL;
+static int64_t s_conn_wait_max_us = 0;
+
+/*
+ * History messages live in fixed-size buffers taken from one block shared
+ * by every session: turns come and go without fragmenting the heap.
+ */
+_Static_assert(CONFIG_MSG_POOL_BUF_SIZE > CONVERSATION_MAX_TEXT_LEN,
+               "CONFIG_MSG_POOL_BUF_SIZE must hold a whole message");
+#define MSG_POOL_STORAGE_SIZE SLAB_POOL_STORAGE_SIZE(CONFIG_MSG_POOL_COUNT, CONFIG_MSG_POOL_BUF_SIZE)
+static slab_pool_t s_msg_pool;
+static SemaphoreHandle_t s_msg_pool_lock = NULL;
+#if CONFIG_MSG_POOL_IN_PSRAM
+static uint8_t *s_msg_pool_storage = NULL;
+#else
+static uint8_t s_msg_pool_storage[MSG_POOL_STORAGE_SIZE] __attribute__((aligned(8)));
+#endif
+
+static char *msg_alloc(void)
+{
+    xSemaphoreTake(s_msg_pool_lock, portMAX_DELAY);
+    char *buf = slab_pool_alloc(&s_msg_pool);
+    xSemaphoreGive(s_msg_pool_lock);
+    return buf;
+}
+
+static void msg_free(void *buf)
+{
+    xSemaphoreTake(s_msg_pool_lock, portMAX_DELAY);
+    slab_pool_free(&s_msg_pool, buf);
+    xSemaphoreGive(s_msg_pool_lock);
+}
+
+static size_t msg_available(void)
+{
+    xSemaphoreTake(s_msg_pool_lock, portMAX_DELAY);
+    size_t n = slab_pool_available(&s_msg_pool);
+    xSemaphoreGive(s_msg_pool_lock);
+    return n;
+}
+
+/*
+ * @brief Forget the history of a session
+ */
+static void conversation_clear(session_t *s)
+{
+    for (size_t i = 0; i < s->history_len; i++) {
+        msg_free((void *)s->history[i].content);
+    }
+    s->history_len = 0;
+}
+
+/*
+ * @brief Drop the last message, whose turn did not complete
+ */
+static void history_drop_last(session_t *s)
+{
+    s->history_len--;
+    msg_free((void *)s->history[s->history_len].content);
+}
+
+/*
+ * @brief Append a message already in a pool buffer, the history takes ownership
+ */
+static void history_push(session_t *s, const char *role, char *content)
+{
+    s->history[s->history_len].role = role;
+    s->history[s->history_len].content = content;
+    s->history_len++;
+}
+
+#if CONFIG_PAYLOAD_COMPRESSION
+/*
+ * @brief Compressed size of one chunk, compression pays off when below len
+ */
+static size_t compressed_len(worker_t *w, const char *chunk, size_t len)
+{
+    int64_t start_us = esp_timer_get_time();
+    if (!lzss_encoder_init(&w->lzss, chunk, len)) {
+        return len;
+    }
+    // Counted without output: the stream is produced again into the part if it is kept
+    size_t packed = lzss_encode(&w->lzss, NULL, SIZE_MAX);
+    s_tx.compress_us += esp_timer_get_time() - start_us;
+    return packed;
+}
+#endif
+
+/*
+ * @brief Publish the chunk of the answer gathered so far as its next part
+ */
+static void publish_part(worker_t *w, bool last)
+{
+    session_t *s = &s_sessions[w->session];
+    size_t payload_len = w->chunk_len;
+    uint8_t flags = last ? MULTIPART_FLAG_LAST : 0;
+
+    if (w->answer_failed) {
+        return;
+    }
+#if CONFIG_PAYLOAD_COMPRESSION
+    // Each part compressed on its own, kept plain when that does not pay off
+    size_t packed = compressed_len(w, w->chunk, w->chunk_len);
+    if (packed < w->chunk_len) {
+        lzss_encoder_init(&w->lzss, w->chunk, w->chunk_len);
+        lzss_encode(&w->lzss, w->part + MULTIPART_HEADER_LEN, packed);
+        payload_len = packed;
+        flags |= MULTIPART_FLAG_LZSS;
+    } else
+#endif
+    {
+        memcpy(w->part + MULTIPART_HEADER_LEN, w->chunk, w->chunk_len);
+    }
+    if (!multipart_writer_next(&w->mw, w->part, flags)) {
+        ESP_LOGE(TAG, "Answer %" PRIu32 " too long to publish, rest dropped", s->answer_id);
+        w->answer_failed = true;
+        return;
+    }
+
+    // MQTT 5: the reply on the session's reply topic echoes the answer id, and a reply nobody took in time expires
+    const mqtt_publisher_props_t props = {
+        .correlation = s->answer_id,
+        .response_topic = s->reply_topic,
+#if CONFIG_MQTT_PROTOCOL_5
+        .expiry_s = CONFIG_MQTT5_MESSAGE_EXPIRY_S,
+#endif
+    };
+    if (!mqtt_publisher_publish_wait(s->answer_topic, (const char *)w->part, MULTIPART_HEADER_LEN + payload_len,
+                                     app_topic_qos(APP_TOPIC_GPT_OUT), 0, &props,
+                                     pdMS_TO_TICKS(ANSWER_PART_TIMEOUT_MS))) {
+        // The receiver drops the incomplete message
+        ESP_LOGW(TAG, "Publish queue full, answer %" PRIu32 " incomplete", s->answer_id);
+        w->answer_failed = true;
+        return;
+    }
+    w->answer_sent += payload_len;
+    w->chunk_len = 0;
+}
+
+/*
+ * @brief llm_client answer callback: publish the answer to the session's answer topic as it arrives
+ *
+ * A part goes out every CONFIG_MULTIPART_CHUNK_SIZE bytes of answer, once
+ * more text follows it; the last one is flagged when the answer is complete.
+ * An answer cut short by a failed or cancelled request never gets its last
+ * part, the receiver drops it.
+ */
+static void publish_answer(const char *data, size_t len, bool last, void *ctx)
+{
+    worker_t *w = ctx;
+    session_t *s = &s_sessions[w->session];
+
+    if (!w->answer_open) {
+        s->answer_id = __atomic_add_fetch(&s_answer_seq, 1, __ATOMIC_RELAXED);
+        multipart_writer_init(&w->mw, s->answer_id);
+        w->answer_open = true;
+    }
+    w->answer_len += len;
+    while (len > 0) {
+        if (w->chunk_len == sizeof(w->chunk)) {
+            publish_part(w, false);
+            // Dropped with the rest of the answer when it failed
+            w->chunk_len = 0;
+        }
+        size_t n = sizeof(w->chunk) - w->chunk_len;
+        n = len < n ? len : n;
+        memcpy(w->chunk + w->chunk_len, data, n);
+        w->chunk_len += n;
+        data += n;
+        len -= n;
+    }
+    if (!last) {
+        return;
+    }
+
+    publish_part(w, true);
+    if (w->answer_failed) {
+        return;
+    }
+    s_tx.raw += w->answer_len;
+    s_tx.sent += w->answer_sent;
+    ESP_LOGI(TAG, "Published ChatGPT response to %s (%u bytes, %u sent in %u parts)",
+             s->answer_topic, (unsigned)w->answer_len, (unsigned)w->answer_sent, (unsigned)w->mw.part);
+}
+
+/*
+ * @brief Send one message of a session to OpenAI and publish the answer
+ *
+ * @param text Prompt in a message buffer, taken over by the history
+ */
+static void conversation_ask(worker_t *w, char *text, const job_t *job)
+{
+    session_t *s = &s_sessions[w->session];
+
+    // Bound the history sent with each request, also leaves room (and a buffer) for this turn
+    if (s->history_len + 2 > HISTORY_MAX_MESSAGES || msg_available() < 1) {
+        ESP_LOGI(TAG, "History reached %d messages, starting over", (int)s->history_len);
+        conversation_clear(s);
+    }
+
+    char *answer = msg_alloc();
+    if (answer == NULL) {
+        // Buffers held by other sessions, counted in the pool statistics
+        ESP_LOGE(TAG, "No free message buffer");
+        msg_free(text);
+        return;
+    }
+    history_push(s, "user", text);
+
+    ESP_LOGI(TAG, "Sending prompt to OpenAI: %s", text);
+
+    // Bounded number of connections: a worker past the limit waits for one to close
+    int64_t wait_start_us = esp_timer_get_time();
+    xSemaphoreTake(s_conn_slots, portMAX_DELAY);
+    int64_t conn_wait_us = esp_timer_get_time() - wait_start_us;
+    if (conn_wait_us > s_conn_wait_max_us) {
+        s_conn_wait_max_us = conn_wait_us;
+    }
+
+    // Published in full as it arrives; written truncated straight into its history buffer, kept there if the turn completes
+    w->answer_open = false;
+    w->answer_failed = false;
+    w->chunk_len = 0;
+    w->answer_len = 0;
+    w->answer_sent = 0;
+    esp_err_t err = llm_client_chat(s->history, s->history_len, &s->cancel, job->generation,
+                                    answer, CONVERSATION_MAX_TEXT_LEN + 1, publish_answer, w);
+    xSemaphoreGive(s_conn_slots);
+    if (err != ESP_OK) {
+        // No answer: drop the prompt so the history stays a sequence of complete turns
+        msg_free(answer);
+        history_drop_last(s);
+        return;
+    }
+    history_push(s, "assistant", answer);
+    ESP_LOGI(TAG, "Response: %s", answer);
+
+    int64_t latency_us = esp_timer_get_time() - job->posted_us;
+    s->turns++;
+    s->latency_last_us = latency_us;
+    if (latency_us > s->latency_max_us) {
+        s->latency_max_us = latency_us;
+    }
+}
+
+/*
+ * @brief Handle one job of the session taken by the worker
+ */
+static void conversation_handle(worker_t *w, job_t *job)
+{
+    session_t *s = &s_sessions[w->session];
+    char *text = job->text;
+
+    int64_t wait_us = esp_timer_get_time() - job->posted_us;
+    if (wait_us > s_wait_max_us[job->cls]) {
+        s_wait_max_us[job->cls] = wait_us;
+    }
+    // Posted before a cancel of its session: belongs to a discussion that is over
+    if (job->generation != s->cancel.generation) {
+        msg_free(text);
+        return;
+    }
+
+    switch (job->type) {
+    case JOB_START:
+        // A button press always starts a new discussion
+        conversation_clear(s);
+        text = msg_alloc();
+        if (text == NULL) {
+            ESP_LOGE(TAG, "No free message buffer");
+            return;
+        }
+        snprintf(text, CONVERSATION_MAX_TEXT_LEN + 1, "%s", CONFIG_INITIAL_PROMPT);
+        conversation_ask(w, text, job);
+        break;
+    case JOB_RESET:
+        conversation_clear(s);
+        ESP_LOGI(TAG, "Conversation history cleared");
+        break;
+    case JOB_REPLY:
+        // Responds to an earlier answer than the last one: another answer went out since
+        if (job->correlation != 0 && job->correlation != s->answer_id) {
+            s_replies_stale++;
+            ESP_LOGW(TAG, "Reply to answer %" PRIu32 " dropped, last answer is %" PRIu32,
+                     job->correlation, s->answer_id);
+            msg_free(text);
+            return;
+        }
+        ESP_LOGI(TAG, "Received ChatGPT response from Rust client: %s", text);
+        conversation_ask(w, text, job);
+        break;
+    }
+}
+
+static void worker_task(void *arg)
+{
+    worker_t *w = arg;
+    job_t job;
+
+    // Started during the network association: requests posted meanwhile wait on their session
+    app_boot_wait(APP_BOOT_NETWORK_UP);
+
+    while (1) {
+        // Given once per job; may find the job's session taken by another worker, which then serves it
+        xSemaphoreTake(s_work, portMAX_DELAY);
+        while (1) {
+            xSemaphoreTake(s_table_lock, portMAX_DELAY);
+            bool found = session_table_take(&s_table, &w->session, &job);
+            xSemaphoreGive(s_table_lock);
+            if (!found) {
+                break;
+            }
+
+            conversation_handle(w, &job);
+
+            xSemaphoreTake(s_table_lock, portMAX_DELAY);
+            session_table_done(&s_table, w->session);
+            xSemaphoreGive(s_table_lock);
+        }
+    }
+}
+
+/*
+ * @brief Set up the state of a session taken into a free or evicted slot
+ *
+ * Called with the table lock held, or before the workers start: nobody else touches the slot.
+ */
+static void session_setup(int i, const char *name)
+{
+    session_t *s = &s_sessions[i];
+
+    conversation_clear(s);
+    memset(s, 0, sizeof(*s));
+    if (name[0] == '\0') {
+        strcpy(s->answer_topic, app_topic(APP_TOPIC_GPT_OUT));
+        strcpy(s->reply_topic, app_topic(APP_TOPIC_CLIENT_GPT));
+    } else {
+        snprintf(s->answer_topic, sizeof(s->answer_topic), "%s/%s", app_topic(APP_TOPIC_GPT_OUT), name);
+        snprintf(s->reply_topic, sizeof(s->reply_topic), "%s/%s", app_topic(APP_TOPIC_CLIENT_GPT), name);
+    }
+    ESP_LOGI(TAG, "Session \"%s\" opened in slot %d", name, i);
+}
+
+/*
+ * @brief Queue a job for a session, creating the session on its first job
+ *
+ * A job of the default session carries the generation it was posted in;
+ * the other sessions are never cancelled, their jobs take the current
+ * generation of their session.
+ *
+ * @return false if the job was posted before the last cancel, or the session
+ *         table or the session's queue is full; the job is not queued
+ */
+static bool dispatch(const char *name, job_t *job)
+{
+    bool created;
+
+    xSemaphoreTake(s_table_lock, portMAX_DELAY);
+    // Checked under the lock: a cancel either sees the job in its purge or the job sees the cancel
+    if (name[0] == '\0' && job->generation != s_sessions[s_default].cancel.generation) {
+        xSemaphoreGive(s_table_lock);
+        return false;
+    }
+    int i = session_table_open(&s_table, name, strlen(name), &created);
+    if (i >= 0 && created) {
+        // Slot of an idle session, or never used
+        session_setup(i, name);
+    }
+    if (i >= 0 && name[0] != '\0') {
+        job->generation = s_sessions[i].cancel.generation;
+    }
+    bool queued = i >= 0 && session_table_post(&s_table, i, job);
+    xSemaphoreGive(s_table_lock);
+
+    if (queued) {
+        xSemaphoreGive(s_work);
+    } else {
+        if (i < 0) {
+            ESP_LOGW(TAG, "Every session is busy, job for \"%s\" dropped", name);
+        } else {
+            ESP_LOGW(TAG, "Session \"%s\" has too many pending turns, job dropped", name);
+        }
+    }
+    return queued;
+}
+
+/*
+ * @brief Move a reply out of the ring into a message buffer and queue it for its session
+ */
+static void conversation_dispatch_reply(const reply_hdr_t *reply)
+{
+    job_t job = {
+        .type = JOB_REPLY,
+        .cls = PRIO_CLASS_CONTINUATION,
+        .generation = reply->generation,
+        .correlation = reply->correlation,
+        .posted_us = reply->posted_us,
+    };
+    // Arrived before the last cancel of the default session: belongs to a discussion that is over
+    if (reply->session[0] == '\0' && reply->generation != s_sessions[s_default].cancel.generation) {
+        return;
+    }
+
+    char *text = msg_alloc();
+    if (text == NULL) {
+        s_replies_dropped++;
+        ESP_LOGW(TAG, "No free message buffer, reply dropped");
+        return;
+    }
+
+    // Plain text, or a single part saying how its content is encoded
+    multipart_header_t hdr;
+    size_t n;
+    if (multipart_read_header((const uint8_t *)reply->text, reply->len, &hdr)) {
+        const uint8_t *payload = (const uint8_t *)reply->text + MULTIPART_HEADER_LEN;
+        size_t payload_len = reply->len - MULTIPART_HEADER_LEN;
+
+        if (hdr.part != 0 || !(hdr.flags & MULTIPART_FLAG_LAST)) {
+            ESP_LOGW(TAG, "Part %u of a reply, only single-part replies are supported", hdr.part);
+            msg_free(text);
+            return;
+        }
+        if (hdr.flags & MULTIPART_FLAG_LZSS) {
+            n = lzss_decode(payload, payload_len, (uint8_t *)text, CONVERSATION_MAX_TEXT_LEN);
+            if (n == LZSS_ERROR) {
+                ESP_LOGW(TAG, "Corrupt or truncated compressed reply dropped");
+                msg_free(text);
+                return;
+            }
+        } else {
+            n = payload_len < CONVERSATION_MAX_TEXT_LEN ? payload_len : CONVERSATION_MAX_TEXT_LEN;
+            memcpy(text, payload, n);
+        }
+    } else {
+        n = reply->len < CONVERSATION_MAX_TEXT_LEN ? reply->len : CONVERSATION_MAX_TEXT_LEN;
+        memcpy(text, reply->text, n);
+    }
+    text[n] = '\0';
+
+    job.text = text;
+    if (!dispatch(reply->session, &job)) {
+        s_replies_dropped++;
+        msg_free(text);
+    }
+}
+
+/*
+ * @brief Dispatcher: hands requests and replies to the sessions in priority order
+ *
+ * Never blocks on HTTPS, the workers do.
+ */
+static void conversation_task(void *arg)
+{
+    conversation_msg_t msg;
+
+    while (1) {
+        prio_class_t cls;
+        xSemaphoreTake(s_sched_lock, portMAX_DELAY);
+        bool found = prio_sched_pop(&s_sched, &msg, &cls);
+        xSemaphoreGive(s_sched_lock);
+        if (!found) {
+            // No button input nor command: the oldest reply, read in place
+            size_t len;
+            const reply_hdr_t *reply = spsc_ring_peek(&s_replies, &len);
+            if (reply != NULL) {
+                conversation_dispatch_reply(reply);
+                spsc_ring_release(&s_replies);
+            } else {
+                // Woken by conversation_post() and conversation_reply_fragment()
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            }
+            continue;
+        }
+
+        // Posted before a cancel that came after it was dequeued
+        if (msg.generation != s_sessions[s_default].cancel.generation) {
+            continue;
+        }
+
+        // The button and the commands drive the default session
+        job_t job = {
+            .type = msg.type == CONVERSATION_START ? JOB_START : JOB_RESET,
+            .cls = cls,
+            .generation = msg.generation,
+            .posted_us = msg.posted_us,
+        };
+        dispatch("", &job);
+    }
+}
+
+/*
+ * @brief Metrics writer: request counters, time from cancel to freed connection and per-session latency
+ */
+static int conversation_metrics_writer(char *buf, size_t len, int64_t interval_us)
+{
+    llm_client_stats_t stats;
+    llm_client_get_stats(&stats);
+    int n = snprintf(buf, len,
+                     "{\"requests\":%" PRIu32 ",\"cancelled\":%" PRIu32 ",\"errors\":%" PRIu32
+                     ",\"cancel_to_free_us\":%" PRId64 ",\"max_cancel_to_free_us\":%" PRId64
+                     ",\"heap_delta\":%" PRId32 ",\"wait_max_us\":[%" PRId64 ",%" PRId64 ",%" PRId64 "]"
+                     ",\"replies_dropped\":%" PRIu32 ",\"replies_stale\":%" PRIu32
+                     ",\"msg_pool\":{\"in_use\":%" PRIu32 ",\"high_water\":%" PRIu32 ",\"exhausted\":%" PRIu32 "}"
+                     ",\"tx_raw\":%" PRIu32 ",\"tx_sent\":%" PRIu32 ",\"compress_us\":%" PRId64
+                     ",\"https\":{\"in_use\":%d,\"limit\":%d,\"wait_max_us\":%" PRId64 "},\"sessions\":{",
+                     stats.requests, stats.cancelled, stats.errors,
+                     stats.last_cancel_us, stats.max_cancel_us, stats.last_heap_delta,
+                     s_wait_max_us[PRIO_CLASS_USER_INPUT], s_wait_max_us[PRIO_CLASS_COMMAND],
+                     s_wait_max_us[PRIO_CLASS_CONTINUATION],
+                     s_replies_dropped, s_replies_stale,
+                     s_msg_pool.stats.in_use, s_msg_pool.stats.high_water, s_msg_pool.stats.exhausted,
+                     s_tx.raw, s_tx.sent, s_tx.compress_us,
+                     CONFIG_LLM_MAX_CONNECTIONS - (int)uxSemaphoreGetCount(s_conn_slots), CONFIG_LLM_MAX_CONNECTIONS,
+                     s_conn_wait_max_us);
+    memset(s_wait_max_us, 0, sizeof(s_wait_max_us));
+    memset(&s_tx, 0, sizeof(s_tx));
+    s_conn_wait_max_us = 0;
+
+    // Turns answered and latency from reply to published answer, per session in use
+    xSemaphoreTake(s_table_lock, portMAX_DELAY);
+    const char *sep = "";
+    for (int i = 0; i < CONFIG_CONVERSATION_SESSIONS && n >= 0 && (size_t)n < len; i++) {
+        session_t *sess = &s_sessions[i];
+        if (!s_table.slots[i].in_use) {
+            continue;
+        }
+        n += snprintf(buf + n, len - n,
+                      "%s\"%s\":{\"turns\":%" PRIu32 ",\"pending\":%u,\"latency_us\":%" PRId64
+                      ",\"latency_max_us\":%" PRId64 "}",
+                      sep, session_table_name(&s_table, i), sess->turns, (unsigned)s_table.slots[i].pending,
+                      sess->latency_last_us, sess->latency_max_us);
+        sess->turns = 0;
+        sess->latency_max_us = 0;
+        sep = ",";
+    }
+    xSemaphoreGive(s_table_lock);
+    if (n >= 0 && (size_t)n < len) {
+        n += snprintf(buf + n, len - n, "}}");
+    }
+    return n;
+}
+
+esp_err_t conversation_start(void)
+{
+    if (strlen(CONFIG_OPENAI_API_KEY) == 0) {
+        ESP_LOGW(TAG, "OpenAI API key not configured, conversation disabled");
+        return ESP_OK;
+    }
+
+    ESP_LOGI(TAG, "Using model %s at %s", CONFIG_OPENAI_MODEL, CONFIG_OPENAI_API_URL);
+
+    prio_sched_init(&s_sched, sizeof(conversation_msg_t));
+    prio_sched_set_class(&s_sched, PRIO_CLASS_USER_INPUT, s_user_input_slots, USER_INPUT_SLOTS);
+    prio_sched_set_class(&s_sched, PRIO_CLASS_COMMAND, s_command_slots, COMMAND_SLOTS);
+    spsc_ring_init(&s_replies, s_reply_buf, sizeof(s_reply_buf));
+
+#if CONFIG_MSG_POOL_IN_PSRAM
+    // Allocated once and never freed: no fragmentation either
+    s_msg_pool_storage = heap_caps_malloc(MSG_POOL_STORAGE_SIZE, MALLOC_CAP_SPIRAM);
+    if (s_msg_pool_storage == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    slab_pool_init(&s_msg_pool, s_msg_pool_storage, CONFIG_MSG_POOL_BUF_SIZE, CONFIG_MSG_POOL_COUNT);
+    session_table_init(&s_table, CONFIG_CONVERSATION_SESSIONS, s_jobs, SESSION_QUEUE_DEPTH, sizeof(job_t));
+
+    s_sched_lock = xSemaphoreCreateMutex();
+    s_table_lock = xSemaphoreCreateMutex();
+    s_msg_pool_lock = xSemaphoreCreateMutex();
+    s_work = xSemaphoreCreateCounting(UINT16_MAX, 0);
+    s_conn_slots = xSemaphoreCreateCounting(CONFIG_LLM_MAX_CONNECTIONS, CONFIG_LLM_MAX_CONNECTIONS);
+    if (s_sched_lock == NULL || s_table_lock == NULL || s_msg_pool_lock == NULL || s_work == NULL ||
+        s_conn_slots == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    // The default session first: it never leaves its slot, so requests and cancels find it without the table
+    s_default = session_table_open(&s_table, "", 0, NULL);
+    session_setup(s_default, "");
+    for (int i = 0; i < CONFIG_CONVERSATION_WORKERS; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "conv_worker%d", i);
+        if (xTaskCreate(worker_task, name, WORKER_TASK_STACK, &s_workers[i], 4, NULL) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    // Above the workers: replies leave the ring as soon as they arrive
+    if (xTaskCreate(conversation_task, "conversation", DISPATCHER_TASK_STACK, NULL, 5, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    app_metrics_register("llm", conversation_metrics_writer);
+    return ESP_OK;
+}
+
+bool conversation_post(prio_class_t prio, conversation_request_t type)
+{
+    conversation_msg_t msg;
+
+    if (s_task == NULL || prio == PRIO_CLASS_CONTINUATION) {
+        return false;
+    }
+
+    // A new discussion supersedes the request in flight and everything still queued
+    if (type == CONVERSATION_START) {
+        conversation_cancel();
+    }
+
+    msg.type = type;
+    msg.generation = s_sessions[s_default].cancel.generation;
+    msg.posted_us = esp_timer_get_time();
+
+    xSemaphoreTake(s_sched_lock, portMAX_DELAY);
+    bool kept_all = prio_sched_push(&s_sched, prio, &msg);
+    xSemaphoreGive(s_sched_lock);
+    if (!kept_all) {
+        ESP_LOGW(TAG, "Too many pending requests, oldest one of its class dropped");
+    }
+    xTaskNotifyGive(s_task);
+    return true;
+}
+
+void conversation_reply_fragment(const char *session, int session_len, const char *data, int len,
+                                 int offset, int total_len, uint32_t correlation)
+{
+    if (s_task == NULL) {
+        return;
+    }
+
+    if (offset == 0) {
+        if (!session_name_valid(session, session_len)) {
+            s_reply_open = NULL;
+            ESP_LOGW(TAG, "Invalid session name %.*s, reply dropped", session_len, session);
+            return;
+        }
+        // First fragment: reserve the whole reply, truncated like every message (part header aside)
+        int max = CONVERSATION_MAX_TEXT_LEN + MULTIPART_HEADER_LEN;
+        int cap = total_len > max ? max : total_len;
+        s_reply_open = spsc_ring_reserve(&s_replies, sizeof(reply_hdr_t) + cap + 1);
+        if (s_reply_open == NULL) {
+            s_replies_dropped++;
+            ESP_LOGW(TAG, "Too many pending replies, reply dropped");
+            return;
+        }
+        s_reply_cap = cap;
+        s_reply_open->generation = s_sessions[s_default].cancel.generation;
+        s_reply_open->correlation = correlation;
+        s_reply_open->posted_us = esp_timer_get_time();
+        memcpy(s_reply_open->session, session, session_len);
+        s_reply_open->session[session_len] = '\0';
+        s_reply_open->len = 0;
+    }
+    if (s_reply_open == NULL) {
+        // Rest of a dropped reply, or of a message for another topic
+        return;
+    }
+
+    // Copied from the MQTT buffer straight to its place in the ring
+    if (offset < s_reply_cap) {
+        int n = len < s_reply_cap - offset ? len : s_reply_cap - offset;
+        memcpy(s_reply_open->text + offset, data, n);
+        s_reply_open->len = offset + n;
+    }
+
+    if (offset + len >= total_len) {
+        if (total_len > s_reply_cap) {
+            ESP_LOGW(TAG, "Message truncated from %d to %d bytes", total_len, s_reply_cap);
+        }
+        s_reply_open->text[s_reply_open->len] = '\0';
+        spsc_ring_commit(&s_replies, sizeof(reply_hdr_t) + s_reply_open->len + 1);
+        s_reply_open = NULL;
+        xTaskNotifyGive(s_task);
+    }
+}
+
+/*
+ * @brief session_table_purge() callback: drop the jobs of a cancelled generation
+ */
+static bool job_stale(void *item, void *ctx)
+{
+    job_t *job = item;
+
+    if (job->generation == *(uint32_t *)ctx) {
+        return false;
+    }
+    msg_free(job->text);
+    return true;
+}
+
+void conversation_cancel(void)
+{
+    if (s_task != NULL) {
+        xSemaphoreTake(s_sched_lock, portMAX_DELAY);
+        for (int cls = 0; cls < PRIO_CLASS_COUNT; cls++) {
+            prio_sched_clear(&s_sched, cls);
+        }
+        uint32_t generation = llm_cancel(&s_sessions[s_default].cancel);
+        xSemaphoreGive(s_sched_lock);
+
+        // Jobs already handed to the sessions go too: a full queue of stale replies would refuse the next press
+        xSemaphoreTake(s_table_lock, portMAX_DELAY);
+        size_t purged = session_table_purge_session(&s_table, s_default, job_stale, &generation);
+        xSemaphoreGive(s_table_lock);
+        ESP_LOGI(TAG, "Conversation request cancelled, %u queued job(s) dropped", (unsigned)purged);
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * Conversation sessions
+ *
+ * Runs the OpenAI calls of the endless discussion in a pool of worker tasks
+ * so the GPIO and MQTT tasks never block on HTTPS. Each session has its
+ * own history, bounded by CONFIG_CONVERSATION_MAX_TURNS: the default one,
+ * driven by the button and the commands, answers /client_gpt on
+ * /esp_gpt_out, and session <name> answers /client_gpt/<name> on
+ * /esp_gpt_out/<name>. A dispatcher task takes requests by priority class
+ * (button, then commands, then /client_gpt replies) and queues them on
+ * their session:
+ *  - START: new conversation with CONFIG_INITIAL_PROMPT (button press)
+ *  - reply: answer a message received on /client_gpt[/<name>] (conversation_reply_fragment())
+ *  - RESET: forget the conversation history
+ * Turns of one session are answered in order, independent sessions in
+ * parallel, with at most CONFIG_LLM_MAX_CONNECTIONS HTTPS connections open.
+ * The requests in flight can be cancelled at any time, which closes their
+ * connections within one poll. Requests are accepted as soon as
+ * conversation_start() returned; they are answered once the network is up.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "prio_sched.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longest message accepted or published, longer text is truncated (limits RAM usage)
+#define CONVERSATION_MAX_TEXT_LEN 500
+
+typedef enum {
+    CONVERSATION_START,
+    CONVERSATION_RESET,
+} conversation_request_t;
+
+/*
+ * @brief Create the dispatcher and worker tasks
+ *
+ * Does nothing when the OpenAI API key is not configured.
+ *
+ * @return ESP_OK, or ESP_ERR_NO_MEM
+ */
+esp_err_t conversation_start(void);
+
+/*
+ * @brief Queue a request for the worker
+ *
+ * Requests apply to the default session. CONVERSATION_START first cancels
+ * its request in flight and drops its queued ones; the other sessions
+ * carry on.
+ * When the class is full its oldest request is dropped.
+ *
+ * @param prio PRIO_CLASS_USER_INPUT or PRIO_CLASS_COMMAND, replies use conversation_reply_fragment()
+ * @param type Request type
+ * @return false if the worker is not started
+ */
+bool conversation_post(prio_class_t prio, conversation_request_t type);
+
+/*
+ * @brief Write a /client_gpt reply, fragment by fragment, for the worker to answer
+ *
+ * MQTT task only (single producer). The reply is reserved in a lock-free
+ * ring on its first fragment, each fragment is copied to its place and the
+ * reply is handed to the worker after the last one, with no intermediate
+ * buffer. Replies are dropped while the ring is full.
+ *
+ * @param session Session name, the topic suffix after /client_gpt/ ("" for /client_gpt);
+ *                read on the first fragment only. Replies to an invalid name are dropped.
+ * @param session_len Name length
+ * @param data Fragment
+ * @param len Fragment length
+ * @param offset Offset of the fragment in the reply, 0 for the first one
+ * @param total_len Length of the whole reply, truncated to CONVERSATION_MAX_TEXT_LEN
+ * @param correlation MQTT 5 correlation data of the reply, the id of the answer it
+ *                    responds to; 0 when absent. Replies to an older answer are dropped.
+ */
+void conversation_reply_fragment(const char *session, int session_len, const char *data, int len,
+                                 int offset, int total_len, uint32_t correlation);
+
+/*
+ * @brief Abort the request in flight and drop every request still waiting, in the default session only
+ */
+void conversation_cancel(void);
+
+#ifdef __cplusplus
+}
+#endif
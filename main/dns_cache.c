@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "dns_cache.h"
+
+void dns_cache_init(dns_cache_t *c, uint32_t max_ttl_s)
+{
+    memset(c, 0, sizeof(*c));
+    c->max_ttl_s = max_ttl_s;
+}
+
+static dns_cache_entry_t *find(dns_cache_t *c, const char *name)
+{
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        if (c->entries[i].name[0] != '\0' && strcasecmp(c->entries[i].name, name) == 0) {
+            return &c->entries[i];
+        }
+    }
+    return NULL;
+}
+
+dns_cache_result_t dns_cache_lookup(dns_cache_t *c, const char *name, int64_t now_us, uint32_t *addr)
+{
+    dns_cache_entry_t *e = find(c, name);
+
+    if (e == NULL || now_us >= e->expires_us) {
+        c->misses++;
+        return DNS_CACHE_MISS;
+    }
+    e->used_us = now_us;
+    if (e->negative) {
+        c->negative_hits++;
+        return DNS_CACHE_NEGATIVE;
+    }
+    *addr = e->addr;
+    c->hits++;
+    return DNS_CACHE_HIT;
+}
+
+/*
+ * @brief Slot for a name: its own, a free or expired one, else the one looked up least recently
+ */
+static dns_cache_entry_t *slot_for(dns_cache_t *c, const char *name, int64_t now_us)
+{
+    dns_cache_entry_t *e = find(c, name);
+
+    if (e != NULL) {
+        return e;
+    }
+    e = &c->entries[0];
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        dns_cache_entry_t *candidate = &c->entries[i];
+        if (candidate->name[0] == '\0' || now_us >= candidate->expires_us) {
+            e = candidate;
+            break;
+        }
+        if (candidate->used_us < e->used_us) {
+            e = candidate;
+        }
+    }
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    e->used_us = now_us;
+    return e;
+}
+
+static void drop(dns_cache_t *c, const char *name)
+{
+    dns_cache_entry_t *e = find(c, name);
+
+    if (e != NULL) {
+        memset(e, 0, sizeof(*e));
+    }
+}
+
+void dns_cache_store(dns_cache_t *c, const char *name, uint32_t addr, uint32_t ttl_s, int64_t now_us)
+{
+    if (ttl_s == 0 || strlen(name) >= DNS_CACHE_NAME_MAX) {
+        drop(c, name);
+        return;
+    }
+    if (ttl_s > c->max_ttl_s) {
+        ttl_s = c->max_ttl_s;
+    }
+    dns_cache_entry_t *e = slot_for(c, name, now_us);
+    int64_t ttl_us = ttl_s * 1000000LL;
+    e->addr = addr;
+    e->negative = false;
+    e->expires_us = now_us + ttl_us;
+    e->refresh_us = ttl_s >= DNS_CACHE_REFRESH_MIN_TTL_S ? e->expires_us - (ttl_us >> DNS_CACHE_REFRESH_SHIFT)
+                                                         : INT64_MAX;
+}
+
+void dns_cache_store_negative(dns_cache_t *c, const char *name, uint32_t ttl_s, int64_t now_us)
+{
+    if (ttl_s == 0 || strlen(name) >= DNS_CACHE_NAME_MAX) {
+        drop(c, name);
+        return;
+    }
+    if (ttl_s > c->max_ttl_s) {
+        ttl_s = c->max_ttl_s;
+    }
+    dns_cache_entry_t *e = slot_for(c, name, now_us);
+    e->addr = 0;
+    e->negative = true;
+    e->expires_us = now_us + ttl_s * 1000000LL;
+    // Asked again when it expires, only if still looked up
+    e->refresh_us = INT64_MAX;
+}
+
+int64_t dns_cache_next_refresh(const dns_cache_t *c, int64_t now_us, char *name, size_t len)
+{
+    const dns_cache_entry_t *next = NULL;
+
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        const dns_cache_entry_t *e = &c->entries[i];
+        if (e->name[0] == '\0' || e->refresh_us == INT64_MAX || now_us >= e->expires_us ||
+            now_us - e->used_us > DNS_CACHE_IDLE_US) {
+            continue;
+        }
+        if (next == NULL || e->refresh_us < next->refresh_us) {
+            next = e;
+        }
+    }
+    if (next == NULL) {
+        return INT64_MAX;
+    }
+    snprintf(name, len, "%s", next->name);
+    return next->refresh_us;
+}
+
+void dns_cache_refresh_failed(dns_cache_t *c, const char *name, int64_t retry_us)
+{
+    dns_cache_entry_t *e = find(c, name);
+
+    if (e != NULL) {
+        e->refresh_us = retry_us < e->expires_us ? retry_us : INT64_MAX;
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * DNS cache
+ *
+ * Hardware-independent part of the DNS cache (dns_resolver.h): the IPv4
+ * addresses of the names resolved lately, each until its TTL runs out, the
+ * names found not to exist (negative entries), and the time each address
+ * is to be resolved again in the background, before it expires, so that a
+ * name in use is always answered from the cache.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_CACHE_SIZE 8
+#define DNS_CACHE_NAME_MAX 64
+// An address is resolved again when 1/8 of its TTL is left
+#define DNS_CACHE_REFRESH_SHIFT 3
+// Shorter TTLs are left to expire: refreshing them would keep the server busy
+#define DNS_CACHE_REFRESH_MIN_TTL_S 10
+// Names not looked up for this long are no longer refreshed
+#define DNS_CACHE_IDLE_US (3600 * 1000000LL)
+
+typedef enum {
+    DNS_CACHE_MISS,
+    DNS_CACHE_HIT,
+    DNS_CACHE_NEGATIVE,         // Known not to exist
+} dns_cache_result_t;
+
+typedef struct {
+    char name[DNS_CACHE_NAME_MAX];  // Empty for a free slot
+    uint32_t addr;              // IPv4 address, network byte order
+    bool negative;
+    int64_t expires_us;
+    int64_t refresh_us;         // Next background resolution, INT64_MAX for none
+    int64_t used_us;            // Latest lookup
+} dns_cache_entry_t;
+
+typedef struct {
+    dns_cache_entry_t entries[DNS_CACHE_SIZE];
+    uint32_t max_ttl_s;         // Longer TTLs are cut to this
+    uint32_t hits;
+    uint32_t negative_hits;
+    uint32_t misses;
+} dns_cache_t;
+
+void dns_cache_init(dns_cache_t *c, uint32_t max_ttl_s);
+
+/*
+ * @brief Look a name up, ignoring case
+ *
+ * @param addr Address of the name on DNS_CACHE_HIT
+ */
+dns_cache_result_t dns_cache_lookup(dns_cache_t *c, const char *name, int64_t now_us, uint32_t *addr);
+
+/*
+ * @brief Store the address of a name for its TTL
+ *
+ * A TTL of 0 means the address must not be cached: the name is dropped. When
+ * the cache is full, the entry looked up least recently is replaced.
+ */
+void dns_cache_store(dns_cache_t *c, const char *name, uint32_t addr, uint32_t ttl_s, int64_t now_us);
+
+/*
+ * @brief Remember for ttl_s that a name does not exist
+ */
+void dns_cache_store_negative(dns_cache_t *c, const char *name, uint32_t ttl_s, int64_t now_us);
+
+/*
+ * @brief Next name to resolve in the background
+ *
+ * Only addresses looked up within DNS_CACHE_IDLE_US are refreshed.
+ *
+ * @param name Set to the name, when there is one
+ * @return Time the resolution is due, INT64_MAX if there is none
+ */
+int64_t dns_cache_next_refresh(const dns_cache_t *c, int64_t now_us, char *name, size_t len);
+
+/*
+ * @brief The background resolution of a name failed: try again at retry_us, unless it expired by then
+ */
+void dns_cache_refresh_failed(dns_cache_t *c, const char *name, int64_t retry_us);
+
+#ifdef __cplusplus
+}
+#endif
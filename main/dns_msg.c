@@ -0,0 +1,204 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "dns_msg.h"
+
+#define HEADER_LEN 12
+#define LABEL_MAX 63
+#define NAME_MAX_LEN 253
+
+#define FLAG_QR 0x8000
+#define FLAG_TC 0x0200
+#define FLAG_RD 0x0100
+#define RCODE_MASK 0x000f
+#define RCODE_NXDOMAIN 3
+
+#define TYPE_A 1
+#define TYPE_CNAME 5
+#define TYPE_SOA 6
+#define CLASS_IN 1
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+int dns_msg_query(uint8_t *buf, size_t len, uint16_t id, const char *name)
+{
+    size_t name_len = strlen(name);
+
+    // Each label takes a length byte instead of its dot, plus the root label, type and class
+    if (name_len == 0 || name_len > NAME_MAX_LEN || len < HEADER_LEN + name_len + 2 + 4) {
+        return -1;
+    }
+    memset(buf, 0, HEADER_LEN);
+    put16(buf, id);
+    put16(buf + 2, FLAG_RD);
+    put16(buf + 4, 1);
+
+    uint8_t *p = buf + HEADER_LEN;
+    while (*name != '\0') {
+        const char *dot = strchr(name, '.');
+        size_t n = dot != NULL ? (size_t)(dot - name) : strlen(name);
+        if (n == 0 || n > LABEL_MAX) {
+            return -1;
+        }
+        *p++ = n;
+        memcpy(p, name, n);
+        p += n;
+        name += dot != NULL ? n + 1 : n;
+    }
+    *p++ = 0;
+    put16(p, TYPE_A);
+    put16(p + 2, CLASS_IN);
+    return p + 4 - buf;
+}
+
+/*
+ * @brief Compare the question name with the name queried, ignoring case
+ *
+ * @return Offset after the name, 0 if it differs
+ */
+static size_t match_name(const uint8_t *buf, size_t len, size_t off, const char *name)
+{
+    while (off < len) {
+        uint8_t n = buf[off++];
+        if (n == 0) {
+            return *name == '\0' ? off : 0;
+        }
+        if (n > LABEL_MAX || off + n > len) {
+            return 0;
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (name[i] == '\0' || tolower((unsigned char)name[i]) != tolower(buf[off + i])) {
+                return 0;
+            }
+        }
+        name += n;
+        off += n;
+        if (*name == '.') {
+            name++;
+        } else if (*name != '\0') {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/*
+ * @brief Skip a name, possibly compressed
+ *
+ * @return Offset after the name, 0 if malformed
+ */
+static size_t skip_name(const uint8_t *buf, size_t len, size_t off)
+{
+    while (off < len) {
+        uint8_t n = buf[off];
+        if ((n & 0xc0) == 0xc0) {
+            return off + 2 <= len ? off + 2 : 0;
+        }
+        if (n > LABEL_MAX) {
+            return 0;
+        }
+        off += 1 + n;
+        if (n == 0) {
+            return off;
+        }
+    }
+    return 0;
+}
+
+static uint32_t min_ttl(uint32_t a, uint32_t b)
+{
+    return a < b ? a : b;
+}
+
+dns_msg_status_t dns_msg_parse(const uint8_t *buf, size_t len, uint16_t id, const char *name,
+                               dns_msg_answer_t *answer)
+{
+    if (len < HEADER_LEN || get16(buf) != id) {
+        return DNS_MSG_INVALID;
+    }
+    uint16_t flags = get16(buf + 2);
+    if (!(flags & FLAG_QR) || get16(buf + 4) != 1) {
+        return DNS_MSG_INVALID;
+    }
+    size_t off = match_name(buf, len, HEADER_LEN, name);
+    if (off == 0 || off + 4 > len || get16(buf + off) != TYPE_A || get16(buf + off + 2) != CLASS_IN) {
+        return DNS_MSG_INVALID;
+    }
+    off += 4;
+
+    // Records may be missing from a truncated answer: left to a resolver retrying over TCP
+    if (flags & FLAG_TC) {
+        return DNS_MSG_FAILED;
+    }
+    uint16_t rcode = flags & RCODE_MASK;
+    if (rcode != 0 && rcode != RCODE_NXDOMAIN) {
+        return DNS_MSG_FAILED;
+    }
+
+    size_t answers = get16(buf + 6);
+    size_t records = answers + get16(buf + 8);
+    uint32_t ttl_s = UINT32_MAX;
+    uint32_t negative_ttl_s = 0;
+    bool found = false;
+    for (size_t i = 0; i < records; i++) {
+        off = skip_name(buf, len, off);
+        if (off == 0 || off + 10 > len) {
+            return DNS_MSG_INVALID;
+        }
+        uint16_t type = get16(buf + off);
+        uint16_t rclass = get16(buf + off + 2);
+        uint32_t rttl = get32(buf + off + 4);
+        uint16_t rdlen = get16(buf + off + 8);
+        const uint8_t *rdata = buf + off + 10;
+        off += 10 + rdlen;
+        if (off > len) {
+            return DNS_MSG_INVALID;
+        }
+        // A TTL with the top bit set is read as 0 (RFC 2181)
+        if (rttl > INT32_MAX) {
+            rttl = 0;
+        }
+        if (rclass != CLASS_IN) {
+            continue;
+        }
+        if (i < answers) {
+            // The CNAME records leading to the address expire with it
+            if (type == TYPE_CNAME || (type == TYPE_A && rdlen == 4)) {
+                ttl_s = min_ttl(ttl_s, rttl);
+            }
+            if (type == TYPE_A && rdlen == 4 && !found) {
+                memcpy(&answer->addr, rdata, 4);
+                found = true;
+            }
+        } else if (type == TYPE_SOA && rdlen >= 22) {
+            // Negative answers last the smaller of the SOA TTL and its MINIMUM field (RFC 2308)
+            negative_ttl_s = min_ttl(rttl, get32(rdata + rdlen - 4));
+        }
+    }
+
+    if (rcode == RCODE_NXDOMAIN) {
+        answer->ttl_s = negative_ttl_s;
+        return DNS_MSG_NXDOMAIN;
+    }
+    if (!found) {
+        answer->ttl_s = negative_ttl_s;
+        return DNS_MSG_NODATA;
+    }
+    answer->ttl_s = ttl_s;
+    return DNS_MSG_ADDR;
+}
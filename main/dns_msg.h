@@ -0,0 +1,53 @@
+/*
+ * DNS messages
+ *
+ * The A query for a name and the reading of the answer: address, TTL, or the
+ * time a name found not to exist may be remembered. Used by the DNS cache
+ * (dns_resolver.h), which needs the TTL that lwIP's resolver keeps to itself.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest message over UDP without EDNS
+#define DNS_MSG_MAX 512
+#define DNS_MSG_PORT 53
+
+typedef enum {
+    DNS_MSG_ADDR,               // IPv4 address found
+    DNS_MSG_NXDOMAIN,           // The name does not exist
+    DNS_MSG_NODATA,             // The name exists without IPv4 address
+    DNS_MSG_FAILED,             // Server failure, refusal or truncated answer
+    DNS_MSG_INVALID,            // Malformed, or not the answer to this query
+} dns_msg_status_t;
+
+typedef struct {
+    uint32_t addr;              // Network byte order
+    uint32_t ttl_s;             // Smallest TTL of the records leading to the address; of the SOA record
+                                // for DNS_MSG_NXDOMAIN and DNS_MSG_NODATA, 0 without one
+} dns_msg_answer_t;
+
+/*
+ * @brief Build the query for the IPv4 address of a name, recursion desired
+ *
+ * @return Length of the query, -1 if the name is invalid or buf too small
+ */
+int dns_msg_query(uint8_t *buf, size_t len, uint16_t id, const char *name);
+
+/*
+ * @brief Read the answer to a query
+ *
+ * Answers with another id or question are DNS_MSG_INVALID, so that a late
+ * answer to an earlier query or a forged one is not taken.
+ */
+dns_msg_status_t dns_msg_parse(const uint8_t *buf, size_t len, uint16_t id, const char *name,
+                               dns_msg_answer_t *answer);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,481 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/api.h"
+#include "lwip/dns.h"
+#include "lwip/sockets.h"
+
+#include "dns_resolver.h"
+#include "dns_cache.h"
+#include "dns_msg.h"
+#include "app_metrics.h"
+#if CONFIG_HAPPY_EYEBALLS
+#include "happy_eyeballs.h"
+#include "broker_config.h"
+#endif
+
+static const char *TAG = "dns_resolver";
+
+#define RESOLVER_TASK_STACK 3072
+// A failed refresh is tried again after this, while the address has not expired
+#define REFRESH_RETRY_US (5 * 1000000LL)
+// The refresh task looks at the cache at least this often, for names looked up again after a pause
+#define REFRESH_CHECK_MS 60000
+
+static dns_cache_t s_cache;
+static SemaphoreHandle_t s_lock = NULL;
+static TaskHandle_t s_task = NULL;
+static uint32_t s_queries = 0;          // Answered by a server
+static uint32_t s_failures = 0;
+static uint32_t s_refreshes = 0;
+static uint32_t s_fallbacks = 0;        // Misses left to lwIP's resolver
+static int64_t s_query_us = 0;          // Total time of the answered queries
+static int64_t s_saved_us = 0;          // Mean query time at each lookup answered from the cache
+
+#if CONFIG_HAPPY_EYEBALLS
+#define RACE_ENDPOINTS 4
+// The family that connected first is used without racing again for this long
+#define RACE_REMEMBER_US (600 * 1000000LL)
+#define RACE_TIMEOUT_MS 3000
+
+typedef struct {
+    char host[DNS_CACHE_NAME_MAX];  // Empty for a free slot
+    uint16_t port;
+    int family;                 // Winner of the latest race, AF_UNSPEC before the first one
+    int64_t until_us;           // The winner is used without racing until then
+    int64_t used_us;
+} race_endpoint_t;
+
+static race_endpoint_t s_endpoints[RACE_ENDPOINTS];
+static uint32_t s_races = 0;
+static uint32_t s_ipv6_first = 0;
+static uint32_t s_ipv4_first = 0;
+static int64_t s_race_max_us = 0;
+#endif
+
+/*
+ * @brief Send the query to one server and wait for its answer
+ */
+static dns_msg_status_t query_server(uint32_t server, const char *name, uint8_t *buf, dns_msg_answer_t *answer)
+{
+    struct sockaddr_in to = {
+        .sin_family = AF_INET,
+        .sin_port = htons(DNS_MSG_PORT),
+        .sin_addr.s_addr = server,
+    };
+    struct timeval tv = {
+        .tv_sec = CONFIG_DNS_CACHE_TIMEOUT_MS / 1000,
+        .tv_usec = (CONFIG_DNS_CACHE_TIMEOUT_MS % 1000) * 1000,
+    };
+    uint16_t id = esp_random();
+    dns_msg_status_t status = DNS_MSG_FAILED;
+
+    int len = dns_msg_query(buf, DNS_MSG_MAX, id, name);
+    if (len < 0) {
+        return DNS_MSG_FAILED;
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return DNS_MSG_FAILED;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    // Connected: datagrams from other addresses are dropped by the stack
+    if (connect(fd, (struct sockaddr *)&to, sizeof(to)) == 0 && send(fd, buf, len, 0) == len) {
+        // Late answers to an earlier query are skipped, until the timeout
+        do {
+            int n = recv(fd, buf, DNS_MSG_MAX, 0);
+            if (n < 0) {
+                break;
+            }
+            status = dns_msg_parse(buf, n, id, name, answer);
+        } while (status == DNS_MSG_INVALID);
+    }
+    close(fd);
+    return status == DNS_MSG_INVALID ? DNS_MSG_FAILED : status;
+}
+
+/*
+ * @brief Query the IPv4 DNS servers in turn, until one answers
+ */
+static dns_msg_status_t query_servers(const char *name, dns_msg_answer_t *answer)
+{
+    dns_msg_status_t status = DNS_MSG_FAILED;
+    // Off the stack: the hook runs on the stack of whichever task connects
+    uint8_t *buf = malloc(DNS_MSG_MAX);
+
+    if (buf == NULL) {
+        return DNS_MSG_FAILED;
+    }
+    for (int i = 0; i < DNS_MAX_SERVERS && status == DNS_MSG_FAILED; i++) {
+        const ip_addr_t *server = dns_getserver(i);
+        if (server == NULL || !IP_IS_V4(server) || ip_addr_isany(server)) {
+            continue;
+        }
+        status = query_server(ip4_addr_get_u32(ip_2_ip4(server)), name, buf, answer);
+    }
+    free(buf);
+    return status;
+}
+
+/*
+ * @brief Time a name found not to exist is remembered
+ *
+ * @param soa_ttl_s Negative TTL given by the server, 0 without SOA record
+ */
+static uint32_t negative_ttl_s(uint32_t soa_ttl_s)
+{
+    uint32_t limit_s = CONFIG_DNS_CACHE_NEGATIVE_TTL_S;
+
+    return soa_ttl_s > 0 && soa_ttl_s < limit_s ? soa_ttl_s : limit_s;
+}
+
+/*
+ * @brief Resolve a name and store the result in the cache
+ *
+ * @param refresh Background resolution of a cached name
+ */
+static dns_msg_status_t resolve(const char *name, dns_msg_answer_t *answer, bool refresh)
+{
+    int64_t start_us = esp_timer_get_time();
+    dns_msg_status_t status = query_servers(name, answer);
+    int64_t now_us = esp_timer_get_time();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (refresh) {
+        s_refreshes++;
+    }
+    switch (status) {
+    case DNS_MSG_ADDR:
+        dns_cache_store(&s_cache, name, answer->addr, answer->ttl_s, now_us);
+        break;
+    case DNS_MSG_NXDOMAIN:
+        dns_cache_store_negative(&s_cache, name, negative_ttl_s(answer->ttl_s), now_us);
+        break;
+    default:
+        s_failures++;
+        if (refresh) {
+            dns_cache_refresh_failed(&s_cache, name, now_us + REFRESH_RETRY_US);
+        }
+        break;
+    }
+    if (status == DNS_MSG_ADDR || status == DNS_MSG_NXDOMAIN) {
+        s_queries++;
+        s_query_us += now_us - start_us;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (status == DNS_MSG_ADDR) {
+        esp_ip4_addr_t ip = {.addr = answer->addr};
+        ESP_LOGI(TAG, "%s%s: " IPSTR ", TTL %" PRIu32 " s, %" PRId64 " ms", refresh ? "Refreshed " : "", name,
+                 IP2STR(&ip), answer->ttl_s, (now_us - start_us) / 1000);
+    } else if (status == DNS_MSG_NXDOMAIN) {
+        ESP_LOGW(TAG, "%s: no such name", name);
+    }
+    return status;
+}
+
+/*
+ * @brief false for the names left to lwIP
+ */
+static bool cacheable(const char *name)
+{
+    ip_addr_t literal;
+    size_t len = strlen(name);
+
+    return len > 0 && len < DNS_CACHE_NAME_MAX && !ipaddr_aton(name, &literal) && strcasecmp(name, "localhost") != 0 &&
+           !(len > 6 && strcasecmp(name + len - 6, ".local") == 0);
+}
+
+/*
+ * @brief IPv4 address of a name, from the cache or the DNS servers
+ *
+ * @return 1 when handled, with the result in err, 0 to leave the lookup to lwIP
+ */
+static int lookup_ipv4(const char *name, uint32_t *addr, err_t *err)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    dns_cache_result_t result = dns_cache_lookup(&s_cache, name, esp_timer_get_time(), addr);
+    if (result != DNS_CACHE_MISS && s_queries > 0) {
+        s_saved_us += s_query_us / s_queries;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (result == DNS_CACHE_HIT) {
+        *err = ERR_OK;
+        return 1;
+    }
+    if (result == DNS_CACHE_NEGATIVE) {
+        *err = ERR_VAL;
+        return 1;
+    }
+
+    dns_msg_answer_t answer;
+    switch (resolve(name, &answer, false)) {
+    case DNS_MSG_ADDR:
+        *addr = answer.addr;
+        *err = ERR_OK;
+        // A new name to keep fresh
+        xTaskNotifyGive(s_task);
+        return 1;
+    case DNS_MSG_NXDOMAIN:
+        *err = ERR_VAL;
+        return 1;
+    default:
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_fallbacks++;
+        xSemaphoreGive(s_lock);
+        return 0;
+    }
+}
+
+#if CONFIG_HAPPY_EYEBALLS
+static race_endpoint_t *race_find(const char *host)
+{
+    for (int i = 0; i < RACE_ENDPOINTS; i++) {
+        if (s_endpoints[i].host[0] != '\0' && strcasecmp(s_endpoints[i].host, host) == 0) {
+            return &s_endpoints[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * @brief Use a family for a host without racing, for RACE_REMEMBER_US
+ */
+static void race_remember(const char *host, int family, int64_t now_us)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    race_endpoint_t *e = race_find(host);
+    if (e != NULL) {
+        e->family = family;
+        e->until_us = now_us + RACE_REMEMBER_US;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+/*
+ * @brief Address to connect to for a raced host: the one of the family that connected first
+ *
+ * @param addr4 IPv4 address of the host, NULL when the cache could not query it: lwIP resolves it then
+ * @return true with addr set, false to go on with the IPv4 address alone
+ */
+static bool race_pick(const char *name, const uint32_t *addr4, ip_addr_t *addr)
+{
+    int64_t now_us = esp_timer_get_time();
+    uint16_t port = 0;
+    int family = AF_UNSPEC;
+    int64_t until_us = 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    race_endpoint_t *e = race_find(name);
+    if (e != NULL) {
+        e->used_us = now_us;
+        port = e->port;
+        family = e->family;
+        until_us = e->until_us;
+    }
+    xSemaphoreGive(s_lock);
+    if (e == NULL) {
+        return false;
+    }
+    bool decided = now_us < until_us;
+    if (decided && family == AF_INET) {
+        return false;
+    }
+
+    ip_addr_t addr6;
+    // This hook leaves IPv6 lookups to lwIP's resolver
+    if (netconn_gethostbyname_addrtype(name, &addr6, NETCONN_DNS_IPV6) != ERR_OK || !IP_IS_V6(&addr6)) {
+        // Not asked again for every connection
+        race_remember(name, AF_INET, now_us);
+        return false;
+    }
+    if (decided && family == AF_INET6) {
+        ip_addr_copy(*addr, addr6);
+        return true;
+    }
+    uint32_t lwip_addr4;
+    if (addr4 == NULL) {
+        // The cache's own query failed (IPv6 DNS server, truncated answer): lwIP's resolver may still find one
+        ip_addr_t a4;
+        if (netconn_gethostbyname_addrtype(name, &a4, NETCONN_DNS_IPV4) != ERR_OK || !IP_IS_V4(&a4)) {
+            // IPv6 only: nothing to race
+            ip_addr_copy(*addr, addr6);
+            return true;
+        }
+        lwip_addr4 = ip4_addr_get_u32(ip_2_ip4(&a4));
+        addr4 = &lwip_addr4;
+    }
+
+    struct sockaddr_storage addrs[2] = {0};
+    struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&addrs[0];
+    struct sockaddr_in *sin = (struct sockaddr_in *)&addrs[1];
+    sin6->sin6_family = AF_INET6;
+    sin6->sin6_port = htons(port);
+    inet6_addr_from_ip6addr(&sin6->sin6_addr, ip_2_ip6(&addr6));
+    sin->sin_family = AF_INET;
+    sin->sin_port = htons(port);
+    sin->sin_addr.s_addr = *addr4;
+    int winner;
+    int fd = happy_eyeballs_connect(addrs, 2, CONFIG_HAPPY_EYEBALLS_STAGGER_MS, RACE_TIMEOUT_MS, &winner);
+    // Only the address is handed over: the transport makes its own connection
+    if (fd >= 0) {
+        close(fd);
+    }
+    int64_t race_us = esp_timer_get_time() - now_us;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_races++;
+    s_ipv6_first += winner == 0;
+    s_ipv4_first += winner == 1;
+    s_race_max_us = race_us > s_race_max_us ? race_us : s_race_max_us;
+    xSemaphoreGive(s_lock);
+    if (winner >= 0) {
+        race_remember(name, winner == 0 ? AF_INET6 : AF_INET, now_us);
+    }
+    ESP_LOGI(TAG, "%s port %u: %s connected first, %" PRId64 " ms", name, port,
+             winner == 0 ? "IPv6" : winner == 1 ? "IPv4" : "neither", race_us / 1000);
+
+    if (winner == 0) {
+        ip_addr_copy(*addr, addr6);
+        return true;
+    }
+    return false;
+}
+
+void dns_resolver_race(const char *uri)
+{
+    char host[DNS_CACHE_NAME_MAX];
+    uint16_t port;
+
+    // IP addresses have a single family, nothing to race
+    if (!broker_uri_host_port(uri, host, sizeof(host), &port) || !cacheable(host)) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    race_endpoint_t *e = race_find(host);
+    if (e == NULL) {
+        // A free slot, else the host connected to least recently
+        e = &s_endpoints[0];
+        for (int i = 0; i < RACE_ENDPOINTS; i++) {
+            if (s_endpoints[i].host[0] == '\0') {
+                e = &s_endpoints[i];
+                break;
+            }
+            if (s_endpoints[i].used_us < e->used_us) {
+                e = &s_endpoints[i];
+            }
+        }
+        snprintf(e->host, sizeof(e->host), "%s", host);
+        e->family = AF_UNSPEC;
+        e->until_us = 0;
+    }
+    e->port = port;
+    e->used_us = esp_timer_get_time();
+    xSemaphoreGive(s_lock);
+}
+#endif
+
+/*
+ * lwIP calls this from netconn_gethostbyname(), in the task resolving the
+ * name, before its own resolver. Returns 1 when the lookup was handled, with
+ * its result in err.
+ */
+int lwip_hook_netconn_external_resolve(const char *name, ip_addr_t *addr, u8_t addrtype, err_t *err)
+{
+    uint32_t addr4 = 0;
+
+    if (s_task == NULL || addrtype == NETCONN_DNS_IPV6 || !cacheable(name)) {
+        return 0;
+    }
+    int handled = lookup_ipv4(name, &addr4, err);
+#if CONFIG_HAPPY_EYEBALLS
+    // A lookup accepting either family (getaddrinfo() with AF_UNSPEC, as esp-tls does) may get IPv6
+    // A name known not to exist is not raced
+    if (addrtype != NETCONN_DNS_IPV4 && (!handled || *err == ERR_OK) &&
+        race_pick(name, handled ? &addr4 : NULL, addr)) {
+        *err = ERR_OK;
+        return 1;
+    }
+#endif
+    if (handled && *err == ERR_OK) {
+        ip_addr_set_ip4_u32(addr, addr4);
+    }
+    return handled;
+}
+
+static void refresh_task(void *arg)
+{
+    char name[DNS_CACHE_NAME_MAX];
+    dns_msg_answer_t answer;
+
+    while (1) {
+        int64_t now_us = esp_timer_get_time();
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        int64_t due_us = dns_cache_next_refresh(&s_cache, now_us, name, sizeof(name));
+        xSemaphoreGive(s_lock);
+
+        if (due_us > now_us) {
+            int64_t wait_ms = (due_us - now_us + 999) / 1000;
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms < REFRESH_CHECK_MS ? wait_ms : REFRESH_CHECK_MS));
+            continue;
+        }
+        resolve(name, &answer, true);
+    }
+}
+
+/*
+ * @brief Metrics writer: lookups, how many the cache answered and the time it saved
+ */
+static int dns_metrics_writer(char *buf, size_t len, int64_t interval_us)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t avoided = s_cache.hits + s_cache.negative_hits;
+    uint32_t lookups = avoided + s_cache.misses;
+    int n = snprintf(buf, len,
+                     "{\"lookups\":%" PRIu32 ",\"avoided\":%" PRIu32 ",\"queries\":%" PRIu32 ",\"refreshes\":%" PRIu32
+                     ",\"failures\":%" PRIu32 ",\"fallbacks\":%" PRIu32 ",\"query_ms\":%.1f,\"saved_ms\":%.1f"
+                     ",\"saved_per_lookup_ms\":%.1f",
+                     lookups, avoided, s_queries, s_refreshes, s_failures, s_fallbacks,
+                     s_queries > 0 ? s_query_us / 1000.0f / s_queries : 0.0f, s_saved_us / 1000.0f,
+                     lookups > 0 ? s_saved_us / 1000.0f / lookups : 0.0f);
+#if CONFIG_HAPPY_EYEBALLS
+    if (n >= 0 && (size_t)n < len) {
+        n += snprintf(buf + n, len - n,
+                      ",\"races\":%" PRIu32 ",\"ipv6_first\":%" PRIu32 ",\"ipv4_first\":%" PRIu32
+                      ",\"race_max_ms\":%.1f",
+                      s_races, s_ipv6_first, s_ipv4_first, s_race_max_us / 1000.0f);
+    }
+#endif
+    xSemaphoreGive(s_lock);
+    if (n >= 0 && (size_t)n < len) {
+        n += snprintf(buf + n, len - n, "}");
+    }
+    return n;
+}
+
+esp_err_t dns_resolver_start(void)
+{
+    dns_cache_init(&s_cache, CONFIG_DNS_CACHE_MAX_TTL_S);
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    // Low priority: refreshes are done well before the addresses expire.
+    // The hook leaves every lookup to lwIP until the task exists.
+    if (xTaskCreate(refresh_task, "dns_refresh", RESOLVER_TASK_STACK, NULL, 2, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    app_metrics_register("dns", dns_metrics_writer);
+    return ESP_OK;
+}
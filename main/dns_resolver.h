@@ -0,0 +1,54 @@
+/*
+ * DNS cache shared by every connection
+ *
+ * lwIP hands every name resolution (getaddrinfo() of the MQTT transport, of
+ * the OpenAI HTTPS client and of the broker probes) to
+ * lwip_hook_netconn_external_resolve() first. The hook answers from the
+ * cache (dns_cache.h); on a miss it queries the DNS servers itself
+ * (dns_msg.h) to learn the TTL, which lwIP's resolver keeps to itself.
+ * Names that do not exist are remembered too, for the time given by the
+ * server, at most CONFIG_DNS_CACHE_NEGATIVE_TTL_S. A task resolves the names
+ * in use again before they expire, so that reconnecting to the broker or
+ * calling OpenAI does not wait for the DNS server.
+ *
+ * IP addresses, "localhost", .local names (mDNS) and IPv6-only lookups are
+ * left to lwIP, and so is any name the query fails for (IPv6 DNS server,
+ * truncated answer, no IPv4 address).
+ *
+ * With CONFIG_HAPPY_EYEBALLS, the lookups for an endpoint registered with
+ * dns_resolver_race() race a connection to its IPv6 address against one to
+ * its IPv4 address, started CONFIG_HAPPY_EYEBALLS_STAGGER_MS later
+ * (happy_eyeballs.h), and return the address that connected first. The
+ * clients make their own connection to that address: neither esp-mqtt nor
+ * esp_http_client takes a connected socket, and lwIP's getaddrinfo() returns
+ * a single address. The winner is used without racing for 10 minutes.
+ *
+ * Needs Component config > LWIP > Hooks > Netconn external resolve Hook set
+ * to "Custom implementation". Lookups answered from the cache and the time
+ * they saved are reported under "dns" on /esp32_metrics.
+ */
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * @brief Start answering lookups from the cache and the refresh task, before any connection
+ */
+esp_err_t dns_resolver_start(void);
+
+/*
+ * @brief Race the IPv6 and IPv4 addresses of the host of a URI when connecting to it
+ *
+ * Only with CONFIG_HAPPY_EYEBALLS. Nothing is done for an IP address or a .local name.
+ *
+ * @param uri mqtt(s)://, ws(s):// or http(s):// URI, the port taken from the scheme when missing
+ */
+void dns_resolver_race(const char *uri);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,46 @@
+#include <string.h>
+
+#include "dup_filter.h"
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+static uint32_t fnv1a(uint32_t h, const void *data, int len)
+{
+    const uint8_t *p = data;
+
+    for (int i = 0; i < len; i++) {
+        h = (h ^ p[i]) * FNV_PRIME;
+    }
+    return h;
+}
+
+void dup_filter_init(dup_filter_t *f)
+{
+    memset(f, 0, sizeof(*f));
+}
+
+uint32_t dup_filter_hash(const char *topic, int topic_len, const char *data, int len, int total_len)
+{
+    uint32_t h = fnv1a(FNV_OFFSET, topic, topic_len);
+    h = fnv1a(h, &total_len, sizeof(total_len));
+    return fnv1a(h, data, len);
+}
+
+bool dup_filter_check(dup_filter_t *f, uint16_t msg_id, uint32_t hash, bool dup)
+{
+    // Only a redelivery can be a duplicate, a first delivery is recorded whatever its id
+    for (int i = 0; dup && i < f->count; i++) {
+        if (f->msg_id[i] == msg_id && f->hash[i] == hash) {
+            f->suppressed++;
+            return true;
+        }
+    }
+    f->msg_id[f->next] = msg_id;
+    f->hash[f->next] = hash;
+    f->next = (f->next + 1) % DUP_FILTER_SIZE;
+    if (f->count < DUP_FILTER_SIZE) {
+        f->count++;
+    }
+    return false;
+}
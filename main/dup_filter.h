@@ -0,0 +1,54 @@
+/*
+ * Inbound duplicate filter
+ *
+ * A QoS 1 message whose PUBACK was lost is delivered again after the
+ * reconnection, with the DUP flag set. A reply on /client_gpt delivered
+ * twice would start a second OpenAI request, so the last DUP_FILTER_SIZE
+ * QoS 1 messages are kept as (packet id, hash) pairs, and a message with the
+ * DUP flag matching one of them is dropped.
+ *
+ * The hash covers the topic, the total length and the first fragment, the
+ * only part known when a long message starts arriving. A message without
+ * the DUP flag is never dropped: a repeated command is delivered even when
+ * the broker reuses a packet id within the window.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DUP_FILTER_SIZE 16
+
+typedef struct {
+    uint16_t msg_id[DUP_FILTER_SIZE];
+    uint32_t hash[DUP_FILTER_SIZE];
+    uint8_t next;                   // Slot replaced by the next message
+    uint8_t count;                  // Slots in use
+    uint32_t suppressed;
+} dup_filter_t;
+
+void dup_filter_init(dup_filter_t *f);
+
+/*
+ * @brief Hash identifying a message
+ *
+ * @param data First fragment of the payload
+ * @param total_len Length of the whole payload
+ */
+uint32_t dup_filter_hash(const char *topic, int topic_len, const char *data, int len, int total_len);
+
+/*
+ * @brief Record a message, checking a redelivered one against the recent ones
+ *
+ * @param dup DUP flag of the PUBLISH packet
+ * @return true if it is a duplicate, counted in suppressed
+ */
+bool dup_filter_check(dup_filter_t *f, uint16_t msg_id, uint32_t hash, bool dup);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,66 @@
+#include <string.h>
+
+#include "gpio_coalescer.h"
+
+// Frame length of a single event with a zero delta, as it would be sent without coalescing
+#define SINGLE_EVENT_FRAME_LEN (GPIO_EVENT_HEADER_LEN + 2)
+
+void gpio_coalescer_init(gpio_coalescer_t *c, const gpio_coalescer_config_t *cfg, gpio_event_t *storage)
+{
+    memset(c, 0, sizeof(*c));
+    c->cfg = *cfg;
+    if (c->cfg.max_events == 0) {
+        c->cfg.max_events = 1;
+    } else if (c->cfg.max_events > GPIO_EVENT_MAX_PER_FRAME) {
+        c->cfg.max_events = GPIO_EVENT_MAX_PER_FRAME;
+    }
+    c->events = storage;
+}
+
+bool gpio_coalescer_add(gpio_coalescer_t *c, const gpio_event_t *event)
+{
+    if (gpio_coalescer_is_full(c)) {
+        return false;
+    }
+    c->events[c->count++] = *event;
+    return true;
+}
+
+bool gpio_coalescer_is_full(const gpio_coalescer_t *c)
+{
+    return c->count >= c->cfg.max_events;
+}
+
+int64_t gpio_coalescer_deadline(const gpio_coalescer_t *c)
+{
+    if (c->count == 0) {
+        return INT64_MAX;
+    }
+
+    // Whichever comes first: quiet window after the newest event or latency cap of the oldest
+    int64_t quiet = c->events[c->count - 1].timestamp_us + c->cfg.window_us;
+    int64_t cap = c->events[0].timestamp_us + c->cfg.max_latency_us;
+    return quiet < cap ? quiet : cap;
+}
+
+int gpio_coalescer_flush(gpio_coalescer_t *c, uint8_t *buf, size_t buf_len)
+{
+    if (c->count == 0) {
+        return 0;
+    }
+
+    int len = gpio_event_encode(c->events, c->count, c->next_seq, buf, buf_len);
+    if (len < 0) {
+        return -1;
+    }
+
+    // Account what was sent against one publish per event
+    c->stats.events += c->count;
+    c->stats.publishes++;
+    c->stats.bytes += len + c->cfg.packet_overhead;
+    c->stats.bytes_unbatched += c->count * (SINGLE_EVENT_FRAME_LEN + c->cfg.packet_overhead);
+
+    c->next_seq += c->count;
+    c->count = 0;
+    return len;
+}
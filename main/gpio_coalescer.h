@@ -0,0 +1,88 @@
+/*
+ * Time-window coalescing of GPIO events
+ *
+ * Events are collected until one of the limits is reached and then packed
+ * into a single gpio_event_codec frame, so a burst of edges costs one MQTT
+ * publish instead of one per scan:
+ *  - window: no new event arrived for window_us since the last one
+ *  - latency cap: the oldest pending event is max_latency_us old
+ *  - batch size: max_events events are pending
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "gpio_event_codec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int64_t window_us;          // Quiet time after the last event before flushing (0 = flush every add)
+    int64_t max_latency_us;     // Upper bound on the time an event waits in the batch
+    size_t max_events;          // Batch size, 1 to GPIO_EVENT_MAX_PER_FRAME
+    size_t packet_overhead;     // MQTT bytes added to every publish (fixed header + topic)
+} gpio_coalescer_config_t;
+
+// Cumulative counters, used to report the savings of coalescing
+typedef struct {
+    uint32_t events;            // Events published
+    uint32_t publishes;         // Frames published
+    uint32_t bytes;             // Bytes sent, MQTT overhead included
+    uint32_t bytes_unbatched;   // Bytes the same events would cost with one publish each
+} gpio_coalescer_stats_t;
+
+typedef struct {
+    gpio_coalescer_config_t cfg;
+    gpio_event_t *events;       // Caller-provided storage for cfg.max_events events
+    size_t count;
+    uint32_t next_seq;          // Sequence number of the next event to publish
+    gpio_coalescer_stats_t stats;
+} gpio_coalescer_t;
+
+/*
+ * @brief Initialize a coalescer
+ *
+ * @param c Coalescer to initialize
+ * @param cfg Limits, copied into the coalescer
+ * @param storage Array of cfg->max_events events owned by the caller
+ */
+void gpio_coalescer_init(gpio_coalescer_t *c, const gpio_coalescer_config_t *cfg, gpio_event_t *storage);
+
+/*
+ * @brief Add one event to the pending batch
+ *
+ * The caller must flush first when gpio_coalescer_is_full() is true.
+ *
+ * @return false if the batch is already full and the event was dropped
+ */
+bool gpio_coalescer_add(gpio_coalescer_t *c, const gpio_event_t *event);
+
+/*
+ * @brief Check whether the pending batch has reached max_events
+ */
+bool gpio_coalescer_is_full(const gpio_coalescer_t *c);
+
+/*
+ * @brief Time at which the pending batch must be flushed
+ *
+ * @return Deadline in microseconds, or INT64_MAX when nothing is pending
+ */
+int64_t gpio_coalescer_deadline(const gpio_coalescer_t *c);
+
+/*
+ * @brief Encode the pending batch into one frame and empty the batch
+ *
+ * @param c Coalescer
+ * @param buf Output buffer, GPIO_EVENT_FRAME_LEN(max_events) bytes always fit
+ * @param buf_len Size of the output buffer
+ * @return Frame length, 0 when nothing was pending, -1 if buf is too small
+ */
+int gpio_coalescer_flush(gpio_coalescer_t *c, uint8_t *buf, size_t buf_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,57 @@
+#include "gpio_event_codec.h"
+
+// Store a value in little-endian order
+static void put_le(uint8_t *p, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+// Append an unsigned LEB128 varint, returns the number of bytes written
+static size_t put_varint(uint8_t *p, uint64_t value)
+{
+    size_t n = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        p[n++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    return n;
+}
+
+int gpio_event_encode(const gpio_event_t *events, size_t count, uint32_t first_seq,
+                      uint8_t *buf, size_t buf_len)
+{
+    if (events == NULL || buf == NULL || count == 0 || count > GPIO_EVENT_MAX_PER_FRAME) {
+        return -1;
+    }
+    if (buf_len < GPIO_EVENT_HEADER_LEN) {
+        return -1;
+    }
+
+    // Header: version, count, first sequence number and base timestamp
+    buf[0] = GPIO_EVENT_FRAME_VERSION;
+    buf[1] = (uint8_t)count;
+    put_le(&buf[2], first_seq, 4);
+    put_le(&buf[6], (uint64_t)events[0].timestamp_us, 8);
+    size_t len = GPIO_EVENT_HEADER_LEN;
+
+    int64_t prev_ts = events[0].timestamp_us;
+    for (size_t i = 0; i < count; i++) {
+        const gpio_event_t *ev = &events[i];
+        if (ev->pin > 63 || ev->timestamp_us < prev_ts) {
+            return -1;
+        }
+        if (buf_len - len < GPIO_EVENT_MAX_ENCODED_LEN) {
+            return -1;
+        }
+
+        // Pin and edge share one byte, the timestamp is a delta to the previous event
+        buf[len++] = ev->pin | (ev->edge == GPIO_EVENT_EDGE_RISING ? 0x80 : 0);
+        len += put_varint(&buf[len], (uint64_t)(ev->timestamp_us - prev_ts));
+        prev_ts = ev->timestamp_us;
+    }
+
+    return (int)len;
+}
@@ -0,0 +1,64 @@
+/*
+ * Compact binary encoding of GPIO events
+ *
+ * Frame layout, version 1 (multi-byte fields are little-endian):
+ *
+ *   offset  size  field
+ *   0       1     version (GPIO_EVENT_FRAME_VERSION)
+ *   1       1     number of events N
+ *   2       4     sequence number of the first event
+ *   6       8     timestamp of the first event, microseconds since boot
+ *   14      ...   N events:
+ *                   1 byte   pin in bits 0-5, edge in bit 7 (1 = rising)
+ *                   varint   microseconds since the previous event (0 for the first)
+ *
+ * Events of one frame have consecutive sequence numbers, so a consumer can
+ * detect lost events by comparing the first sequence number of a frame with
+ * the one it expected.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GPIO_EVENT_FRAME_VERSION 1
+#define GPIO_EVENT_HEADER_LEN 14
+// Pin/edge byte plus the longest varint of a 64-bit delta
+#define GPIO_EVENT_MAX_ENCODED_LEN (1 + 10)
+#define GPIO_EVENT_MAX_PER_FRAME 255
+// Buffer size that always holds a frame of n events
+#define GPIO_EVENT_FRAME_LEN(n) (GPIO_EVENT_HEADER_LEN + (n) * GPIO_EVENT_MAX_ENCODED_LEN)
+
+typedef enum {
+    GPIO_EVENT_EDGE_FALLING = 0,
+    GPIO_EVENT_EDGE_RISING = 1,
+} gpio_event_edge_t;
+
+typedef struct {
+    uint8_t pin;                // GPIO number, 0-63
+    gpio_event_edge_t edge;     // Level transition seen on the pin
+    int64_t timestamp_us;       // Monotonic time of the event (esp_timer_get_time())
+} gpio_event_t;
+
+/*
+ * @brief Encode events into one version 1 frame
+ *
+ * Events must be ordered by timestamp.
+ *
+ * @param events Events to encode
+ * @param count Number of events, 1 to GPIO_EVENT_MAX_PER_FRAME
+ * @param first_seq Sequence number given to events[0]
+ * @param buf Output buffer
+ * @param buf_len Size of the output buffer
+ * @return Frame length in bytes, or -1 if the arguments are invalid or buf is too small
+ */
+int gpio_event_encode(const gpio_event_t *events, size_t count, uint32_t first_seq,
+                      uint8_t *buf, size_t buf_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <inttypes.h>
+
+#include "gpio_pins.h"
+
+bool gpio_pins_parse(const char *list, uint64_t *mask_out)
+{
+    uint64_t mask = 0;
+    const char *p = list;
+
+    while (*p != '\0') {
+        char *end;
+
+        // Skip separators and whitespace between entries
+        if (*p == ',' || isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+
+        long first = strtol(p, &end, 10);
+        if (end == p) {
+            return false;
+        }
+        long last = first;
+        p = end;
+
+        // Optional "first-last" range
+        if (*p == '-') {
+            p++;
+            last = strtol(p, &end, 10);
+            if (end == p) {
+                return false;
+            }
+            p = end;
+        }
+
+        if (first < 0 || last > 63 || first > last) {
+            return false;
+        }
+        for (long pin = first; pin <= last; pin++) {
+            mask |= 1ULL << pin;
+        }
+    }
+
+    *mask_out = mask;
+    return true;
+}
+
+int gpio_pins_format_changes(uint64_t changed, uint64_t levels, int64_t timestamp_us,
+                             char *buf, size_t buf_len)
+{
+    int len = snprintf(buf, buf_len, "{\"ts\":%" PRId64 ",\"changes\":[", timestamp_us);
+    if (len < 0 || (size_t)len >= buf_len) {
+        return -1;
+    }
+
+    bool first = true;
+    while (changed != 0) {
+        // Walk only the set bits, lowest pin first
+        int pin = __builtin_ctzll(changed);
+        changed &= changed - 1;
+
+        int n = snprintf(buf + len, buf_len - len, "%s{\"pin\":%d,\"level\":%d}",
+                         first ? "" : ",", pin, (int)((levels >> pin) & 1));
+        if (n < 0 || (size_t)n >= buf_len - len) {
+            return -1;
+        }
+        len += n;
+        first = false;
+    }
+
+    int n = snprintf(buf + len, buf_len - len, "]}");
+    if (n < 0 || (size_t)n >= buf_len - len) {
+        return -1;
+    }
+    return len + n;
+}
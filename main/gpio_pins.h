@@ -0,0 +1,46 @@
+/*
+ * Pin lists and pin change messages of the GPIO scanner
+ *
+ * The string side of gpio_scanner.h, kept apart from the driver code so
+ * that it builds on the host: parsing the pin lists of menuconfig and
+ * formatting the JSON message of one scan.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * @brief Parse a pin list such as "4,5,12-15" into a 64-bit pin mask
+ *
+ * Whitespace is ignored. Pins must be in the range 0-63.
+ *
+ * @param list Comma-separated list of pins and inclusive pin ranges
+ * @param mask_out Resulting bit mask (bit N set means GPIO N is listed), unchanged on error
+ * @return false on a malformed list
+ */
+bool gpio_pins_parse(const char *list, uint64_t *mask_out);
+
+/*
+ * @brief Format the changed pins of one scan as a single JSON message
+ *
+ * Output looks like {"ts":123456,"changes":[{"pin":4,"level":1}]}.
+ *
+ * @param changed Pins whose level changed (previous XOR current)
+ * @param levels Current pin levels
+ * @param timestamp_us Time of the scan in microseconds since boot
+ * @param buf Output buffer
+ * @param buf_len Size of the output buffer
+ * @return Length of the message, or -1 if it does not fit in buf
+ */
+int gpio_pins_format_changes(uint64_t changed, uint64_t levels, int64_t timestamp_us,
+                             char *buf, size_t buf_len);
+
+#ifdef __cplusplus
+}
+#endif
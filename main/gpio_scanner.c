@@ -0,0 +1,115 @@
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "freertos/task.h"
+#include "soc/soc.h"
+#include "soc/soc_caps.h"
+#include "soc/gpio_reg.h"
+
+#include "gpio_scanner.h"
+
+static const char *TAG = "gpio_scanner";
+
+// Pins configured by gpio_scanner_init(), used to mask out unrelated register bits
+static uint64_t s_pin_mask = 0;
+
+// Task blocked in gpio_scanner_wait_edge(), woken by the edge interrupt
+static TaskHandle_t s_waiter = NULL;
+// Time of the first edge not yet returned by gpio_scanner_wait_edge(), 0 if none
+static int64_t s_first_edge_us = 0;
+static portMUX_TYPE s_edge_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ * @brief Edge interrupt shared by all scanned pins
+ *
+ * Only records when the burst of edges started and wakes the scanning task;
+ * the pins themselves are read by the task once they settled.
+ */
+static void IRAM_ATTR gpio_scanner_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+
+    portENTER_CRITICAL_ISR(&s_edge_lock);
+    if (s_first_edge_us == 0) {
+        s_first_edge_us = esp_timer_get_time();
+    }
+    portEXIT_CRITICAL_ISR(&s_edge_lock);
+
+    if (s_waiter != NULL) {
+        vTaskNotifyGiveFromISR(s_waiter, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+esp_err_t gpio_scanner_init(uint64_t pin_mask)
+{
+    // Reject pins that do not exist on this chip before touching the hardware
+    for (int pin = 0; pin < 64; pin++) {
+        if ((pin_mask & (1ULL << pin)) && !GPIO_IS_VALID_GPIO(pin)) {
+            ESP_LOGE(TAG, "GPIO %d is not a valid input on this chip", pin);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    // All scanned pins share one configuration, applied in a single call
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_ANYEDGE,      // Any edge wakes the scanning task
+        .mode = GPIO_MODE_INPUT,
+        .pin_bit_mask = pin_mask,
+        .pull_down_en = GPIO_PULLDOWN_ENABLE,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+    };
+    esp_err_t err = gpio_config(&io_conf);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // The ISR service may already be installed by another driver
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return err;
+    }
+    for (int pin = 0; pin < 64; pin++) {
+        if (pin_mask & (1ULL << pin)) {
+            err = gpio_isr_handler_add(pin, gpio_scanner_isr, NULL);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+
+    s_pin_mask = pin_mask;
+    ESP_LOGI(TAG, "Scanning %d input pins, mask=0x%010" PRIx64,
+             __builtin_popcountll(pin_mask), pin_mask);
+    return ESP_OK;
+}
+
+int64_t gpio_scanner_wait_edge(TickType_t timeout)
+{
+    s_waiter = xTaskGetCurrentTaskHandle();
+
+    if (ulTaskNotifyTake(pdTRUE, timeout) == 0) {
+        return -1;
+    }
+
+    // Consume the timestamp so the next burst records its own
+    portENTER_CRITICAL(&s_edge_lock);
+    int64_t edge_us = s_first_edge_us;
+    s_first_edge_us = 0;
+    portEXIT_CRITICAL(&s_edge_lock);
+
+    return edge_us != 0 ? edge_us : esp_timer_get_time();
+}
+
+uint64_t gpio_scanner_read(void)
+{
+    // One register read covers 32 pins, so the cost is fixed whatever the pin count
+    uint64_t levels = REG_READ(GPIO_IN_REG);
+#if SOC_GPIO_PIN_COUNT > 32
+    levels |= (uint64_t)REG_READ(GPIO_IN1_REG) << 32;
+#endif
+    return levels & s_pin_mask;
+}
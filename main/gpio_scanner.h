@@ -0,0 +1,50 @@
+/*
+ * GPIO input scanner
+ *
+ * Reads every configured input pin with one access to the GPIO input
+ * register(s) and reports which pins changed since the previous scan.
+ * The cost of a scan does not depend on how many pins are configured.
+ * Scans are driven by edge interrupts: nothing runs while the inputs are idle.
+ * Pin lists and the JSON message of a scan are in gpio_pins.h.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * @brief Configure all pins in the mask as inputs with pull-down
+ *
+ * Every pin gets an any-edge interrupt that wakes gpio_scanner_wait_edge().
+ *
+ * @param pin_mask Pins to configure and scan
+ * @return ESP_OK, or the error of the GPIO driver
+ */
+esp_err_t gpio_scanner_init(uint64_t pin_mask);
+
+/*
+ * @brief Wait for an edge on any scanned pin
+ *
+ * Must always be called from the same task.
+ *
+ * @param timeout Maximum time to wait, portMAX_DELAY to wait forever
+ * @return Time of the first edge since the previous call in microseconds
+ *         since boot, or -1 on timeout
+ */
+int64_t gpio_scanner_wait_edge(TickType_t timeout);
+
+/*
+ * @brief Read the level of every scanned pin in one register access
+ *
+ * @return Bit mask of pin levels, restricted to the scanned pins
+ */
+uint64_t gpio_scanner_read(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,120 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+
+#include "happy_eyeballs.h"
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/*
+ * @brief Start a non-blocking connection
+ *
+ * @return Socket, or -1 if the attempt failed at once (no route, no socket left)
+ */
+static int attempt_start(const struct sockaddr_storage *addr)
+{
+    socklen_t len = addr->ss_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+    int fd = socket(addr->ss_family, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    // Connected at once or in progress, either way the socket becomes writable
+    if (connect(fd, (const struct sockaddr *)addr, len) != 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int happy_eyeballs_connect(const struct sockaddr_storage *addrs, int count, int stagger_ms, int timeout_ms,
+                           int *winner)
+{
+    int fds[HAPPY_EYEBALLS_MAX];
+    int started = 0;
+    int pending = 0;
+    int fd = -1;
+    int64_t now = now_ms();
+    int64_t deadline = now + timeout_ms;
+    int64_t next_start = now;
+
+    *winner = -1;
+    if (count > HAPPY_EYEBALLS_MAX) {
+        count = HAPPY_EYEBALLS_MAX;
+    }
+    while (fd < 0) {
+        now = now_ms();
+        if (now >= deadline) {
+            break;
+        }
+        // The next attempt starts at its turn, or at once when none is left in flight
+        if (started < count && (now >= next_start || pending == 0)) {
+            fds[started] = attempt_start(&addrs[started]);
+            pending += fds[started] >= 0;
+            next_start = fds[started] >= 0 ? now + stagger_ms : now;
+            started++;
+            continue;
+        }
+        if (pending == 0) {
+            break;
+        }
+
+        fd_set wfds;
+        int max_fd = -1;
+        FD_ZERO(&wfds);
+        for (int i = 0; i < started; i++) {
+            if (fds[i] >= 0) {
+                FD_SET(fds[i], &wfds);
+                max_fd = fds[i] > max_fd ? fds[i] : max_fd;
+            }
+        }
+        int64_t wait_ms = deadline - now;
+        if (started < count && next_start - now < wait_ms) {
+            wait_ms = next_start - now;
+        }
+        struct timeval tv = {.tv_sec = wait_ms / 1000, .tv_usec = (wait_ms % 1000) * 1000};
+        if (select(max_fd + 1, NULL, &wfds, NULL, &tv) < 0 && errno != EINTR) {
+            break;
+        }
+        for (int i = 0; i < started && fd < 0; i++) {
+            if (fds[i] < 0 || !FD_ISSET(fds[i], &wfds)) {
+                continue;
+            }
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(fds[i], SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err == 0) {
+                fd = fds[i];
+                fds[i] = -1;
+                *winner = i;
+            } else {
+                // Refused or unreachable: the next attempt need not wait for its turn
+                close(fds[i]);
+                fds[i] = -1;
+                pending--;
+                next_start = now;
+            }
+        }
+    }
+
+    for (int i = 0; i < started; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+    }
+    return fd;
+}
@@ -0,0 +1,38 @@
+/*
+ * Happy eyeballs connection racing (RFC 8305)
+ *
+ * Connects to the addresses of a host in the order given, starting the next
+ * attempt when the previous one has not completed within the stagger
+ * instead of waiting for its timeout, or at once when it failed. The first
+ * connection established wins and the others are closed: a blackholed
+ * address family costs the stagger, not a TCP connection timeout.
+ *
+ * Plain POSIX sockets, so that the same code runs on lwIP and in the host
+ * tests against real blackholed addresses.
+ */
+#pragma once
+
+#include <sys/socket.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HAPPY_EYEBALLS_MAX 4
+
+/*
+ * @brief Race connections to the addresses, IPv4 or IPv6
+ *
+ * @param addrs Addresses in order of preference, usually IPv6 then IPv4
+ * @param count Number of addresses, at most HAPPY_EYEBALLS_MAX
+ * @param stagger_ms Head start of each attempt over the next one
+ * @param timeout_ms Time after which every attempt is given up
+ * @param winner Set to the index of the address connected to, -1 if none
+ * @return Connected socket, in blocking mode, or -1
+ */
+int happy_eyeballs_connect(const struct sockaddr_storage *addrs, int count, int stagger_ms, int timeout_ms,
+                           int *winner);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,248 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "json_partial.h"
+
+enum {
+    ST_KEY,                     // Matching "key"
+    ST_COLON,                   // Key matched, colon expected
+    ST_OPEN,                    // Opening quote of the value expected
+    ST_STRING,
+    ST_ESCAPE,                  // Inside an escape, its bytes in esc
+    ST_COMPLETE,
+    ST_INVALID,
+};
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/*
+ * @brief Code unit of the 4 hex digits of a \u escape, -1 if one is not a hex digit
+ */
+static int32_t read_u16(const char *p)
+{
+    int32_t value = 0;
+
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_value(p[i]);
+        if (digit < 0) {
+            return -1;
+        }
+        value = value << 4 | digit;
+    }
+    return value;
+}
+
+static size_t utf8_encode(uint32_t cp, char *buf)
+{
+    if (cp < 0x80) {
+        buf[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        buf[0] = (char)(0xC0 | cp >> 6);
+        buf[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        buf[0] = (char)(0xE0 | cp >> 12);
+        buf[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+        buf[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    buf[0] = (char)(0xF0 | cp >> 18);
+    buf[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+    buf[2] = (char)(0x80 | (cp >> 6 & 0x3F));
+    buf[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/*
+ * @brief Length of the UTF-8 sequence starting with this byte, 1 for anything else
+ */
+static size_t utf8_len(unsigned char c)
+{
+    if (c >= 0xF0 && c < 0xF8) {
+        return 4;
+    }
+    if (c >= 0xE0) {
+        return c < 0xF0 ? 3 : 1;
+    }
+    return c >= 0xC0 ? 2 : 1;
+}
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/*
+ * @brief Character i of the quoted key
+ */
+static char key_char(const json_partial_t *j, size_t i)
+{
+    return i == 0 || i == j->key_len + 1 ? '"' : j->key[i - 1];
+}
+
+void json_partial_init(json_partial_t *j, const char *key)
+{
+    memset(j, 0, sizeof(*j));
+    j->key = key;
+    j->key_len = strlen(key);
+    j->state = ST_KEY;
+}
+
+/*
+ * @brief Decode the escape in esc once it is whole
+ */
+static void escape_step(json_partial_t *j, json_partial_emit_t emit, void *ctx)
+{
+    char buf[4];
+    size_t size = 1;
+
+    switch (j->esc[0]) {
+    case 'n': buf[0] = '\n'; break;
+    case 't': buf[0] = '\t'; break;
+    case 'r': buf[0] = '\r'; break;
+    case 'b': buf[0] = '\b'; break;
+    case 'f': buf[0] = '\f'; break;
+    case 'u': {
+        if (j->esc_len < 5) {
+            return;
+        }
+        int32_t cp = read_u16(j->esc + 1);
+        if (cp < 0) {
+            j->state = ST_INVALID;
+            return;
+        }
+        // A high surrogate needs the low one that follows
+        if (cp >= 0xD800 && cp < 0xDC00) {
+            if ((j->esc_len >= 6 && j->esc[5] != '\\') || (j->esc_len >= 7 && j->esc[6] != 'u')) {
+                j->state = ST_INVALID;
+                return;
+            }
+            if (j->esc_len < 11) {
+                return;
+            }
+            int32_t low = read_u16(j->esc + 7);
+            if (low < 0xDC00 || low >= 0xE000) {
+                j->state = ST_INVALID;
+                return;
+            }
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        }
+        size = utf8_encode((uint32_t)cp, buf);
+        break;
+    }
+    default:
+        // \" \\ \/
+        buf[0] = j->esc[0];
+        break;
+    }
+    emit(buf, size, ctx);
+    j->state = ST_STRING;
+}
+
+static json_partial_status_t status(const json_partial_t *j)
+{
+    switch (j->state) {
+    case ST_STRING:
+    case ST_ESCAPE:
+        return JSON_PARTIAL_VALUE;
+    case ST_COMPLETE:
+        return JSON_PARTIAL_COMPLETE;
+    case ST_INVALID:
+        return JSON_PARTIAL_INVALID;
+    default:
+        return JSON_PARTIAL_SEARCHING;
+    }
+}
+
+json_partial_status_t json_partial_feed(json_partial_t *j, const char *in, size_t len,
+                                        json_partial_emit_t emit, void *ctx)
+{
+    const char *p = in;
+    const char *end = in + len;
+
+    while (p < end && j->state != ST_COMPLETE && j->state != ST_INVALID) {
+        char c = *p;
+
+        switch (j->state) {
+        case ST_KEY:
+            if (c == key_char(j, j->matched)) {
+                if (++j->matched == j->key_len + 2) {
+                    j->state = ST_COLON;
+                }
+            } else {
+                // The quote that broke the match may open the key
+                j->matched = c == '"';
+            }
+            p++;
+            break;
+        case ST_COLON:
+            if (c == ':') {
+                j->state = ST_OPEN;
+            } else if (!is_space(c)) {
+                // Not a key after all, e.g. a string value
+                j->state = ST_KEY;
+                j->matched = c == '"';
+            }
+            p++;
+            break;
+        case ST_OPEN:
+            if (c == '"') {
+                j->state = ST_STRING;
+            } else if (!is_space(c)) {
+                j->state = ST_INVALID;
+            }
+            p++;
+            break;
+        case ST_STRING: {
+            // Plain characters go out in one run, straight from the input
+            const char *run = p;
+            while (p < end && *p != '"' && *p != '\\') {
+                p++;
+            }
+            if (p > run) {
+                emit(run, p - run, ctx);
+            }
+            if (p < end) {
+                j->state = *p == '"' ? ST_COMPLETE : ST_ESCAPE;
+                j->esc_len = 0;
+                p++;
+            }
+            break;
+        }
+        case ST_ESCAPE:
+            j->esc[j->esc_len++] = c;
+            p++;
+            escape_step(j, emit, ctx);
+            break;
+        }
+    }
+    return status(j);
+}
+
+size_t json_partial_utf8_complete(const char *s, size_t len)
+{
+    // The last character starts at most 4 bytes before the end
+    for (size_t i = 1; i <= 4 && i <= len; i++) {
+        unsigned char c = (unsigned char)s[len - i];
+        if ((c & 0xC0) == 0x80) {
+            continue;
+        }
+        return utf8_len(c) > i ? len - i : len;
+    }
+    return len;
+}
@@ -0,0 +1,78 @@
+/*
+ * String value of a JSON document read piece by piece
+ *
+ * The LLM response is not kept in RAM: it is fed to this decoder one read
+ * block at a time, and the string value of a key comes out decoded as soon
+ * as its bytes arrive, whatever the block boundaries (a key, an escape or a
+ * surrogate pair may be split between two blocks). The RAM needed does not
+ * depend on the size of the document nor of the value.
+ *
+ * The key is matched textually, first occurrence, without regard for the
+ * nesting: fine for "content" in a chat completion, where no other field
+ * of that name comes before choices[0].message.content, or for "message"
+ * in an API error.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    JSON_PARTIAL_SEARCHING,     // The key was not seen yet
+    JSON_PARTIAL_VALUE,         // Inside the value, more may follow
+    JSON_PARTIAL_COMPLETE,      // Closing quote of the value seen
+    JSON_PARTIAL_INVALID,       // The key is not followed by a string, or the value holds a malformed escape
+} json_partial_status_t;
+
+/*
+ * Called with the decoded value as it comes, in runs of any length. Escapes
+ * are decoded, \uXXXX to UTF-8; a run may end inside a UTF-8 character, the
+ * next one continues it.
+ */
+typedef void (*json_partial_emit_t)(const char *data, size_t len, void *ctx);
+
+typedef struct {
+    const char *key;
+    size_t key_len;
+    size_t matched;             // Characters of "key" (quotes included) matched so far
+    uint8_t state;
+    char esc[11];               // Escape being read, after its backslash: up to u + 4 hex + \u + 4 hex
+    uint8_t esc_len;
+} json_partial_t;
+
+/*
+ * @brief Start looking for the string value of "key": in a new document
+ *
+ * @param key Key to look for, without quotes; must stay valid while the document is fed
+ */
+void json_partial_init(json_partial_t *j, const char *key);
+
+/*
+ * @brief Feed the next bytes of the document
+ *
+ * Bytes fed once the value is complete or invalid are ignored.
+ *
+ * @param in Next bytes, not NUL-terminated
+ * @param len Number of bytes
+ * @param emit Called with the decoded bytes of the value found in this block
+ * @param ctx Passed to emit
+ * @return Status after this block
+ */
+json_partial_status_t json_partial_feed(json_partial_t *j, const char *in, size_t len,
+                                        json_partial_emit_t emit, void *ctx);
+
+/*
+ * @brief Length of a UTF-8 string without the character its end cut in two
+ *
+ * For keeping the beginning of a value that does not fit a buffer.
+ */
+size_t json_partial_utf8_complete(const char *s, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
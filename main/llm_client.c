@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "cJSON.h"
+
+#include "llm_client.h"
+#include "json_partial.h"
+
+static const char *TAG = "llm_client";
+
+// Response body read at a time, decoded and handed on before the next read
+#define LLM_READ_BLOCK_LEN 512
+// Longest API error message logged
+#define LLM_ERROR_MSG_LEN 160
+// Connection and TLS handshake, and sending the request
+#define LLM_CONNECT_TIMEOUT_MS 10000
+
+static llm_client_stats_t s_stats;
+
+uint32_t llm_cancel(llm_cancel_t *cancel)
+{
+    cancel->cancelled_us = esp_timer_get_time();
+    // Atomic: the GPIO and MQTT tasks may cancel at the same time
+    return __atomic_add_fetch(&cancel->generation, 1, __ATOMIC_SEQ_CST);
+}
+
+static bool is_cancelled(const llm_cancel_t *cancel, uint32_t generation)
+{
+    return cancel->generation != generation;
+}
+
+/*
+ * @brief Build the JSON request body, to be freed with cJSON_free()
+ */
+static char *build_request(const llm_message_t *messages, size_t count)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (root == NULL) {
+        return NULL;
+    }
+    cJSON_AddStringToObject(root, "model", CONFIG_OPENAI_MODEL);
+    cJSON_AddNumberToObject(root, "temperature", 0.7);
+    cJSON *array = cJSON_AddArrayToObject(root, "messages");
+    for (size_t i = 0; array != NULL && i < count; i++) {
+        cJSON *msg = cJSON_CreateObject();
+        if (msg == NULL) {
+            break;
+        }
+        cJSON_AddStringToObject(msg, "role", messages[i].role);
+        cJSON_AddStringToObject(msg, "content", messages[i].content);
+        cJSON_AddItemToArray(array, msg);
+    }
+    char *body = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return body;
+}
+
+/*
+ * Answer being received: decoded from the JSON as the body arrives, copied
+ * (its beginning) into the caller's buffer and handed on to the callback
+ */
+typedef struct {
+    json_partial_t json;
+    char *out;
+    size_t out_len;
+    size_t out_used;
+    bool out_full;
+    size_t len;                     // Whole answer so far
+    llm_answer_cb_t on_answer;
+    void *ctx;
+} answer_t;
+
+static void answer_init(answer_t *a, const char *key, char *out, size_t out_len, llm_answer_cb_t on_answer, void *ctx)
+{
+    memset(a, 0, sizeof(*a));
+    json_partial_init(&a->json, key);
+    a->out = out;
+    a->out_len = out_len;
+    a->on_answer = on_answer;
+    a->ctx = ctx;
+    out[0] = '\0';
+}
+
+/*
+ * @brief json_partial emit callback: the next bytes of the answer
+ */
+static void answer_emit(const char *data, size_t len, void *arg)
+{
+    answer_t *a = arg;
+
+    a->len += len;
+    if (!a->out_full) {
+        size_t room = a->out_len - 1 - a->out_used;
+        size_t n = len < room ? len : room;
+        memcpy(a->out + a->out_used, data, n);
+        a->out_used += n;
+        if (n < len) {
+            // Truncated between two characters, so the copy stays valid UTF-8
+            a->out_used = json_partial_utf8_complete(a->out, a->out_used);
+            a->out_full = true;
+        }
+        a->out[a->out_used] = '\0';
+    }
+    if (a->on_answer != NULL) {
+        a->on_answer(data, len, false, a->ctx);
+    }
+}
+
+/*
+ * @brief Wait for the response headers, checking the cancellation token between polls
+ *
+ * The read timeout of the client is CONFIG_LLM_CANCEL_POLL_MS, so a read never
+ * blocks longer than that while the server is still generating the answer.
+ */
+static esp_err_t read_headers(esp_http_client_handle_t client, const llm_cancel_t *cancel,
+                              uint32_t generation, int64_t deadline_us)
+{
+    // fetch_headers() returns -ESP_ERR_HTTP_EAGAIN when the poll timed out
+    while (1) {
+        if (is_cancelled(cancel, generation)) {
+            return LLM_ERR_CANCELLED;
+        }
+        int64_t content_len = esp_http_client_fetch_headers(client);
+        if (content_len >= 0) {
+            return ESP_OK;
+        }
+        if (content_len != -ESP_ERR_HTTP_EAGAIN) {
+            return ESP_FAIL;
+        }
+        if (esp_timer_get_time() >= deadline_us) {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+}
+
+/*
+ * @brief Read the body block by block into the JSON decoder, until the value looked for is complete
+ *
+ * Only one block is in RAM at a time, whatever the length of the answer.
+ * The rest of the body (finish reason, token usage) is not read.
+ */
+static esp_err_t read_answer(esp_http_client_handle_t client, const llm_cancel_t *cancel,
+                             uint32_t generation, int64_t deadline_us, answer_t *a, char *block)
+{
+    json_partial_status_t st = JSON_PARTIAL_SEARCHING;
+
+    while (1) {
+        if (is_cancelled(cancel, generation)) {
+            return LLM_ERR_CANCELLED;
+        }
+        int r = esp_http_client_read(client, block, LLM_READ_BLOCK_LEN);
+        if (r > 0) {
+            st = json_partial_feed(&a->json, block, r, answer_emit, a);
+            if (st == JSON_PARTIAL_COMPLETE) {
+                return ESP_OK;
+            }
+            if (st == JSON_PARTIAL_INVALID) {
+                break;
+            }
+        } else if (r == 0 && esp_http_client_is_complete_data_received(client)) {
+            break;
+        } else if (r == -ESP_ERR_HTTP_EAGAIN || r == 0) {
+            if (esp_timer_get_time() >= deadline_us) {
+                return ESP_ERR_TIMEOUT;
+            }
+        } else {
+            return ESP_FAIL;
+        }
+    }
+    ESP_LOGE(TAG, "%s", st == JSON_PARTIAL_SEARCHING ? "No answer in response" :
+             st == JSON_PARTIAL_VALUE ? "Response ended inside the answer" : "Malformed answer in response");
+    return ESP_FAIL;
+}
+
+esp_err_t llm_client_chat(const llm_message_t *messages, size_t count,
+                          const llm_cancel_t *cancel, uint32_t generation,
+                          char *out, size_t out_len,
+                          llm_answer_cb_t on_answer, void *ctx)
+{
+    esp_err_t err;
+    int status = 0;
+    answer_t answer;
+    int64_t deadline_us = esp_timer_get_time() + CONFIG_LLM_TIMEOUT_MS * 1000LL;
+    uint32_t heap_before = esp_get_free_heap_size();
+
+    s_stats.requests++;
+    answer_init(&answer, "content", out, out_len, on_answer, ctx);
+
+    char *body = build_request(messages, count);
+    char *block = malloc(LLM_READ_BLOCK_LEN);
+    esp_http_client_handle_t client = NULL;
+    if (body == NULL || block == NULL) {
+        err = ESP_ERR_NO_MEM;
+        goto cleanup;
+    }
+
+    esp_http_client_config_t config = {
+        .url = CONFIG_OPENAI_API_URL,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = LLM_CONNECT_TIMEOUT_MS,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+    };
+    client = esp_http_client_init(&config);
+    if (client == NULL) {
+        err = ESP_ERR_NO_MEM;
+        goto cleanup;
+    }
+
+    // Sized from the key itself: project keys are longer than 160 characters
+    char auth[sizeof("Bearer ") + sizeof(CONFIG_OPENAI_API_KEY)];
+    snprintf(auth, sizeof(auth), "Bearer %s", CONFIG_OPENAI_API_KEY);
+    esp_http_client_set_header(client, "Content-Type", "application/json");
+    esp_http_client_set_header(client, "Authorization", auth);
+
+    // Cancelled while waiting in the queue, do not even connect
+    if (is_cancelled(cancel, generation)) {
+        err = LLM_ERR_CANCELLED;
+        goto cleanup;
+    }
+
+    int body_len = strlen(body);
+    err = esp_http_client_open(client, body_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Connection failed: %s", esp_err_to_name(err));
+        goto cleanup;
+    }
+    if (esp_http_client_write(client, body, body_len) != body_len) {
+        ESP_LOGE(TAG, "Failed to send request");
+        err = ESP_FAIL;
+        goto cleanup;
+    }
+    // The request is gone, free it now rather than holding it while the server works
+    cJSON_free(body);
+    body = NULL;
+
+    // From now on reads only block for one poll interval
+    esp_http_client_set_timeout_ms(client, CONFIG_LLM_CANCEL_POLL_MS);
+    err = read_headers(client, cancel, generation, deadline_us);
+    if (err == ESP_OK) {
+        status = esp_http_client_get_status_code(client);
+        if (status == 200) {
+            err = read_answer(client, cancel, generation, deadline_us, &answer, block);
+        } else {
+            // The error body is decoded the same way, for its message alone
+            char msg[LLM_ERROR_MSG_LEN];
+            answer_t error;
+            answer_init(&error, "message", msg, sizeof(msg), NULL, NULL);
+            read_answer(client, cancel, generation, deadline_us, &error, block);
+            ESP_LOGE(TAG, "HTTP status %d: %s", status, msg[0] != '\0' ? msg : "no error message");
+            err = ESP_FAIL;
+        }
+    }
+
+cleanup:
+    // Closing aborts the connection whatever state the request is in
+    if (client != NULL) {
+        esp_http_client_close(client);
+        esp_http_client_cleanup(client);
+    }
+    if (body != NULL) {
+        cJSON_free(body);
+    }
+
+    free(block);
+    if (err == ESP_OK) {
+        if (answer.out_full) {
+            ESP_LOGI(TAG, "Answer of %u bytes, first %u kept", (unsigned)answer.len, (unsigned)answer.out_used);
+        }
+        if (on_answer != NULL) {
+            on_answer(NULL, 0, true, ctx);
+        }
+    }
+
+    // Connection closed and every buffer freed: measure how long the cancel took
+    s_stats.last_heap_delta = (int32_t)(esp_get_free_heap_size() - heap_before);
+    if (err == LLM_ERR_CANCELLED) {
+        int64_t cancel_us = esp_timer_get_time() - cancel->cancelled_us;
+        s_stats.cancelled++;
+        s_stats.last_cancel_us = cancel_us;
+        if (cancel_us > s_stats.max_cancel_us) {
+            s_stats.max_cancel_us = cancel_us;
+        }
+        ESP_LOGI(TAG, "Request cancelled, connection and memory freed %" PRId64 " us after cancel, heap delta %" PRId32,
+                 cancel_us, s_stats.last_heap_delta);
+    } else if (err != ESP_OK) {
+        s_stats.errors++;
+        ESP_LOGE(TAG, "Request failed: %s", err == ESP_ERR_TIMEOUT ? "timeout" : esp_err_to_name(err));
+    }
+    return err;
+}
+
+void llm_client_get_stats(llm_client_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,97 @@
+/*
+ * Cancellable LLM client
+ *
+ * Sends a chat completion request to an OpenAI-compatible endpoint with
+ * esp_http_client. The response is read in short polls; between two polls
+ * the cancellation token is checked and, once it is set, the socket is
+ * closed and every buffer freed right away instead of waiting for the
+ * server to answer.
+ *
+ * The response body is not kept: each block read is fed to the JSON
+ * decoder (json_partial.h) and the answer handed on as it is decoded, so a
+ * request needs one read block of RAM whatever the length of the answer.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returned by llm_client_chat() when the request was cancelled
+#define LLM_ERR_CANCELLED 0x7101
+
+typedef struct {
+    const char *role;       // "system", "user" or "assistant"
+    const char *content;
+} llm_message_t;
+
+/*
+ * Cancellation token shared between the task running the request and the
+ * tasks cancelling it. A request belongs to one generation: it is cancelled
+ * as soon as the token generation moves past it.
+ */
+typedef struct {
+    volatile uint32_t generation;
+    volatile int64_t cancelled_us;  // Time of the last cancel, microseconds since boot
+} llm_cancel_t;
+
+/*
+ * Called with the answer as it is decoded, in runs of any length that may
+ * end inside a UTF-8 character, e.g. to publish it in full while only its
+ * beginning fits out. Once the whole answer was received it is called one
+ * more time with last set and no data; not when the request failed or was
+ * cancelled halfway. Runs in the task calling llm_client_chat().
+ */
+typedef void (*llm_answer_cb_t)(const char *data, size_t len, bool last, void *ctx);
+
+typedef struct {
+    uint32_t requests;
+    uint32_t cancelled;
+    uint32_t errors;
+    int64_t last_cancel_us;         // Cancel to connection closed and memory freed, last request
+    int64_t max_cancel_us;          // Same, worst case since boot
+    int32_t last_heap_delta;        // Free heap after the request minus before, 0 when nothing leaked
+} llm_client_stats_t;
+
+/*
+ * @brief Cancel the request of the current generation, callable from any task
+ *
+ * @return New generation, to be used by the next request
+ */
+uint32_t llm_cancel(llm_cancel_t *cancel);
+
+/*
+ * @brief Send the conversation and wait for the answer
+ *
+ * Blocks the calling task until the answer is received, the request failed
+ * or it was cancelled. Cancellation is noticed within CONFIG_LLM_CANCEL_POLL_MS
+ * once the response is awaited; the TLS handshake itself cannot be interrupted.
+ *
+ * @param messages Conversation, oldest message first
+ * @param count Number of messages
+ * @param cancel Cancellation token
+ * @param generation Generation of the token this request belongs to
+ * @param out Answer of the assistant, NUL-terminated and truncated to out_len - 1
+ * @param out_len Size of out
+ * @param on_answer Called with the answer as it arrives, may be NULL
+ * @param ctx Passed to on_answer
+ * @return ESP_OK, LLM_ERR_CANCELLED, ESP_ERR_TIMEOUT, ESP_ERR_NO_MEM or ESP_FAIL
+ */
+esp_err_t llm_client_chat(const llm_message_t *messages, size_t count,
+                          const llm_cancel_t *cancel, uint32_t generation,
+                          char *out, size_t out_len,
+                          llm_answer_cb_t on_answer, void *ctx);
+
+/*
+ * @brief Copy the request counters and cancellation timings
+ */
+void llm_client_get_stats(llm_client_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
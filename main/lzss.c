@@ -0,0 +1,150 @@
+#include <string.h>
+
+#include "lzss.h"
+
+static uint32_t hash3(const uint8_t *p)
+{
+    uint32_t v = p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16;
+    return (v * 2654435761u) >> (32 - LZSS_HASH_BITS);
+}
+
+bool lzss_encoder_init(lzss_encoder_t *e, const void *in, size_t len)
+{
+    if (len > LZSS_MAX_INPUT) {
+        return false;
+    }
+    e->in = in;
+    e->len = len;
+    e->pos = 0;
+    memset(e->head, 0, sizeof(e->head));
+    e->group_len = 0;
+    e->group_pos = 0;
+    return true;
+}
+
+/*
+ * @brief Remember position pos, bucket gets the earlier positions with the same hash
+ *
+ * The bucket is copied as it was before pos was added, most recent first.
+ */
+static void index_pos(lzss_encoder_t *e, size_t pos, uint16_t *bucket)
+{
+    uint16_t *ways = e->head[hash3(e->in + pos)];
+    memcpy(bucket, ways, sizeof(e->head[0]));
+    memmove(ways + 1, ways, sizeof(e->head[0]) - sizeof(ways[0]));
+    ways[0] = pos + 1;
+}
+
+/*
+ * @brief Encode the next flag byte and its up to 8 items into the group buffer
+ */
+static void fill_group(lzss_encoder_t *e)
+{
+    uint8_t flags = 0;
+    uint8_t n = 1;
+
+    for (int i = 0; i < 8 && e->pos < e->len; i++) {
+        size_t left = e->len - e->pos;
+        size_t best_len = 0;
+        size_t dist = 0;
+
+        // Longest match among the few recent positions with the same hash
+        if (left >= LZSS_MIN_MATCH) {
+            uint16_t bucket[LZSS_HASH_WAYS];
+            const uint8_t *b = e->in + e->pos;
+            size_t max = left < LZSS_MAX_MATCH ? left : LZSS_MAX_MATCH;
+            index_pos(e, e->pos, bucket);
+            for (int w = 0; w < LZSS_HASH_WAYS && bucket[w] != 0; w++) {
+                const uint8_t *a = e->in + bucket[w] - 1;
+                if (b - a > LZSS_WINDOW) {
+                    break;
+                }
+                size_t len = 0;
+                while (len < max && a[len] == b[len]) {
+                    len++;
+                }
+                if (len > best_len) {
+                    best_len = len;
+                    dist = b - a;
+                }
+            }
+        }
+
+        if (best_len >= LZSS_MIN_MATCH) {
+            uint16_t token = (uint16_t)((dist - 1) << 5 | (best_len - LZSS_MIN_MATCH));
+            flags |= 1 << i;
+            e->group[n++] = token & 0xFF;
+            e->group[n++] = token >> 8;
+            // Index the positions inside the match, later matches can start there
+            for (size_t k = 1; k < best_len && e->pos + k + LZSS_MIN_MATCH <= e->len; k++) {
+                uint16_t bucket[LZSS_HASH_WAYS];
+                index_pos(e, e->pos + k, bucket);
+            }
+            e->pos += best_len;
+        } else {
+            e->group[n++] = e->in[e->pos++];
+        }
+    }
+
+    e->group[0] = flags;
+    e->group_len = n;
+    e->group_pos = 0;
+}
+
+size_t lzss_encode(lzss_encoder_t *e, uint8_t *out, size_t out_len)
+{
+    size_t written = 0;
+
+    while (written < out_len) {
+        if (e->group_pos == e->group_len) {
+            if (e->pos == e->len) {
+                break;
+            }
+            fill_group(e);
+        }
+        size_t n = e->group_len - e->group_pos;
+        if (n > out_len - written) {
+            n = out_len - written;
+        }
+        if (out != NULL) {
+            memcpy(out + written, e->group + e->group_pos, n);
+        }
+        e->group_pos += n;
+        written += n;
+    }
+    return written;
+}
+
+size_t lzss_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_cap)
+{
+    size_t i = 0;
+    size_t o = 0;
+
+    while (i < len) {
+        uint8_t flags = in[i++];
+        for (int b = 0; b < 8 && i < len; b++) {
+            if (flags & (1 << b)) {
+                if (len - i < 2) {
+                    return LZSS_ERROR;
+                }
+                uint16_t token = in[i] | in[i + 1] << 8;
+                i += 2;
+                size_t dist = (token >> 5) + 1;
+                size_t n = (token & 0x1F) + LZSS_MIN_MATCH;
+                if (dist > o || n > out_cap - o) {
+                    return LZSS_ERROR;
+                }
+                // Byte by byte: the source may overlap what is being written
+                for (size_t k = 0; k < n; k++, o++) {
+                    out[o] = out[o - dist];
+                }
+            } else {
+                if (o == out_cap) {
+                    return LZSS_ERROR;
+                }
+                out[o++] = in[i++];
+            }
+        }
+    }
+    return o;
+}
@@ -0,0 +1,79 @@
+/*
+ * LZSS compression of text payloads
+ *
+ * Small-window LZ77 in the style of heatshrink, sized for conversation text
+ * on a microcontroller: the encoder keeps a 2 KB hash table and works in
+ * place on the input, the decoder needs no memory besides its output.
+ *
+ * Stream format: a flag byte announces the next 8 items, bit i set when item
+ * i is a match. A literal is one byte; a match is a little-endian u16 with
+ * the length minus LZSS_MIN_MATCH in bits 0-4 and the distance minus 1 in
+ * bits 5-15. The stream simply ends after the last item.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LZSS_WINDOW 2048
+#define LZSS_MIN_MATCH 3
+#define LZSS_MAX_MATCH (LZSS_MIN_MATCH + 31)
+// Match candidates: LZSS_HASH_WAYS recent positions for each of 2^LZSS_HASH_BITS hashes
+#define LZSS_HASH_BITS 8
+#define LZSS_HASH_WAYS 4
+// Longest input of one encoder, positions are kept as 16 bits
+#define LZSS_MAX_INPUT 65534
+// Returned by lzss_decode() for a corrupt stream or an output overflow
+#define LZSS_ERROR SIZE_MAX
+
+typedef struct {
+    const uint8_t *in;
+    size_t len;
+    size_t pos;                             // Next input byte to encode
+    uint16_t head[1 << LZSS_HASH_BITS][LZSS_HASH_WAYS]; // Recent positions + 1 of each 3-byte hash, 0 if none
+    uint8_t group[1 + 8 * 2];               // Flag byte and up to 8 items, encoded but not yet output
+    uint8_t group_len;
+    uint8_t group_pos;
+} lzss_encoder_t;
+
+/*
+ * @brief Start compressing a message
+ *
+ * The encoder reads the input in place, it must stay valid until the end.
+ *
+ * @return false if the input is longer than LZSS_MAX_INPUT
+ */
+bool lzss_encoder_init(lzss_encoder_t *e, const void *in, size_t len);
+
+/*
+ * @brief Produce the next compressed bytes
+ *
+ * Resumable: the stream can be taken in pieces of any size, e.g. one MQTT
+ * part at a time, without buffering the whole compressed message.
+ *
+ * @param e Encoder
+ * @param out Output, or NULL to only count the bytes
+ * @param out_len Space in out
+ * @return Bytes produced, less than out_len only at the end of the stream
+ */
+size_t lzss_encode(lzss_encoder_t *e, uint8_t *out, size_t out_len);
+
+/*
+ * @brief Decompress a whole stream
+ *
+ * @param in Compressed stream
+ * @param len Stream length
+ * @param out Output
+ * @param out_cap Space in out
+ * @return Decompressed length, or LZSS_ERROR
+ */
+size_t lzss_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_cap);
+
+#ifdef __cplusplus
+}
+#endif
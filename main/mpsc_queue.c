@@ -0,0 +1,88 @@
+#include <string.h>
+
+#include "mpsc_queue.h"
+
+static mpsc_slot_hdr_t *slot_at(mpsc_queue_t *q, uint32_t index)
+{
+    return (mpsc_slot_hdr_t *)(q->storage + (index & q->mask) * q->stride);
+}
+
+bool mpsc_queue_init(mpsc_queue_t *q, void *storage, uint32_t capacity, size_t slot_size)
+{
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+    q->storage = storage;
+    q->mask = capacity - 1;
+    q->slot_size = slot_size;
+    q->stride = MPSC_QUEUE_STRIDE(slot_size);
+    atomic_init(&q->head, 0);
+    q->tail = 0;
+    for (uint32_t i = 0; i < capacity; i++) {
+        atomic_init(&slot_at(q, i)->seq, i);
+    }
+    return true;
+}
+
+bool mpsc_queue_push(mpsc_queue_t *q, const void *a, size_t a_len, const void *b, size_t b_len)
+{
+    if (a_len + b_len > q->slot_size) {
+        return false;
+    }
+
+    uint32_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    mpsc_slot_hdr_t *slot;
+    while (1) {
+        slot = slot_at(q, pos);
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            // Slot free for this lap: claim it, or retry with the head another producer moved
+            uint32_t expected = pos;
+            if (atomic_compare_exchange_weak_explicit(&q->head, &expected, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+            pos = expected;
+        } else if (diff < 0) {
+            // The consumer has not released this slot since the previous lap
+            return false;
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+
+    uint8_t *data = (uint8_t *)(slot + 1);
+    memcpy(data, a, a_len);
+    if (b_len > 0) {
+        memcpy(data + a_len, b, b_len);
+    }
+    slot->len = a_len + b_len;
+    // Publish the copy to the consumer
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return true;
+}
+
+const void *mpsc_queue_peek(mpsc_queue_t *q, size_t *len_out)
+{
+    mpsc_slot_hdr_t *slot = slot_at(q, q->tail);
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != q->tail + 1) {
+        // Empty, or the producer of the oldest slot is still copying
+        return NULL;
+    }
+    *len_out = slot->len;
+    return slot + 1;
+}
+
+void mpsc_queue_release(mpsc_queue_t *q)
+{
+    mpsc_slot_hdr_t *slot = slot_at(q, q->tail);
+    // Claimable again on the next lap
+    atomic_store_explicit(&slot->seq, q->tail + q->mask + 1, memory_order_release);
+    q->tail++;
+}
+
+uint32_t mpsc_queue_depth(mpsc_queue_t *q)
+{
+    return (uint32_t)atomic_load_explicit(&q->head, memory_order_relaxed) - q->tail;
+}
@@ -0,0 +1,88 @@
+/*
+ * Lock-free bounded multi-producer single-consumer queue
+ *
+ * Messages are copied inline into fixed-size slots of a ring owned by the
+ * caller, so pushing never allocates nor takes a lock: producers claim a
+ * slot with one compare-and-swap on the head index, and each slot carries
+ * a sequence number telling the consumer when its copy is complete. A full
+ * queue rejects the message instead of blocking the producer.
+ *
+ * Any number of tasks may push; only one task may peek and release.
+ */
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    _Atomic uint32_t seq;       // Slot index it is ready for: claimable at i, readable at i + 1
+    uint32_t len;
+} mpsc_slot_hdr_t;
+
+// Bytes taken by one slot holding up to slot_size bytes, padded to keep the headers aligned
+#define MPSC_QUEUE_STRIDE(slot_size) \
+    ((sizeof(mpsc_slot_hdr_t) + (slot_size) + 7) & ~(size_t)7)
+// Storage to provide for a queue, must be 8-byte aligned
+#define MPSC_QUEUE_STORAGE_SIZE(capacity, slot_size) ((capacity) * MPSC_QUEUE_STRIDE(slot_size))
+
+typedef struct {
+    uint8_t *storage;
+    uint32_t mask;              // capacity - 1
+    size_t slot_size;
+    size_t stride;
+    _Atomic uint32_t head;      // Next slot to claim, shared by the producers
+    uint32_t tail;              // Next slot to read, consumer only
+} mpsc_queue_t;
+
+/*
+ * @brief Initialize an empty queue
+ *
+ * @param q Queue
+ * @param storage MPSC_QUEUE_STORAGE_SIZE(capacity, slot_size) bytes, 8-byte aligned
+ * @param capacity Number of slots, a power of two
+ * @param slot_size Largest message in bytes
+ * @return false if capacity is not a power of two
+ */
+bool mpsc_queue_init(mpsc_queue_t *q, void *storage, uint32_t capacity, size_t slot_size);
+
+/*
+ * @brief Copy a message made of two parts (e.g. header and payload) into the queue
+ *
+ * Never blocks. Safe to call from several tasks at once.
+ *
+ * @return false if the queue is full or the message is larger than the slot size
+ */
+bool mpsc_queue_push(mpsc_queue_t *q, const void *a, size_t a_len, const void *b, size_t b_len);
+
+/*
+ * @brief Oldest complete message, left in the queue until released
+ *
+ * Consumer only.
+ *
+ * @param q Queue
+ * @param len_out Length of the message
+ * @return Message, or NULL if the queue is empty
+ */
+const void *mpsc_queue_peek(mpsc_queue_t *q, size_t *len_out);
+
+/*
+ * @brief Free the slot of the message returned by mpsc_queue_peek()
+ *
+ * Consumer only.
+ */
+void mpsc_queue_release(mpsc_queue_t *q);
+
+/*
+ * @brief Number of slots claimed and not released yet
+ */
+uint32_t mpsc_queue_depth(mpsc_queue_t *q);
+
+#ifdef __cplusplus
+}
+#endif
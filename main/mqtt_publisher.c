@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "mqtt_publisher.h"
+#include "mpsc_queue.h"
+#include "app_topics.h"
+#include "app_metrics.h"
+
+static const char *TAG = "mqtt_publisher";
+
+#define PUBLISHER_TASK_STACK 3072
+
+// Stored in front of the payload in each queue slot
+typedef struct {
+    char topic[MQTT_PUBLISHER_TOPIC_MAX];   // Copied: the caller's string need not outlive the queue
+    char response_topic[MQTT_PUBLISHER_TOPIC_MAX];
+    int64_t enqueued_us;
+    mqtt_publisher_props_t props;           // response_topic set again once dequeued
+    char *heap_data;                        // Payload too large for a slot, owned by the queue; NULL when inline
+    int heap_len;
+    uint8_t qos;
+    uint8_t retain;
+} publish_hdr_t;
+
+#define SLOT_SIZE (sizeof(publish_hdr_t) + CONFIG_PUBLISH_QUEUE_SLOT_SIZE)
+
+_Static_assert((CONFIG_PUBLISH_QUEUE_LEN & (CONFIG_PUBLISH_QUEUE_LEN - 1)) == 0,
+               "CONFIG_PUBLISH_QUEUE_LEN must be a power of two");
+
+static uint8_t s_storage[MPSC_QUEUE_STORAGE_SIZE(CONFIG_PUBLISH_QUEUE_LEN, SLOT_SIZE)] __attribute__((aligned(8)));
+static mpsc_queue_t s_queue;
+static esp_mqtt_client_handle_t s_client = NULL;
+static TaskHandle_t s_task = NULL;
+
+#if CONFIG_MQTT_PROTOCOL_5
+// Published often enough for an alias to pay off; the alias of a topic is its index + 1
+#define ALIAS_COUNT (sizeof(s_alias_topics) / sizeof(s_alias_topics[0]))
+static const app_topic_t s_alias_topics[] = {
+    APP_TOPIC_GPIO_EVENTS,
+    APP_TOPIC_GPIO_INPUTS,
+    APP_TOPIC_METRICS,
+    APP_TOPIC_PCNT,
+    APP_TOPIC_GPT_OUT,
+};
+static uint32_t s_alias_sent = 0;           // Bit i set once alias i + 1 went out with its topic
+static int s_alias_max = ALIAS_COUNT;       // Lowered to the broker's topic alias maximum once it refuses one
+// Publish properties are client-wide in esp-mqtt: set them and enqueue as one step
+static SemaphoreHandle_t s_props_lock = NULL;
+#endif
+
+// Counters since the last metrics report, written by several tasks: approximate by design
+static struct {
+    uint32_t published;
+    uint32_t dropped;
+    uint32_t oversize;          // Payloads larger than a slot, queued by pointer
+    uint32_t depth_max;
+    int64_t push_max_us;        // Time a producer spent in mqtt_publisher_publish()
+    int64_t wait_max_us;        // Time from push to handing the message to the MQTT client
+} s_stats;
+
+#if CONFIG_MQTT_PROTOCOL_5
+static int alias_index(const char *topic, int qos)
+{
+    // Only QoS 0: QoS 1 and 2 messages can be resent on a later connection, where the alias is unknown
+    if (qos != 0) {
+        return -1;
+    }
+    for (int i = 0; i < s_alias_max; i++) {
+        if (strcmp(topic, app_topic(s_alias_topics[i])) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * @brief Enqueue with the properties of this message, topic replaced by its alias once known
+ */
+static int enqueue(const char *topic, const char *data, int len, int qos, int retain,
+                   const mqtt_publisher_props_t *props)
+{
+    esp_mqtt5_publish_property_config_t prop = {0};
+    uint8_t correlation[4];
+
+    if (props != NULL) {
+        if (props->correlation != 0) {
+            for (int i = 0; i < 4; i++) {
+                correlation[i] = props->correlation >> (8 * i);
+            }
+            prop.correlation_data = (const char *)correlation;
+            prop.correlation_data_len = sizeof(correlation);
+        }
+        prop.response_topic = props->response_topic;
+        prop.message_expiry_interval = props->expiry_s;
+    }
+
+    xSemaphoreTake(s_props_lock, portMAX_DELAY);
+    int alias = alias_index(topic, qos);
+    const char *wire_topic = topic;
+    if (alias >= 0) {
+        prop.topic_alias = alias + 1;
+        if (s_alias_sent & (1u << alias)) {
+            // The broker knows the alias: an empty topic saves its bytes
+            wire_topic = "";
+        }
+    }
+    // esp-mqtt refuses an alias above the topic alias maximum of the broker's CONNACK
+    if (esp_mqtt5_client_set_publish_property(s_client, &prop) != ESP_OK && alias >= 0) {
+        ESP_LOGW(TAG, "Topic alias %d above the broker's maximum, %d alias(es) used on this connection",
+                 alias + 1, alias);
+        s_alias_max = alias;
+        alias = -1;
+        wire_topic = topic;
+        prop.topic_alias = 0;
+        esp_mqtt5_client_set_publish_property(s_client, &prop);
+    }
+    int msg_id = esp_mqtt_client_enqueue(s_client, wire_topic, data, len, qos, retain, true);
+    // A failed enqueue (outbox full) leaves the alias unsent: the next message carries the topic
+    if (msg_id >= 0 && alias >= 0) {
+        s_alias_sent |= 1u << alias;
+    }
+    xSemaphoreGive(s_props_lock);
+    return msg_id;
+}
+#else
+static int enqueue(const char *topic, const char *data, int len, int qos, int retain,
+                   const mqtt_publisher_props_t *props)
+{
+    return esp_mqtt_client_enqueue(s_client, topic, data, len, qos, retain, true);
+}
+#endif
+
+static void publisher_task(void *arg)
+{
+    while (1) {
+        // Woken by the producers; drain everything pending before sleeping again
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // Messages published during boot stay queued until the client exists
+        if (s_client == NULL) {
+            continue;
+        }
+
+        size_t len;
+        const uint8_t *slot;
+        while ((slot = mpsc_queue_peek(&s_queue, &len)) != NULL) {
+            publish_hdr_t hdr;
+            memcpy(&hdr, slot, sizeof(hdr));
+            if (hdr.props.response_topic != NULL) {
+                hdr.props.response_topic = hdr.response_topic;
+            }
+
+            // Queued in the outbox, sent by the MQTT task: no socket write here
+            const char *data = hdr.heap_data != NULL ? hdr.heap_data : (const char *)slot + sizeof(hdr);
+            int data_len = hdr.heap_data != NULL ? hdr.heap_len : (int)(len - sizeof(hdr));
+            int msg_id = enqueue(hdr.topic, data, data_len, hdr.qos, hdr.retain, &hdr.props);
+            // The client copied it into its outbox
+            free(hdr.heap_data);
+            if (msg_id < 0) {
+                ESP_LOGW(TAG, "Outbox full, message to %s dropped", hdr.topic);
+                s_stats.dropped++;
+            } else {
+                s_stats.published++;
+            }
+
+            int64_t wait_us = esp_timer_get_time() - hdr.enqueued_us;
+            if (wait_us > s_stats.wait_max_us) {
+                s_stats.wait_max_us = wait_us;
+            }
+            mpsc_queue_release(&s_queue);
+        }
+    }
+}
+
+/*
+ * @brief Metrics writer: queue depth and latencies since the previous report
+ */
+static int publisher_metrics_writer(char *buf, size_t len, int64_t interval_us)
+{
+    int n = snprintf(buf, len,
+                     "{\"published\":%" PRIu32 ",\"dropped\":%" PRIu32 ",\"oversize\":%" PRIu32
+                     ",\"depth\":%" PRIu32 ",\"depth_max\":%" PRIu32
+                     ",\"push_max_us\":%" PRId64 ",\"wait_max_us\":%" PRId64 "}",
+                     s_stats.published, s_stats.dropped, s_stats.oversize,
+                     mpsc_queue_depth(&s_queue), s_stats.depth_max,
+                     s_stats.push_max_us, s_stats.wait_max_us);
+    memset(&s_stats, 0, sizeof(s_stats));
+    return n;
+}
+
+esp_err_t mqtt_publisher_init(void)
+{
+    mpsc_queue_init(&s_queue, s_storage, CONFIG_PUBLISH_QUEUE_LEN, SLOT_SIZE);
+#if CONFIG_MQTT_PROTOCOL_5
+    s_props_lock = xSemaphoreCreateMutex();
+    if (s_props_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+    // Above the producers (GPIO task excepted) so the queue drains as soon as it fills
+    if (xTaskCreate(publisher_task, "publisher", PUBLISHER_TASK_STACK, NULL, 6, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    app_metrics_register("publish", publisher_metrics_writer);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_publisher_start(esp_mqtt_client_handle_t client)
+{
+    if (s_task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_client = client;
+    // Drain what was queued before
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+static bool publish(const char *topic, const char *data, int len, int qos, int retain,
+                    const mqtt_publisher_props_t *props)
+{
+    if (s_task == NULL) {
+        return false;
+    }
+    if (len == 0) {
+        len = strlen(data);
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    publish_hdr_t hdr = {
+        .enqueued_us = start_us,
+        .qos = qos,
+        .retain = retain,
+    };
+    size_t topic_len = strlen(topic);
+    size_t response_len = props != NULL && props->response_topic != NULL ? strlen(props->response_topic) : 0;
+    if (topic_len >= sizeof(hdr.topic) || response_len >= sizeof(hdr.response_topic)) {
+        ESP_LOGE(TAG, "Topic %s too long, message dropped", topic);
+        s_stats.dropped++;
+        return false;
+    }
+    memcpy(hdr.topic, topic, topic_len + 1);
+    if (props != NULL) {
+        hdr.props = *props;
+        if (props->response_topic != NULL) {
+            memcpy(hdr.response_topic, props->response_topic, response_len + 1);
+        }
+    }
+    if (len > CONFIG_PUBLISH_QUEUE_SLOT_SIZE) {
+        // Too large for a slot: a copy on the heap goes through the queue, freed by the publisher task
+        hdr.heap_data = malloc(len);
+        if (hdr.heap_data == NULL) {
+            ESP_LOGE(TAG, "No memory for a %d-byte message to %s, dropped", len, topic);
+            s_stats.dropped++;
+            return false;
+        }
+        memcpy(hdr.heap_data, data, len);
+        hdr.heap_len = len;
+        data = NULL;
+        len = 0;
+        s_stats.oversize++;
+    }
+    if (!mpsc_queue_push(&s_queue, &hdr, sizeof(hdr), data, len)) {
+        free(hdr.heap_data);
+        s_stats.dropped++;
+        return false;
+    }
+    xTaskNotifyGive(s_task);
+
+    uint32_t depth = mpsc_queue_depth(&s_queue);
+    if (depth > s_stats.depth_max) {
+        s_stats.depth_max = depth;
+    }
+    int64_t push_us = esp_timer_get_time() - start_us;
+    if (push_us > s_stats.push_max_us) {
+        s_stats.push_max_us = push_us;
+    }
+    return true;
+}
+
+bool mqtt_publisher_publish(const char *topic, const char *data, int len, int qos, int retain)
+{
+    return publish(topic, data, len, qos, retain, NULL);
+}
+
+bool mqtt_publisher_publish_wait(const char *topic, const char *data, int len, int qos, int retain,
+                                 const mqtt_publisher_props_t *props, TickType_t timeout)
+{
+    TickType_t start = xTaskGetTickCount();
+
+    // Poll for room rather than counting a drop for every try
+    while (s_task != NULL && mpsc_queue_depth(&s_queue) >= CONFIG_PUBLISH_QUEUE_LEN) {
+        if (xTaskGetTickCount() - start >= timeout) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+    return publish(topic, data, len, qos, retain, props);
+}
+
+void mqtt_publisher_reset_aliases(void)
+{
+#if CONFIG_MQTT_PROTOCOL_5
+    if (s_props_lock != NULL) {
+        xSemaphoreTake(s_props_lock, portMAX_DELAY);
+        s_alias_sent = 0;
+        // The next broker may accept more (failover)
+        s_alias_max = ALIAS_COUNT;
+        xSemaphoreGive(s_props_lock);
+    }
+#endif
+}
@@ -0,0 +1,95 @@
+/*
+ * Single-writer MQTT publisher
+ *
+ * Every task publishes through this module instead of calling
+ * esp_mqtt_client_publish() itself: the message is copied into a lock-free
+ * queue (mpsc_queue.h) and one publisher task drains it, handing all the
+ * pending messages to the MQTT client in one go with the non-blocking
+ * esp_mqtt_client_enqueue(). Producers never contend on the client lock
+ * nor wait on a socket write.
+ *
+ * With MQTT 5 (CONFIG_MQTT_PROTOCOL_5) the publisher also sets the publish
+ * properties of each message, which esp-mqtt keeps per client, and sends
+ * the frequently published topics as 2-byte topic aliases.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longest topic of a queued message, terminating NUL included
+#define MQTT_PUBLISHER_TOPIC_MAX 80
+
+// MQTT 5 properties of one message, ignored with MQTT 3.1.1
+typedef struct {
+    uint32_t correlation;           // Correlation data (4 bytes, little-endian), 0 for none
+    const char *response_topic;     // Topic the receiver answers on, NULL for none
+    uint32_t expiry_s;              // Message expiry interval, 0 to never expire
+} mqtt_publisher_props_t;
+
+/*
+ * @brief Create the queue and the publisher task
+ *
+ * Messages published before mqtt_publisher_start() wait in the queue,
+ * so events of the first milliseconds after boot are not lost.
+ *
+ * @return ESP_OK, or ESP_ERR_NO_MEM
+ */
+esp_err_t mqtt_publisher_init(void);
+
+/*
+ * @brief Hand the queued messages and the following ones to the client
+ *
+ * @param client Started MQTT client
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE before mqtt_publisher_init()
+ */
+esp_err_t mqtt_publisher_start(esp_mqtt_client_handle_t client);
+
+/*
+ * @brief Queue a message for publishing, never blocks
+ *
+ * Messages longer than CONFIG_PUBLISH_QUEUE_SLOT_SIZE bytes are copied to
+ * the heap and queued by pointer: they go through the publisher task too,
+ * and wait for the client like the others.
+ *
+ * @param topic Topic, copied; at most MQTT_PUBLISHER_TOPIC_MAX - 1 characters
+ * @param data Payload
+ * @param len Payload length, 0 to use strlen(data)
+ * @param qos QoS level
+ * @param retain Retain flag
+ * @return false if the queue is full, the topic too long, no memory is left
+ *         for a long message or the publisher is not started
+ */
+bool mqtt_publisher_publish(const char *topic, const char *data, int len, int qos, int retain);
+
+/*
+ * @brief Queue a message for publishing, waiting for room in the queue
+ *
+ * For producers sending a burst of messages, such as the parts of a long
+ * one, faster than the publisher drains them.
+ *
+ * @param props MQTT 5 properties, NULL for none
+ * @param timeout Longest wait for a free slot
+ * @return false if the queue stayed full or the publisher is not started
+ */
+bool mqtt_publisher_publish_wait(const char *topic, const char *data, int len, int qos, int retain,
+                                 const mqtt_publisher_props_t *props, TickType_t timeout);
+
+/*
+ * @brief Forget the topic aliases sent so far, on every connection and disconnection
+ *
+ * Aliases only live as long as the connection, the next message of each
+ * topic carries the topic again. The alias limit learnt from a refusal is
+ * forgotten too, the broker of the next connection may differ.
+ */
+void mqtt_publisher_reset_aliases(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+
+#include "mqtt_reconnect.h"
+#include "reconnect_policy.h"
+#include "app_metrics.h"
+
+static const char *TAG = "mqtt_reconnect";
+
+// Only reached if the timer failed to reconnect
+#define BACKSTOP_MARGIN_MS 30000
+
+static esp_mqtt_client_handle_t s_client;
+static esp_timer_handle_t s_timer;
+static reconnect_policy_t s_policy;
+static bool s_connected = false;
+// Cause of the latest failed attempt, from MQTT_EVENT_ERROR
+static reconnect_cause_t s_cause = RECONNECT_CAUSE_UNREACHABLE;
+
+static uint32_t s_attempts;
+static uint32_t s_last_delay_ms;
+static reconnect_cause_t s_last_cause = RECONNECT_CAUSE_UNREACHABLE;
+
+static void reconnect_timer_cb(void *arg)
+{
+    // Fails harmlessly if a broker switch already reconnected the client
+    esp_mqtt_client_reconnect(s_client);
+}
+
+static int reconnect_metrics_writer(char *buf, size_t len, int64_t interval_us)
+{
+    return snprintf(buf, len, "{\"attempts\":%" PRIu32 ",\"last_delay_ms\":%" PRIu32 ",\"last_cause\":\"%s\"}",
+                    s_attempts, s_last_delay_ms, reconnect_cause_name(s_last_cause));
+}
+
+esp_err_t mqtt_reconnect_init(esp_mqtt_client_handle_t client)
+{
+    const esp_timer_create_args_t args = {
+        .callback = reconnect_timer_cb,
+        .name = "mqtt_reconnect",
+    };
+
+    s_client = client;
+    // Devices of a fleet must draw different delays, hence a random seed rather than the MAC address
+    reconnect_policy_init(&s_policy, CONFIG_MQTT_RECONNECT_FIRST_MS, CONFIG_MQTT_RECONNECT_BASE_MS,
+                          CONFIG_MQTT_RECONNECT_MAX_MS, esp_random());
+    esp_err_t err = esp_timer_create(&args, &s_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    app_metrics_register("reconnect", reconnect_metrics_writer);
+    return ESP_OK;
+}
+
+int mqtt_reconnect_backstop_ms(void)
+{
+    return CONFIG_MQTT_RECONNECT_MAX_MS + BACKSTOP_MARGIN_MS;
+}
+
+void mqtt_reconnect_error(const esp_mqtt_error_codes_t *error)
+{
+    if (error->error_type == MQTT_ERROR_TYPE_CONNECTION_REFUSED) {
+        s_cause = reconnect_cause_from_connack(error->connect_return_code);
+    } else if (error->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT) {
+        // A certificate the broker's chain does not match will not match sooner on retry
+        s_cause = error->esp_tls_cert_verify_flags != 0 ? RECONNECT_CAUSE_REJECTED : RECONNECT_CAUSE_UNREACHABLE;
+    }
+}
+
+void mqtt_reconnect_connected(void)
+{
+    esp_timer_stop(s_timer);
+    s_connected = true;
+    reconnect_policy_connected(&s_policy, esp_timer_get_time());
+}
+
+void mqtt_reconnect_disconnected(void)
+{
+    reconnect_cause_t cause = s_connected ? RECONNECT_CAUSE_LOST : s_cause;
+    uint32_t delay_ms = reconnect_policy_delay_ms(&s_policy, cause, esp_timer_get_time());
+
+    s_connected = false;
+    s_cause = RECONNECT_CAUSE_UNREACHABLE;
+    s_attempts++;
+    s_last_delay_ms = delay_ms;
+    s_last_cause = cause;
+    ESP_LOGI(TAG, "Reconnecting in %" PRIu32 " ms (%s)", delay_ms, reconnect_cause_name(cause));
+    // Restarted if still pending, e.g. after a disconnection during a broker switch
+    esp_timer_stop(s_timer);
+    esp_timer_start_once(s_timer, (uint64_t)delay_ms * 1000);
+}
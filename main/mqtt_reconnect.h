@@ -0,0 +1,42 @@
+/*
+ * Reconnection to the broker
+ *
+ * Replaces the client's fixed reconnect interval with reconnect_policy.h:
+ * after each disconnection or failed attempt a timer calls
+ * esp_mqtt_client_reconnect() after a delay drawn from the backoff window,
+ * chosen from the error the client reported (MQTT_EVENT_ERROR). The
+ * client's own reconnect timeout stays as a backstop, longer than any
+ * delay of the policy.
+ *
+ * The number of attempts, the latest delay and its cause are reported
+ * under "reconnect" on /esp32_metrics.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * @brief Create the reconnect timer, before the client starts
+ */
+esp_err_t mqtt_reconnect_init(esp_mqtt_client_handle_t client);
+
+/*
+ * @brief Reconnect timeout for the client configuration, beyond the policy's delays
+ */
+int mqtt_reconnect_backstop_ms(void);
+
+/*
+ * @brief Report the client's events, from the MQTT event handler
+ */
+void mqtt_reconnect_error(const esp_mqtt_error_codes_t *error);
+void mqtt_reconnect_connected(void);
+void mqtt_reconnect_disconnected(void);
+
+#ifdef __cplusplus
+}
+#endif
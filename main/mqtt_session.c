@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+
+#include "mqtt_session.h"
+#include "app_topics.h"
+#include "app_metrics.h"
+#include "seq_tracker.h"
+#include "dup_filter.h"
+#include "topic_ns.h"
+
+static const char *TAG = "mqtt_session";
+
+#if CONFIG_MQTT_PERSISTENT_SESSION
+#define PERSISTENT true
+#else
+#define PERSISTENT false
+#endif
+
+static char s_client_id[TOPIC_NS_BASE_MAX + 8];
+static char s_client_gpt_filter[APP_TOPIC_MAX + 2];
+// The broker holds our subscriptions: made on this broker since boot and acknowledged
+static bool s_subscribed = false;
+static int s_subscribe_msg_id = -1;
+static int64_t s_connect_start_us = -1;
+
+static uint32_t s_present;
+static uint32_t s_subscribes;
+static int64_t s_ready_us = -1;
+static seq_tracker_t s_seq;
+// Only touched by the MQTT task
+static dup_filter_t s_dups;
+static bool s_skipping = false;         // Rest of a duplicate message
+
+static void session_ready(void)
+{
+    if (s_connect_start_us >= 0) {
+        s_ready_us = esp_timer_get_time() - s_connect_start_us;
+        ESP_LOGI(TAG, "Ready %lld ms after the connection attempt", (long long)(s_ready_us / 1000));
+    }
+}
+
+static int session_metrics_writer(char *buf, size_t len, int64_t interval_us)
+{
+    return snprintf(buf, len,
+                    "{\"persistent\":%s,\"present\":%" PRIu32 ",\"subscribes\":%" PRIu32 ",\"ready_ms\":%lld,"
+                    "\"dup_suppressed\":%" PRIu32 ","
+                    "\"seq\":{\"received\":%" PRIu32 ",\"lost\":%" PRIu32 ",\"late\":%" PRIu32 ",\"duplicates\":%" PRIu32 "}}",
+                    PERSISTENT ? "true" : "false", s_present, s_subscribes,
+                    s_ready_us < 0 ? -1LL : (long long)(s_ready_us / 1000), s_dups.suppressed,
+                    s_seq.received, s_seq.lost, s_seq.late, s_seq.duplicates);
+}
+
+esp_err_t mqtt_session_init(void)
+{
+    const char *device_id = app_topics_device_id();
+    char mac_id[TOPIC_NS_MAC_ID_LEN + 1];
+
+    // The broker finds the session by client identifier: it must not change across boots
+    if (device_id[0] == '\0') {
+        uint8_t mac[6];
+        esp_err_t err = esp_read_mac(mac, ESP_MAC_WIFI_STA);
+        if (err != ESP_OK) {
+            return err;
+        }
+        topic_ns_mac_id(mac_id, mac);
+        device_id = mac_id;
+    }
+    snprintf(s_client_id, sizeof(s_client_id), "esp32-%s", device_id);
+    snprintf(s_client_gpt_filter, sizeof(s_client_gpt_filter), "%s/+", app_topic(APP_TOPIC_CLIENT_GPT));
+    seq_tracker_init(&s_seq);
+    dup_filter_init(&s_dups);
+    ESP_LOGI(TAG, "Client %s, %s session", s_client_id, PERSISTENT ? "persistent" : "clean");
+    app_metrics_register("session", session_metrics_writer);
+    return ESP_OK;
+}
+
+void mqtt_session_client_config(esp_mqtt_client_config_t *mqtt_cfg)
+{
+    mqtt_cfg->credentials.client_id = s_client_id;
+    mqtt_cfg->session.disable_clean_session = PERSISTENT;
+}
+
+esp_err_t mqtt_session_start(esp_mqtt_client_handle_t client)
+{
+#if CONFIG_MQTT_PROTOCOL_5 && CONFIG_MQTT_PERSISTENT_SESSION
+    // MQTT 5 ends the session with the connection unless told otherwise
+    esp_mqtt5_connection_property_config_t props = {
+        .session_expiry_interval = CONFIG_MQTT_SESSION_EXPIRY_S,
+    };
+    return esp_mqtt5_client_set_connect_property(client, &props);
+#else
+    return ESP_OK;
+#endif
+}
+
+void mqtt_session_before_connect(void)
+{
+    s_connect_start_us = esp_timer_get_time();
+}
+
+void mqtt_session_connected(esp_mqtt_client_handle_t client, bool session_present)
+{
+    if (PERSISTENT && session_present && s_subscribed) {
+        s_present++;
+        ESP_LOGI(TAG, "Session present, subscriptions kept by the broker");
+        session_ready();
+        return;
+    }
+
+    // Topics of this device only (app_topics.h): traffic for the rest of the fleet never reaches it.
+    // /client_gpt carries the replies of the Rust client, /client_gpt/<session> those of the other sessions.
+    const esp_mqtt_topic_t topics[] = {
+        {.filter = app_topic(APP_TOPIC_COMMANDS), .qos = app_topic_qos(APP_TOPIC_COMMANDS)},
+        {.filter = app_topic(APP_TOPIC_CLIENT_GPT), .qos = app_topic_qos(APP_TOPIC_CLIENT_GPT)},
+        {.filter = s_client_gpt_filter, .qos = app_topic_qos(APP_TOPIC_CLIENT_GPT)},
+    };
+    s_subscribed = false;
+    s_subscribe_msg_id = esp_mqtt_client_subscribe_multiple(client, topics, sizeof(topics) / sizeof(topics[0]));
+    if (s_subscribe_msg_id < 0) {
+        ESP_LOGE(TAG, "Subscription not sent");
+        return;
+    }
+    s_subscribes++;
+    ESP_LOGI(TAG, "Subscribed to %s, %s and %s, msg_id=%d", topics[0].filter, topics[1].filter, topics[2].filter,
+             s_subscribe_msg_id);
+}
+
+void mqtt_session_subscribed(int msg_id)
+{
+    if (msg_id == s_subscribe_msg_id) {
+        s_subscribed = true;
+        s_subscribe_msg_id = -1;
+        session_ready();
+    }
+}
+
+void mqtt_session_forget(void)
+{
+    s_subscribed = false;
+}
+
+bool mqtt_session_duplicate(const esp_mqtt_event_t *event)
+{
+    // Only the first event of a long message carries its topic and packet id
+    if (event->current_data_offset > 0) {
+        return s_skipping;
+    }
+    s_skipping = false;
+    if (event->qos == 0) {
+        return false;
+    }
+    uint32_t hash = dup_filter_hash(event->topic, event->topic_len, event->data, event->data_len,
+                                    event->total_data_len);
+    if (dup_filter_check(&s_dups, event->msg_id, hash, event->dup)) {
+        ESP_LOGW(TAG, "Duplicate of msg_id=%d on %.*s dropped", event->msg_id, event->topic_len, event->topic);
+        s_skipping = true;
+    }
+    return s_skipping;
+}
+
+/*
+ * @brief Close the connection, in the timer service task: not from the MQTT event handler
+ */
+static void force_reconnect(void *arg, uint32_t client_arg)
+{
+    esp_mqtt_client_handle_t client = (esp_mqtt_client_handle_t)(uintptr_t)client_arg;
+
+    ESP_LOGI(TAG, "Forced disconnection");
+    esp_mqtt_client_disconnect(client);
+}
+
+bool mqtt_session_command(esp_mqtt_client_handle_t client, const char *data, int len)
+{
+    if (len == 9 && strncmp(data, "reconnect", 9) == 0) {
+        // Pointers fit in the 32-bit argument on the ESP32 targets
+        if (xTimerPendFunctionCall(force_reconnect, NULL, (uint32_t)(uintptr_t)client, 0) != pdPASS) {
+            ESP_LOGE(TAG, "Cannot reconnect now");
+        }
+        return true;
+    }
+    if (len > 4 && len < 16 && strncmp(data, "seq ", 4) == 0) {
+        char num[12];
+        memcpy(num, data + 4, len - 4);
+        num[len - 4] = '\0';
+        seq_tracker_record(&s_seq, strtoul(num, NULL, 10));
+        return true;
+    }
+    return false;
+}
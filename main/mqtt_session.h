@@ -0,0 +1,76 @@
+/*
+ * MQTT session of this device
+ *
+ * With CONFIG_MQTT_PERSISTENT_SESSION the client connects with a stable
+ * client identifier and without clean session: the broker keeps the
+ * subscriptions and queues the messages published while the device is
+ * offline on topics subscribed with QoS 1 (app_topic_qos()), delivered as
+ * soon as it reconnects. When
+ * the broker reports the session as present, nothing is sent again;
+ * otherwise (first connection since boot, another broker, expired session)
+ * every topic is subscribed in a single SUBSCRIBE.
+ *
+ * Reported under "session" on /esp32_metrics: connections that found
+ * their session, SUBSCRIBE packets sent, the time from connection attempt
+ * to ready (subscribed) of the last connection, the QoS 1 messages
+ * dropped as redelivered duplicates (dup_filter.h), and the counts of the
+ * "seq <n>" test stream received on /esp32_commands (seq_tracker.h). The
+ * "reconnect" command forces a disconnection, to measure both.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * @brief Build the client identifier, once the topics are set up (app_topics.h)
+ */
+esp_err_t mqtt_session_init(void);
+
+/*
+ * @brief Session settings of the client configuration
+ */
+void mqtt_session_client_config(esp_mqtt_client_config_t *mqtt_cfg);
+
+/*
+ * @brief Client-level settings (MQTT 5 session expiry), before the client starts
+ */
+esp_err_t mqtt_session_start(esp_mqtt_client_handle_t client);
+
+/*
+ * @brief Report the client's events, from the MQTT event handler
+ */
+void mqtt_session_before_connect(void);
+void mqtt_session_connected(esp_mqtt_client_handle_t client, bool session_present);
+void mqtt_session_subscribed(int msg_id);
+
+/*
+ * @brief Check a received message against the recent QoS 1 ones (dup_filter.h)
+ *
+ * For every MQTT_EVENT_DATA, before it is handled: a redelivered message,
+ * all its events included, is dropped and counted.
+ *
+ * @return true if the event belongs to a duplicate
+ */
+bool mqtt_session_duplicate(const esp_mqtt_event_t *event);
+
+/*
+ * @brief The client moves to another broker, which holds no session of this device
+ */
+void mqtt_session_forget(void);
+
+/*
+ * @brief Run a session command received on /esp32_commands: "reconnect" or "seq <n>"
+ *
+ * @return false if the payload is not a session command
+ */
+bool mqtt_session_command(esp_mqtt_client_handle_t client, const char *data, int len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,47 @@
+#include "multipart.h"
+
+void multipart_writer_init(multipart_writer_t *w, uint32_t msg_id)
+{
+    w->msg_id = msg_id;
+    w->part = 0;
+    w->closed = false;
+}
+
+bool multipart_writer_next(multipart_writer_t *w, uint8_t *out, uint8_t flags)
+{
+    if (w->closed) {
+        return false;
+    }
+    // Part 65535 can only be the last one
+    if (w->part == UINT16_MAX && !(flags & MULTIPART_FLAG_LAST)) {
+        w->closed = true;
+        return false;
+    }
+
+    out[0] = 'M';
+    out[1] = 'P';
+    out[2] = MULTIPART_VERSION;
+    out[3] = flags;
+    out[4] = w->msg_id & 0xFF;
+    out[5] = (w->msg_id >> 8) & 0xFF;
+    out[6] = (w->msg_id >> 16) & 0xFF;
+    out[7] = (w->msg_id >> 24) & 0xFF;
+    out[8] = w->part & 0xFF;
+    out[9] = (w->part >> 8) & 0xFF;
+
+    w->part++;
+    w->closed = (flags & MULTIPART_FLAG_LAST) != 0;
+    return true;
+}
+
+bool multipart_read_header(const uint8_t *in, size_t len, multipart_header_t *hdr)
+{
+    if (len < MULTIPART_HEADER_LEN || in[0] != 'M' || in[1] != 'P' || in[2] != MULTIPART_VERSION ||
+        (in[3] & ~MULTIPART_FLAGS_KNOWN) != 0) {
+        return false;
+    }
+    hdr->flags = in[3];
+    hdr->msg_id = in[4] | in[5] << 8 | in[6] << 16 | (uint32_t)in[7] << 24;
+    hdr->part = in[8] | in[9] << 8;
+    return true;
+}
@@ -0,0 +1,82 @@
+/*
+ * Multipart framing of long messages
+ *
+ * A message longer than one MQTT publish should carry is split into parts
+ * published back-to-back on the same topic, each with a small header so the
+ * receiver can put the message back together:
+ *
+ *   'M' 'P' version (u8) flags (u8) message id (u32) part (u16)
+ *
+ * Little-endian, part numbers start at 0. The last part carries
+ * MULTIPART_FLAG_LAST instead of a part count, so a message can be sent
+ * while it is still being produced: only one part has to be in RAM at a
+ * time, never the whole message. Every message is framed, even a short one
+ * (a single part flagged last), so a payload is never mistaken for a part.
+ *
+ * The other flags describe the payload of their part, e.g. compressed: the
+ * receiver decodes each part on its own, the message is the decoded parts
+ * joined in order.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MULTIPART_VERSION 2
+#define MULTIPART_HEADER_LEN 10
+
+#define MULTIPART_FLAG_LZSS 0x01    // Payload of this part compressed on its own, see lzss.h
+#define MULTIPART_FLAG_LAST 0x80    // Last part of the message
+#define MULTIPART_FLAGS_KNOWN (MULTIPART_FLAG_LZSS | MULTIPART_FLAG_LAST)
+
+typedef struct {
+    uint32_t msg_id;
+    uint16_t part;
+    uint8_t flags;
+} multipart_header_t;
+
+typedef struct {
+    uint32_t msg_id;
+    uint32_t part;              // Number of the next part
+    bool closed;                // The last part was written, or the part numbers ran out
+} multipart_writer_t;
+
+/*
+ * @brief Start a message
+ *
+ * The writer only produces the headers: the caller puts the payload of each
+ * part behind its header, from a buffer or straight from an encoder.
+ *
+ * @param w Writer
+ * @param msg_id Identifier shared by every part of the message
+ */
+void multipart_writer_init(multipart_writer_t *w, uint32_t msg_id);
+
+/*
+ * @brief Write the header of the next part
+ *
+ * @param w Writer
+ * @param out MULTIPART_HEADER_LEN bytes, followed by room for the payload
+ * @param flags MULTIPART_FLAG_* of this part, MULTIPART_FLAG_LAST on the last one
+ * @return false once the last part was written, or after 65535 parts not flagged last
+ */
+bool multipart_writer_next(multipart_writer_t *w, uint8_t *out, uint8_t flags);
+
+/*
+ * @brief Read the header of a part
+ *
+ * @param in Received payload
+ * @param len Payload length
+ * @param hdr Header of the part, its payload starts at in + MULTIPART_HEADER_LEN
+ * @return false if the payload is not a part of a version and with flags this code understands
+ */
+bool multipart_read_header(const uint8_t *in, size_t len, multipart_header_t *hdr);
+
+#ifdef __cplusplus
+}
+#endif
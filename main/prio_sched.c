@@ -0,0 +1,65 @@
+#include <string.h>
+
+#include "prio_sched.h"
+
+void prio_sched_init(prio_sched_t *s, size_t item_size)
+{
+    memset(s, 0, sizeof(*s));
+    s->item_size = item_size;
+}
+
+void prio_sched_set_class(prio_sched_t *s, prio_class_t cls, void *storage, size_t capacity)
+{
+    prio_sched_class_t *c = &s->classes[cls];
+    c->storage = storage;
+    c->capacity = capacity;
+    c->head = 0;
+    c->count = 0;
+}
+
+bool prio_sched_push(prio_sched_t *s, prio_class_t cls, const void *item)
+{
+    prio_sched_class_t *c = &s->classes[cls];
+    bool kept_all = true;
+
+    if (c->count == c->capacity) {
+        // Full: the oldest item makes room
+        c->head = (c->head + 1) % c->capacity;
+        c->count--;
+        c->dropped++;
+        kept_all = false;
+    }
+    size_t tail = (c->head + c->count) % c->capacity;
+    memcpy(c->storage + tail * s->item_size, item, s->item_size);
+    c->count++;
+    return kept_all;
+}
+
+bool prio_sched_pop(prio_sched_t *s, void *item, prio_class_t *cls_out)
+{
+    for (int cls = 0; cls < PRIO_CLASS_COUNT; cls++) {
+        prio_sched_class_t *c = &s->classes[cls];
+        if (c->count == 0) {
+            continue;
+        }
+        memcpy(item, c->storage + c->head * s->item_size, s->item_size);
+        c->head = (c->head + 1) % c->capacity;
+        c->count--;
+        if (cls_out != NULL) {
+            *cls_out = (prio_class_t)cls;
+        }
+        return true;
+    }
+    return false;
+}
+
+void prio_sched_clear(prio_sched_t *s, prio_class_t cls)
+{
+    s->classes[cls].head = 0;
+    s->classes[cls].count = 0;
+}
+
+size_t prio_sched_pending(const prio_sched_t *s, prio_class_t cls)
+{
+    return s->classes[cls].count;
+}
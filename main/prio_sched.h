@@ -0,0 +1,92 @@
+/*
+ * Priority scheduling of conversation work
+ *
+ * Fixed-size work items are queued in one bounded FIFO per priority class
+ * and always taken from the highest class that has work pending, so a
+ * button press never waits behind queued conversation turns:
+ *  - USER_INPUT: button gestures
+ *  - COMMAND: commands from the computer and conversation management
+ *  - CONTINUATION: replies received on /client_gpt
+ * A full class drops its oldest item: the newest input is the one that matters.
+ *
+ * Not thread-safe, the caller serializes access.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Highest priority first
+typedef enum {
+    PRIO_CLASS_USER_INPUT,
+    PRIO_CLASS_COMMAND,
+    PRIO_CLASS_CONTINUATION,
+    PRIO_CLASS_COUNT,
+} prio_class_t;
+
+typedef struct {
+    uint8_t *storage;       // capacity * item_size bytes owned by the caller
+    size_t capacity;
+    size_t head;            // Index of the oldest item
+    size_t count;
+    uint32_t dropped;       // Items overwritten because the class was full
+} prio_sched_class_t;
+
+typedef struct {
+    size_t item_size;
+    prio_sched_class_t classes[PRIO_CLASS_COUNT];
+} prio_sched_t;
+
+/*
+ * @brief Initialize a scheduler with no storage, every class must then be set
+ *
+ * @param s Scheduler
+ * @param item_size Size of one work item in bytes
+ */
+void prio_sched_init(prio_sched_t *s, size_t item_size);
+
+/*
+ * @brief Give a class its storage
+ *
+ * @param s Scheduler
+ * @param cls Priority class
+ * @param storage Buffer of capacity * item_size bytes
+ * @param capacity Number of items the class can hold, at least 1
+ */
+void prio_sched_set_class(prio_sched_t *s, prio_class_t cls, void *storage, size_t capacity);
+
+/*
+ * @brief Queue a copy of an item at the end of its class
+ *
+ * @return false if the class was full and its oldest item was dropped
+ */
+bool prio_sched_push(prio_sched_t *s, prio_class_t cls, const void *item);
+
+/*
+ * @brief Take the oldest item of the highest priority class with work pending
+ *
+ * @param s Scheduler
+ * @param item Receives a copy of the item
+ * @param cls_out Class of the item, may be NULL
+ * @return false if every class is empty
+ */
+bool prio_sched_pop(prio_sched_t *s, void *item, prio_class_t *cls_out);
+
+/*
+ * @brief Drop every item of a class
+ */
+void prio_sched_clear(prio_sched_t *s, prio_class_t cls);
+
+/*
+ * @brief Number of items waiting in a class
+ */
+size_t prio_sched_pending(const prio_sched_t *s, prio_class_t cls);
+
+#ifdef __cplusplus
+}
+#endif
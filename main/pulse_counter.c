@@ -0,0 +1,147 @@
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "driver/pulse_cnt.h"
+#include "soc/soc_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "pulse_counter.h"
+#include "pulse_report.h"
+#include "mqtt_publisher.h"
+#include "app_topics.h"
+
+static const char *TAG = "pulse_counter";
+
+// Hardware counter limits; with accum_count the driver extends the count past them
+#define PCNT_HIGH_LIMIT 30000
+#define PCNT_LOW_LIMIT -1
+#define PCNT_PAYLOAD_LEN 768
+// One unit per pin: 8 on the ESP32, 4 on the S3 and C6
+#if SOC_PCNT_UNITS_PER_GROUP < PULSE_REPORT_MAX_CHANNELS
+#define PCNT_MAX_UNITS SOC_PCNT_UNITS_PER_GROUP
+#else
+#define PCNT_MAX_UNITS PULSE_REPORT_MAX_CHANNELS
+#endif
+
+static pcnt_unit_handle_t s_units[PCNT_MAX_UNITS];
+static pulse_report_t s_report;
+
+/*
+ * @brief Create and start the unit counting the rising edges of one pin
+ *
+ * Whatever was created is deleted again on error.
+ */
+static esp_err_t counter_create(int pin, pcnt_unit_handle_t *unit_out)
+{
+    esp_err_t ret = ESP_OK;
+    pcnt_unit_handle_t unit = NULL;
+    pcnt_channel_handle_t chan = NULL;
+
+    // One unit per pin, accumulating across hardware overflows
+    pcnt_unit_config_t unit_config = {
+        .high_limit = PCNT_HIGH_LIMIT,
+        .low_limit = PCNT_LOW_LIMIT,
+        .flags.accum_count = true,
+    };
+    ESP_RETURN_ON_ERROR(pcnt_new_unit(&unit_config, &unit), TAG, "create unit for GPIO %d", pin);
+
+    // Filter out glitches shorter than the configured width
+    pcnt_glitch_filter_config_t filter_config = {
+        .max_glitch_ns = CONFIG_GPIO_PCNT_GLITCH_FILTER_NS,
+    };
+    ESP_GOTO_ON_ERROR(pcnt_unit_set_glitch_filter(unit, &filter_config), err, TAG, "set glitch filter");
+
+    // Count rising edges only, the level input is unused
+    pcnt_chan_config_t chan_config = {
+        .edge_gpio_num = pin,
+        .level_gpio_num = -1,
+    };
+    ESP_GOTO_ON_ERROR(pcnt_new_channel(unit, &chan_config, &chan), err, TAG, "create channel");
+    ESP_GOTO_ON_ERROR(pcnt_channel_set_edge_action(chan, PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+                                                   PCNT_CHANNEL_EDGE_ACTION_HOLD),
+                      err, TAG, "set edge action");
+
+    // Same electrical setup as the scanned inputs
+    gpio_pulldown_en(pin);
+
+    // The high limit watch point lets the driver accumulate overflows
+    ESP_GOTO_ON_ERROR(pcnt_unit_add_watch_point(unit, PCNT_HIGH_LIMIT), err, TAG, "add watch point");
+    ESP_GOTO_ON_ERROR(pcnt_unit_enable(unit), err, TAG, "enable unit");
+    ESP_GOTO_ON_ERROR(pcnt_unit_clear_count(unit), err_enabled, TAG, "clear count");
+    ESP_GOTO_ON_ERROR(pcnt_unit_start(unit), err_enabled, TAG, "start unit");
+
+    *unit_out = unit;
+    return ESP_OK;
+
+err_enabled:
+    pcnt_unit_disable(unit);
+err:
+    if (chan != NULL) {
+        pcnt_del_channel(chan);
+    }
+    pcnt_del_unit(unit);
+    return ret;
+}
+
+esp_err_t pulse_counter_init(uint64_t pin_mask)
+{
+    pulse_report_init(&s_report, esp_timer_get_time());
+
+    while (pin_mask != 0) {
+        int pin = __builtin_ctzll(pin_mask);
+        pin_mask &= pin_mask - 1;
+
+        // Pins beyond the units of the chip are left out, the others are still counted
+        if (s_report.count >= PCNT_MAX_UNITS) {
+            ESP_LOGE(TAG, "Only %d PCNT units on this chip, GPIO %d not counted", PCNT_MAX_UNITS, pin);
+            continue;
+        }
+        pcnt_unit_handle_t unit = NULL;
+        if (counter_create(pin, &unit) != ESP_OK) {
+            ESP_LOGE(TAG, "GPIO %d not counted", pin);
+            continue;
+        }
+
+        int channel = pulse_report_add_channel(&s_report, pin);
+        s_units[channel] = unit;
+        ESP_LOGI(TAG, "GPIO %d counted by PCNT unit %d", pin, channel);
+    }
+    return ESP_OK;
+}
+
+static void pulse_counter_task(void *arg)
+{
+    // Report buffer (static to keep the task stack small)
+    static char payload[PCNT_PAYLOAD_LEN];
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_GPIO_PCNT_REPORT_INTERVAL_MS));
+
+        // Read every counter, the report keeps the 64-bit totals
+        for (size_t i = 0; i < s_report.count; i++) {
+            int raw = 0;
+            if (pcnt_unit_get_count(s_units[i], &raw) == ESP_OK) {
+                pulse_report_update(&s_report, i, raw);
+            }
+        }
+
+        int len = pulse_report_format(&s_report, esp_timer_get_time(), payload, sizeof(payload));
+        if (len > 0) {
+            mqtt_publisher_publish(app_topic(APP_TOPIC_PCNT), payload, len, app_topic_qos(APP_TOPIC_PCNT), 0);
+        }
+    }
+}
+
+void pulse_counter_start(void)
+{
+    if (s_report.count == 0) {
+        return;
+    }
+    xTaskCreate(pulse_counter_task, "pcnt_task", 3072, NULL, 5, NULL);
+    ESP_LOGI(TAG, "Publishing %d counter(s) to %s every %d ms", (int)s_report.count, app_topic(APP_TOPIC_PCNT),
+             CONFIG_GPIO_PCNT_REPORT_INTERVAL_MS);
+}
@@ -0,0 +1,36 @@
+/*
+ * Hardware pulse counter mode
+ *
+ * Pins listed in CONFIG_GPIO_PCNT_PINS are counted by the PCNT peripheral
+ * instead of being scanned, so edges far faster than the scan period are
+ * not missed (flow meters, encoders...). Counts and rates are published
+ * every CONFIG_GPIO_PCNT_REPORT_INTERVAL_MS on /esp32_pcnt.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * @brief Create one PCNT unit per pin, counting rising edges
+ *
+ * Pins beyond the PCNT units of the chip (SOC_PCNT_UNITS_PER_GROUP), or
+ * whose unit cannot be set up, are logged and not counted.
+ *
+ * @param pin_mask Pins to count, lowest GPIO first
+ * @return ESP_OK
+ */
+esp_err_t pulse_counter_init(uint64_t pin_mask);
+
+/*
+ * @brief Start the task publishing the periodic counter report through mqtt_publisher
+ */
+void pulse_counter_start(void);
+
+#ifdef __cplusplus
+}
+#endif
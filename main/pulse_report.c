@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "pulse_report.h"
+
+void pulse_report_init(pulse_report_t *r, int64_t now_us)
+{
+    memset(r, 0, sizeof(*r));
+    r->last_report_us = now_us;
+}
+
+int pulse_report_add_channel(pulse_report_t *r, uint8_t pin)
+{
+    if (r->count >= PULSE_REPORT_MAX_CHANNELS) {
+        return -1;
+    }
+    pulse_report_channel_t *ch = &r->channels[r->count];
+    memset(ch, 0, sizeof(*ch));
+    ch->pin = pin;
+    return (int)r->count++;
+}
+
+void pulse_report_update(pulse_report_t *r, int channel, int32_t raw)
+{
+    pulse_report_channel_t *ch = &r->channels[channel];
+
+    // Unsigned subtraction keeps the delta right across a counter wrap-around
+    uint32_t delta = (uint32_t)raw - (uint32_t)ch->last_raw;
+    ch->total += delta;
+    ch->last_raw = raw;
+}
+
+int pulse_report_format(pulse_report_t *r, int64_t now_us, char *buf, size_t buf_len)
+{
+    int64_t interval_us = now_us - r->last_report_us;
+    if (interval_us <= 0) {
+        interval_us = 1;
+    }
+
+    int len = snprintf(buf, buf_len, "{\"interval_ms\":%" PRId64 ",\"counters\":[", interval_us / 1000);
+    if (len < 0 || (size_t)len >= buf_len) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < r->count; i++) {
+        pulse_report_channel_t *ch = &r->channels[i];
+        uint64_t count = ch->total - ch->reported_total;
+        double rate_hz = (double)count * 1000000.0 / (double)interval_us;
+
+        int n = snprintf(buf + len, buf_len - len,
+                         "%s{\"pin\":%u,\"count\":%" PRIu64 ",\"total\":%" PRIu64 ",\"rate_hz\":%.1f}",
+                         i == 0 ? "" : ",", ch->pin, count, ch->total, rate_hz);
+        if (n < 0 || (size_t)n >= buf_len - len) {
+            return -1;
+        }
+        len += n;
+    }
+
+    int n = snprintf(buf + len, buf_len - len, "]}");
+    if (n < 0 || (size_t)n >= buf_len - len) {
+        return -1;
+    }
+
+    // The interval is only closed once the report was produced
+    for (size_t i = 0; i < r->count; i++) {
+        r->channels[i].reported_total = r->channels[i].total;
+    }
+    r->last_report_us = now_us;
+    return len + n;
+}
@@ -0,0 +1,73 @@
+/*
+ * Pulse counter report
+ *
+ * Hardware-independent part of the pulse counter mode: turns raw counter
+ * readings into 64-bit totals and formats the periodic report published
+ * on /esp32_pcnt, e.g.
+ * {"interval_ms":1000,"counters":[{"pin":18,"count":250,"total":9000,"rate_hz":250.0}]}
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PULSE_REPORT_MAX_CHANNELS 8
+
+typedef struct {
+    uint8_t pin;
+    int32_t last_raw;           // Last raw hardware reading, used to compute deltas
+    uint64_t total;             // Pulses counted since start
+    uint64_t reported_total;    // Total at the previous report
+} pulse_report_channel_t;
+
+typedef struct {
+    pulse_report_channel_t channels[PULSE_REPORT_MAX_CHANNELS];
+    size_t count;
+    int64_t last_report_us;
+} pulse_report_t;
+
+/*
+ * @brief Initialize an empty report
+ *
+ * @param r Report state
+ * @param now_us Current time, start of the first interval
+ */
+void pulse_report_init(pulse_report_t *r, int64_t now_us);
+
+/*
+ * @brief Add a counted pin
+ *
+ * @return Channel index, or -1 when all channels are used
+ */
+int pulse_report_add_channel(pulse_report_t *r, uint8_t pin);
+
+/*
+ * @brief Record a raw reading of a channel's hardware counter
+ *
+ * The counter may wrap around: only the difference with the previous
+ * reading is added to the total, computed modulo 2^32.
+ *
+ * @param r Report state
+ * @param channel Index returned by pulse_report_add_channel()
+ * @param raw Current raw counter value
+ */
+void pulse_report_update(pulse_report_t *r, int channel, int32_t raw);
+
+/*
+ * @brief Format the report of the interval ending now and start a new one
+ *
+ * @param r Report state
+ * @param now_us End of the interval
+ * @param buf Output buffer
+ * @param buf_len Size of the output buffer
+ * @return Length of the JSON report, or -1 if it does not fit in buf
+ */
+int pulse_report_format(pulse_report_t *r, int64_t now_us, char *buf, size_t buf_len);
+
+#ifdef __cplusplus
+}
+#endif
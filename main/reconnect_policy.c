@@ -0,0 +1,113 @@
+#include "reconnect_policy.h"
+
+// Window doublings beyond which base_ms << attempt could overflow
+#define MAX_SHIFT 20
+
+static uint32_t next_random(reconnect_policy_t *p)
+{
+    uint32_t x = p->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    p->rng = x;
+    return x;
+}
+
+// Uniform in [0, window]
+static uint32_t jitter(reconnect_policy_t *p, uint32_t window)
+{
+    return (uint32_t)(((uint64_t)next_random(p) * ((uint64_t)window + 1)) >> 32);
+}
+
+static uint32_t backoff_window(const reconnect_policy_t *p, uint32_t steps)
+{
+    uint64_t window = (uint64_t)p->base_ms << (steps < MAX_SHIFT ? steps : MAX_SHIFT);
+    return window < p->cap_ms ? (uint32_t)window : p->cap_ms;
+}
+
+void reconnect_policy_init(reconnect_policy_t *p, uint32_t first_ms, uint32_t base_ms, uint32_t cap_ms,
+                           uint32_t seed)
+{
+    p->first_ms = first_ms;
+    p->base_ms = base_ms;
+    p->cap_ms = cap_ms > base_ms ? cap_ms : base_ms;
+    p->attempt = 0;
+    p->connected_us = -1;
+    // Close seeds (consecutive device numbers) must not give close first delays: mix them
+    seed ^= seed >> 16;
+    seed *= 0x85EBCA6Bu;
+    seed ^= seed >> 13;
+    seed *= 0xC2B2AE35u;
+    seed ^= seed >> 16;
+    // xorshift stays at 0 forever
+    p->rng = seed != 0 ? seed : 0x9E3779B9u;
+}
+
+void reconnect_policy_connected(reconnect_policy_t *p, int64_t now_us)
+{
+    p->connected_us = now_us;
+}
+
+uint32_t reconnect_policy_delay_ms(reconnect_policy_t *p, reconnect_cause_t cause, int64_t now_us)
+{
+    uint32_t delay;
+
+    // Only a connection that held resets the backoff: one dropped at once by the broker keeps backing off
+    if (cause == RECONNECT_CAUSE_LOST && p->connected_us >= 0 &&
+            now_us - p->connected_us >= RECONNECT_POLICY_STABLE_US) {
+        p->attempt = 0;
+    }
+    p->connected_us = -1;
+
+    switch (cause) {
+    case RECONNECT_CAUSE_LOST:
+        delay = p->attempt == 0 ? jitter(p, p->first_ms) : jitter(p, backoff_window(p, p->attempt - 1));
+        break;
+    case RECONNECT_CAUSE_BUSY:
+        delay = jitter(p, backoff_window(p, p->attempt + RECONNECT_POLICY_BUSY_STEPS));
+        break;
+    case RECONNECT_CAUSE_REJECTED:
+        // Retrying sooner does not fix a configuration, the upper half of the cap leaves time to fix it
+        delay = p->cap_ms / 2 + jitter(p, p->cap_ms - p->cap_ms / 2);
+        break;
+    case RECONNECT_CAUSE_UNREACHABLE:
+    default:
+        delay = jitter(p, backoff_window(p, p->attempt));
+        break;
+    }
+    if (p->attempt < MAX_SHIFT) {
+        p->attempt++;
+    }
+    return delay;
+}
+
+reconnect_cause_t reconnect_cause_from_connack(int code)
+{
+    switch (code) {
+    case 3:         // Server unavailable
+    case 0x88:      // Server unavailable
+    case 0x89:      // Server busy
+    case 0x97:      // Quota exceeded
+    case 0x9C:      // Use another server
+    case 0x9D:      // Server moved
+    case 0x9F:      // Connection rate exceeded
+        return RECONNECT_CAUSE_BUSY;
+    default:
+        return RECONNECT_CAUSE_REJECTED;
+    }
+}
+
+const char *reconnect_cause_name(reconnect_cause_t cause)
+{
+    switch (cause) {
+    case RECONNECT_CAUSE_LOST:
+        return "lost";
+    case RECONNECT_CAUSE_UNREACHABLE:
+        return "unreachable";
+    case RECONNECT_CAUSE_BUSY:
+        return "busy";
+    case RECONNECT_CAUSE_REJECTED:
+        return "rejected";
+    }
+    return "?";
+}
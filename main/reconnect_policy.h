@@ -0,0 +1,83 @@
+/*
+ * Reconnect policy
+ *
+ * Delay before the next connection attempt to the broker, instead of the
+ * client's fixed reconnect interval, with which every device of a fleet
+ * reconnects in lockstep after a broker restart:
+ *
+ *  - exponential backoff: the window doubles with each failed attempt, from
+ *    base_ms up to cap_ms
+ *  - full jitter: the delay is drawn uniformly in [0, window], which spreads
+ *    the fleet's attempts over the whole window
+ *  - fast first retry: a connection that had been up for
+ *    RECONNECT_POLICY_STABLE_US is retried within first_ms, most drops
+ *    being transient; a connection dropping sooner keeps backing off
+ *  - the cause of the failure weighs in: a busy broker gets a wider window,
+ *    a refused client (credentials, certificate) only retries near the cap
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Connection time after which a drop counts as transient again
+#define RECONNECT_POLICY_STABLE_US (60 * 1000000LL)
+// Extra doublings of the window when the broker reports itself busy
+#define RECONNECT_POLICY_BUSY_STEPS 2
+
+typedef enum {
+    RECONNECT_CAUSE_LOST,           // Established connection dropped
+    RECONNECT_CAUSE_UNREACHABLE,    // TCP or TLS connection failed
+    RECONNECT_CAUSE_BUSY,           // Broker unavailable, busy or rate limiting
+    RECONNECT_CAUSE_REJECTED,       // Credentials, client identifier or certificate refused
+} reconnect_cause_t;
+
+typedef struct {
+    uint32_t first_ms;
+    uint32_t base_ms;
+    uint32_t cap_ms;
+    uint32_t attempt;               // Delays given since the last stable connection
+    int64_t connected_us;           // Start of the current connection, -1 when not connected
+    uint32_t rng;                   // xorshift32 state
+} reconnect_policy_t;
+
+/*
+ * @brief Initialize a policy
+ *
+ * @param first_ms Window of the fast first retry
+ * @param base_ms First backoff window
+ * @param cap_ms Largest window
+ * @param seed Random seed, different on every device (0 is replaced)
+ */
+void reconnect_policy_init(reconnect_policy_t *p, uint32_t first_ms, uint32_t base_ms, uint32_t cap_ms,
+                           uint32_t seed);
+
+/*
+ * @brief Record a successful connection
+ */
+void reconnect_policy_connected(reconnect_policy_t *p, int64_t now_us);
+
+/*
+ * @brief Delay before the next attempt, after a disconnection or a failed attempt
+ *
+ * @param cause Why the previous connection or attempt failed
+ * @param now_us Current time
+ * @return Delay in milliseconds
+ */
+uint32_t reconnect_policy_delay_ms(reconnect_policy_t *p, reconnect_cause_t cause, int64_t now_us);
+
+/*
+ * @brief Cause of a refused connection from the CONNACK return code
+ *
+ * MQTT 3.1.1 return codes (1 to 5) and MQTT 5 reason codes (0x80 and up).
+ */
+reconnect_cause_t reconnect_cause_from_connack(int code);
+
+const char *reconnect_cause_name(reconnect_cause_t cause);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,47 @@
+#include <string.h>
+
+#include "seq_tracker.h"
+
+void seq_tracker_init(seq_tracker_t *t)
+{
+    memset(t, 0, sizeof(*t));
+}
+
+void seq_tracker_record(seq_tracker_t *t, uint32_t n)
+{
+    if (n == 0) {
+        return;
+    }
+    // A new run of the test stream
+    if (n == 1 && t->last > 1) {
+        seq_tracker_init(t);
+    }
+
+    if (n > t->last) {
+        uint32_t gap = n - t->last - 1;
+        // The first message of a stream may be any number, nothing was expected before it
+        if (t->last > 0) {
+            t->lost += gap;
+        }
+        t->seen = n - t->last >= SEQ_TRACKER_WINDOW ? 0 : t->seen << (n - t->last);
+        t->seen |= 1;
+        t->last = n;
+        t->received++;
+        return;
+    }
+
+    uint32_t age = t->last - n;
+    if (age >= SEQ_TRACKER_WINDOW) {
+        // Too old to tell a duplicate from a late one
+        t->duplicates++;
+    } else if (t->seen & (1ULL << age)) {
+        t->duplicates++;
+    } else {
+        t->seen |= 1ULL << age;
+        t->received++;
+        t->late++;
+        if (t->lost > 0) {
+            t->lost--;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ * Sequence number tracking
+ *
+ * Counts the messages of a numbered test stream (1, 2, 3, ...) that never
+ * arrived, arrived late or twice, e.g. across a forced reconnection. A
+ * message missing when a later one arrives is counted lost, and no longer
+ * lost if it turns up within the last SEQ_TRACKER_WINDOW numbers (QoS 1
+ * redelivery after the reconnection). A stream starting over at 1 resets
+ * the counts.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SEQ_TRACKER_WINDOW 64
+
+typedef struct {
+    uint32_t last;              // Highest number received, 0 before the first one
+    uint64_t seen;              // Bit i: last - i received
+    uint32_t received;
+    uint32_t lost;
+    uint32_t duplicates;
+    uint32_t late;              // Arrived after a higher number
+} seq_tracker_t;
+
+void seq_tracker_init(seq_tracker_t *t);
+
+/*
+ * @brief Record a received number, 0 is ignored
+ */
+void seq_tracker_record(seq_tracker_t *t, uint32_t n);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,187 @@
+#include <string.h>
+
+#include "session_table.h"
+
+void session_table_init(session_table_t *t, size_t count, void *storage, size_t depth, size_t item_size)
+{
+    memset(t, 0, sizeof(*t));
+    t->count = count < SESSION_TABLE_MAX ? count : SESSION_TABLE_MAX;
+    t->storage = storage;
+    t->depth = depth;
+    t->item_size = item_size;
+}
+
+bool session_name_valid(const char *name, size_t len)
+{
+    if (len > SESSION_NAME_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = name[i];
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                  c == '-' || c == '_';
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void ready_push(session_table_t *t, int session)
+{
+    t->ready[(t->ready_head + t->ready_count) % SESSION_TABLE_MAX] = (uint8_t)session;
+    t->ready_count++;
+}
+
+int session_table_open(session_table_t *t, const char *name, size_t len, bool *created)
+{
+    int free_slot = -1;
+    int idle = -1;
+
+    if (created != NULL) {
+        *created = false;
+    }
+    for (size_t i = 0; i < t->count; i++) {
+        session_slot_t *s = &t->slots[i];
+        if (!s->in_use) {
+            if (free_slot < 0) {
+                free_slot = (int)i;
+            }
+        } else if (strlen(s->name) == len && memcmp(s->name, name, len) == 0) {
+            return (int)i;
+        } else if (s->name[0] != '\0' && !s->busy && s->pending == 0 &&
+                   (idle < 0 || s->last_used < t->slots[idle].last_used)) {
+            idle = (int)i;
+        }
+    }
+    // A free slot first, then the idle session unused for the longest time
+    int victim = free_slot >= 0 ? free_slot : idle;
+    if (victim < 0) {
+        return -1;
+    }
+
+    session_slot_t *s = &t->slots[victim];
+    memset(s, 0, sizeof(*s));
+    memcpy(s->name, name, len);
+    s->name[len] = '\0';
+    s->in_use = true;
+    s->last_used = ++t->clock;
+    if (created != NULL) {
+        *created = true;
+    }
+    return victim;
+}
+
+bool session_table_post(session_table_t *t, int session, const void *item)
+{
+    session_slot_t *s = &t->slots[session];
+
+    if (s->pending == t->depth) {
+        s->rejected++;
+        return false;
+    }
+    size_t tail = (s->head + s->pending) % t->depth;
+    memcpy(t->storage + ((size_t)session * t->depth + tail) * t->item_size, item, t->item_size);
+    s->pending++;
+    s->last_used = ++t->clock;
+    // Already in the ready list when it had work, or taken: done() puts it back
+    if (s->pending == 1 && !s->busy) {
+        ready_push(t, session);
+    }
+    return true;
+}
+
+bool session_table_take(session_table_t *t, int *session, void *item)
+{
+    if (t->ready_count == 0) {
+        return false;
+    }
+    int i = t->ready[t->ready_head];
+    t->ready_head = (t->ready_head + 1) % SESSION_TABLE_MAX;
+    t->ready_count--;
+
+    session_slot_t *s = &t->slots[i];
+    memcpy(item, t->storage + ((size_t)i * t->depth + s->head) * t->item_size, t->item_size);
+    s->head = (s->head + 1) % t->depth;
+    s->pending--;
+    s->busy = true;
+    *session = i;
+    return true;
+}
+
+void session_table_done(session_table_t *t, int session)
+{
+    session_slot_t *s = &t->slots[session];
+
+    s->busy = false;
+    if (s->pending > 0) {
+        ready_push(t, session);
+    }
+}
+
+/*
+ * @brief Remove the items selected by drop from one FIFO, without touching the ready list
+ */
+static size_t purge_fifo(session_table_t *t, size_t session, session_table_drop_fn drop, void *ctx)
+{
+    session_slot_t *s = &t->slots[session];
+    uint8_t *fifo = t->storage + session * t->depth * t->item_size;
+    size_t removed = 0;
+    size_t kept = 0;
+
+    // Kept items slide down over the removed ones, oldest first
+    for (size_t k = 0; k < s->pending; k++) {
+        uint8_t *item = fifo + (s->head + k) % t->depth * t->item_size;
+        if (drop(item, ctx)) {
+            removed++;
+        } else {
+            if (kept != k) {
+                memcpy(fifo + (s->head + kept) % t->depth * t->item_size, item, t->item_size);
+            }
+            kept++;
+        }
+    }
+    s->pending = kept;
+    return removed;
+}
+
+/*
+ * @brief Take the sessions left with nothing pending out of the ready list
+ */
+static void ready_prune(session_table_t *t)
+{
+    // Only sessions with work left stay ready, in the same order
+    size_t ready_count = t->ready_count;
+    size_t head = t->ready_head;
+    t->ready_count = 0;
+    for (size_t k = 0; k < ready_count; k++) {
+        int session = t->ready[(head + k) % SESSION_TABLE_MAX];
+        if (t->slots[session].pending > 0) {
+            ready_push(t, session);
+        }
+    }
+}
+
+size_t session_table_purge(session_table_t *t, session_table_drop_fn drop, void *ctx)
+{
+    size_t removed = 0;
+
+    for (size_t i = 0; i < t->count; i++) {
+        removed += purge_fifo(t, i, drop, ctx);
+    }
+    ready_prune(t);
+    return removed;
+}
+
+size_t session_table_purge_session(session_table_t *t, int session, session_table_drop_fn drop, void *ctx)
+{
+    size_t removed = purge_fifo(t, session, drop, ctx);
+
+    ready_prune(t);
+    return removed;
+}
+
+const char *session_table_name(const session_table_t *t, int session)
+{
+    return t->slots[session].name;
+}
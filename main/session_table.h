@@ -0,0 +1,140 @@
+/*
+ * Conversation sessions and their dispatch to a pool of workers
+ *
+ * A session is named after the suffix of its topic (/client_gpt/<name>,
+ * "" for the default one). Each has a bounded FIFO of fixed-size work
+ * items. Sessions with work pending and no worker are kept in a ready list:
+ * a worker takes the first one, serves one item and gives the session back,
+ * so the items of one session are handled in order, one at a time, while
+ * independent sessions proceed in parallel and take turns fairly.
+ *
+ * Not thread-safe, the caller serializes access.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SESSION_TABLE_MAX 16
+// Longest session name, letters, digits, '-' and '_' only
+#define SESSION_NAME_MAX 24
+
+typedef struct {
+    char name[SESSION_NAME_MAX + 1];
+    bool in_use;
+    bool busy;                  // Taken by a worker
+    uint32_t last_used;         // Table clock of the last post, for eviction
+    size_t head;                // Index of the oldest item
+    size_t pending;
+    uint32_t rejected;          // Items refused because the FIFO was full
+} session_slot_t;
+
+typedef struct {
+    session_slot_t slots[SESSION_TABLE_MAX];
+    size_t count;
+    uint8_t *storage;           // count * depth * item_size bytes owned by the caller
+    size_t depth;
+    size_t item_size;
+    uint8_t ready[SESSION_TABLE_MAX];   // Sessions waiting for a worker, FIFO
+    size_t ready_head;
+    size_t ready_count;
+    uint32_t clock;
+} session_table_t;
+
+/*
+ * @brief Initialize an empty table
+ *
+ * @param t Table
+ * @param count Number of sessions, at most SESSION_TABLE_MAX
+ * @param storage Buffer of count * depth * item_size bytes
+ * @param depth Items each session can hold, at least 1
+ * @param item_size Size of one work item in bytes
+ */
+void session_table_init(session_table_t *t, size_t count, void *storage, size_t depth, size_t item_size);
+
+/*
+ * @brief Check a session name taken from a topic
+ *
+ * @return true if the name is short enough and has only allowed characters
+ */
+bool session_name_valid(const char *name, size_t len);
+
+/*
+ * @brief Find a session by name, creating it if needed
+ *
+ * A new session takes a free slot, or the least recently used session that
+ * is idle: not taken by a worker and with nothing pending. The default
+ * session ("") is never evicted: once opened it keeps its slot.
+ *
+ * @param t Table
+ * @param name Session name, need not be NUL-terminated; must be valid
+ * @param len Name length
+ * @param created Set to true if the session was created, may be NULL
+ * @return Session index, or -1 if every session is active
+ */
+int session_table_open(session_table_t *t, const char *name, size_t len, bool *created);
+
+/*
+ * @brief Queue a copy of an item at the end of a session's FIFO
+ *
+ * @return false if the FIFO is full, the item is then not queued
+ */
+bool session_table_post(session_table_t *t, int session, const void *item);
+
+/*
+ * @brief Take the oldest item of the first ready session, for a worker
+ *
+ * The session stays taken, nobody else gets its items, until session_table_done().
+ *
+ * @param t Table
+ * @param session Receives the session index
+ * @param item Receives a copy of the item
+ * @return false if no session is ready
+ */
+bool session_table_take(session_table_t *t, int *session, void *item);
+
+/*
+ * @brief Give a session back once its item is handled
+ *
+ * The session goes back to the end of the ready list if it has more work.
+ */
+void session_table_done(session_table_t *t, int session);
+
+/*
+ * Called by session_table_purge() for each pending item, returns true to
+ * remove it; may release what the item owns.
+ */
+typedef bool (*session_table_drop_fn)(void *item, void *ctx);
+
+/*
+ * @brief Remove the pending items selected by drop, from every session
+ *
+ * The remaining items keep their order. A session left with nothing
+ * pending leaves the ready list.
+ *
+ * @return Number of items removed
+ */
+size_t session_table_purge(session_table_t *t, session_table_drop_fn drop, void *ctx);
+
+/*
+ * @brief Remove the pending items selected by drop, from one session only
+ *
+ * Same as session_table_purge(), the other sessions keep every item.
+ *
+ * @return Number of items removed
+ */
+size_t session_table_purge_session(session_table_t *t, int session, session_table_drop_fn drop, void *ctx);
+
+/*
+ * @brief Name of a session, "" for the default one
+ */
+const char *session_table_name(const session_table_t *t, int session);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,48 @@
+#include "slab_pool.h"
+
+void slab_pool_init(slab_pool_t *p, void *storage, size_t buf_size, size_t count)
+{
+    p->storage = storage;
+    p->buf_size = SLAB_POOL_BUF_STRIDE(buf_size);
+    p->count = count;
+    p->stats = (slab_pool_stats_t){0};
+
+    // Chain every buffer, lowest address first
+    p->free_list = NULL;
+    for (size_t i = count; i > 0; i--) {
+        void **buf = (void **)(p->storage + (i - 1) * p->buf_size);
+        *buf = p->free_list;
+        p->free_list = buf;
+    }
+}
+
+void *slab_pool_alloc(slab_pool_t *p)
+{
+    void **buf = p->free_list;
+    if (buf == NULL) {
+        p->stats.exhausted++;
+        return NULL;
+    }
+    p->free_list = *buf;
+
+    p->stats.in_use++;
+    if (p->stats.in_use > p->stats.high_water) {
+        p->stats.high_water = p->stats.in_use;
+    }
+    return buf;
+}
+
+void slab_pool_free(slab_pool_t *p, void *buf)
+{
+    if (buf == NULL) {
+        return;
+    }
+    *(void **)buf = p->free_list;
+    p->free_list = buf;
+    p->stats.in_use--;
+}
+
+size_t slab_pool_available(const slab_pool_t *p)
+{
+    return p->count - p->stats.in_use;
+}
@@ -0,0 +1,69 @@
+/*
+ * Fixed-size buffer pool
+ *
+ * Hands out buffers of one size from a single block allocated once, so
+ * messages kept for a while never fragment the heap. Free buffers are
+ * chained through their own first bytes: allocating and freeing are O(1)
+ * and need no extra memory.
+ *
+ * Not thread-safe, the caller serializes access.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t in_use;
+    uint32_t high_water;        // Most buffers in use at once
+    uint32_t exhausted;         // Allocations that failed because every buffer was in use
+} slab_pool_stats_t;
+
+typedef struct {
+    uint8_t *storage;
+    size_t buf_size;            // Rounded up to keep every buffer pointer-aligned
+    size_t count;
+    void *free_list;
+    slab_pool_stats_t stats;
+} slab_pool_t;
+
+// Storage to provide for count buffers of buf_size bytes
+#define SLAB_POOL_BUF_STRIDE(buf_size) \
+    ((((buf_size) < sizeof(void *) ? sizeof(void *) : (buf_size)) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+#define SLAB_POOL_STORAGE_SIZE(count, buf_size) ((count) * SLAB_POOL_BUF_STRIDE(buf_size))
+
+/*
+ * @brief Initialize a pool with every buffer free
+ *
+ * @param p Pool
+ * @param storage SLAB_POOL_STORAGE_SIZE(count, buf_size) bytes, pointer-aligned
+ * @param buf_size Usable size of one buffer
+ * @param count Number of buffers
+ */
+void slab_pool_init(slab_pool_t *p, void *storage, size_t buf_size, size_t count);
+
+/*
+ * @brief Take a free buffer of at least buf_size bytes
+ *
+ * @return Buffer, or NULL when every buffer is in use
+ */
+void *slab_pool_alloc(slab_pool_t *p);
+
+/*
+ * @brief Give a buffer back to the pool, NULL is ignored
+ */
+void slab_pool_free(slab_pool_t *p, void *buf);
+
+/*
+ * @brief Number of free buffers
+ */
+size_t slab_pool_available(const slab_pool_t *p);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,100 @@
+#include "spsc_ring.h"
+
+// Each record starts with its length; this length marks the skipped end of the buffer
+#define RECORD_PAD UINT32_MAX
+#define HDR_LEN sizeof(uint32_t)
+
+// Space taken by a record, headers stay 4-byte aligned
+static uint32_t record_space(size_t len)
+{
+    return (HDR_LEN + len + 3) & ~3u;
+}
+
+static uint32_t *hdr_at(const spsc_ring_t *r, uint32_t pos)
+{
+    return (uint32_t *)(r->buf + (pos & r->mask));
+}
+
+bool spsc_ring_init(spsc_ring_t *r, void *buf, size_t size)
+{
+    if (size < 16 || (size & (size - 1)) != 0) {
+        return false;
+    }
+    r->buf = buf;
+    r->mask = size - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->cached_tail = 0;
+    r->cached_head = 0;
+    r->reserved = 0;
+    return true;
+}
+
+size_t spsc_ring_max_record(const spsc_ring_t *r)
+{
+    // Worst case the padding skips just under one record at the end of the buffer
+    return (r->mask + 1) / 2 - HDR_LEN;
+}
+
+void *spsc_ring_reserve(spsc_ring_t *r, size_t len)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t space = record_space(len);
+    uint32_t to_end = r->mask + 1 - (head & r->mask);
+    uint32_t pad = space > to_end ? to_end : 0;
+    uint32_t size = r->mask + 1;
+
+    if (len > spsc_ring_max_record(r)) {
+        return NULL;
+    }
+    if (size - (head - r->cached_tail) < pad + space) {
+        // Looks full: see how far the consumer got since last time
+        r->cached_tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (size - (head - r->cached_tail) < pad + space) {
+            return NULL;
+        }
+    }
+
+    if (pad > 0) {
+        // Not visible to the consumer before the commit moves head past it
+        *hdr_at(r, head) = RECORD_PAD;
+    }
+    r->reserved = head + pad;
+    return hdr_at(r, r->reserved) + 1;
+}
+
+void spsc_ring_commit(spsc_ring_t *r, size_t len)
+{
+    *hdr_at(r, r->reserved) = len;
+    // Record (and padding) become visible to the consumer
+    atomic_store_explicit(&r->head, r->reserved + record_space(len), memory_order_release);
+}
+
+const void *spsc_ring_peek(spsc_ring_t *r, size_t *len_out)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    while (1) {
+        if (tail == r->cached_head) {
+            r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+            if (tail == r->cached_head) {
+                return NULL;
+            }
+        }
+        uint32_t len = *hdr_at(r, tail);
+        if (len != RECORD_PAD) {
+            *len_out = len;
+            return hdr_at(r, tail) + 1;
+        }
+        // Skip the padding at the end of the buffer, its space goes back to the producer
+        tail += r->mask + 1 - (tail & r->mask);
+        atomic_store_explicit(&r->tail, tail, memory_order_release);
+    }
+}
+
+void spsc_ring_release(spsc_ring_t *r)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t len = *hdr_at(r, tail);
+    atomic_store_explicit(&r->tail, tail + record_space(len), memory_order_release);
+}
@@ -0,0 +1,92 @@
+/*
+ * Lock-free single-producer single-consumer ring of variable-length records
+ *
+ * The producer reserves contiguous space, writes the record in place and
+ * commits it; the consumer reads the record in place and releases it. No
+ * copy is made besides the producer's own write, and no lock is taken: the
+ * head index is only written by the producer and the tail index only by
+ * the consumer, each in its own cache line so the two sides do not keep
+ * invalidating each other's line.
+ *
+ * A record never wraps around the end of the buffer: when it does not fit
+ * there, the rest of the buffer is skipped with a padding marker.
+ */
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SPSC_RING_CACHE_LINE
+#define SPSC_RING_CACHE_LINE 64
+#endif
+
+typedef struct {
+    // Producer side
+    _Alignas(SPSC_RING_CACHE_LINE) _Atomic uint32_t head;  // Bytes committed since init
+    uint32_t cached_tail;       // Last tail seen by the producer, refreshed when space looks short
+    uint32_t reserved;          // Start of the reserved record, after any padding
+    // Consumer side
+    _Alignas(SPSC_RING_CACHE_LINE) _Atomic uint32_t tail;  // Bytes released since init
+    uint32_t cached_head;       // Last head seen by the consumer, refreshed when the ring looks empty
+    // Shared, read-only after init
+    _Alignas(SPSC_RING_CACHE_LINE) uint8_t *buf;
+    uint32_t mask;              // size - 1
+} spsc_ring_t;
+
+/*
+ * @brief Initialize an empty ring
+ *
+ * @param r Ring
+ * @param buf Buffer of size bytes, 4-byte aligned
+ * @param size Buffer size, a power of two of at least 16 bytes
+ * @return false if size is not a power of two or too small
+ */
+bool spsc_ring_init(spsc_ring_t *r, void *buf, size_t size);
+
+/*
+ * @brief Largest record that always fits in an empty ring
+ */
+size_t spsc_ring_max_record(const spsc_ring_t *r);
+
+/*
+ * @brief Reserve contiguous space for one record, producer only
+ *
+ * Nothing is visible to the consumer until spsc_ring_commit().
+ *
+ * @param r Ring
+ * @param len Record length in bytes
+ * @return Space to write the record into, or NULL if the ring is too full
+ */
+void *spsc_ring_reserve(spsc_ring_t *r, size_t len);
+
+/*
+ * @brief Publish the reserved record, producer only
+ *
+ * @param r Ring
+ * @param len Final record length, at most the reserved length
+ */
+void spsc_ring_commit(spsc_ring_t *r, size_t len);
+
+/*
+ * @brief Oldest committed record, left in the ring until released, consumer only
+ *
+ * @param r Ring
+ * @param len_out Record length
+ * @return Record, or NULL if the ring is empty
+ */
+const void *spsc_ring_peek(spsc_ring_t *r, size_t *len_out);
+
+/*
+ * @brief Free the record returned by spsc_ring_peek(), consumer only
+ */
+void spsc_ring_release(spsc_ring_t *r);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "topic_ns.h"
+
+void topic_ns_mac_id(char out[TOPIC_NS_MAC_ID_LEN + 1], const uint8_t mac[6])
+{
+    static const char hex[] = "0123456789abcdef";
+
+    for (int i = 0; i < 6; i++) {
+        out[2 * i] = hex[mac[i] >> 4];
+        out[2 * i + 1] = hex[mac[i] & 0x0F];
+    }
+    out[TOPIC_NS_MAC_ID_LEN] = '\0';
+}
+
+bool topic_ns_init(topic_ns_t *ns, const char *prefix, const char *device_id)
+{
+    ns->base[0] = '\0';
+    ns->base_len = 0;
+    if (prefix[0] == '\0') {
+        return true;
+    }
+
+    // Published names must not hold wildcards, the identifier is a single level
+    if (strpbrk(prefix, "+#") != NULL || device_id[0] == '\0' || strpbrk(device_id, "+#/") != NULL) {
+        return false;
+    }
+    int n = snprintf(ns->base, sizeof(ns->base), "%s/%s", prefix, device_id);
+    if (n < 0 || (size_t)n >= sizeof(ns->base)) {
+        ns->base[0] = '\0';
+        return false;
+    }
+    ns->base_len = n;
+    return true;
+}
+
+bool topic_ns_build(const topic_ns_t *ns, const char *topic, char *out, size_t len)
+{
+    int n = snprintf(out, len, "%s%s", ns->base, topic);
+    return n >= 0 && (size_t)n < len;
+}
+
+const char *topic_ns_strip(const topic_ns_t *ns, const char *topic, size_t len, size_t *rest_len)
+{
+    // The namespace must be followed by a level separator, not by more characters of a level
+    if (len <= ns->base_len || memcmp(topic, ns->base, ns->base_len) != 0 || topic[ns->base_len] != '/') {
+        return NULL;
+    }
+    *rest_len = len - ns->base_len;
+    return topic + ns->base_len;
+}
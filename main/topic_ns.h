@@ -0,0 +1,74 @@
+/*
+ * Per-device topic namespace
+ *
+ * On a shared broker every device subscribing to the flat topics receives
+ * the traffic of the whole fleet. Namespaced topics put the device
+ * identifier in the path, <prefix>/<device id>/<topic>, e.g.
+ * esp32/a1b2c3d4e5f6/esp_gpt_out: each device only subscribes to its own
+ * subtree and a computer follows the fleet with one wildcard filter,
+ * esp32/+/esp_gpt_out. With an empty prefix the flat topics are kept.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longest namespace, prefix and device identifier included
+#define TOPIC_NS_BASE_MAX 40
+// Device identifier made from a MAC address: 12 hex digits
+#define TOPIC_NS_MAC_ID_LEN 12
+
+typedef struct {
+    char base[TOPIC_NS_BASE_MAX + 1];   // "<prefix>/<device id>", "" for flat topics
+    size_t base_len;
+} topic_ns_t;
+
+/*
+ * @brief Device identifier from a MAC address, lowercase hex without separators
+ *
+ * @param out Receives TOPIC_NS_MAC_ID_LEN characters and a NUL
+ * @param mac MAC address
+ */
+void topic_ns_mac_id(char out[TOPIC_NS_MAC_ID_LEN + 1], const uint8_t mac[6]);
+
+/*
+ * @brief Set up a namespace
+ *
+ * @param ns Namespace
+ * @param prefix First topic levels, may contain '/'; "" for flat topics
+ * @param device_id Device identifier, one topic level; ignored for flat topics
+ * @return false if a name holds a wildcard, the identifier is empty or holds
+ *         a '/', or the namespace is longer than TOPIC_NS_BASE_MAX
+ */
+bool topic_ns_init(topic_ns_t *ns, const char *prefix, const char *device_id);
+
+/*
+ * @brief Full topic of a device topic
+ *
+ * @param ns Namespace
+ * @param topic Device topic, starting with '/', e.g. "/esp_gpt_out"
+ * @param out Receives the full topic
+ * @param len Size of out
+ * @return false if out is too small
+ */
+bool topic_ns_build(const topic_ns_t *ns, const char *topic, char *out, size_t len);
+
+/*
+ * @brief Device topic of a full topic received from the broker
+ *
+ * @param ns Namespace
+ * @param topic Full topic, need not be NUL-terminated
+ * @param len Topic length
+ * @param rest_len Receives the device topic length
+ * @return Device topic within topic, starting with '/', or NULL if the topic is outside the namespace
+ */
+const char *topic_ns_strip(const topic_ns_t *ns, const char *topic, size_t len, size_t *rest_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,47 @@
+#include <string.h>
+
+#include "wifi_cache.h"
+
+static uint32_t octets(const uint8_t o[4])
+{
+    return (uint32_t)o[0] << 24 | (uint32_t)o[1] << 16 | (uint32_t)o[2] << 8 | o[3];
+}
+
+bool wifi_cache_valid(const wifi_cache_t *cache, size_t len)
+{
+    static const uint8_t zero[6] = {0};
+
+    if (len != sizeof(*cache) || cache->version != WIFI_CACHE_VERSION) {
+        return false;
+    }
+    if (memchr(cache->ssid, '\0', sizeof(cache->ssid)) == NULL || cache->ssid[0] == '\0' ||
+        memchr(cache->password, '\0', sizeof(cache->password)) == NULL) {
+        return false;
+    }
+    // 2.4 GHz channels 1-14, 5 GHz channels up to 177
+    if (cache->channel < 1 || cache->channel > 177) {
+        return false;
+    }
+    // Group bit set: not the address of one access point
+    return memcmp(cache->bssid, zero, sizeof(zero)) != 0 && (cache->bssid[0] & 0x01) == 0;
+}
+
+bool wifi_cache_lease_valid(const wifi_cache_t *cache)
+{
+    uint32_t ip = octets(cache->ip);
+    uint32_t mask = octets(cache->netmask);
+    uint32_t gw = octets(cache->gateway);
+
+    if (ip == 0 || gw == 0 || mask == 0 || ip == gw) {
+        return false;
+    }
+    // Contiguous: the host bits plus one is a power of two
+    uint32_t host = ~mask;
+    if ((host & (host + 1)) != 0) {
+        return false;
+    }
+    if ((ip & mask) != (gw & mask)) {
+        return false;
+    }
+    return (ip & host) != 0 && (ip & host) != host;
+}
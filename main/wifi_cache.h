@@ -0,0 +1,55 @@
+/*
+ * Cached Wi-Fi connection
+ *
+ * Hardware-independent part of the Wi-Fi fast connect (wifi_fast.h): the
+ * record kept in NVS after each successful connection, i.e. credentials,
+ * the access point's BSSID and channel and the DHCP lease, and its checks
+ * before a directed connect is attempted with it.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bumped whenever the layout of wifi_cache_t changes, older records are ignored
+#define WIFI_CACHE_VERSION 1
+
+typedef struct {
+    uint8_t version;
+    uint8_t channel;            // Primary channel of the access point
+    uint8_t bssid[6];
+    char ssid[33];              // NUL-terminated, 32 characters at most
+    char password[65];
+    // DHCP lease, octets in network order
+    uint8_t ip[4];
+    uint8_t netmask[4];
+    uint8_t gateway[4];
+    uint8_t dns[4];
+} wifi_cache_t;
+
+/*
+ * @brief Check a record read back from NVS before connecting with it
+ *
+ * @param cache Record
+ * @param len Size of the stored record, sizeof(wifi_cache_t) unless the layout changed
+ * @return true if it names an access point: right version, SSID, unicast BSSID, valid channel
+ */
+bool wifi_cache_valid(const wifi_cache_t *cache, size_t len);
+
+/*
+ * @brief Check that the cached lease can be used as a static address
+ *
+ * Address, netmask and gateway set, contiguous netmask, address and
+ * gateway distinct and in the same subnet, address neither the network
+ * nor the broadcast address.
+ */
+bool wifi_cache_lease_valid(const wifi_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif
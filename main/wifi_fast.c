@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "nvs.h"
+#include "protocol_examples_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#include "wifi_fast.h"
+#include "app_boot.h"
+#include "app_metrics.h"
+
+#if CONFIG_WIFI_FAST_CONNECT
+#include "esp_wifi.h"
+#include "wifi_cache.h"
+
+static const char *TAG = "wifi_fast";
+
+#define NVS_NAMESPACE "wifi_fast"
+#define NVS_KEY "cache"
+// Directed attempts after a lost connection before the access point is searched on every channel
+#define DIRECTED_RETRIES 3
+
+#define GOT_IP_BIT BIT0
+#define GOT_IP6_BIT BIT1
+
+#if CONFIG_EXAMPLE_CONNECT_IPV6
+// Same address type example_connect() waits for
+#if CONFIG_EXAMPLE_CONNECT_IPV6_PREF_GLOBAL
+#define PREFERRED_IPV6_TYPE ESP_IP6_ADDR_IS_GLOBAL
+#elif CONFIG_EXAMPLE_CONNECT_IPV6_PREF_SITE_LOCAL
+#define PREFERRED_IPV6_TYPE ESP_IP6_ADDR_IS_SITE_LOCAL
+#elif CONFIG_EXAMPLE_CONNECT_IPV6_PREF_UNIQUE_LOCAL
+#define PREFERRED_IPV6_TYPE ESP_IP6_ADDR_IS_UNIQUE_LOCAL
+#else
+#define PREFERRED_IPV6_TYPE ESP_IP6_ADDR_IS_LINK_LOCAL
+#endif
+#define CONNECTED_BITS (GOT_IP_BIT | GOT_IP6_BIT)
+#else
+#define CONNECTED_BITS GOT_IP_BIT
+#endif
+
+typedef enum {
+    WIFI_PATH_NONE,
+    WIFI_PATH_CACHED,           // Directed connect with the cached record
+    WIFI_PATH_SCAN,             // example_connect(): scan of every channel and DHCP
+} wifi_path_t;
+
+static const char *const s_path_names[] = {"none", "cached", "scan"};
+
+static EventGroupHandle_t s_events;
+static esp_netif_t *s_netif = NULL;         // Interface of the cached path, NULL once torn down
+static wifi_cache_t s_cache;                // As stored in NVS
+static bool s_cache_loaded = false;
+static int s_directed_failures = 0;
+
+// Timings of the latest connection, since the start of its attempt
+static struct {
+    wifi_path_t path;
+    bool fell_back;             // The cached path was tried first and failed
+    int64_t attempt_us;
+    int64_t assoc_us;           // Attempt start to association, -1 until associated
+    int64_t ip_us;              // Attempt start to IP address, -1 until assigned
+    uint32_t reconnects;
+} s_stats = {.assoc_us = -1, .ip_us = -1};
+
+static void start_attempt(wifi_path_t path)
+{
+    s_stats.path = path;
+    s_stats.attempt_us = esp_timer_get_time();
+    s_stats.assoc_us = -1;
+    s_stats.ip_us = -1;
+}
+
+/*
+ * @brief Time both paths: association and IP address, for every connection
+ */
+static void timing_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    int64_t elapsed_us = esp_timer_get_time() - s_stats.attempt_us;
+
+    if (base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        // Reconnections after boot are counted and timed again
+        if (xEventGroupGetBits(s_events) & GOT_IP_BIT) {
+            xEventGroupClearBits(s_events, GOT_IP_BIT | GOT_IP6_BIT);
+            s_stats.reconnects++;
+            start_attempt(s_stats.path);
+        }
+    } else if (base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        s_stats.assoc_us = elapsed_us;
+        s_directed_failures = 0;
+    } else if (base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        s_stats.ip_us = elapsed_us;
+        ESP_LOGI(TAG, "Connected (%s): associated in %" PRId64 " ms, IP address in %" PRId64 " ms",
+                 s_path_names[s_stats.path], s_stats.assoc_us / 1000, s_stats.ip_us / 1000);
+        xEventGroupSetBits(s_events, GOT_IP_BIT);
+    }
+}
+
+/*
+ * @brief Reconnect on the cached path, searching every channel once the access point stopped answering
+ */
+static void disconnect_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    if (++s_directed_failures == DIRECTED_RETRIES) {
+        wifi_config_t cfg;
+        ESP_LOGW(TAG, "Access point %02x:%02x:%02x:%02x:%02x:%02x lost, scanning every channel",
+                 s_cache.bssid[0], s_cache.bssid[1], s_cache.bssid[2],
+                 s_cache.bssid[3], s_cache.bssid[4], s_cache.bssid[5]);
+        if (esp_wifi_get_config(WIFI_IF_STA, &cfg) == ESP_OK) {
+            cfg.sta.bssid_set = false;
+            cfg.sta.channel = 0;
+            cfg.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+            esp_wifi_set_config(WIFI_IF_STA, &cfg);
+        }
+    }
+    esp_wifi_connect();
+}
+
+#if CONFIG_EXAMPLE_CONNECT_IPV6
+/*
+ * @brief IPv6 on the cached path, as example_connect() sets it up: link-local address at every association
+ */
+static void ipv6_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    if (base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        esp_netif_create_ip6_linklocal(s_netif);
+    } else if (base == IP_EVENT && event_id == IP_EVENT_GOT_IP6) {
+        ip_event_got_ip6_t *event = (ip_event_got_ip6_t *)event_data;
+        if (event->esp_netif == s_netif &&
+            esp_netif_ip6_get_addr_type(&event->ip6_info.ip) == PREFERRED_IPV6_TYPE) {
+            ESP_LOGI(TAG, "IPv6 address " IPV6STR, IPV62STR(event->ip6_info.ip));
+            xEventGroupSetBits(s_events, GOT_IP6_BIT);
+        }
+    }
+}
+#endif
+
+static bool load_cache(void)
+{
+    nvs_handle_t nvs;
+    size_t len = sizeof(s_cache);
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    esp_err_t err = nvs_get_blob(nvs, NVS_KEY, &s_cache, &len);
+    nvs_close(nvs);
+    if (err != ESP_OK || !wifi_cache_valid(&s_cache, len)) {
+        if (err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Ignoring cached Wi-Fi connection (%s)", esp_err_to_name(err));
+        }
+        return false;
+    }
+    return true;
+}
+
+/*
+ * @brief Cache the current connection for the next boots, if anything changed
+ */
+static void save_cache(esp_netif_t *netif)
+{
+    wifi_cache_t cache = {.version = WIFI_CACHE_VERSION};
+    wifi_config_t cfg;
+    wifi_ap_record_t ap;
+    esp_netif_ip_info_t ip;
+    esp_netif_dns_info_t dns;
+
+    if (netif == NULL || esp_wifi_get_config(WIFI_IF_STA, &cfg) != ESP_OK ||
+        esp_wifi_sta_get_ap_info(&ap) != ESP_OK || esp_netif_get_ip_info(netif, &ip) != ESP_OK) {
+        ESP_LOGW(TAG, "Connection details unavailable, not cached");
+        return;
+    }
+    // The driver's fields are not NUL-terminated when full, the record's are one longer
+    memcpy(cache.ssid, cfg.sta.ssid, sizeof(cfg.sta.ssid));
+    memcpy(cache.password, cfg.sta.password, sizeof(cfg.sta.password));
+    memcpy(cache.bssid, ap.bssid, sizeof(cache.bssid));
+    cache.channel = ap.primary;
+    memcpy(cache.ip, &ip.ip.addr, 4);
+    memcpy(cache.netmask, &ip.netmask.addr, 4);
+    memcpy(cache.gateway, &ip.gw.addr, 4);
+    if (esp_netif_get_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK && dns.ip.type == ESP_IPADDR_TYPE_V4) {
+        memcpy(cache.dns, &dns.ip.u_addr.ip4.addr, 4);
+    }
+
+    // Spare the flash when the same access point gave the same lease
+    if (s_cache_loaded && memcmp(&cache, &s_cache, sizeof(cache)) == 0) {
+        return;
+    }
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, NVS_KEY, &cache, sizeof(cache));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Wi-Fi connection not cached: %s", esp_err_to_name(err));
+        return;
+    }
+    s_cache = cache;
+    s_cache_loaded = true;
+    ESP_LOGI(TAG, "Cached access point %s on channel %d", cache.ssid, cache.channel);
+}
+
+#if CONFIG_WIFI_FAST_STATIC_IP
+/*
+ * @brief Skip DHCP: the cached lease becomes the static address
+ */
+static void set_static_ip(void)
+{
+    esp_netif_ip_info_t ip;
+    esp_netif_dns_info_t dns = {.ip.type = ESP_IPADDR_TYPE_V4};
+
+    memcpy(&ip.ip.addr, s_cache.ip, 4);
+    memcpy(&ip.netmask.addr, s_cache.netmask, 4);
+    memcpy(&ip.gw.addr, s_cache.gateway, 4);
+    memcpy(&dns.ip.u_addr.ip4.addr, s_cache.dns, 4);
+    if (esp_netif_dhcpc_stop(s_netif) != ESP_OK || esp_netif_set_ip_info(s_netif, &ip) != ESP_OK) {
+        ESP_LOGW(TAG, "Static address not set, using DHCP");
+        esp_netif_dhcpc_start(s_netif);
+        return;
+    }
+    if (dns.ip.u_addr.ip4.addr != 0) {
+        esp_netif_set_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns);
+    }
+    ESP_LOGI(TAG, "Static address %d.%d.%d.%d", s_cache.ip[0], s_cache.ip[1], s_cache.ip[2], s_cache.ip[3]);
+}
+#endif
+
+/*
+ * @brief Release everything the cached path set up, so that example_connect() starts clean
+ */
+static void teardown_cached(void)
+{
+    esp_event_handler_unregister(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, disconnect_handler);
+#if CONFIG_EXAMPLE_CONNECT_IPV6
+    esp_event_handler_unregister(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, ipv6_handler);
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_GOT_IP6, ipv6_handler);
+#endif
+    esp_wifi_disconnect();
+    esp_wifi_stop();
+    esp_wifi_deinit();
+    esp_netif_destroy_default_wifi(s_netif);
+    s_netif = NULL;
+}
+
+/*
+ * @brief Directed connect to the cached access point on its channel
+ *
+ * With CONFIG_EXAMPLE_CONNECT_IPV6, waits for an IPv6 address too, as example_connect() does.
+ *
+ * @return ESP_OK once the addresses are assigned, ESP_ERR_TIMEOUT after the fast connect timeout
+ */
+static esp_err_t connect_cached(void)
+{
+    wifi_init_config_t init = WIFI_INIT_CONFIG_DEFAULT();
+    wifi_config_t cfg = {0};
+
+    s_netif = esp_netif_create_default_wifi_sta();
+    esp_err_t err = esp_wifi_init(&init);
+    if (err != ESP_OK) {
+        esp_netif_destroy_default_wifi(s_netif);
+        s_netif = NULL;
+        return err;
+    }
+    // The record is in NVS already, the driver would write its config to flash at every boot
+    esp_wifi_set_storage(WIFI_STORAGE_RAM);
+    esp_wifi_set_mode(WIFI_MODE_STA);
+
+    memcpy(cfg.sta.ssid, s_cache.ssid, strnlen(s_cache.ssid, sizeof(cfg.sta.ssid)));
+    memcpy(cfg.sta.password, s_cache.password, strnlen(s_cache.password, sizeof(cfg.sta.password)));
+    cfg.sta.bssid_set = true;
+    memcpy(cfg.sta.bssid, s_cache.bssid, sizeof(cfg.sta.bssid));
+    // Known channel: only that one is probed, no scan of the band
+    cfg.sta.channel = s_cache.channel;
+    cfg.sta.scan_method = WIFI_FAST_SCAN;
+    esp_wifi_set_config(WIFI_IF_STA, &cfg);
+#if CONFIG_WIFI_FAST_STATIC_IP
+    if (wifi_cache_lease_valid(&s_cache)) {
+        set_static_ip();
+    }
+#endif
+    esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, disconnect_handler, NULL);
+#if CONFIG_EXAMPLE_CONNECT_IPV6
+    esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, ipv6_handler, NULL);
+    esp_event_handler_register(IP_EVENT, IP_EVENT_GOT_IP6, ipv6_handler, NULL);
+#endif
+
+    start_attempt(WIFI_PATH_CACHED);
+    esp_wifi_start();
+    esp_wifi_connect();
+    EventBits_t bits = xEventGroupWaitBits(s_events, CONNECTED_BITS, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(CONFIG_WIFI_FAST_TIMEOUT_MS));
+    if ((bits & CONNECTED_BITS) != CONNECTED_BITS) {
+        teardown_cached();
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+/*
+ * @brief Metrics writer: path and timings of the latest connection
+ */
+static int wifi_metrics_writer(char *buf, size_t len, int64_t interval_us)
+{
+    return snprintf(buf, len,
+                    "{\"path\":\"%s\",\"fell_back\":%s,\"assoc_ms\":%" PRId64 ",\"ip_ms\":%" PRId64
+                    ",\"reconnects\":%" PRIu32 "}",
+                    s_path_names[s_stats.path], s_stats.fell_back ? "true" : "false",
+                    s_stats.assoc_us < 0 ? -1 : s_stats.assoc_us / 1000,
+                    s_stats.ip_us < 0 ? -1 : s_stats.ip_us / 1000, s_stats.reconnects);
+}
+
+esp_err_t wifi_fast_connect(void)
+{
+    s_events = xEventGroupCreate();
+    if (s_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    // Registered before the path handlers, so the timings restart before a reconnection
+    esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, timing_handler, NULL);
+    esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, timing_handler, NULL);
+    esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, timing_handler, NULL);
+    app_metrics_register("wifi", wifi_metrics_writer);
+
+    s_cache_loaded = load_cache();
+    if (s_cache_loaded) {
+        int step = app_boot_step_begin("wifi_cached");
+        esp_err_t err = connect_cached();
+        app_boot_step_end(step);
+        if (err == ESP_OK) {
+            // Lease renewed by DHCP, or access point changed after a lost connection
+            save_cache(s_netif);
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "Cached access point not reached (%s), scanning", esp_err_to_name(err));
+        s_stats.fell_back = true;
+    }
+
+    int step = app_boot_step_begin("wifi_scan");
+    start_attempt(WIFI_PATH_SCAN);
+    esp_err_t err = example_connect();
+    app_boot_step_end(step);
+    if (err == ESP_OK) {
+        save_cache(get_example_netif());
+    }
+    return err;
+}
+
+#else
+
+esp_err_t wifi_fast_connect(void)
+{
+    return example_connect();
+}
+
+#endif /* CONFIG_WIFI_FAST_CONNECT */
@@ -0,0 +1,36 @@
+/*
+ * Wi-Fi fast connect
+ *
+ * example_connect() scans every channel and runs DHCP at each boot, and
+ * with CONFIG_EXAMPLE_WIFI_SSID_PWD_FROM_STDIN waits for the credentials
+ * on the console. After the first connection the credentials, the access
+ * point's BSSID and channel and the DHCP lease are cached in NVS
+ * (wifi_cache.h); the following boots connect straight to that access
+ * point on that channel, optionally with the lease as static address
+ * (CONFIG_WIFI_FAST_STATIC_IP), and fall back to example_connect() if
+ * that does not succeed within CONFIG_WIFI_FAST_TIMEOUT_MS.
+ *
+ * The path taken and the time to association and to IP address are
+ * reported under "wifi" on /esp32_metrics.
+ */
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * @brief Connect to the network, replaces example_connect()
+ *
+ * Blocks until an IP address is assigned. Without CONFIG_WIFI_FAST_CONNECT
+ * (Ethernet, or disabled in menuconfig) this is example_connect().
+ *
+ * @return ESP_OK, or the error of example_connect()
+ */
+esp_err_t wifi_fast_connect(void);
+
+#ifdef __cplusplus
+}
+#endif